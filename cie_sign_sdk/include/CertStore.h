@@ -2,20 +2,107 @@
 
 
 #include "Certificate.h"
+#include <atomic>
 #include <map>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <time.h>
+#include <vector>
 
 using namespace std;
 
+class CTrustedListSnapshot;
+
+// durata predefinita degli esiti in cache, in secondi
+#define CERTSTORE_DEFAULT_TTL	3600
+
+/*
+ * CA certificates indexed by the exact bytes of their SubjectKeyIdentifier and
+ * by their subject DN (DER). The issuer of a certificate is looked up by its
+ * AuthorityKeyIdentifier, or by its issuer DN when the AKI is missing.
+ *
+ * Signature checks are cached per (certificate, issuer) pair and the chain
+ * built above each store certificate is cached as a whole, both for the TTL
+ * (SetCacheTTL): verifying many documents signed under the same CA chain
+ * costs one lookup and one RSA verification (the signer's certificate) per
+ * document.
+ *
+ * A trusted list snapshot (SetTrustedList) is searched by SKI and DN after
+ * the store certificates: a granted certificate of the list is decoded the
+ * first time a lookup finds it, and kept until CleanUp.
+ *
+ * Lookups run in parallel; AddCertificate and CleanUp are exclusive and drop
+ * the cached results. Store certificates are fully decoded when added, so
+ * they can be read from several threads; the returned pointers stay valid
+ * until CleanUp.
+ */
 class CCertStore
 {
 public:
 
     static void AddCertificate(CCertificate& caCertificate);
 
+	// lo store diventa proprietario della snapshot e la sostituisce alla precedente
+	static void SetTrustedList(CTrustedListSnapshot* pSnapshot);
+
+	// issuer di certificate, NULL se non e' nello store o se certificate e' autofirmato
 	static CCertificate* GetCertificate(CCertificate& certificate);
 
+	// certificate.verifySignature(issuer), con l'esito in cache
+	static bool VerifySignature(CCertificate& certificate, CCertificate& issuer);
+
+	// certificati di CA sopra certificate, ciascuno verificato con il successivo.
+	// true se la catena termina con un certificato senza issuer nello store,
+	// false se una firma della catena non e' valida
+	static bool BuildChain(CCertificate& certificate, vector<CCertificate*>& chain);
+
+	// durata in secondi degli esiti in cache; 0 = nessuna cache
+	static void SetCacheTTL(long nSeconds);
+
+	// verifiche di firma servite dalla cache e verifiche eseguite, dall'avvio del processo
+	static void GetStats(long* pnHits, long* pnMisses);
+
 	static void CleanUp();
 
 private:
-	static map<unsigned long, CCertificate*> m_certMap;
+	struct Chain
+	{
+		vector<CCertificate*> certificates;
+		bool bComplete;
+		time_t nExpires;
+	};
+
+	struct Verification
+	{
+		bool bVerified;
+		time_t nExpires;
+	};
+
+	static CCertificate* findIssuer(CCertificate& certificate);
+	static CCertificate* fromTrustedList(const string& szKey, bool bSubject);
+	static string fingerprint(CCertificate& certificate);
+	static bool verify(CCertificate& certificate, CCertificate& issuer);
+	static bool buildChain(CCertificate& certificate, vector<CCertificate*>& chain, size_t nDepth);
+
+	// certificati e indici: lettori in parallelo, AddCertificate e CleanUp esclusivi
+	static shared_mutex m_storeMutex;
+	static vector<CCertificate*> m_certificates;
+	static map<string, CCertificate*> m_bySki;
+	static map<string, CCertificate*> m_bySubject;
+	static map<string, CCertificate*> m_byFingerprint;
+	static map<const CCertificate*, string> m_fingerprints;
+
+	// snapshot della trusted list e suoi certificati gia' decodificati, per SHA-256 del DER
+	static CTrustedListSnapshot* m_pTrustedList;
+	static mutex m_trustedListMutex;
+	static map<string, CCertificate*> m_fromTrustedList;
+
+	// esiti delle verifiche
+	static mutex m_cacheMutex;
+	static map<string, Verification> m_verifications;
+	static map<const CCertificate*, Chain> m_chains;
+	static long m_nTTL;
+	static atomic<long> m_nHits;
+	static atomic<long> m_nMisses;
 };
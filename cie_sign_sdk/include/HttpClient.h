@@ -0,0 +1,69 @@
+/*
+ *  HttpClient.h
+ *
+ *  HTTP client shared by the OCSP, CRL and TSA requests of the SDK.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "ASN1/UUCByteArray.h"
+
+#include <string>
+
+/*
+ * All requests go through a pool of curl easy handles bound to one curl share
+ * handle, so DNS entries, TLS sessions and open connections are reused across
+ * requests and threads: a second request to the same responder costs no DNS
+ * lookup, TCP handshake or TLS handshake. Connections are kept alive; with
+ * SetHttp2(true) HTTP/2 is negotiated over TLS (ALPN) and concurrent requests
+ * to the same host wait for a connection they can multiplex on.
+ *
+ * Perform is thread safe.
+ */
+class CHttpClient
+{
+public:
+	struct Request
+	{
+		const char* szUrl;
+		const UUCByteArray* pData;      // POST se non NULL
+		const char* szContentType;
+		const char* szUsername;         // autenticazione basic, NULL = nessuna
+		const char* szPassword;
+		const char* szETag;             // GET condizionale, NULL = nessun validatore
+		const char* szLastModified;
+		const char* szProxy;            // NULL = nessun proxy
+		long nProxyPort;                // 0 = quella del proxy
+		const char* szProxyUsrPass;
+		long nTimeout;                  // secondi per l'intera richiesta, 0 = nessun limite
+		bool bVerifyHost;               // verifica del nome host nel certificato TLS
+
+		Request(const char* url)
+		: szUrl(url), pData(NULL), szContentType(NULL), szUsername(NULL), szPassword(NULL),
+		  szETag(NULL), szLastModified(NULL), szProxy(NULL), nProxyPort(0), szProxyUsrPass(NULL), nTimeout(0), bVerifyHost(true)
+		{
+		}
+	};
+
+	struct Response
+	{
+		long nHttpCode;
+		UUCByteArray body;
+		std::string szETag;
+		std::string szLastModified;
+
+		Response() : nHttpCode(0) {}
+	};
+
+	// 0 se il server ha risposto (qualunque codice HTTP, in response.nHttpCode),
+	// altrimenti il codice di errore curl
+	static long Perform(const Request& request, Response& response);
+
+	// negoziazione HTTP/2 su TLS (predefinito: HTTP/1.1)
+	static void SetHttp2(bool bEnable);
+
+	// chiude le connessioni e libera gli handle; il client resta utilizzabile
+	static void CleanUp();
+};
@@ -0,0 +1,90 @@
+/*
+ *  PdfPreflight.h
+ *
+ *  Checks whether a PDF can be signed before the card is used, reading
+ *  only the trailer, the xref sections, the encryption dictionary, the
+ *  AcroForm and the DocMDP permissions.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "PdfRevisionMap.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// livelli di /Kids seguiti al massimo (documenti malformati con cicli)
+#define PDF_PREFLIGHT_MAX_DEPTH		32
+
+struct PdfPreflightField
+{
+	// nome completo (parent.child) e nome parziale /T, in UTF-8
+	std::string name;
+	std::string partialName;
+	// /V e' un dizionario firma, nel campo o in un suo widget
+	bool bSigned;
+};
+
+/*
+ * check() does not load the object graph: it reads the objects it needs
+ * through CPdfRevisionMap, as they are in the last revision of the file,
+ * so its cost depends on the size of the xref sections and of the field
+ * tree, not on the pages. The field names follow PdfSignatureFieldIndex,
+ * the index PdfSignatureGenerator uses when it signs.
+ */
+class CPdfPreflight
+{
+public:
+	CPdfPreflight();
+	virtual ~CPdfPreflight();
+
+	// 0, o DISIGON_ERROR_INVALID_FILE se il buffer non inizia con l'intestazione PDF;
+	// un file senza xref leggibile non e' un errore, ma needsRebuild()
+	long check(const BYTE* pbtData, size_t nLength);
+
+	bool encrypted() const { return m_bEncrypted; }
+
+	// xref illeggibile, offset sbagliati o ultimo aggiornamento troncato: PoDoFo
+	// ricostruisce la tabella leggendo l'intero file
+	bool needsRebuild() const { return m_bRebuild; }
+
+	// /P della firma di certificazione (1 nessuna modifica, 2 moduli e firme, 3 anche
+	// annotazioni); 0 se il documento non e' certificato
+	int docMdp() const { return m_nDocMdp; }
+
+	// catalogo letto e documento non cifrato: fields() e' completo
+	bool formRead() const { return m_bFormRead; }
+
+	size_t revisions() const { return m_nRevisions; }
+	size_t objects() const { return m_nObjects; }
+
+	// campi firma nell'ordine di /Fields, in profondita'
+	const std::vector<PdfPreflightField>& fields() const { return m_fields; }
+
+	// nome completo, altrimenti nome parziale; NULL se il campo non esiste
+	const PdfPreflightField* find(const std::string& name) const;
+
+	CPdfPreflight(const CPdfPreflight&) = delete;
+	CPdfPreflight& operator=(const CPdfPreflight&) = delete;
+
+private:
+	bool resolve(const std::string& value, std::map<std::string, std::string>& dict) const;
+	std::string resolve(const std::string& value) const;
+	void readDocMdp(const std::map<std::string, std::string>& catalog);
+	void addField(const std::string& value, const std::string& parentName, bool bInheritedSig, int nDepth);
+
+	CPdfRevisionMap m_map;
+	size_t m_nRevision;
+	bool m_bEncrypted;
+	bool m_bRebuild;
+	int m_nDocMdp;
+	bool m_bFormRead;
+	size_t m_nRevisions;
+	size_t m_nObjects;
+	std::vector<PdfPreflightField> m_fields;
+	std::set<uint32_t> m_visited;
+};
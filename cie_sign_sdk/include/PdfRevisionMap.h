@@ -0,0 +1,127 @@
+/*
+ *  PdfRevisionMap.h
+ *
+ *  Revisions of a PDF file (incremental updates) read from the xref
+ *  sections only, and classification of what each update changed.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "definitions.h"
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// modifiche di un aggiornamento incrementale rispetto alle revisioni precedenti
+#define PDF_UPDATE_ANNOTATION		0x01	// annotazioni aggiunte, modificate o rimosse
+#define PDF_UPDATE_FORM_FILL		0x02	// campi del modulo compilati
+#define PDF_UPDATE_SIGNATURE		0x04	// firme o campi firma
+#define PDF_UPDATE_CONTENT			0x08	// pagine, contenuto o struttura del documento
+
+// oggetti decompressi al massimo per uno stream di oggetti o di xref
+#define PDF_REVISION_MAX_STREAM		(64 * 1024 * 1024)
+
+/*
+ * scan() finds every startxref / %%EOF boundary of the file and reads the
+ * xref section of each revision: classic tables, xref streams and hybrid
+ * files. The file is not parsed as a whole: only the objects listed in the
+ * xref section of an update are read (their dictionaries, and the object
+ * streams that hold them) and compared with the previous version of the
+ * same object. With bClassify false scan() stops after the xref sections
+ * and trailers, and no object is read.
+ *
+ * The map refers to the buffer passed to scan(), which must outlive it.
+ * It is not thread safe: object streams are decompressed on first use.
+ */
+class CPdfRevisionMap
+{
+public:
+	struct Entry
+	{
+		uint32_t nGeneration;
+		// 0 libero, 1 nel file (nOffset), 2 nello stream di oggetti nOffset, indice nIndex
+		int nType;
+		uint64_t nOffset;
+		uint32_t nIndex;
+	};
+
+	struct Revision
+	{
+		// offset della sezione xref e fine della revisione, dopo %%EOF e il fine riga
+		size_t nXref;
+		size_t nEof;
+		size_t nEnd;
+		bool bXrefStream;
+		// dizionario del trailer o dello stream xref
+		std::string trailer;
+		// voci della sezione xref, per numero di oggetto
+		std::map<uint32_t, Entry> entries;
+		// PDF_UPDATE_* rispetto alle revisioni precedenti (0 per la prima, -1 se non classificata)
+		int nChanges;
+	};
+
+	CPdfRevisionMap();
+	virtual ~CPdfRevisionMap();
+
+	// 0 o DISIGON_ERROR_INVALID_FILE se non c'e' una sezione xref leggibile; senza
+	// bClassify legge solo xref e trailer (nChanges resta -1)
+	long scan(const BYTE* pbtData, size_t nLength, bool bClassify = true);
+
+	size_t count() const { return m_revisions.size(); }
+	const Revision& revision(size_t nRevision) const { return m_revisions[nRevision]; }
+
+	// revisione che termina dove termina la /ByteRange, che deve partire dall'inizio
+	// del file; -1 se la firma non copre esattamente una revisione
+	int revisionOf(const int64_t byteRange[4]) const;
+
+	// PDF_UPDATE_* degli aggiornamenti successivi a nRevision; -1 se scan() non li ha classificati
+	int changesAfter(int nRevision) const;
+
+	// dizionario dell'oggetto (e dati dello stream, se c'e', come sono nel file) come si
+	// presenta nella revisione nRevision; false se l'oggetto non esiste o non e' leggibile
+	bool object(uint32_t nNumber, size_t nRevision, std::string& dictionary, std::string* pStream = NULL) const;
+
+	// l'oggetto, come si presenta nella revisione nRevision, e' uno stream (anche vuoto)
+	bool hasStream(uint32_t nNumber, size_t nRevision) const;
+
+	// oggetti in uso nella revisione nRevision (anche definiti nelle precedenti) e quanti
+	// hanno un offset xref che non porta a "N G obj": il file va ricostruito per leggerlo
+	size_t brokenOffsets(size_t nRevision, size_t* pnObjects) const;
+
+	// dati di uno stream senza filtri o con /FlateDecode (anche con predittore PNG)
+	static bool decode(const std::string& dictionary, const std::string& stream, std::string& data);
+
+	// voci di un dizionario ed elementi di un array come restituiti da object(), ciascuno
+	// nella stessa forma canonica; riferimento N G R
+	static bool dictionary(const std::string& text, std::map<std::string, std::string>& entries);
+	static bool array(const std::string& text, std::vector<std::string>& items);
+	static bool reference(const std::string& text, uint32_t& nNumber);
+
+	// trailer valido nella revisione nRevision (/Root, /Encrypt, /Info, /ID)
+	const std::string& trailer(size_t nRevision) const { return m_revisions[nRevision].trailer; }
+
+	CPdfRevisionMap(const CPdfRevisionMap&) = delete;
+	CPdfRevisionMap& operator=(const CPdfRevisionMap&) = delete;
+
+private:
+	bool readXref(size_t nOffset, Revision& revision) const;
+	bool readXrefTable(size_t nOffset, Revision& revision) const;
+	bool readXrefStream(size_t nOffset, Revision& revision) const;
+	const Entry* find(uint32_t nNumber, size_t nRevision) const;
+	bool objectAt(size_t nOffset, uint32_t nNumber, std::string& dictionary, std::string* pStream) const;
+	bool objectInStream(uint32_t nStream, uint32_t nIndex, size_t nRevision, std::string& dictionary) const;
+	bool streamData(const std::string& dictionary, size_t nStart, std::string& data) const;
+	size_t linearizedXref(size_t* pnLength) const;
+	int classify(size_t nRevision) const;
+
+	const BYTE* m_pbtData;
+	size_t m_nLength;
+	std::vector<Revision> m_revisions;
+	// stream di oggetti decompressi, per offset nel file
+	mutable std::map<size_t, std::string> m_objectStreams;
+};
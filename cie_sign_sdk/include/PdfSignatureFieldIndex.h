@@ -0,0 +1,80 @@
+/*
+ *  PdfSignatureFieldIndex.h
+ *
+ *  Signature fields of a loaded PDF, collected in a single pass over the
+ *  AcroForm field tree and the page annotations.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "podofo/podofo.h"
+
+#include <array>
+#include <map>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// livelli di /Kids seguiti al massimo (documenti malformati con cicli)
+#define PDF_SIGNATURE_FIELD_MAX_DEPTH	32
+
+struct PdfSignatureFieldInfo
+{
+	// nome completo (parent.child) e nome parziale /T
+	std::string name;
+	std::string partialName;
+	const PoDoFo::PdfObject* field;
+	// primo widget del campo, lo stesso oggetto se campo e widget sono uniti
+	const PoDoFo::PdfObject* widget;
+	PoDoFo::PdfReference widgetRef;
+	// dizionario /V, anche se scritto nel widget; nullptr se manca
+	const PoDoFo::PdfObject* value;
+	// -1 se la pagina non e' nota
+	int pageIndex;
+	// false se il widget non e' nelle /Annots della pagina (campi legacy)
+	bool inPageAnnotations;
+	bool hasRect;
+	PoDoFo::Rect rect;
+	// /V con /Contents non nullo
+	bool isSigned;
+	bool hasByteRange;
+	std::array<int64_t, 4> byteRange;
+};
+
+/*
+ * The index is built once per loaded document and refers to its objects:
+ * it has to be built again when the document is replaced or its fields or
+ * annotations change. Fields are kept in /Fields order, depth first, so
+ * the signatures of a document are numbered the same way on every call.
+ */
+class PdfSignatureFieldIndex
+{
+public:
+	explicit PdfSignatureFieldIndex(const PoDoFo::PdfMemDocument& document);
+
+	const std::vector<PdfSignatureFieldInfo>& GetFields() const { return m_fields; }
+
+	// nome completo; nullptr se il campo non esiste
+	const PdfSignatureFieldInfo* Find(const std::string& name) const;
+
+	// campi con un dizionario /V, nell'ordine di GetFields
+	const std::vector<const PdfSignatureFieldInfo*>& GetSignatures() const { return m_signatures; }
+
+	// m_signatures punta dentro m_fields
+	PdfSignatureFieldIndex(const PdfSignatureFieldIndex&) = delete;
+	PdfSignatureFieldIndex& operator=(const PdfSignatureFieldIndex&) = delete;
+
+private:
+	void AddField(const PoDoFo::PdfMemDocument& document, const PoDoFo::PdfObject& field,
+		const std::string& parentName, bool inheritedSig, int depth);
+
+	std::vector<PdfSignatureFieldInfo> m_fields;
+	std::vector<const PdfSignatureFieldInfo*> m_signatures;
+	std::map<std::string, size_t> m_names;
+	// widget -> pagina, dalle /Annots di ogni pagina
+	std::map<PoDoFo::PdfReference, int> m_widgetPages;
+	std::set<const PoDoFo::PdfObject*> m_visited;
+};
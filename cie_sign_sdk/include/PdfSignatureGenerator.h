@@ -14,11 +14,16 @@
 #include "ASN1/UUCByteArray.h"
 
 #include <cstddef>
+#include <functional>
+#include <map>
 #include <memory>
 #include <optional>
 #include <string>
 #include <vector>
 
+// spazio riservato in /Contents se non e' indicata la dimensione della CMS
+#define PDF_SIGNATURE_DEFAULT_SIZE	16384
+
 namespace PoDoFo {
 class PdfSigningContext;
 class PdfSignerId;
@@ -27,6 +32,10 @@ class PdfSigner;
 class StreamDevice;
 }
 
+class CSignatureFont;
+class PdfSignatureFieldIndex;
+struct PdfSignatureFieldInfo;
+
 class PdfSignatureGenerator
 {
 public:
@@ -57,12 +66,34 @@ public:
 	
 	void SetSignatureImage(const uint8_t* signatureImageData, size_t signatureImageLen, uint32_t width, uint32_t height);
 	
+	// immagini copiate dalla cache tra documenti e immagini da codificare, dall'avvio del processo
+	static void GetAppearanceCacheStats(long* pnHits, long* pnMisses);
+	
+	// risoluzione dell'immagine ridotta al riquadro del campo (0 = SIGNATURE_IMAGE_DEFAULT_DPI)
+	void SetSignatureImageResolution(uint32_t dpi);
+	
+	// byte riservati in /Contents per la CMS, di norma CSignatureGenerator::GetSignatureSize
+	// (0 = PDF_SIGNATURE_DEFAULT_SIZE); vale per il prossimo GetBufferForSignature
+	void SetSignatureSize(size_t nSize);
+	
+	// nuova revisione con stream di oggetti e stream xref compressi, se il PDF caricato
+	// usa gia' gli stream xref; vale per il prossimo GetBufferForSignature
+	void SetCompactUpdate(bool bCompact);
+	
+	// se la firma precedente non e' stata completata il campo viene preparato di nuovo
+	// sul PDF caricato, con il segnaposto della dimensione attuale
 	void GetBufferForSignature(UUCByteArray& toSign);
 	
-	void SetSignature(const char* signature, int len);
+	// false se la CMS non entra nel segnaposto: il PDF non viene modificato e
+	// GetRequiredSignatureSize indica la dimensione con cui ripetere la firma
+	bool SetSignature(const char* signature, int len);
+	
+	size_t GetRequiredSignatureSize() const;
 	
 	void GetSignedPdf(UUCByteArray& signature);
 	
+	// font TrueType dell'aspetto testuale (nome, data, motivo, luogo), usato
+	// quando non e' impostata un'immagine di firma
 	void AddFont(const char* szFontName, const char* szFontPath);
 	
 	const double getWidth(int pageIndex);
@@ -70,27 +101,23 @@ public:
 	const double getHeight(int pageIndex);
 	
 private:
-    struct LegacyFieldInfo {
-        std::string name;
-        PoDoFo::Rect rect;
-        int pageIndex;
-        PoDoFo::PdfReference widgetRef;
-    };
-
     PoDoFo::PdfSignature* FindSignatureField(const std::string& fieldName,
         bool requireUnsigned);
-    PoDoFo::PdfSignature* CreateFieldFromLegacy(const LegacyFieldInfo& info);
-    bool IsFieldSigned(const PoDoFo::PdfSignature& signature) const;
+    // indice dei campi firma, ricostruito quando il documento cambia
+    const PdfSignatureFieldIndex& GetFieldIndex() const;
+    PoDoFo::PdfSignature* GetSignatureField(const PdfSignatureFieldInfo& info);
+    PoDoFo::PdfSignature* CreateFieldFromLegacy(const PdfSignatureFieldInfo& info);
     bool PrepareSignatureField(PoDoFo::PdfSignature& signature,
         const PoDoFo::Rect* customRect,
         const char* szReason,
         const char* szName,
         const char* szLocation,
         const char* szSubFilter);
-    std::vector<LegacyFieldInfo> ExtractLegacySignatureFields() const;
-    void RemoveLegacyFieldReferences(const LegacyFieldInfo& info, const PoDoFo::PdfReference& widgetRef);
+    void RemoveLegacyFieldReferences(const PdfSignatureFieldInfo& info);
+    void PrepareAgain();
 	std::unique_ptr<PoDoFo::PdfMemDocument> m_pPdfDocument;
 	PoDoFo::PdfSignature* m_pSignatureField;
+	mutable std::unique_ptr<PdfSignatureFieldIndex> m_pFieldIndex;
 	std::unique_ptr<PoDoFo::PdfSigningContext> m_pSigningContext;
 	std::shared_ptr<PoDoFo::PdfSigner> m_pSigner;
 	std::shared_ptr<PoDoFo::StreamDevice> m_pDevice;
@@ -98,12 +125,29 @@ private:
 	std::optional<PoDoFo::PdfSignerId> m_signerId;
 	std::string m_subFilter;
 	int m_actualLen;
+    size_t m_signatureSize;
     size_t m_placeholderSize;
+    size_t m_requiredSignatureSize;
+    bool m_bSigningPending;
+    bool m_bCompactUpdate;
+    // /Contents nel PDF riscritto da CPdfUpdateCompactor; 0 se la revisione e' quella di PoDoFo
+    size_t m_compactContents;
+    size_t m_compactContentsEnd;
+    std::function<bool()> m_prepareField;
     std::string m_originalPdfData;
     std::string m_streamBuffer;
     std::vector<uint8_t> m_signatureImage;
     uint32_t m_signatureImageWidth;
     uint32_t m_signatureImageHeight;
+    uint32_t m_signatureImageDpi;
+    std::string m_signatureImageKey;
+    std::shared_ptr<const CSignatureFont> m_pSignatureFont;
+    std::string m_signatureFontName;
+    std::string m_reasonLabel;
+    std::string m_nameLabel;
+    std::string m_locationLabel;
+    // XObject dell'aspetto gia' presenti nel documento, per chiave di immagine e dimensione
+    std::map<std::string, PoDoFo::PdfReference> m_appearanceObjects;
 	
 	static bool IsSignatureField(const PoDoFo::PdfMemDocument* pDoc, const PoDoFo::PdfObject *const pObj);
 };
@@ -0,0 +1,44 @@
+/*
+ *  PdfSyntax.h
+ *
+ *  Pieces of PDF syntax shared by the readers and writers of the SDK:
+ *  Flate streams and access to parsed dictionaries.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Dictionaries are the ones returned by CPdfRevisionMap::dictionary():
+ * each value is kept as text, in canonical form (names with the leading
+ * slash, references as "N G R").
+ */
+class CPdfSyntax
+{
+public:
+	typedef std::map<std::string, std::string> Dictionary;
+
+	// parola chiave che precede l'offset della sezione xref
+	static constexpr char szStartXref[] = "startxref";
+
+	// stream zlib (RFC 1950), come richiesto da /FlateDecode; out vuoto in caso di errore
+	static bool deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out);
+	static bool deflate(const std::string& data, std::string& out);
+
+	// false se lo stream non e' valido o decompresso supera nMaxLength byte
+	static bool inflate(const std::string& stream, std::string& data, size_t nMaxLength);
+
+	// valore della voce, vuoto se manca
+	static std::string valueOf(const Dictionary& dict, const char* szKey);
+
+	// nome senza la barra iniziale; vuoto se la voce non e' un nome
+	static std::string nameOf(const Dictionary& dict, const char* szKey);
+
+	CPdfSyntax() = delete;
+};
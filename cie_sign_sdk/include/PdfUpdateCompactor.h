@@ -0,0 +1,61 @@
+/*
+ *  PdfUpdateCompactor.h
+ *
+ *  Rewrites the incremental update appended to a PDF that already uses
+ *  cross-reference streams: the objects go into a compressed object
+ *  stream, the xref section into a compressed xref stream.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "PdfRevisionMap.h"
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+/*
+ * compact() reads the last revision of the file (which must start at
+ * nBase, right after the original document) through CPdfRevisionMap and
+ * writes it again. Streams, objects with a generation other than 0 and
+ * the signature dictionary, whose /Contents must be in the file to be
+ * left out of the /ByteRange, stay outside the object stream; the
+ * /ByteRange of the signature is recomputed on the new layout.
+ *
+ * The new revision is used only if the previous one has an xref stream
+ * (a reader limited to xref tables could not read the document anyway),
+ * the document is not encrypted and the result is smaller.
+ */
+class CPdfUpdateCompactor
+{
+public:
+	CPdfUpdateCompactor();
+	virtual ~CPdfUpdateCompactor();
+
+	// false se l'aggiornamento resta com'e'
+	bool compact(const BYTE* pbtData, size_t nLength, size_t nBase);
+
+	// byte da accodare al documento originale, al posto dell'aggiornamento
+	const std::string& update() const { return m_update; }
+
+	// /ByteRange della firma nel file riscritto; /Contents e' tra byteRange[1] e byteRange[2]
+	const int64_t* byteRange() const { return m_byteRange; }
+
+	CPdfUpdateCompactor(const CPdfUpdateCompactor&) = delete;
+	CPdfUpdateCompactor& operator=(const CPdfUpdateCompactor&) = delete;
+
+private:
+	bool writeObjects(const CPdfRevisionMap& map, size_t nBase, size_t nByteRangeWidth);
+	void writeXref(const std::string& trailer, size_t nBase, size_t nPrev);
+
+	std::string m_update;
+	int64_t m_byteRange[4];
+	// posizione in m_update della /ByteRange provvisoria
+	size_t m_nByteRange;
+	// oggetti scritti, per numero: offset nel file o indice nello stream di oggetti
+	std::map<uint32_t, CPdfRevisionMap::Entry> m_entries;
+	uint32_t m_nObjectStream;
+	uint32_t m_nXref;
+};
@@ -15,6 +15,15 @@
 #include "ASN1/UUCByteArray.h"
 #include "disigonsdk.h"
 
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// thread usati al massimo da VerifySignatures
+#define PDF_VERIFY_MAX_THREADS	8
+
 using namespace PoDoFo;
 using namespace std;
 
@@ -26,6 +35,39 @@ typedef struct _SignatureAppearanceInfo
 	int heigth;
 } SignatureAppearanceInfo;
 
+// firma letta dal documento e risultato della sua verifica
+typedef struct _SignatureVerifyResult
+{
+	// CMS e aspetto del campo, come da GetSignature (nError e' il suo codice di errore)
+	UUCByteArray signature;
+	SignatureAppearanceInfo appearance;
+	int nError;
+	// risultato di VerifySignature
+	int bitmask;
+	string subFilter;
+	REVOCATION_INFO revocationInfo;
+	// intervalli firmati; nVerifyError != 0 se la firma non e' verificabile
+	array<int64_t, 4> byteRange;
+	int nVerifyError;
+} SignatureVerifyResult;
+
+// revisione del file coperta da una firma e modifiche successive
+typedef struct _SignatureCoverage
+{
+	// revisione firmata (0 la prima) su nRevisions; -1 se la /ByteRange non termina
+	// su un %%EOF del file
+	int nRevision;
+	int nRevisions;
+	// la firma copre l'intero file
+	bool bWholeDocument;
+	// PDF_UPDATE_* degli aggiornamenti incrementali successivi alla revisione firmata
+	int nChanges;
+} SignatureCoverage;
+
+class CPdfRevisionMap;
+class PdfSignatureFieldIndex;
+struct PdfSignatureFieldInfo;
+
 class PDFVerifier 
 {
 public:
@@ -43,6 +85,17 @@ public:
 	
 	int GetSignature(int index, UUCByteArray& signedDocument, SignatureAppearanceInfo& appearanceInfo);
 	
+	// verifica di tutte le firme: le firme sono lette dal documento in un solo passaggio
+	// (0 o il primo errore di GetSignature, prima di ogni verifica), poi CMS, catena e
+	// revoca sono verificate su piu' thread. I risultati sono nell'ordine dei campi;
+	// fnVerified e' chiamata sul thread che ha verificato la firma
+	int VerifySignatures(const char* szDate, bool bRevocation, vector<SignatureVerifyResult>& results,
+		const function<void(size_t, SignatureVerifyResult&)>& fnVerified = nullptr);
+	
+	// revisione coperta dalla firma index, dalle sole sezioni xref del file: le
+	// revisioni sono lette alla prima chiamata dopo Load
+	int GetSignatureCoverage(int index, SignatureCoverage& coverage);
+	
 	static int GetNumberOfSignatures(PdfMemDocument* pPdfDocument);
     static int GetNumberOfSignatures(const char* szFilePath);
 	
@@ -50,16 +103,27 @@ private:
 	UUCByteArray m_data;
 	static bool IsSignatureField(const PdfMemDocument* pDoc, const PdfObject *const pObj);
 	
-	int VerifySignature(const PdfMemDocument* pDoc, const PdfObject *const pObj, const char* szDate, char* signatureType, REVOCATION_INFO* pRevocationInfo);
+	void ReadSignature(const PdfSignatureFieldInfo& field, SignatureVerifyResult& result);
 
-	int GetSignature(const PdfMemDocument* pDoc, const PdfObject *const pObj, UUCByteArray& signedDocument, SignatureAppearanceInfo& appearanceInfo);
+	// legge solo il risultato e il buffer del documento: si puo' chiamare da piu' thread
+	int VerifySignature(const SignatureVerifyResult& signature, const char* szDate, REVOCATION_INFO* pRevocationInfo) const;
 
 	PdfMemDocument* m_pPdfDocument;
 	
+	// campi firma del documento caricato, letti una volta in Load
+	std::unique_ptr<PdfSignatureFieldIndex> m_pFieldIndex;
+	
+	// revisioni del documento caricato, per GetSignatureCoverage
+	std::unique_ptr<CPdfRevisionMap> m_pRevisionMap;
+	
 	int m_actualLen;
 	
 	const char* m_szDocBuffer;
 	
+	// file caricato con Load(szFilePath), mappato in memoria
+	void* m_pMappedFile;
+	size_t m_nMappedSize;
+	
 };
 
 #endif //_PDFVERIFIER_H
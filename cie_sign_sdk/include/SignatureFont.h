@@ -0,0 +1,105 @@
+/*
+ *  SignatureFont.h
+ *
+ *  TrueType font for the text appearance of the signature: glyph lookup,
+ *  metrics and subsets for a Type0 / CIDFontType2 font with Identity-H
+ *  encoding.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// subset tenuti in memoria per ogni font
+#define SIGNATURE_FONT_SUBSET_CACHE_SIZE	16
+
+/*
+ * A font file is read and parsed once per process: load() returns the same
+ * instance for the same path to every caller and thread. Metrics are in
+ * thousandths of an em, the unit of the PDF font dictionaries.
+ *
+ * subset() keeps the glyph ids of the original font (CIDToGIDMap /Identity),
+ * empties the glyphs that are not used and drops the tables a PDF viewer
+ * does not need. The result (FontFile2 stream, ToUnicode CMap, widths) is
+ * cached by glyph set, so signatures with the same characters reuse it.
+ */
+class CSignatureFont
+{
+public:
+	struct Subset
+	{
+		// chiave del set di glifi e prefisso del nome del font (6 lettere maiuscole)
+		std::string key;
+		std::string tag;
+		// font TrueType ridotto, compresso Flate; nLength1 e' la lunghezza non compressa
+		std::vector<uint8_t> fontFile;
+		size_t nLength1;
+		// CMap /ToUnicode
+		std::string toUnicode;
+		// glifo e larghezza, in ordine di glifo
+		std::vector<std::pair<uint16_t, int>> widths;
+	};
+
+	// nullptr se il file non e' un font TrueType (con tabella glyf) utilizzabile
+	static std::shared_ptr<const CSignatureFont> load(const char* szPath);
+
+	// codepoint Unicode di una stringa UTF-8; le sequenze non valide diventano U+FFFD
+	static std::vector<uint32_t> codePoints(const std::string& utf8);
+
+	// 0 (.notdef) se il carattere manca nel font
+	uint16_t glyph(uint32_t nCodePoint) const;
+
+	int advance(uint16_t nGlyph) const;
+
+	// larghezza del testo
+	int textWidth(const std::vector<uint32_t>& text) const;
+
+	int ascent() const { return m_nAscent; }
+	int descent() const { return m_nDescent; }
+	const int* bbox() const { return m_bbox; }
+
+	// font ridotto ai caratteri di text (piu' .notdef)
+	std::shared_ptr<const Subset> subset(const std::vector<uint32_t>& text) const;
+
+	CSignatureFont(const CSignatureFont&) = delete;
+	CSignatureFont& operator=(const CSignatureFont&) = delete;
+
+private:
+	struct Table
+	{
+		uint32_t nOffset;
+		uint32_t nLength;
+	};
+
+	CSignatureFont();
+
+	bool parse();
+	bool table(const char* szTag, Table& table) const;
+	uint32_t glyphOffset(uint16_t nGlyph) const;
+	std::shared_ptr<const Subset> createSubset(const std::vector<uint32_t>& text, const std::vector<uint16_t>& glyphs, const std::string& key) const;
+
+	std::vector<uint8_t> m_data;
+	Table m_glyf;
+	Table m_loca;
+	Table m_hmtx;
+	Table m_cmap;
+	uint32_t m_nCmapFormat;
+	uint16_t m_nUnitsPerEm;
+	uint16_t m_nGlyphs;
+	uint16_t m_nHMetrics;
+	bool m_bLongLoca;
+	int m_nAscent;
+	int m_nDescent;
+	int m_bbox[4];
+
+	mutable std::mutex m_subsetsMutex;
+	mutable std::list<std::shared_ptr<const Subset>> m_subsets;
+};
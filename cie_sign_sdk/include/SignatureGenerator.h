@@ -9,9 +9,15 @@
 #include "TSAClient.h"
 #include "BaseSigner.h"
 
+#include <atomic>
+#include <vector>
+
 #define ALGO_SHA1 1
 #define ALGO_SHA256 2
 
+// marca temporale ipotizzata finche' la TSA non ne ha restituita una
+#define TSA_TOKEN_SIZE_ESTIMATE	6144
+
 class CSignatureGeneratorBase
 {
 protected:
@@ -58,7 +64,23 @@ public:
     long GetCertificate(CCertificate** ppCertificate);
 	virtual long Generate(UUCByteArray& pkcs7SignedData, BOOL bDetached = FALSE, BOOL bVerifyRevocation = FALSE);
 
+	virtual void SetAlias(char* alias);
+
+	// limite superiore in byte della SignedData detached di Generate per il certificato
+	// signerCertificate (DER), i certificati chain e una marca temporale di
+	// nTimeStampTokenSize byte (0 = senza marca)
+	static size_t PredictSignatureSize(const UUCByteArray& signerCertificate, const std::vector<UUCByteArray>& chain, int nHashAlgo, size_t nTimeStampTokenSize);
+
+	// PredictSignatureSize per il firmatario e la TSA impostati; la marca e' stimata
+	// dall'ultima ricevuta (TSA_TOKEN_SIZE_ESTIMATE prima della prima)
+	long GetSignatureSize(size_t* pnSize);
+
+	// prepara una nuova firma con lo stesso firmatario: dati, signerInfo e certificati azzerati
+	void Reset();
+
 private:
+	long getSignerCertificate(CCertificate** ppCertificate, UUCByteArray& id);
+
 	bool m_bCAdES;
 	bool m_bRemote;
 
@@ -68,4 +90,10 @@ private:
 	CASN1SetOf m_digestAlgos;// = new DerSet(certificates);
 
 	CSignerInfoGenerator m_signerInfoGenerator;
+
+	// certificato letto dal signer una sola volta (la CIE lo legge via NFC)
+	UUCByteArray m_signerCertificate;
+	UUCByteArray m_signerId;
+
+	static std::atomic<size_t> m_nLastTimeStampTokenSize;
 };
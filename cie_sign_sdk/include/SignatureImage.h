@@ -0,0 +1,70 @@
+/*
+ *  SignatureImage.h
+ *
+ *  Signature image preparation for the PDF appearance: downsampling to the
+ *  widget, colour reduction, alpha channel and Flate compression.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// risoluzione dell'immagine nel riquadro della firma
+#define SIGNATURE_IMAGE_DEFAULT_DPI		200
+
+/*
+ * An RGBA capture from a signature pad is usually much larger than the
+ * widget it is drawn into, nearly always monochrome, and mostly
+ * transparent. CSignatureImage reduces it to what the widget can show:
+ *
+ *   downsample  area average to the pixel size of the widget at the
+ *               requested resolution (never enlarged); colours are
+ *               weighted by alpha so the strokes keep no dark fringes
+ *   encode      DeviceGray when every visible pixel is grey, 1 bit per
+ *               sample when the greys are also black or white, DeviceRGB
+ *               otherwise; alpha goes to a separate DeviceGray SMask
+ *               (none if the image is opaque); samples are Flate
+ *               compressed, ready for a /FlateDecode image stream
+ */
+class CSignatureImage
+{
+public:
+	// pixel RGBA non premoltiplicati, nWidth * nHeight * 4 byte
+	CSignatureImage(const uint8_t* pRgba, uint32_t nWidth, uint32_t nHeight);
+
+	// pixel di un riquadro di fWidth x fHeight punti a nDpi (0 = SIGNATURE_IMAGE_DEFAULT_DPI)
+	static void targetSize(double fWidth, double fHeight, uint32_t nDpi, uint32_t* pnWidth, uint32_t* pnHeight);
+
+	// media d'area a nWidth x nHeight; le dimensioni maggiori dell'immagine restano invariate
+	void downsample(uint32_t nWidth, uint32_t nHeight);
+
+	// 0, -1 se la compressione fallisce
+	int encode();
+
+	uint32_t width() const { return m_nWidth; }
+	uint32_t height() const { return m_nHeight; }
+
+	// 1 (DeviceGray) o 3 (DeviceRGB)
+	int components() const { return m_nComponents; }
+
+	// 1 o 8
+	int bitsPerComponent() const { return m_nBitsPerComponent; }
+
+	// campioni compressi Flate
+	const std::vector<uint8_t>& data() const { return m_data; }
+
+	// alpha compressa Flate, DeviceGray 8 bit; vuota se l'immagine e' opaca
+	const std::vector<uint8_t>& softMask() const { return m_softMask; }
+
+private:
+	std::vector<uint8_t> m_rgba;
+	uint32_t m_nWidth;
+	uint32_t m_nHeight;
+	int m_nComponents;
+	int m_nBitsPerComponent;
+	std::vector<uint8_t> m_data;
+	std::vector<uint8_t> m_softMask;
+};
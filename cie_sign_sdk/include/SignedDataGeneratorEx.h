@@ -13,7 +13,9 @@
 #include "ASN1/SignerInfo.h"
 #include "ASN1/ASN1Setof.h"
 #include "ASN1/TimeStampResponse.h"
+#include "SignedDataPatcher.h"
 
+#include <stdio.h>
 #include <vector>
 
 class SignedDataGeneratorEx
@@ -21,6 +23,12 @@ class SignedDataGeneratorEx
 public:
 	SignedDataGeneratorEx(CSignedDocument& sd);
 
+	// patch mode: the encoded SignedData is not decoded; countersignatures,
+	// timestamps and signers are spliced into it by toByteArray/writeTo.
+	// The buffer (or file) must stay valid until the output has been written.
+	SignedDataGeneratorEx(const BYTE* pkcs7SignedData, int len);
+	SignedDataGeneratorEx(FILE* pPkcs7File);
+
 	virtual ~SignedDataGeneratorEx();
 
 	bool isDetached();
@@ -34,9 +42,14 @@ public:
 	void addCounterSignature(CSignerInfo& signerInfoRef, CSignedDocument& counterSignature, CTimeStampResponse& tsr);
 
 	void setTimestamp(CTimeStampResponse& tsr, int signerInfoIndex);
+
+	void setTimestamp(CTimeStampToken& tst, int signerInfoIndex);
 	
 		
 	void toByteArray(UUCByteArray& pkcs7SignedData);
+
+	// streams the result to pOut (patch mode only)
+	long writeTo(FILE* pOut);
 	
 private:
 	UUCByteArray m_content;
@@ -45,5 +58,11 @@ private:
 	CASN1SetOf m_certificates;
 	CASN1SetOf m_digestAlgos;
 
+	CSignedDataPatcher* m_pPatcher;
+
 	bool addCounterSignature(CSignerInfo& signerInfo, CSignerInfo& signerInfoRef, CSignerInfo& counterSignature);
+	void spliceCounterSignature(CSignerInfo& signerInfoRef, CSignerInfo& signerInfoToAdd, CSignedDocument& counterSignature);
+
+	SignedDataGeneratorEx(const SignedDataGeneratorEx&);
+	SignedDataGeneratorEx& operator = (const SignedDataGeneratorEx&);
 };
@@ -0,0 +1,127 @@
+/*
+ *  SignedDataPatcher.h
+ *
+ *  In-place editing of an encoded CMS SignedData.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "ASN1/UUCByteArray.h"
+#include "ASN1/ASN1Object.h"
+
+#include <stdio.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+/*
+ * Adds unsigned attributes (timestamps, countersignatures), signerInfos,
+ * certificates and digest algorithms to an encoded ContentInfo/SignedData
+ * without decoding and re-encoding it.
+ *
+ * Only the TLV headers on the path from the root to the edited elements are
+ * read; on output the unchanged byte ranges are copied through as they are,
+ * the new elements are inserted and only the length prefixes of the
+ * enclosing elements are rewritten (indefinite lengths are left untouched).
+ * The cost is the size of the new attributes plus one sequential copy.
+ *
+ * Malformed input raises CASN1ParsingException.
+ */
+class CSignedDataPatcher
+{
+public:
+	// il buffer deve restare valido per tutta la vita del patcher
+	CSignedDataPatcher(const BYTE* pkcs7SignedData, size_t len);
+
+	// sorgente su file: letta a blocchi, mai caricata per intero
+	CSignedDataPatcher(FILE* pFile);
+
+	virtual ~CSignedDataPatcher();
+
+	int getSignerInfoCount();
+
+	// codifica originale del signerInfo (senza le modifiche pendenti)
+	void getSignerInfo(int signerInfoIndex, UUCByteArray& signerInfo);
+
+	// attribute e' un Attribute completo: SEQUENCE { OID, SET { value } }
+	void addUnsignedAttribute(int signerInfoIndex, const CASN1Object& attribute);
+
+	// cerca signerInfoRef tra i signerInfo e le loro controfirme (ricorsivamente)
+	bool addUnsignedAttribute(const CASN1Object& signerInfoRef, const CASN1Object& attribute);
+
+	void addSignerInfo(const CASN1Object& signerInfo);
+
+	// ignorati se gia' presenti
+	void addCertificate(const CASN1Object& certificate);
+	void addDigestAlgorithm(const CASN1Object& digestAlgorithm);
+
+	void toByteArray(UUCByteArray& pkcs7SignedData);
+
+	// ritorna 0 oppure DISIGON_ERROR_INVALID_FILE se la scrittura fallisce
+	long writeTo(FILE* pOut);
+
+private:
+	CSignedDataPatcher(const CSignedDataPatcher&);
+	CSignedDataPatcher& operator = (const CSignedDataPatcher&);
+
+	struct Node
+	{
+		size_t nOffset;         // inizio dell'header
+		size_t nHeaderLen;
+		size_t nTagLen;
+		size_t nContentLen;     // per le lunghezze indefinite esclude l'EOC
+		bool   bIndefinite;
+		BYTE   btTag;
+		int    nDepth;
+
+		size_t contentStart() const { return nOffset + nHeaderLen; }
+		size_t contentEnd() const { return contentStart() + nContentLen; }
+		size_t end() const { return contentEnd() + (bIndefinite ? 2 : 0); }
+	};
+
+	typedef std::vector<Node> NodePath;
+
+	// elementi da accodare al contenuto di uno stesso SET/SEQUENCE
+	struct Insertion
+	{
+		size_t nPos;
+		int nDepth;             // profondita' dell'elemento che riceve i dati
+		BYTE btWrapTag;         // != 0: campo opzionale assente da creare con questo tag
+		NodePath ancestors;     // elementi la cui lunghezza cresce
+		UUCByteArray data;
+	};
+
+	void read(size_t nOffset, BYTE* pBuffer, size_t nLen);
+	void readBytes(const Node& node, UUCByteArray& bytes);
+	Node readNode(size_t nOffset, int nDepth);
+	void children(const Node& parent, std::vector<Node>& nodes);
+
+	void locate();
+	bool findSignerInfo(const NodePath& path, const UUCByteArray& encoded, NodePath& found);
+	bool contains(const Node& set, const UUCByteArray& encoded);
+	void addToSignerInfo(const NodePath& path, const UUCByteArray& attribute);
+	void append(const NodePath& ancestors, size_t nPos, int nDepth, BYTE btWrapTag, const UUCByteArray& data);
+
+	bool write(UUCByteArray* pArray, FILE* pOut);
+	bool emit(const BYTE* pData, size_t nLen, UUCByteArray* pArray, FILE* pOut);
+	bool copy(size_t nFrom, size_t nTo, UUCByteArray* pArray, FILE* pOut);
+
+	const BYTE* m_pBuffer;
+	FILE* m_pFile;
+	size_t m_nLength;
+
+	bool m_bLocated;
+	NodePath m_signedDataPath;   // ContentInfo, [0], SignedData
+	Node m_digestAlgos;
+	Node m_encapContentInfo;
+	Node m_certificates;
+	bool m_bHasCertificates;
+	Node m_signerInfos;
+	std::vector<Node> m_signerInfoNodes;
+
+	std::map<std::pair<size_t, int>, Insertion> m_insertions;   // chiave: offset, profondita'
+	std::vector<UUCByteArray> m_addedCertificates;
+	std::vector<UUCByteArray> m_addedDigestAlgos;
+};
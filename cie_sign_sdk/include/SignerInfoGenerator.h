@@ -39,6 +39,9 @@ public:
 	void toByteArray(UUCByteArray& signerInfo);
 	
 	CSignerInfo getSignerInfo();
+
+	// torna allo stato iniziale per generare un nuovo signerInfo
+	void reset();
 	
 private:
 	UUCByteArray m_content;
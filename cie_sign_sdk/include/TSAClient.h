@@ -12,7 +12,8 @@ public:
 	void SetCredential(const char* szUsername, const char* szPassword);
 	void SetUsername(const char* szUsername);
 	void SetPassword(const char* szPassword);
-	long GetTimeStampToken(UUCByteArray& digest, const char* szPolicyID, CTimeStampToken** ppTimeStampToken);
+	// thread safe: i parametri non vengono modificati durante la richiesta
+	virtual long GetTimeStampToken(UUCByteArray& digest, const char* szPolicyID, CTimeStampToken** ppTimeStampToken);
 
 private:
 	char m_szTSAUrl[256];
@@ -0,0 +1,78 @@
+/*
+ *  TimestampUpgrader.h
+ *
+ *  Bulk CAdES-BES -> CAdES-T upgrade of existing .p7m files.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "TSAClient.h"
+
+#include <string>
+#include <vector>
+
+typedef struct _TIMESTAMP_UPGRADE_RESULT
+{
+	std::string szInputPath;
+	std::string szOutputPath;
+	long nError;            // 0, DISIGON_ERROR_* o codice ritornato dalla TSA
+	int nTimestamped;       // signerInfo a cui e' stata aggiunta la marca
+	int nSkipped;           // signerInfo che avevano gia' una marca
+} TIMESTAMP_UPGRADE_RESULT;
+
+/*
+ * Adds an RFC 3161 signature timestamp to every signerInfo of a set of
+ * .p7m files that does not have one yet.
+ *
+ * Work is split in two stages connected by a bounded queue:
+ *  - preparation threads open each file, locate the signerInfos without
+ *    decoding the content and compute the digest of each signature value;
+ *  - TSA threads keep up to nInFlight requests outstanding, then splice the
+ *    tokens in with SignedDataGeneratorEx::setTimestamp (patch mode) and
+ *    stream the result to the output file.
+ *
+ * The TSA client is shared by all the TSA threads: GetTimeStampToken can be
+ * overridden to plug in a different (e.g. local) time stamping authority.
+ */
+class CTimestampUpgrader
+{
+public:
+	CTimestampUpgrader(CTSAClient& tsaClient);
+	virtual ~CTimestampUpgrader();
+
+	void setPolicyID(const char* szPolicyID);
+
+	// senza output dir i file vengono riscritti sul posto (file temporaneo + rename);
+	// i file che finirebbero sullo stesso output (stesso nome in directory diverse)
+	// non vengono aggiornati e hanno nError DISIGON_ERROR_OUTPUT_CONFLICT
+	void setOutputDir(const char* szOutputDir);
+
+	void setThreads(int nPrepareThreads, int nInFlight);
+
+	void addFile(const char* szPath);
+
+	// aggiunge i file .p7m della directory (non ricorsivo); ritorna il numero di file aggiunti
+	int addDirectory(const char* szDir);
+
+	// ritorna il numero di file non aggiornati per errore
+	int run(std::vector<TIMESTAMP_UPGRADE_RESULT>& results);
+
+private:
+	CTimestampUpgrader(const CTimestampUpgrader&);
+	CTimestampUpgrader& operator = (const CTimestampUpgrader&);
+
+	struct Job;
+
+	void prepare(Job& job);
+	void timestamp(Job& job);
+	std::string outputPath(const std::string& szInputPath);
+
+	CTSAClient& m_tsaClient;
+	std::string m_szPolicyID;
+	std::string m_szOutputDir;
+	int m_nPrepareThreads;
+	int m_nInFlight;
+	std::vector<std::string> m_files;
+};
@@ -0,0 +1,148 @@
+/*
+ *  TrustedList.h
+ *
+ *  ETSI TS 119 612 trusted lists (national TSL and EU LOTL) and their
+ *  precompiled binary snapshot.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "ASN1/UUCByteArray.h"
+
+#include <time.h>
+#include <string>
+#include <vector>
+
+// ServiceTypeIdentifier dei servizi estratti
+#define TSL_SERVICE_CA_QC			1	// http://uri.etsi.org/TrstSvc/Svctype/CA/QC
+#define TSL_SERVICE_TSA_QTST		2	// http://uri.etsi.org/TrstSvc/Svctype/TSA/QTST
+
+// ServiceStatus
+#define TSL_STATUS_UNKNOWN			0
+#define TSL_STATUS_GRANTED			1	// granted, recognisedatnationallevel e gli stati attivi pre-eIDAS
+#define TSL_STATUS_WITHDRAWN		2	// withdrawn, deprecatedatnationallevel e gli stati cessati pre-eIDAS
+
+// nome della snapshot nella directory DISIGON_OPT_CACERT_DIR
+#define TSL_SNAPSHOT_FILE			"tsl.snapshot"
+
+typedef struct _TSL_SERVICE
+{
+	int nType;                      // TSL_SERVICE_*
+	int nStatus;                    // TSL_STATUS_*
+	time_t nStatusStartingTime;
+	std::string szKeyId;            // SubjectKeyIdentifier, o SHA-1 della chiave pubblica se assente
+	UUCByteArray certificate;       // DER
+} TSL_SERVICE;
+
+/*
+ * Qualified CA (CA/QC) and TSA (TSA/QTST) certificates of a trusted list,
+ * one TSL_SERVICE per X509Certificate of the service digital identity, with
+ * the current status of the service (the service history is not read).
+ *
+ * load() follows the PointersToOtherTSL of a list of trusted lists and
+ * reads every XML trusted list it points to. The XML signature of the lists
+ * is not checked: the location must be a trusted source.
+ *
+ * Parsing a national list costs XML parsing, base64 decoding and a DER
+ * decoding per certificate; writeSnapshot stores the result so that other
+ * processes can start from CTrustedListSnapshot instead.
+ */
+class CTrustedList
+{
+public:
+	CTrustedList();
+	virtual ~CTrustedList();
+
+	// aggiunge i servizi di una trusted list XML;
+	// 0, DISIGON_ERROR_TSL_PARSE o DISIGON_ERROR_TSL_INVALID
+	long parse(const BYTE* pbtXml, size_t nLength);
+
+	// file locale o URL http(s); 0, DISIGON_ERROR_TSL_LOAD o gli errori di parse
+	long load(const char* szLocation);
+
+	// 0 o DISIGON_ERROR_TSL_LOAD
+	long writeSnapshot(const char* szPath) const;
+
+	// certificati dei servizi con stato TSL_STATUS_GRANTED nel CCertStore; ritorna quanti
+	int addToCertStore() const;
+
+	const std::vector<TSL_SERVICE>& getServices() const;
+
+	// TSLLocation delle trusted list XML a cui punta la lista (LOTL)
+	const std::vector<std::string>& getPointers() const;
+
+	// la piu' vicina fra le NextUpdate delle liste lette, 0 se nessuna
+	time_t getNextUpdate() const;
+
+	const std::string& getSource() const;
+
+	// certificati della lista szLocation nel CCertStore, dalla snapshot szSnapshotPath
+	// se e' di quella lista e non ha superato la NextUpdate; altrimenti la lista
+	// viene letta e la snapshot riscritta. La snapshot resta mappata e lo store vi
+	// cerca gli issuer (CCertStore::SetTrustedList)
+	static long LoadCertStore(const char* szLocation, const char* szSnapshotPath);
+
+private:
+	CTrustedList(const CTrustedList&);
+	CTrustedList& operator = (const CTrustedList&);
+
+	long fetch(const char* szLocation, UUCByteArray& data);
+
+	std::vector<TSL_SERVICE> m_services;
+	std::vector<std::string> m_pointers;
+	time_t m_nNextUpdate;
+	std::string m_szSource;
+};
+
+/*
+ * Read-only view of a snapshot written by CTrustedList::writeSnapshot. The
+ * file is memory-mapped and used in place: a fixed-size index sorted by key
+ * identifier, a second one sorted by SHA-1 of the subject DN, then the DER
+ * certificates. Opening it validates the header and the bounds of every
+ * entry, nothing is parsed or copied, and find() and findSubject() are
+ * binary searches over the indexes.
+ *
+ * The layout uses the byte order of the machine that wrote it; a snapshot
+ * from a different byte order, or a different format version, is rejected.
+ */
+class CTrustedListSnapshot
+{
+public:
+	CTrustedListSnapshot();
+	virtual ~CTrustedListSnapshot();
+
+	// 0, DISIGON_ERROR_FILE_NOT_FOUND o DISIGON_ERROR_TSL_INVALID
+	long open(const char* szPath);
+	void close();
+
+	int size() const;
+	time_t getNextUpdate() const;
+	std::string getSource() const;
+
+	bool getService(int nIndex, TSL_SERVICE& service) const;
+
+	// servizi dei certificati con key identifier szKeyId (AuthorityKeyIdentifier
+	// del certificato emesso); ritorna quanti ne ha aggiunti a services
+	int find(const std::string& szKeyId, std::vector<TSL_SERVICE>& services) const;
+
+	// servizi dei certificati con subject szSubject (DER, issuer del certificato emesso)
+	int findSubject(const std::string& szSubject, std::vector<TSL_SERVICE>& services) const;
+
+	// layout del file, in TrustedList.cpp
+	struct Header;
+	struct Entry;
+	struct Subject;
+
+private:
+	CTrustedListSnapshot(const CTrustedListSnapshot&);
+	CTrustedListSnapshot& operator = (const CTrustedListSnapshot&);
+
+	const Header* header() const;
+	const Entry* entry(int nIndex) const;
+	const Subject* subject(int nIndex) const;
+
+	BYTE* m_pbtData;
+	size_t m_nSize;
+};
@@ -0,0 +1,132 @@
+/*
+ *  VerifyDaemon.h
+ *
+ *  Long-running verification service on a Unix domain socket and its client.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// richieste accettate in attesa di un worker
+#define VERIFYD_DEFAULT_QUEUE_SIZE	64
+
+// tentativi del client quando il demone risponde BUSY
+#define VERIFYD_DEFAULT_RETRIES		8
+
+/*
+ * Verification requests served by a pool of worker threads that share the
+ * process-wide state: OpenSSL and libxml2 initialised once, the CA store
+ * (trusted list), the CRL and OCSP caches and the pooled HTTP connections.
+ * A caller that used to start a verifier per document pays the
+ * initialisation and the cold caches once per daemon instead.
+ *
+ * Protocol: one request per connection, one line each way.
+ *   VERIFY <0|1> <path>   verifica del file (1 = con revoca) -> OK <json>
+ *   STATS                 contatori del demone e delle cache -> OK <json>
+ *   PING                                                      -> OK
+ * Malformed requests get ERR <code>. Paths are opened by the daemon, so
+ * they must be absolute (CVerifyClient resolves them).
+ *
+ * Accepted connections wait in a queue of setQueueSize entries; when it is
+ * full the connection is answered BUSY at once instead of piling up, and
+ * the client decides whether to retry.
+ *
+ * stop() is graceful: no new connections are accepted, the queued requests
+ * are served, then the workers exit and the socket file is removed.
+ *
+ * The daemon configuration (CA directory, trusted list, cache directories)
+ * is the global one set with disigon_set before start().
+ */
+class CVerifyDaemon
+{
+public:
+	CVerifyDaemon();
+	virtual ~CVerifyDaemon();
+
+	void setThreads(int nThreads);
+	void setQueueSize(int nQueueSize);
+
+	// il socket e' creato 0600; con un gruppo 0660 e di quel gruppo
+	void setSocketGroup(const char* szGroup);
+
+	// 0 o DISIGON_ERROR_DAEMON_SOCKET (path non utilizzabile o demone gia' attivo)
+	long start(const char* szSocketPath);
+
+	// termina dopo aver servito le richieste in coda
+	void stop();
+
+	bool isRunning() const;
+
+protected:
+	// verifica di szPath, esito JSON in szResult; chiamata in parallelo dai worker,
+	// nWorker identifica il thread (0 .. nThreads - 1)
+	virtual long verify(int nWorker, const char* szPath, bool bRevocation, std::string& szResult);
+
+private:
+	CVerifyDaemon(const CVerifyDaemon&);
+	CVerifyDaemon& operator = (const CVerifyDaemon&);
+
+	void acceptLoop();
+	void workerLoop(int nWorker);
+	void serve(int nWorker, int nSocket);
+	std::string stats();
+
+	int m_nThreads;
+	int m_nQueueSize;
+	std::string m_szSocketPath;
+	std::string m_szSocketGroup;
+	int m_nListenSocket;
+	int m_stopPipe[2];
+	std::atomic<bool> m_bRunning;
+
+	std::thread m_acceptThread;
+	std::vector<std::thread> m_workers;
+	std::vector<void*> m_contexts;
+
+	std::mutex m_mutex;
+	std::condition_variable m_queueReady;
+	std::deque<int> m_queue;
+	bool m_bAccepting;
+
+	std::atomic<long> m_nServed;
+	std::atomic<long> m_nRejected;
+};
+
+/*
+ * Client side of CVerifyDaemon. Each call opens its own connection, so one
+ * CVerifyClient can be used from several threads.
+ */
+class CVerifyClient
+{
+public:
+	CVerifyClient(const char* szSocketPath);
+	virtual ~CVerifyClient();
+
+	// BUSY: nRetries nuovi tentativi, con attesa iniziale nDelayMs raddoppiata ogni volta
+	void setRetries(int nRetries, int nDelayMs);
+
+	// esito JSON della verifica di szPath; 0, DISIGON_ERROR_DAEMON_SOCKET,
+	// DISIGON_ERROR_DAEMON_BUSY o DISIGON_ERROR_UNEXPECTED (risposta non valida)
+	long verify(const char* szPath, bool bRevocation, std::string& szResult);
+
+	long getStats(std::string& szResult);
+
+	long ping();
+
+private:
+	long request(const std::string& szRequest, std::string& szResult);
+	long transact(const std::string& szRequest, std::string& szResponse);
+
+	std::string m_szSocketPath;
+	int m_nRetries;
+	int m_nDelayMs;
+};
@@ -0,0 +1,33 @@
+/*
+ *  VerifyReport.h
+ *
+ *  JSON rendering of verification results, shared by the verification
+ *  daemon and the batch verifier.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "disigonsdk.h"
+
+#include <string>
+
+class CVerifyReport
+{
+public:
+	// stringa JSON tra virgolette, con i caratteri di controllo escapati
+	static std::string jsonString(const char* szValue);
+
+	// "revoked", "suspended", "good" o "unknown" secondo i bit VERIFIED_CERT_*
+	static const char* revocationStatus(long bitmask);
+
+	// firma integra, certificato nel periodo di validita', catena fino a una CA nota, non revocato;
+	// un valore negativo (errore di verifica) non e' mai valido
+	static bool signerValid(long bitmask);
+
+	// {"cn":...,"bitmask":"0x......","valid":...,"revocation":...}
+	static std::string signerJson(const SIGNER_INFO& signerInfo);
+
+	CVerifyReport() = delete;
+};
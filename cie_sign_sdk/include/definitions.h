@@ -127,6 +127,7 @@ unsigned long GetLastError();
 #define szSignedDataOID					"1.2.840.113549.1.7.2"
 #define szCounterSignatureOID			"1.2.840.113549.1.9.6"
 #define szCrlDistributionPointsOID		"2.5.29.31"
+#define szFreshestCRLOID				"2.5.29.46"
 #define szKeyUsageOID					"2.5.29.15"
 #define szTimestampTokenOID				"1.2.840.113549.1.9.16.2.14"
 #define szAuthorityInfoAccess		    "1.3.6.1.5.5.7.1.1"
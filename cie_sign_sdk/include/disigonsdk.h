@@ -48,11 +48,6 @@
 
 #define VERIFIED_KEY_USAGE				0x200000
 
-// TODO
-// certificate store con cache degli esiti delle verifiche dei certificati
-// stato revoca e validit� dei certificati nella chain
-
-
 #define REVOCATION_STATUS_GOOD  0
 #define REVOCATION_STATUS_REVOKED  1
 #define REVOCATION_STATUS_SUSPENDED 2
@@ -119,6 +114,12 @@
 
 #define DISIGON_OPT_TSL_URL				60
 #define DISIGON_OPT_VERIFY_USER_CERTIFICATE	61
+#define DISIGON_OPT_CRL_CACHE_DIR		62
+#define DISIGON_OPT_OCSP_CACHE_DIR		63
+#define DISIGON_OPT_OCSP_MAX_AGE		64
+#define DISIGON_OPT_HTTP2				65
+#define DISIGON_OPT_REVOCATION_TIMEOUT	66
+#define DISIGON_OPT_CERT_CACHE_TTL		67
 
 #define DISIGON_OPT_P12_FILEPATH			70
 #define DISIGON_OPT_P12_PASSWORD			71
@@ -152,6 +153,12 @@
 #define DISIGON_ERROR_TSL_INVALID		DISIGON_ERROR_BASE + 22
 #define DISIGON_ERROR_TSL_CACERTDIR_NOT_SET		DISIGON_ERROR_BASE + 23
 #define DISIGON_ERROR_TSA		DISIGON_ERROR_BASE + 30
+#define DISIGON_ERROR_OUTPUT_CONFLICT	DISIGON_ERROR_BASE + 31
+
+#define DISIGON_ERROR_DAEMON_SOCKET		DISIGON_ERROR_BASE + 50
+#define DISIGON_ERROR_DAEMON_BUSY		DISIGON_ERROR_BASE + 51
+
+#define DISIGON_ERROR_PDF_SIGNATURE_SIZE	DISIGON_ERROR_BASE + 60
 
 #define  DISIGON_ERROR_WRONG_PIN     DISIGON_ERROR_BASE + 40
 #define  DISIGON_ERROR_PIN_LOCKED  DISIGON_ERROR_BASE + 41
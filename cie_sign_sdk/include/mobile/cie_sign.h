@@ -32,6 +32,8 @@ typedef struct {
     size_t signature_image_len;
     uint32_t signature_image_width;
     uint32_t signature_image_height;
+    uint32_t signature_image_dpi; /* image resolution in the widget, 0 = 200 dpi */
+    const char *signature_font_path; /* TrueType font for a text appearance when there is no image */
     uint32_t page_index;
     float left;
     float bottom;
@@ -39,6 +41,7 @@ typedef struct {
     float height;
     const char *const *field_ids;
     size_t field_ids_len;
+    int compact_update; /* object and xref streams in the new revision, if the PDF already uses xref streams */
 } cie_pdf_options;
 
 typedef struct {
@@ -70,6 +73,35 @@ typedef struct {
     size_t output_len;
 } cie_sign_result;
 
+/* cie_pdf_check_result.issues */
+#define CIE_PDF_ISSUE_NOT_PDF        0x0001u /* no %PDF- header */
+#define CIE_PDF_ISSUE_ENCRYPTED      0x0002u /* /Encrypt in the trailer */
+#define CIE_PDF_ISSUE_NO_CHANGES     0x0004u /* certified with DocMDP /P 1 */
+#define CIE_PDF_ISSUE_FIELD_MISSING  0x0008u /* a field in field_ids does not exist */
+#define CIE_PDF_ISSUE_FIELD_SIGNED   0x0010u /* a field in field_ids is already signed */
+#define CIE_PDF_ISSUE_XREF_REBUILD   0x0020u /* damaged xref: signing works, but parses the whole file */
+
+/* issues that make cie_sign_execute fail on this document */
+#define CIE_PDF_BLOCKING_ISSUES (CIE_PDF_ISSUE_NOT_PDF | CIE_PDF_ISSUE_ENCRYPTED | CIE_PDF_ISSUE_NO_CHANGES | \
+                                 CIE_PDF_ISSUE_FIELD_MISSING | CIE_PDF_ISSUE_FIELD_SIGNED)
+
+typedef struct {
+    uint32_t issues;              /* CIE_PDF_ISSUE_* */
+    uint32_t revisions;           /* original file plus incremental updates */
+    uint32_t docmdp_permissions;  /* /P of the certification signature, 0 if not certified */
+    uint32_t signature_fields;
+    uint32_t signed_fields;
+    uint32_t signatures_to_apply; /* signatures cie_sign_execute would add with the same options */
+    /* rough estimates for a mid-range phone: PDF parsing and hashing, and the NFC session */
+    uint32_t estimated_document_ms;
+    uint32_t estimated_card_ms;
+    /* unsigned signature fields, UTF-8 and NUL terminated one after the other;
+       written only when signable_fields_capacity >= signable_fields_len */
+    char *signable_fields;
+    size_t signable_fields_capacity;
+    size_t signable_fields_len;
+} cie_pdf_check_result;
+
 cie_sign_ctx *cie_sign_ctx_create(cie_apdu_cb cb,
                                   void *user_data,
                                   const uint8_t *atr,
@@ -87,6 +119,14 @@ cie_status cie_sign_verify_pin(cie_sign_ctx *ctx,
                                const char *pin,
                                size_t pin_len);
 
+/* Reads only the trailer, the xref sections, the encryption dictionary, the
+   AcroForm and the DocMDP permissions: no card and no context are needed, so
+   apps can reject a document before the NFC session. options may be NULL. */
+cie_status cie_sign_check_pdf(const uint8_t *input,
+                              size_t input_len,
+                              const cie_pdf_options *options,
+                              cie_pdf_check_result *result);
+
 const char *cie_sign_get_last_error(cie_sign_ctx *ctx);
 
 #ifdef __cplusplus
@@ -1,58 +1,66 @@
 
 #include "ASN1GenericSequence.h"
 #include "ASN1Exception.h"
+#include "UUCArena.h"
 #include <stdlib.h>
+#include <string.h>
 
 
 CASN1GenericSequence::CASN1GenericSequence(BYTE btTag)
-: m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	setTag(btTag);
 }
 
 CASN1GenericSequence::CASN1GenericSequence(UUCBufferedReader& reader)
-: CASN1Object(reader), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: CASN1Object(reader), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	m_nSize = makeOffset();
 }
 
 CASN1GenericSequence::CASN1GenericSequence(const UUCByteArray& content)
-: CASN1Object(content), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: CASN1Object(content), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	m_nSize = makeOffset();
 }
 
 CASN1GenericSequence::CASN1GenericSequence(const CASN1Object& obj)
-: CASN1Object(obj), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: CASN1Object(obj), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	m_nSize = makeOffset();
 }
 
 CASN1GenericSequence::CASN1GenericSequence(const CASN1GenericSequence& obj)
-: CASN1Object(obj), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: CASN1Object(obj), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	m_nSize = makeOffset();
 }
 
 CASN1GenericSequence::CASN1GenericSequence(const BYTE* value, long len)
-: CASN1Object(value, len), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL)
+: CASN1Object(value, len), m_nSize(0), m_nOffsetsMax(MAXSIZE), m_pnOffsets(NULL), m_pOffsetsArena(NULL)
 {
-	m_pnOffsets = (unsigned int*)calloc(m_nOffsetsMax + 2, sizeof(m_pnOffsets[0]));
+	allocOffsets();
 	m_nSize = makeOffset();
 }
 
 CASN1GenericSequence::~CASN1GenericSequence()
 {
-	if (m_pnOffsets)
-		free(m_pnOffsets);
+	UUCArena::deallocate(m_pnOffsets, m_pOffsetsArena);
 	//NSLog(@"~CASN1GenericSequence()");
 }
 
+void CASN1GenericSequence::allocOffsets()
+{
+	size_t nSize = (m_nOffsetsMax + 2) * sizeof(m_pnOffsets[0]);
+	m_pnOffsets = (unsigned int*)UUCArena::allocate(nSize, &m_pOffsetsArena);
+	memset(m_pnOffsets, 0, nSize);
+}
+
 CASN1GenericSequence& CASN1GenericSequence::operator = (const CASN1GenericSequence& obj)
 {
     setValue(*obj.getValue());
@@ -151,7 +159,7 @@ CASN1Object CASN1GenericSequence::elementAt(int nPos)
 	if (this->size() > nPos)
 	{
 		int offset = m_pnOffsets[nPos];//getOffset(nPos);
-		UUCByteArray curObj(getValue()->getContent() + offset, getLength() - offset + 1);
+		UUCByteArray curObj(getValue()->getContent() + offset, getLength() - offset);
 		CASN1Object curAsn1Obj(curObj);
 
 		m_nextOffset = offset + curAsn1Obj.getSerializedLength();
@@ -164,7 +172,7 @@ CASN1Object CASN1GenericSequence::elementAt(int nPos)
 
 CASN1Object CASN1GenericSequence::nextElement()
 {
-	UUCByteArray curObj(getValue()->getContent() + m_nextOffset, getLength() - m_nextOffset + 1);
+	UUCByteArray curObj(getValue()->getContent() + m_nextOffset, getLength() - m_nextOffset);
 
 	CASN1Object curAsn1Obj(curObj);
 
@@ -178,7 +186,7 @@ CASN1Object CASN1GenericSequence::elementAtOpt(int nPos)
 	if (this->size() > (unsigned int)nPos)
 	{
 		int offset = m_pnOffsets[nPos];//getOffset(nPos);
-		CASN1Object curAsn1Obj(getValue()->getContent() + offset, getLength() - offset + 1);
+		CASN1Object curAsn1Obj(getValue()->getContent() + offset, getLength() - offset);
 
 		m_nextOffset = offset + curAsn1Obj.getSerializedLength();
 
@@ -192,7 +200,7 @@ CASN1Object CASN1GenericSequence::nextElementOpt()
 {
 	//UUCByteArray curObj(getValue()->getContent() + m_nextOffset, getLength() - m_nextOffset + 1);
 
-	CASN1Object curAsn1Obj(getValue()->getContent() + m_nextOffset, getLength() - m_nextOffset + 1);
+	CASN1Object curAsn1Obj(getValue()->getContent() + m_nextOffset, getLength() - m_nextOffset);
 
 	m_nextOffset += curAsn1Obj.getSerializedLength();
 
@@ -385,8 +393,9 @@ int CASN1GenericSequence::makeOffset()
 	{
 		if (i == m_nOffsetsMax)
 		{
+			unsigned int nOldSize = (m_nOffsetsMax + 2) * sizeof(m_pnOffsets[0]);
 			m_nOffsetsMax += 1000;
-			m_pnOffsets = (unsigned int*)realloc(m_pnOffsets, sizeof(m_pnOffsets[0]) * m_nOffsetsMax + 2);
+			m_pnOffsets = (unsigned int*)UUCArena::reallocate(m_pnOffsets, nOldSize, (m_nOffsetsMax + 2) * sizeof(m_pnOffsets[0]), &m_pOffsetsArena);
 
 		}
 		m_pnOffsets[i] = offset;
@@ -394,7 +403,7 @@ int CASN1GenericSequence::makeOffset()
 		// oggetto corrente
 		//UUCByteArray currentObjArray(pContent->getContent() + offset, pContent->getLength() - offset + 1);
 		try{
-			CASN1Object currentObj(pContent->getContent() + offset, pContent->getLength() - offset + 1);
+			CASN1Object currentObj(pContent->getContent() + offset, pContent->getLength() - offset);
 			int iLen = currentObj.getOrigLenLen() + currentObj.getLength() + 2;
 			//int iSer = currentObj.getSerializedLength();
 			//if (iLen != iSer)
@@ -47,7 +47,9 @@ private:
 	unsigned int * m_pnOffsets;
 	unsigned int m_nOffsetsMax;
 	int m_nSize;
+	UUCArena* m_pOffsetsArena;
 
+	void allocOffsets();
 	int makeOffset();
 };
 
@@ -4,6 +4,7 @@
 #include <memory.h>
 #include <math.h>
 #include "ASN1Exception.h"
+#include "UUCArena.h"
 
 
 // costruttori
@@ -167,9 +168,10 @@ bool CASN1Object::operator != (const CASN1Object& obj) const
 
 void CASN1Object::toByteArray(UUCByteArray& byteArray) const
 {	
-	//UUCByteArray serializedForm;
-	BYTE* pbtSerialized = NULL;
-	int nTLVLen;
+	// tag e lunghezza vengono scritti su stack e il valore accodato direttamente,
+	// senza passare da un buffer temporaneo
+	BYTE pbtHeader[2 + sizeof(unsigned int)];
+	int nHeaderLen;
 	unsigned int nLen = getLength();
 		
 	//if (nLen < 0x00000080)
@@ -180,47 +182,30 @@ void CASN1Object::toByteArray(UUCByteArray& byteArray) const
 	if(nLen < 0x80)	
 	{
 		// Short Form
-		nTLVLen    = 2 + nLen;
-		pbtSerialized = new BYTE[nTLVLen+1];
-		
-		pbtSerialized[0] = getTag();
-		pbtSerialized[1] = (BYTE)nLen;
-					
-		memcpy((pbtSerialized + 2), getValue()->getContent(), nLen);	
-	
+		nHeaderLen = 2;
+		pbtHeader[0] = getTag();
+		pbtHeader[1] = (BYTE)nLen;
 	}
 	else //if (nLen >= 0x80)
 	{
 		// Long Form
-		//int nLenNeeded = (int)(ceil((log((double)nLen) / log((double)2)) / 8));
 		int nLenNeeded = 0;
-		int nAuxLen = nLen;
+		unsigned int nAuxLen = nLen;
 		for(nLenNeeded = 0; nAuxLen > 0; nLenNeeded++, nAuxLen >>= 8);
 
-		nTLVLen    = 2 + nLenNeeded + nLen;
-		
-		pbtSerialized = new BYTE[nTLVLen];
-		
-		pbtSerialized[0] = getTag();
-		pbtSerialized[1] = (BYTE)(0x80 + nLenNeeded);
-		int nDigit = 0;
-		int i = 0;
-		int nAux = nLen;
-		for(i = 0; i < nLenNeeded; i++)				
+		nHeaderLen = 2 + nLenNeeded;
+		pbtHeader[0] = getTag();
+		pbtHeader[1] = (BYTE)(0x80 + nLenNeeded);
+		unsigned int nAux = nLen;
+		for(int i = 0; i < nLenNeeded; i++)
 		{
-			nDigit = nAux >> (256 * i);			
-			pbtSerialized[2 + (nLenNeeded - i - 1)] = (BYTE)nDigit;
-			nAux = nAux / 256;					
-		}					
-									
-		memcpy((pbtSerialized + 2 + (nLenNeeded)), getValue()->getContent(), nLen);												
+			pbtHeader[2 + (nLenNeeded - i - 1)] = (BYTE)(nAux & 0xFF);
+			nAux >>= 8;
+		}
 	}	
 	
-	byteArray.append(pbtSerialized, nTLVLen);
-
-	delete pbtSerialized;
-
-	//return serializedForm;
+	byteArray.append(pbtHeader, nHeaderLen);
+	byteArray.append(getValue()->getContent(), nLen);
 }
 
 
@@ -317,17 +302,19 @@ int CASN1Object::parseLen(UUCBufferedReader& reader, BYTE* pbtTag, UUCByteArray*
 	if (pValue)
 	{
 
-		BYTE* pbtVal = new BYTE[nLen];
+		// buffer temporaneo dall'arena corrente, se presente
+		UUCArena* pArena = NULL;
+		BYTE* pbtVal = (BYTE*)UUCArena::allocate(nLen, &pArena);
 		unsigned int n;
 		if ((n = reader.read(pbtVal, nLen)) < nLen)
 		{
-			delete pbtVal;
+			UUCArena::deallocate(pbtVal, pArena);
 			throw CASN1ParsingException();
 		}
 
 		pValue->append(pbtVal, nLen);
 
-		delete pbtVal;
+		UUCArena::deallocate(pbtVal, pArena);
 	}
 	return nLen;
 }
@@ -34,15 +34,16 @@ CASN1ObjectIdentifier::CASN1ObjectIdentifier(const char* strObjId)
 	int nVal;
 	int nAux;
 	char* szTok;
+	char* szSavePtr = NULL;
 	char* szOID = new char[strlen(strObjId) + 2];
 	strcpy(szOID, strObjId);
 
-	szTok = strtok(szOID, ".");
+	szTok = strtok_r(szOID, ".", &szSavePtr);
 	
-	UINT nFirst = 40 * atoi(szTok) + atoi(strtok(NULL, "."));
+	UINT nFirst = 40 * atoi(szTok) + atoi(strtok_r(NULL, ".", &szSavePtr));
 	if(nFirst > 0xff)
 	{
-		delete szOID;
+		delete[] szOID;
 		throw -1;//new CASN1BadObjectIdException(strObjId);
 	}
 	out[nIndex] = nFirst;
@@ -50,7 +51,7 @@ CASN1ObjectIdentifier::CASN1ObjectIdentifier(const char* strObjId)
 		
 	int i = 0;
 		
-	while ((szTok = strtok(NULL, ".")) != NULL)
+	while ((szTok = strtok_r(NULL, ".", &szSavePtr)) != NULL)
 	{
 		nVal = atoi(szTok);
 		if(nVal == 0)
@@ -86,7 +87,7 @@ CASN1ObjectIdentifier::CASN1ObjectIdentifier(const char* strObjId)
 	
 	setValue(UUCByteArray(out, nIndex));
 	
-	delete szOID;
+	delete[] szOID;
 	
 }
 		
@@ -9,6 +9,9 @@
 #include "OCSPRequest.h"
 #include "ASN1OptionalField.h"
 #include "Crl.h"
+#include "CrlCache.h"
+#include "OCSPCache.h"
+#include "RevocationResolver.h"
 #include "ASN1Exception.h"
 #include "RSAPublicKey.h"
 #include "../RSA/rsaeuro.h"
@@ -19,18 +22,20 @@
 #include <time.h>
 #include "RSAPublicKey.h"
 #include "Base64.h"
-#include <curl/curl.h>
+#include "HttpClient.h"
 #include "LdapCrl.h"
 #include "UUCLogger.h"
 #include "CertStore.h"
 #include <openssl/bio.h>
 #include <openssl/rsa.h>
 #include <openssl/x509.h>
+#include <string>
+#include <vector>
 
 #define PROXY_AUTHENTICATION_REQUIRED	407
 
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp);
 long HTTPRequest(UUCByteArray& data, const char* szUrl, const char* szContentType, UUCByteArray& response);
+long HTTPConditionalGet(const char* szUrl, const char* szETag, const char* szLastModified, UUCByteArray& response, std::string& etag, std::string& lastModified, bool* pbNotModified);
 
 extern char g_szVerifyProxy[MAX_PATH];
 extern char* g_szVerifyProxyUsrPass;
@@ -38,6 +43,72 @@ extern int g_nVerifyProxyPort;
 
 USE_LOG;
 
+// Campi del certificato gia' decodificati. Ogni campo viene estratto dal DER
+// al primo accesso e riusato per tutta la vita dell'oggetto CCertificate.
+class CCertificateCache
+{
+public:
+	CCertificateCache()
+	: pCertInfo(NULL), pIssuer(NULL), pSubject(NULL), pSerialNumber(NULL),
+	  pFrom(NULL), pExpiration(NULL), pExtensions(NULL),
+	  pAuthorityKeyIdentifier(NULL), pSubjectKeyIdentifier(NULL), bExtensionsIndexed(false),
+	  bSignature(false), bTBS(false), nNonRepudiation(-1), nQualified(-1), nSHA256(-1),
+	  pX509(NULL), pPublicKey(NULL), bX509Loaded(false)
+	{
+	}
+
+	~CCertificateCache()
+	{
+		delete pCertInfo;
+		delete pIssuer;
+		delete pSubject;
+		delete pSerialNumber;
+		delete pFrom;
+		delete pExpiration;
+		delete pExtensions;
+		delete pAuthorityKeyIdentifier;
+		delete pSubjectKeyIdentifier;
+
+		if(pPublicKey)
+			EVP_PKEY_free(pPublicKey);
+		if(pX509)
+			X509_free(pX509);
+	}
+
+	CCertificateInfo* pCertInfo;
+	CName* pIssuer;
+	CName* pSubject;
+	CASN1Integer* pSerialNumber;
+	CASN1UTCTime* pFrom;
+	CASN1UTCTime* pExpiration;
+	CASN1Sequence* pExtensions;
+	CASN1OctetString* pAuthorityKeyIdentifier;
+	CASN1OctetString* pSubjectKeyIdentifier;
+
+	// estensioni indicizzate per OID
+	bool bExtensionsIndexed;
+	std::vector<CASN1ObjectIdentifier> extensionOIDs;
+	std::vector<CASN1Sequence> extensions;
+
+	// firma (senza il byte degli unused bits) e TBSCertificate codificato
+	bool bSignature;
+	UUCByteArray signature;
+	bool bTBS;
+	UUCByteArray tbs;
+
+	// -1 = non ancora calcolato
+	int nNonRepudiation;
+	int nQualified;
+	int nSHA256;
+
+	X509* pX509;
+	EVP_PKEY* pPublicKey;
+	bool bX509Loaded;
+};
+
+static bool checkNonRepudiation(CCertificate& cert);
+static bool checkQualified(CCertificate& cert);
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
@@ -120,13 +191,13 @@ CCertificate* CCertificate::createCertificate(UUCByteArray& contentArray)
 }
 
 CCertificate::CCertificate(const BYTE* value, long len)
-: CASN1Sequence(value, len)
+: CASN1Sequence(value, len), m_pCache(NULL)
 {	
 	
 }
 
 CCertificate::CCertificate(UUCBufferedReader& reader)
-:CASN1Sequence(reader)
+:CASN1Sequence(reader), m_pCache(NULL)
 {
 	
 }
@@ -141,19 +212,50 @@ CCertificate::CCertificate(const CCertificateInfo& certInfo, const CAlgorithmIde
 */
 
 CCertificate::CCertificate(const CASN1Object& cert)
-: CASN1Sequence(cert)
+: CASN1Sequence(cert), m_pCache(NULL)
+{
+
+}
+
+// la copia riparte con la cache vuota
+CCertificate::CCertificate(const CCertificate& cert)
+: CASN1Sequence(cert), m_pCache(NULL)
 {
 
 }
 
 CCertificate::~CCertificate()
 {
+	delete m_pCache;
+}
+
+CCertificate& CCertificate::operator = (const CCertificate& cert)
+{
+	if(this != &cert)
+	{
+		CASN1Sequence::operator = (cert);
+		delete m_pCache;
+		m_pCache = NULL;
+	}
+
+	return *this;
+}
+
+CCertificateCache& CCertificate::cache()
+{
+	if(!m_pCache)
+		m_pCache = new CCertificateCache();
 
+	return *m_pCache;
 }
 
 CCertificateInfo CCertificate::getCertificateInfo()
 {
-	return elementAt(0);
+	CCertificateCache& c = cache();
+	if(!c.pCertInfo)
+		c.pCertInfo = new CCertificateInfo(elementAt(0));
+
+	return *c.pCertInfo;
 }
 
 CAlgorithmIdentifier CCertificate::getAlgorithmIdentifier()
@@ -163,35 +265,102 @@ CAlgorithmIdentifier CCertificate::getAlgorithmIdentifier()
 
 CName CCertificate::getIssuer()
 {
-	return getCertificateInfo().getIssuer();
+	CCertificateCache& c = cache();
+	if(!c.pIssuer)
+	{
+		getCertificateInfo();
+		c.pIssuer = new CName(c.pCertInfo->getIssuer());
+	}
+
+	return *c.pIssuer;
 }
 
 CName CCertificate::getSubject()
 {
-	return getCertificateInfo().getSubject();
+	CCertificateCache& c = cache();
+	if(!c.pSubject)
+	{
+		getCertificateInfo();
+		c.pSubject = new CName(c.pCertInfo->getSubject());
+	}
+
+	return *c.pSubject;
 }
 
 CASN1Integer CCertificate::getSerialNumber()
 {
-	return getCertificateInfo().getSerialNumber();
+	CCertificateCache& c = cache();
+	if(!c.pSerialNumber)
+	{
+		getCertificateInfo();
+		c.pSerialNumber = new CASN1Integer(c.pCertInfo->getSerialNumber());
+	}
+
+	return *c.pSerialNumber;
 }
 
 CASN1UTCTime CCertificate::getExpiration()
 {
-	return getCertificateInfo().getExpiration();
+	CCertificateCache& c = cache();
+	if(!c.pExpiration)
+	{
+		getCertificateInfo();
+		c.pExpiration = new CASN1UTCTime(c.pCertInfo->getExpiration());
+	}
+
+	return *c.pExpiration;
 }	
 
 CASN1UTCTime CCertificate::getFrom()
 {
-	return getCertificateInfo().getFrom();
+	CCertificateCache& c = cache();
+	if(!c.pFrom)
+	{
+		getCertificateInfo();
+		c.pFrom = new CASN1UTCTime(c.pCertInfo->getFrom());
+	}
+
+	return *c.pFrom;
 }	
 
 
 CASN1Sequence CCertificate::getExtensions()
 {
-	return getCertificateInfo().getExtensions();
+	CCertificateCache& c = cache();
+	if(!c.pExtensions)
+	{
+		getCertificateInfo();
+		c.pExtensions = new CASN1Sequence(c.pCertInfo->getExtensions());
+	}
+
+	return *c.pExtensions;
 }	
 
+X509* CCertificate::getX509()
+{
+	CCertificateCache& c = cache();
+	if(!c.bX509Loaded)
+	{
+		c.bX509Loaded = true;
+
+		UUCByteArray baCert;
+		toByteArray(baCert);
+
+		const BYTE* content = baCert.getContent();
+		c.pX509 = d2i_X509(NULL, &content, baCert.getLength());
+		if(c.pX509)
+			c.pPublicKey = X509_get_pubkey(c.pX509);
+	}
+
+	return c.pX509;
+}
+
+EVP_PKEY* CCertificate::getPublicKey()
+{
+	getX509();
+	return cache().pPublicKey;
+}
+
 CASN1Sequence CCertificate::getQCStatements()
 {
 	return getExtension(CASN1ObjectIdentifier("1.3.6.1.5.5.7.1.3"));
@@ -199,7 +368,16 @@ CASN1Sequence CCertificate::getQCStatements()
 
 bool CCertificate::isNonRepudiation()
 {
-	CASN1Sequence keyUsage(getExtension(CASN1ObjectIdentifier("2.5.29.15")));
+	CCertificateCache& c = cache();
+	if(c.nNonRepudiation == -1)
+		c.nNonRepudiation = checkNonRepudiation(*this) ? 1 : 0;
+
+	return c.nNonRepudiation == 1;
+}
+
+static bool checkNonRepudiation(CCertificate& cert)
+{
+	CASN1Sequence keyUsage(cert.getExtension(CASN1ObjectIdentifier("2.5.29.15")));
 	int n = keyUsage.size(); 
 	if(n == 0) // not found
 		return false;
@@ -241,9 +419,18 @@ bool CCertificate::isNonRepudiation()
 }
 
 bool CCertificate::isQualified()
+{
+	CCertificateCache& c = cache();
+	if(c.nQualified == -1)
+		c.nQualified = checkQualified(*this) ? 1 : 0;
+
+	return c.nQualified == 1;
+}
+
+static bool checkQualified(CCertificate& cert)
 {
 	
-	CASN1Sequence keyUsage(getExtension(CASN1ObjectIdentifier("2.5.29.15")));
+	CASN1Sequence keyUsage(cert.getExtension(CASN1ObjectIdentifier("2.5.29.15")));
 	if(keyUsage.size() == 0) // not found
 		return false;
 	
@@ -253,7 +440,7 @@ bool CCertificate::isQualified()
 	if(!(pKeyUsageFlags[0] & 0x01)) // non repudiation
 		return false;
 	
-	CASN1Sequence qcStatement(getExtension(CASN1ObjectIdentifier("1.3.6.1.5.5.7.1.3")));
+	CASN1Sequence qcStatement(cert.getExtension(CASN1ObjectIdentifier("1.3.6.1.5.5.7.1.3")));
 	if(qcStatement.size() == 0) // not found
 		return false;
 	
@@ -269,13 +456,15 @@ bool CCertificate::isQualified()
 
 bool CCertificate::isSHA256()
 {
-		
-	CAlgorithmIdentifier sha256Algo(szSHA256OID);
-	CAlgorithmIdentifier digestAlgo(elementAt(1));
-	if(!(digestAlgo.elementAt(0) == sha256Algo.elementAt(0)))
-		return false;
+	CCertificateCache& c = cache();
+	if(c.nSHA256 == -1)
+	{
+		CAlgorithmIdentifier sha256Algo(szSHA256OID);
+		CAlgorithmIdentifier digestAlgo(elementAt(1));
+		c.nSHA256 = (digestAlgo.elementAt(0) == sha256Algo.elementAt(0)) ? 1 : 0;
+	}
 	
-	return true;
+	return c.nSHA256 == 1;
 }
 bool CCertificate::isValid()
 {
@@ -331,23 +520,29 @@ bool CCertificate::isValid(const char* szDateTime)
 
 CASN1Sequence CCertificate::getExtension(const CASN1ObjectIdentifier& oid)
 {
-	CASN1Sequence certExtensions = getExtensions();
-	CASN1Sequence extensions = certExtensions.elementAt(0);
-	CASN1Sequence requestedExtension;
-	int count = extensions.size();
-	for(int i = 0; i < count; i++)
+	CCertificateCache& c = cache();
+	if(!c.bExtensionsIndexed)
 	{
-		CASN1Sequence extension = extensions.elementAt(i);
-		//int n = extension.size();
-		//const char* szHex = ((UUCByteArray*)(extension.getValue()))->toHexString();
-		CASN1ObjectIdentifier extoid = extension.elementAt(0);
-		if(extoid.equals(oid))
+		// le estensioni vengono scandite una sola volta
+		CASN1Sequence certExtensions = getExtensions();
+		CASN1Sequence extensions = certExtensions.elementAt(0);
+		int count = extensions.size();
+		for(int i = 0; i < count; i++)
 		{
-			return extension;
-		
+			CASN1Sequence extension = extensions.elementAt(i);
+			c.extensionOIDs.push_back(CASN1ObjectIdentifier(extension.elementAt(0)));
+			c.extensions.push_back(extension);
 		}
+		c.bExtensionsIndexed = true;
+	}
+
+	for(size_t i = 0; i < c.extensionOIDs.size(); i++)
+	{
+		if(c.extensionOIDs[i].equals(oid))
+			return c.extensions[i];
 	}
 	
+	CASN1Sequence requestedExtension;
 	return requestedExtension; 
 }
 
@@ -371,30 +566,35 @@ CASN1Sequence CCertificate::getCertificatePolicies()
 
 CASN1OctetString CCertificate::getAuthorithyKeyIdentifier()
 {
-	CASN1Sequence keyIdentifier(getExtension(szAuthorityKeyIdentifier));
+	CCertificateCache& c = cache();
+	if(!c.pAuthorityKeyIdentifier)
+	{
+		CASN1Sequence keyIdentifier(getExtension(szAuthorityKeyIdentifier));
 	
-	CASN1OctetString val(keyIdentifier.elementAt(1));
+		CASN1OctetString val(keyIdentifier.elementAt(1));
 	
-	UUCBufferedReader reader(*val.getValue());
-	return CASN1Sequence(reader);
+		UUCBufferedReader reader(*val.getValue());
+		c.pAuthorityKeyIdentifier = new CASN1OctetString(CASN1Sequence(reader));
+	}
+
+	return *c.pAuthorityKeyIdentifier;
 }
 
 
 CASN1OctetString CCertificate::getSubjectKeyIdentifier()
 {
+	CCertificateCache& c = cache();
+	if(!c.pSubjectKeyIdentifier)
+	{
+		CASN1Sequence keyIdentifier = getExtension(szSubjectKeyIdentifier);
     
-    CASN1Sequence keyIdentifier = getExtension(szSubjectKeyIdentifier);
-    
-    if(keyIdentifier.size() > 0)
-    {
-        CASN1OctetString val(keyIdentifier.elementAt(1));
-        return val;
-    }
-    else
-    {
-        CASN1OctetString val("");
-        return val;
-    }
+		if(keyIdentifier.size() > 0)
+			c.pSubjectKeyIdentifier = new CASN1OctetString(keyIdentifier.elementAt(1));
+		else
+			c.pSubjectKeyIdentifier = new CASN1OctetString("");
+	}
+
+	return *c.pSubjectKeyIdentifier;
 }
 
 /*
@@ -502,8 +702,9 @@ int CCertificate::verifyStatus(const char* szTime, REVOCATION_INFO* pRevocationI
 
 				LOG_DBG((0, "CCertificate::verifyStatus", "POST OCSP Request"));
 
+				// risposta gia' ottenuta per la stessa CertID e ancora valida, altrimenti POST al responder
 				UUCByteArray response;
-				long nRet = HTTPRequest(baOcspRequest, (char*)pValue->getContent(), "application/ocsp-request", response);
+				long nRet = COCSPCache::GetResponse((char*)pValue->getContent(), baOcspRequest, response);
 				if(nRet)
 				{
 					LOG_ERR((0, "CCertificate::verifyStatus", "OCSP not available. Error: %x", nRet));
@@ -700,6 +901,31 @@ int CCertificate::verifyStatus(const char* szTime, REVOCATION_INFO* pRevocationI
 		//sz = (char*)((UUCByteArray*)crlDP.getValue())->toHexString();
 		//NSLog([NSString stringWithCString:sz]);
 		
+		// delta CRL (RFC 5280 5.2.4): FreshestCRL ha la stessa sintassi di CRLDistributionPoints
+		std::string szDeltaUrl;
+		try
+		{
+			CASN1Sequence freshestCRL(getExtension(szFreshestCRLOID));
+			if(freshestCRL.size() > 0)
+			{
+				CASN1OctetString freshestCRLValue(freshestCRL.elementAt(freshestCRL.size() - 1));
+				UUCBufferedReader freshestReader(*(freshestCRLValue.getValue()));
+				CASN1Sequence freshestDP(freshestReader);
+				CASN1Sequence dp(freshestDP.elementAt(0));
+				CASN1Sequence distributionPointName(dp.elementAt(0));
+				CASN1Sequence fullName(distributionPointName.elementAt(0));
+				CASN1Object name(fullName.elementAt(0));
+				szDeltaUrl.assign((const char*)name.getValue()->getContent(), name.getValue()->getLength());
+				LOG_DBG((0, "CCertificate::verifyStatus", "Delta CRL Url: %s", szDeltaUrl.c_str()));
+			}
+		}
+		catch(...)
+		{
+			// senza delta si usa la sola CRL completa
+			LOG_ERR((0, "CCertificate::verifyStatus", "invalid FreshestCRL extension"));
+			szDeltaUrl.clear();
+		}
+
 		int size = crlDP.size();
 		if(size > 0)
 		{
@@ -724,7 +950,15 @@ int CCertificate::verifyStatus(const char* szTime, REVOCATION_INFO* pRevocationI
 
 				//crlurl.append((char*)name3.getValue()->getContent(), name3.getLength());
 				
-				UUCByteArray response;
+				int revstatus = CCrlCache::CheckRevocation(szcrlurl, szDeltaUrl.empty() ? NULL : szDeltaUrl.c_str(), serialNumber, szTime, pRevocationInfo);
+				if(revstatus == REVOCATION_STATUS_NOTLOADED)
+				{
+					LOG_ERR((0, "CCertificate::verifyStatus", "CRL not available: %s", szcrlurl));
+					return REVOCATION_STATUS_NOTLOADED;
+				}
+
+				LOG_MSG((0, "CCertificate::verifyStatus", "Cert Status: %d", revstatus));
+				status = revstatus == REVOCATION_STATUS_GOOD ? REVOCATION_STATUS_GOOD : REVOCATION_STATUS_REVOKED;
 /*				
 				if(strstr(szcrlurl, "ldap") > 0)
 	 			{
@@ -746,44 +980,7 @@ int CCertificate::verifyStatus(const char* szTime, REVOCATION_INFO* pRevocationI
 					}
 
 				}
-				else 
-				{*/
-					UUCByteArray data;
-					long nRet = HTTPRequest(data, szcrlurl, NULL, response);
-					if(nRet)
-					{
-						LOG_ERR((0, "CCertificate::verifyStatus", "CRL not available. Error: %x", nRet));
-						return REVOCATION_STATUS_NOTLOADED;
-					}
-					else
-					{
-						LOG_DBG((0, "CCertificate::verifyStatus", "CRL OK, nRet: %d", nRet));
-					}
-			//	}
-
-			    if(response.getLength() > 0)
-			    {				
-					UUCBufferedReader reader(response.getContent(), response.getLength());
-					//LOG_MSG((0, "CCertificate::verifyStatus", "proxy response: %s", response.getContent()));
-					CCrl crl(reader);
-
-                    int revstatus = 0;
-					if(!crl.isRevoked(serialNumber, szTime, &revstatus, pRevocationInfo))
-					{
-						LOG_MSG((0, "CCertificate::verifyStatus", "Cert Status: GOOD: %d", revstatus));
-						status = REVOCATION_STATUS_GOOD;
-					}
-                    else
-                    {
-                        LOG_MSG((0, "CCertificate::verifyStatus", "Cert Status: REVOKED: %d", revstatus));
-                        status = REVOCATION_STATUS_REVOKED;
-                    }
-				}			
-				else
-				{
-					LOG_ERR((0, "CCertificate::verifyStatus", "CRL Empty"));
-					return REVOCATION_STATUS_NOTLOADED;
-				}
+				*/
 			}
 		}
 	}
@@ -802,23 +999,65 @@ int CCertificate::verifyStatus(const char* szTime, REVOCATION_INFO* pRevocationI
 	return status;
 }
 
+// firma (senza il byte degli unused bits) e TBSCertificate codificato
+void CCertificate::decodeSignature()
+{
+	CCertificateCache& c = cache();
+	if(!c.bSignature)
+	{
+		CASN1BitString encryptedDigest(elementAt(2));	
+		c.signature.append(*encryptedDigest.getValue());
+		c.signature.remove(0);
+		c.bSignature = true;
+	}
+
+	if(!c.bTBS)
+	{
+		getCertificateInfo();
+		c.pCertInfo->toByteArray(c.tbs);
+		c.bTBS = true;
+	}
+}
+
+void CCertificate::decode()
+{
+	getIssuer();
+	getSubject();
+	getSerialNumber();
+	getFrom();
+	getExpiration();
+	getSubjectKeyIdentifier();
+	isNonRepudiation();
+	isQualified();
+	isSHA256();
+	getPublicKey();
+	decodeSignature();
+
+	try
+	{
+		getAuthorithyKeyIdentifier();
+	}
+	catch(CASN1Exception* ex)
+	{
+		// certificato senza AuthorityKeyIdentifier: nessun campo in cache
+		delete ex;
+	}
+	catch(...)
+	{
+	}
+}
+
 int CCertificate::verify()
 {
 	int bitmask = 0;
 
 	// verifica la cert chain
-    CCertificate* pCert = this;
-	CCertificate* pCACert = CCertStore::GetCertificate(*pCert);
-	while(pCACert && pCert->verifySignature(*pCACert) )
-	{
-		//NSLog(@"issuer: %s, SN: %s", issuer.c_str(), serialNumber.toHexString());
-		
+    std::vector<CCertificate*> chain;
+    bool bChainComplete = CCertStore::BuildChain(*this, chain);
+	if(!chain.empty())
 		bitmask |= VERIFIED_CACERT_FOUND;
-        pCert = pCACert;
-        pCACert = CCertStore::GetCertificate(*pCACert);
-	}
 
-    if(!pCACert)
+    if(bChainComplete)
     {
         //NSLog(@"CA Cert valid");
         bitmask |= VERIFIED_CERT_CHAIN;
@@ -835,39 +1074,29 @@ bool CCertificate::verifySignature(CCertificate& cert)
 {
 	//NSLog(@"Verify CERT signature");
 	
-    // OpenSSL
-    UUCByteArray baCert;
-    cert.toByteArray(baCert);
-        
-    X509 *x509 = NULL;
-    
-    const BYTE* content = baCert.getContent();
-    x509 = d2i_X509(NULL, &content, baCert.getLength());
-            
-    EVP_PKEY *evp_pubkey;
-    RSA *rsa_pubkey;
-
-    evp_pubkey  = X509_get_pubkey(x509);
-    rsa_pubkey  = EVP_PKEY_get1_RSA(evp_pubkey);
+    // OpenSSL: la chiave pubblica dell'issuer e' decodificata una sola volta
+    EVP_PKEY *evp_pubkey = cert.getPublicKey();
+    if(!evp_pubkey)
+        return false;
+
+    RSA *rsa_pubkey = EVP_PKEY_get1_RSA(evp_pubkey);
+    if(!rsa_pubkey)
+        return false;
     
-	CASN1BitString encryptedDigest(elementAt(2));	
-	UUCByteArray encDigest(*(UUCByteArray*)encryptedDigest.getValue());
-	encDigest.remove(0);
+	CCertificateCache& c = cache();
+	decodeSignature();
 	
     BYTE decrypted[MAX_RSA_MODULUS_LEN];
-    unsigned int len = MAX_RSA_MODULUS_LEN;
+    int len = 0;
     
-    const BYTE* encrypted = encDigest.getContent();
-    const int encrypted_len = (int)encDigest.getLength();
+    const BYTE* encrypted = c.signature.getContent();
+    const int encrypted_len = (int)c.signature.getLength();
     
     len = RSA_public_decrypt(encrypted_len, (BYTE*)encrypted, decrypted, rsa_pubkey,RSA_PKCS1_PADDING);
     
     RSA_free(rsa_pubkey);
-    EVP_PKEY_free(evp_pubkey);
-    X509_free(x509);
-    
     
-    if(len)
+    if(len > 0)
     {
         //NSLog(@"RSA OK");
         try
@@ -885,8 +1114,7 @@ bool CCertificate::verifySignature(CCertificate& cert)
 			//szHex = pDigestValue->toHexString();
 			
 			// content
-			UUCByteArray content;
-			getCertificateInfo().toByteArray(content);
+			const UUCByteArray& content = c.tbs;
 			
 			
 			BYTE* buff;
@@ -1023,123 +1251,95 @@ CASN1BitString& CCertificate::getSignature()
  */
 
 
-long HTTPRequest(UUCByteArray& data, const char* szUrl, const char* szContentType, UUCByteArray& response)
-{    
-	//general initilization
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-    
-	CURL* ctx = curl_easy_init();
-
-	//set URL
-	curl_easy_setopt(ctx, CURLOPT_URL, szUrl);
-	
-	curl_easy_setopt(ctx, CURLOPT_SSL_VERIFYPEER, false);
-
-	if(data.getLength() > 0)
-	{
-		//set POST method
-		curl_easy_setopt(ctx, CURLOPT_POST, 1);
-
-		//give the data you want to post
-		curl_easy_setopt(ctx, CURLOPT_POSTFIELDS, data.getContent());
-		LOG_ERR((0, "HTTPRequest", "POST data content: %s", data.getContent()));
-		//give the data lenght
-		curl_easy_setopt(ctx, CURLOPT_POSTFIELDSIZE, data.getLength());
-	}
-
+// richieste OCSP e download delle CRL: con il proxy di verifica, se impostato
+static void SetVerifyProxy(CHttpClient::Request& request)
+{
 	if(g_nVerifyProxyPort != -1)
 	{
 		LOG_MSG((0, "HTTPRequest", "Proxy: %s, %d", g_szVerifyProxy, g_nVerifyProxyPort));
 
-		//set the proxy
-		curl_easy_setopt(ctx, CURLOPT_PROXY, g_szVerifyProxy);
-
-		//set the proxy type
-		curl_easy_setopt(ctx, CURLOPT_PROXYTYPE,  CURLPROXY_HTTP);
-
-		if(g_nVerifyProxyPort != 0)
-		{
-			LOG_MSG((0, "HTTPRequest", "Proxy Port: %d", g_nVerifyProxyPort));
-
-			curl_easy_setopt(ctx, CURLOPT_PROXYPORT, g_nVerifyProxyPort);			
-		}
-	
-		if(g_szVerifyProxyUsrPass != NULL)
-		{
-			LOG_MSG((0, "HTTPRequest", "Proxy UserPass: %s", g_szVerifyProxyUsrPass));
-			curl_easy_setopt(ctx, CURLOPT_PROXYUSERPWD, g_szVerifyProxyUsrPass);			
-		}
+		request.szProxy = g_szVerifyProxy;
+		request.nProxyPort = g_nVerifyProxyPort;
+		request.szProxyUsrPass = g_szVerifyProxyUsrPass;
 	}
-    
-	//set the callback function that handle the data return from server
-	//if you don't set this, the return data just show up on the screen
-	//size_t write_callback(void *ptr, size_t size, size_t nmemb, void *userp)
-	curl_easy_setopt(ctx, CURLOPT_WRITEFUNCTION, WriteCallback);
-
-	/* we pass our 'chunk' struct to the callback function */ 
-	curl_easy_setopt(ctx, CURLOPT_WRITEDATA, (void *)&response);
-
-	struct curl_slist *headers = NULL;
+}
 
-	if(szContentType)
+long HTTPRequest(UUCByteArray& data, const char* szUrl, const char* szContentType, UUCByteArray& response)
+{
+	CHttpClient::Request request(szUrl);
+	if(data.getLength() > 0)
+		request.pData = &data;
+	request.szContentType = szContentType;
+	request.nTimeout = CRevocationResolver::GetTimeout();
+	SetVerifyProxy(request);
+
+	CHttpClient::Response httpResponse;
+	long ret = CHttpClient::Perform(request, httpResponse);
+	if(ret != 0)
 	{
-		char szAux[256];
-		sprintf(szAux, "Content-Type: %s", szContentType);
+		LOG_ERR((0, "HTTPRequest", "Unable to connect to: %s", szUrl));
+		return ret;
+	}
 
-		headers = curl_slist_append(headers, szAux);
+	LOG_DBG((0, "HTTPRequest", "%s HttpCode: %d", szUrl, httpResponse.nHttpCode));
 
-		curl_easy_setopt(ctx, CURLOPT_HTTPHEADER, headers);
+	if (httpResponse.nHttpCode == PROXY_AUTHENTICATION_REQUIRED)
+	{
+		LOG_ERR((0, "HTTPRequest", "Unable to connect to: %s. Proxy authentication required", szUrl));
+		return httpResponse.nHttpCode;
 	}
 
-	//let's do it...
-	CURLcode ret = curl_easy_perform(ctx);
-
-	LONG responseCode;
+	response.append(httpResponse.body);
 
-	/* Check for errors */
-	if (ret != CURLE_OK)
+	if (response.getLength() == 0)
 	{
-		//fprintf(stderr, "curl_easy_perform() failed: %s\n",
-		//      curl_easy_strerror(ret));
+		LOG_ERR((0, "<-- HTTPRequest", "empty response"));
+		return -1;
+	}
 
-		LOG_ERR((0, "HTTPRequest", "Unable to connect to: %s", szUrl));
+	return 0;
+}
 
+long HTTPConditionalGet(const char* szUrl, const char* szETag, const char* szLastModified, UUCByteArray& response, std::string& etag, std::string& lastModified, bool* pbNotModified)
+{
+	*pbNotModified = false;
+
+	// validatori della copia gia' presente
+	CHttpClient::Request request(szUrl);
+	request.szETag = szETag;
+	request.szLastModified = szLastModified;
+	request.nTimeout = CRevocationResolver::GetTimeout();
+	SetVerifyProxy(request);
+
+	CHttpClient::Response httpResponse;
+	long ret = CHttpClient::Perform(request, httpResponse);
+	if (ret != 0)
+	{
+		LOG_ERR((0, "HTTPConditionalGet", "Unable to connect to: %s", szUrl));
 		return ret;
 	}
 
-	CURLcode httpCode = curl_easy_getinfo(ctx, CURLINFO_RESPONSE_CODE, &responseCode);
+	LOG_DBG((0, "HTTPConditionalGet", "%s HttpCode: %d", szUrl, httpResponse.nHttpCode));
 
-	LOG_ERR((0, "HTTPRequest", "HttpCode: %d", responseCode));
-	
-	if (responseCode == PROXY_AUTHENTICATION_REQUIRED)
+	etag = httpResponse.szETag;
+	lastModified = httpResponse.szLastModified;
+
+	if(httpResponse.nHttpCode == 304)
 	{
-		LOG_ERR((0, "HTTPRequest", "Unable to connect to: %s. Proxy authentication required", szUrl));
-		return responseCode;
+		*pbNotModified = true;
+		return 0;
 	}
 
-	LOG_ERR((0, "HTTPRequest", "connect to: %s OK", szUrl));
+	if(httpResponse.nHttpCode != 200)
+		return httpResponse.nHttpCode;
 
-	//clean up
-	if(headers)
-		curl_slist_free_all(headers);
-
-	curl_easy_cleanup(ctx);
+	response.append(httpResponse.body);
 
 	if (response.getLength() == 0)
 	{
-		LOG_ERR((0, "<-- HTTPRequest", "empty response"));
+		LOG_ERR((0, "<-- HTTPConditionalGet", "empty response"));
 		return -1;
 	}
 
 	return 0;
 }
-
-static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
-{
-	UUCByteArray* pResponse = (UUCByteArray*)userp;
-	size_t realsize = size * nmemb;
-	//LOG_ERR((0, "WriteCallback", "response len: %d", realsize));
-	pResponse->append((BYTE*)contents, realsize);
-
-	return realsize;
-}
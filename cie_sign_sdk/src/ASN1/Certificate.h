@@ -18,7 +18,9 @@
 #include "ASN1UTCTime.h"
 #include "Crl.h"
 #include "disigonsdk.h"
+#include <openssl/ossl_typ.h>
 
+class CCertificateCache;
 
 
 class CCertificate : public CASN1Sequence  
@@ -33,8 +35,12 @@ public:
 
 	CCertificate (const CASN1Object& cert);
 
+	CCertificate (const CCertificate& cert);
+
 	virtual ~CCertificate();
 
+	CCertificate& operator = (const CCertificate& cert);
+
 	CCertificateInfo		getCertificateInfo();
 
 	CAlgorithmIdentifier	getAlgorithmIdentifier();
@@ -67,8 +73,22 @@ public:
 	bool isValid(const char* szDateTime);
 	bool isSHA256();
 	CASN1Sequence getExtension(const CASN1ObjectIdentifier& oid);
+
+	// handle OpenSSL decodificati una sola volta e posseduti dal certificato
+	X509* getX509();
+	EVP_PKEY* getPublicKey();
+
+	// decodifica subito tutti i campi on demand: da quel momento il certificato
+	// viene solo letto e si puo' usare da piu' thread (es. i certificati di CCertStore)
+	void decode();
 	
 	static CCertificate* createCertificate(UUCByteArray& contentArray);
+
+private:
+	// campi decodificati on demand; il DER del certificato non cambia dopo la costruzione
+	CCertificateCache* m_pCache;
+	CCertificateCache& cache();
+	void decodeSignature();
 };
 
 #endif // !defined(AFX_CERTIFICATE_H__2DF2B808_9398_479F_9FD2_9A229517EF9D__INCLUDED_)
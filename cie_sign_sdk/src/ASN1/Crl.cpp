@@ -10,105 +10,357 @@
 #include "Crl.h"
 #include "ASN1Octetstring.h"
 #include "ASN1UTCTime.h"
+#include "ASN1Exception.h"
 #include "UUCLogger.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
 
 USE_LOG;
 
+// UTCTime (YYMMDDHHMMSSZ) o GeneralizedTime (YYYYMMDDHHMMSSZ)
+time_t timeFromASN1(BYTE btTag, const BYTE* pbtValue, size_t nLen)
+{
+	char szTime[32];
+	if(nLen >= sizeof(szTime))
+		return 0;
+
+	memcpy(szTime, pbtValue, nLen);
+	szTime[nLen] = 0;
+
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	const char* p = szTime;
+	if(btTag == 0x18)
+	{
+		if(sscanf(p, "%4d", &t.tm_year) != 1)
+			return 0;
+		t.tm_year -= 1900;
+		p += 4;
+	}
+	else
+	{
+		if(sscanf(p, "%2d", &t.tm_year) != 1)
+			return 0;
+		// RFC 5280: YY >= 50 -> 19YY
+		if(t.tm_year < 50)
+			t.tm_year += 100;
+		p += 2;
+	}
+
+	if(sscanf(p, "%2d%2d%2d%2d%2d", &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) != 5)
+		return 0;
+	t.tm_mon -= 1;
+
+	return timegm(&t);
+}
+
+// header DER (tag a un byte, lunghezza definita) in [nPos, nEnd): ritorna l'inizio del contenuto
+static size_t readTLV(const BYTE* pbtData, size_t nEnd, size_t nPos, BYTE* pbtTag, size_t* pnLen)
+{
+	if(nPos + 2 > nEnd)
+		throw CASN1ParsingException();
+
+	*pbtTag = pbtData[nPos++];
+	size_t nLen = pbtData[nPos++];
+	if(nLen & 0x80)
+	{
+		size_t nBytes = nLen & 0x7F;
+		if(nBytes == 0 || nBytes > 4 || nPos + nBytes > nEnd)
+			throw CASN1ParsingException();
+
+		nLen = 0;
+		while(nBytes--)
+			nLen = (nLen << 8) | pbtData[nPos++];
+	}
+
+	if(nLen > nEnd - nPos)
+		throw CASN1ParsingException();
+
+	*pnLen = nLen;
+	return nPos;
+}
+
+// Extension ::= SEQUENCE { extnID, critical BOOLEAN DEFAULT FALSE, extnValue OCTET STRING }
+// cerca l'estensione in [nFrom, nTo) (contenuto di Extensions): ritorna l'inizio del contenuto di extnValue, 0 se assente
+static size_t findExtension(const BYTE* pbtData, size_t nFrom, size_t nTo, const BYTE* pbtOid, size_t nOidLen, size_t* pnLen)
+{
+	BYTE btTag;
+	size_t nLen;
+	while(nFrom < nTo)
+	{
+		size_t nExt = readTLV(pbtData, nTo, nFrom, &btTag, &nLen);
+		size_t nExtEnd = nExt + nLen;
+		nFrom = nExtEnd;
+
+		size_t nOid = readTLV(pbtData, nExtEnd, nExt, &btTag, &nLen);
+		if(btTag != 0x06 || nLen != nOidLen || memcmp(pbtData + nOid, pbtOid, nLen) != 0)
+			continue;
+
+		size_t nValue = readTLV(pbtData, nExtEnd, nOid + nLen, &btTag, &nLen);
+		if(btTag == 0x01)
+			nValue = readTLV(pbtData, nExtEnd, nValue + nLen, &btTag, &nLen);
+
+		if(btTag != 0x04)
+			throw CASN1ParsingException();
+
+		*pnLen = nLen;
+		return nValue;
+	}
+
+	return 0;
+}
+
+static const BYTE CRL_REASON_OID[] = { 0x55, 0x1D, 0x15 };            // 2.5.29.21
+static const BYTE CRL_NUMBER_OID[] = { 0x55, 0x1D, 0x14 };            // 2.5.29.20
+static const BYTE DELTA_CRL_INDICATOR_OID[] = { 0x55, 0x1D, 0x1B };   // 2.5.29.27
+static const BYTE FRESHEST_CRL_OID[] = { 0x55, 0x1D, 0x2E };          // 2.5.29.46
+static const BYTE REMOVE_FROM_CRL = 8;
+static const BYTE NO_REASON = 0xFF;
+
 CCrl::CCrl(UUCBufferedReader& reader)
 : CASN1Sequence(reader)
 {
+	buildIndex();
 }
 
 CCrl::CCrl(const CASN1Object& contentInfo)
 : CASN1Sequence(contentInfo)
 {
+	buildIndex();
+}
+
+void CCrl::buildIndex()
+{
+	const BYTE* pbtData = getValue()->getContent();
+	size_t nLength = getValue()->getLength();
+
+	m_nNextUpdate = 0;
+
+	// TBSCertList ::= SEQUENCE { version OPTIONAL, signature, issuer, thisUpdate,
+	//                            nextUpdate OPTIONAL, revokedCertificates OPTIONAL, crlExtensions [0] OPTIONAL }
+	BYTE btTag;
+	size_t nLen;
+	size_t nPos = readTLV(pbtData, nLength, 0, &btTag, &nLen);
+	size_t nEnd = nPos + nLen;
+
+	size_t nContent = readTLV(pbtData, nEnd, nPos, &btTag, &nLen);
+	if(btTag == 0x02)
+		nContent = readTLV(pbtData, nEnd, nContent + nLen, &btTag, &nLen);
+
+	nContent = readTLV(pbtData, nEnd, nContent + nLen, &btTag, &nLen);      // issuer
+	m_szIssuer.assign((const char*)pbtData + nContent, nLen);
+	nContent = readTLV(pbtData, nEnd, nContent + nLen, &btTag, &nLen);      // thisUpdate
+	m_szThisUpdate.assign((const char*)pbtData + nContent, nLen);
+	nPos = nContent + nLen;
+
+	if(nPos < nEnd)
+	{
+		nContent = readTLV(pbtData, nEnd, nPos, &btTag, &nLen);
+		if(btTag == 0x17 || btTag == 0x18)
+		{
+			m_nNextUpdate = timeFromASN1(btTag, pbtData + nContent, nLen);
+			nPos = nContent + nLen;
+			if(nPos < nEnd)
+				nContent = readTLV(pbtData, nEnd, nPos, &btTag, &nLen);
+		}
+	}
+
+	m_revoked.clear();
+	if(nPos < nEnd && btTag == 0x30)
+	{
+		indexRevoked(pbtData, nContent, nContent + nLen);
+		nPos = nContent + nLen;
+		if(nPos < nEnd)
+			nContent = readTLV(pbtData, nEnd, nPos, &btTag, &nLen);
+	}
+
+	if(nPos < nEnd && btTag == 0xA0)
+	{
+		size_t nExtList = readTLV(pbtData, nContent + nLen, nContent, &btTag, &nLen);
+		parseExtensions(pbtData, nExtList, nExtList + nLen);
+	}
+}
+
+// revokedCertificates: un solo passaggio sul DER, senza copie degli elementi
+void CCrl::indexRevoked(const BYTE* pbtData, size_t nListStart, size_t nListEnd)
+{
+	BYTE btTag;
+	size_t nLen;
+	for(size_t nPos = nListStart; nPos < nListEnd; )
+	{
+		size_t nEntryLen;
+		size_t nEntry = readTLV(pbtData, nListEnd, nPos, &btTag, &nEntryLen);
+		size_t nEntryEnd = nEntry + nEntryLen;
+		nPos = nEntryEnd;
+
+		RevokedEntry entry;
+		size_t nSerialLen;
+		size_t nSerial = readTLV(pbtData, nEntryEnd, nEntry, &btTag, &nSerialLen);
+		if(btTag != 0x02 || nSerialLen > 0xFFFF)
+			throw CASN1ParsingException();
+
+		entry.nSerialOffset = (uint32_t)nSerial;
+		entry.nSerialLen = (uint16_t)nSerialLen;
+
+		size_t nDateLen;
+		size_t nDate = readTLV(pbtData, nEntryEnd, nSerial + nSerialLen, &btTag, &nDateLen);
+
+		// della data di revoca si usano le ultime 13 cifre (YYMMDDHHMMSSZ)
+		entry.nDateOffset = (uint32_t)(nDateLen > 13 ? nDate + nDateLen - 13 : nDate);
+		entry.btDateLen = (BYTE)(nDateLen > 13 ? 13 : nDateLen);
+		entry.btReason = NO_REASON;
+
+		// crlEntryExtensions: cerca CRLReason ::= ENUMERATED
+		size_t nExtensions = nDate + nDateLen;
+		if(nExtensions < nEntryEnd)
+		{
+			size_t nExtListLen;
+			size_t nExtList = readTLV(pbtData, nEntryEnd, nExtensions, &btTag, &nExtListLen);
+			size_t nValue = findExtension(pbtData, nExtList, nExtList + nExtListLen, CRL_REASON_OID, sizeof(CRL_REASON_OID), &nLen);
+			if(nValue)
+			{
+				size_t nReason = readTLV(pbtData, nValue + nLen, nValue, &btTag, &nLen);
+				if(btTag == 0x0A && nLen > 0)
+					entry.btReason = pbtData[nReason + nLen - 1];
+			}
+		}
+
+		m_revoked.push_back(entry);
+	}
+
+	std::sort(m_revoked.begin(), m_revoked.end(), [pbtData](const RevokedEntry& a, const RevokedEntry& b) {
+		if(a.nSerialLen != b.nSerialLen)
+			return a.nSerialLen < b.nSerialLen;
+		return memcmp(pbtData + a.nSerialOffset, pbtData + b.nSerialOffset, a.nSerialLen) < 0;
+	});
+
+	LOG_DBG((0, "CCrl::indexRevoked", "revoked certificates: %d", (int)m_revoked.size()));
+}
+
+
+void CCrl::parseExtensions(const BYTE* pbtData, size_t nFrom, size_t nTo)
+{
+	BYTE btTag;
+	size_t nLen;
+
+	size_t nValue = findExtension(pbtData, nFrom, nTo, CRL_NUMBER_OID, sizeof(CRL_NUMBER_OID), &nLen);
+	if(nValue)
+	{
+		size_t nNumber = readTLV(pbtData, nValue + nLen, nValue, &btTag, &nLen);
+		m_szCrlNumber.assign((const char*)pbtData + nNumber, nLen);
+	}
+
+	nValue = findExtension(pbtData, nFrom, nTo, DELTA_CRL_INDICATOR_OID, sizeof(DELTA_CRL_INDICATOR_OID), &nLen);
+	if(nValue)
+	{
+		size_t nNumber = readTLV(pbtData, nValue + nLen, nValue, &btTag, &nLen);
+		m_szBaseCrlNumber.assign((const char*)pbtData + nNumber, nLen);
+	}
+
+	// FreshestCRL ha la sintassi di CRLDistributionPoints: si raccolgono gli URI dei fullName
+	nValue = findExtension(pbtData, nFrom, nTo, FRESHEST_CRL_OID, sizeof(FRESHEST_CRL_OID), &nLen);
+	if(nValue)
+	{
+		size_t nPoints = readTLV(pbtData, nValue + nLen, nValue, &btTag, &nLen);
+		size_t nPointsEnd = nPoints + nLen;
+		while(nPoints < nPointsEnd)
+		{
+			size_t nPoint = readTLV(pbtData, nPointsEnd, nPoints, &btTag, &nLen);
+			size_t nPointEnd = nPoint + nLen;
+			nPoints = nPointEnd;
+			if(nPoint >= nPointEnd)
+				continue;
+
+			size_t nName = readTLV(pbtData, nPointEnd, nPoint, &btTag, &nLen);
+			if(btTag != 0xA0 || nLen == 0)
+				continue;
+
+			size_t nFullName = readTLV(pbtData, nName + nLen, nName, &btTag, &nLen);
+			if(btTag != 0xA0)
+				continue;
+
+			size_t nFullNameEnd = nFullName + nLen;
+			while(nFullName < nFullNameEnd)
+			{
+				size_t nGeneralName = readTLV(pbtData, nFullNameEnd, nFullName, &btTag, &nLen);
+				if(btTag == 0x86)
+					m_freshestCrlUrls.push_back(std::string((const char*)pbtData + nGeneralName, nLen));
+				nFullName = nGeneralName + nLen;
+			}
+		}
+	}
+}
+
+const CCrl::RevokedEntry* CCrl::find(const BYTE* pbtSerial, size_t nSerialLen) const
+{
+	const BYTE* pbtData = getValue()->getContent();
+
+	std::vector<RevokedEntry>::const_iterator it = std::lower_bound(m_revoked.begin(), m_revoked.end(), nSerialLen,
+		[pbtData, pbtSerial](const RevokedEntry& entry, size_t nLen) {
+			if(entry.nSerialLen != nLen)
+				return entry.nSerialLen < nLen;
+			return memcmp(pbtData + entry.nSerialOffset, pbtSerial, nLen) < 0;
+		});
+
+	if(it == m_revoked.end() || it->nSerialLen != nSerialLen || memcmp(pbtData + it->nSerialOffset, pbtSerial, nSerialLen) != 0)
+		return NULL;
+
+	return &*it;
 }
 
 bool CCrl::isRevoked(const CASN1Integer& serialNumber, const char* szDateTime, int* pReason, REVOCATION_INFO* pRevocationInfo) 
 {
     LOG_MSG((0, "CCrl::isRevoked", "enter"));
     
-	CASN1Sequence tbsCertList(elementAt(0));
-	
 	if(pRevocationInfo)
 	{
-		CASN1UTCTime thisUpdate = tbsCertList.elementAt(3);
-		thisUpdate.getUTCTime(pRevocationInfo->szThisUpdate);
+		size_t nLen = std::min(m_szThisUpdate.length(), sizeof(pRevocationInfo->szThisUpdate) - 1);
+		memcpy(pRevocationInfo->szThisUpdate, m_szThisUpdate.c_str(), nLen);
+		pRevocationInfo->szThisUpdate[nLen] = 0;
 	}
 
-	CASN1Sequence revokedCertificates(tbsCertList.elementAt(5));
-	int count = revokedCertificates.size();
-	if(count > 0)
+	const UUCByteArray* pSerial = serialNumber.getValue();
+	const RevokedEntry* pEntry = find(pSerial->getContent(), pSerial->getLength());
+
+	// in una delta CRL removeFromCRL annulla la sospensione riportata dalla CRL di base
+	if(pEntry && pEntry->btReason == REMOVE_FROM_CRL)
+		pEntry = NULL;
+
+	if(pEntry)
 	{
-		for(int i = 0; i < count; i++)
+		const BYTE* btRevocationDate = getValue()->getContent() + pEntry->nDateOffset;
+		
+		if(pRevocationInfo)
 		{
-			CASN1Sequence revokedCertificate = revokedCertificates.elementAt(i);
-
-			CASN1Integer sn(revokedCertificate.elementAt(0));
+			pRevocationInfo->nType = TYPE_CRL;
+			memcpy(pRevocationInfo->szRevocationDate, btRevocationDate, pEntry->btDateLen);
+			pRevocationInfo->szRevocationDate[pEntry->btDateLen] = 0;
+		}
 
-			if(serialNumber == sn)
+		if(szDateTime != NULL)
+		{
+			
+			if(memcmp(szDateTime, btRevocationDate, pEntry->btDateLen) < 0)
 			{
-				CASN1Object revocationDate(revokedCertificate.elementAt(1));
-				
-				BYTE* btRevocationDate;
-				
-				if(revocationDate.getValue()->getLength() > 13)
-				{
-					btRevocationDate = (BYTE*)revocationDate.getValue()->getContent() + revocationDate.getValue()->getLength() - 13;
-				}
-				else 
-				{
-					btRevocationDate = (BYTE*)revocationDate.getValue()->getContent();
-				}
-				
-				if(pRevocationInfo)
-				{
-					pRevocationInfo->nType = TYPE_CRL;
-					memcpy(pRevocationInfo->szRevocationDate, btRevocationDate, 13);
-					pRevocationInfo->szRevocationDate[13] = 0;
-				}
-
-				if(szDateTime != NULL)
-				{
-					
-					if(memcmp(szDateTime, btRevocationDate, 13) < 0)
-					{
-						if(pRevocationInfo)
-							pRevocationInfo->nRevocationStatus = REVOCATION_STATUS_GOOD;
-						*pReason = REVOCATION_STATUS_GOOD;                        
-                        return false;
-					}
-				}
-				
-				if(revokedCertificate.size() > 2)
-				{
-					CASN1Sequence extension(revokedCertificate.elementAt(2));
-					
-					CASN1Sequence crlReason(extension.elementAt(0));
-					
-					CASN1OctetString reasonCode(crlReason.elementAt(1));
-					const UUCByteArray *pVal = reasonCode.getValue();
-					
-					BYTE reason = pVal->getContent()[2];//reasonCode.getTag() & 0x0F;
-					if(reason == 6) //Certificate HOLD
-						*pReason = REVOCATION_STATUS_SUSPENDED;
-					else 
-						*pReason = REVOCATION_STATUS_REVOKED;
-				}
-				else 
-				{
-					// reason non presente
-					*pReason = REVOCATION_STATUS_REVOKED;
-				}
-
 				if(pRevocationInfo)
-					pRevocationInfo->nRevocationStatus = *pReason;
-	
-                LOG_MSG((0, "CCrl::isRevoked", "YES: %d", *pReason));
-                
-				return true;
+					pRevocationInfo->nRevocationStatus = REVOCATION_STATUS_GOOD;
+				*pReason = REVOCATION_STATUS_GOOD;                        
+                return false;
 			}
 		}
+		
+		if(pEntry->btReason == 6) //Certificate HOLD
+			*pReason = REVOCATION_STATUS_SUSPENDED;
+		else 
+			*pReason = REVOCATION_STATUS_REVOKED;
+
+		if(pRevocationInfo)
+			pRevocationInfo->nRevocationStatus = *pReason;
+
+        LOG_MSG((0, "CCrl::isRevoked", "YES: %d", *pReason));
+        
+		return true;
 	}
 	
     *pReason = REVOCATION_STATUS_GOOD;
@@ -120,3 +372,23 @@ bool CCrl::isRevoked(const CASN1Integer& serialNumber, const char* szDateTime, i
     
 	return false;
 }
+
+time_t CCrl::getNextUpdate()
+{
+	return m_nNextUpdate;
+}
+
+bool CCrl::contains(const CASN1Integer& serialNumber) const
+{
+	const UUCByteArray* pSerial = serialNumber.getValue();
+	return find(pSerial->getContent(), pSerial->getLength()) != NULL;
+}
+
+// CRLNumber e BaseCRLNumber come contenuto di INTEGER DER (positivi, senza zeri iniziali superflui)
+int CCrl::compareNumbers(const std::string& szNumber1, const std::string& szNumber2)
+{
+	if(szNumber1.length() != szNumber2.length())
+		return szNumber1.length() < szNumber2.length() ? -1 : 1;
+
+	return memcmp(szNumber1.data(), szNumber2.data(), szNumber1.length());
+}
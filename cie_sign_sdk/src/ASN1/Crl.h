@@ -14,6 +14,10 @@
 #include "ASN1Sequence.h"
 #include "ASN1Integer.h"
 #include "disigonsdk.h"
+#include <time.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
 
 
 class CCrl : public CASN1Sequence
@@ -25,9 +29,53 @@ public:
 	
 	CCrl(const CASN1Object& contentInfo);
 	
+	// O(log n) sull'indice dei seriali revocati costruito una sola volta dal costruttore;
+	// non modifica l'oggetto: piu' thread possono interrogare la stessa CRL
 	bool isRevoked(const CASN1Integer& serialNumber, const char* szDateTime, int* pReason, REVOCATION_INFO* pRevocationInfo);
 	
-	
+	// nextUpdate in UTC; 0 se il campo (opzionale) non e' presente
+	time_t getNextUpdate();
+
+	int getRevokedCount() const { return (int)m_revoked.size(); }
+
+	// true se il seriale compare nella CRL (anche come removeFromCRL in una delta)
+	bool contains(const CASN1Integer& serialNumber) const;
+
+	// RFC 5280 5.2.3, 5.2.4, 5.2.6
+	const std::string& getCrlNumber() const { return m_szCrlNumber; }
+	const std::string& getBaseCrlNumber() const { return m_szBaseCrlNumber; }
+	bool isDelta() const { return !m_szBaseCrlNumber.empty(); }
+	const std::vector<std::string>& getFreshestCrlUrls() const { return m_freshestCrlUrls; }
+
+	const std::string& getIssuer() const { return m_szIssuer; }
+	const std::string& getThisUpdate() const { return m_szThisUpdate; }
+
+	// <0, 0, >0 come memcmp
+	static int compareNumbers(const std::string& szNumber1, const std::string& szNumber2);
+
+private:
+	// posizioni relative al contenuto della CRL (getValue())
+	struct RevokedEntry
+	{
+		uint32_t nSerialOffset;
+		uint32_t nDateOffset;
+		uint16_t nSerialLen;
+		BYTE     btDateLen;
+		BYTE     btReason;      // CRLReason, 0xFF se assente
+	};
+
+	void buildIndex();
+	void indexRevoked(const BYTE* pbtData, size_t nListStart, size_t nListEnd);
+	void parseExtensions(const BYTE* pbtData, size_t nFrom, size_t nTo);
+	const RevokedEntry* find(const BYTE* pbtSerial, size_t nSerialLen) const;
+
+	std::vector<RevokedEntry> m_revoked;     // ordinati per seriale
+	std::string m_szThisUpdate;
+	time_t m_nNextUpdate;
+	std::string m_szIssuer;                  // contenuto del Name
+	std::string m_szCrlNumber;
+	std::string m_szBaseCrlNumber;           // solo nelle delta CRL
+	std::vector<std::string> m_freshestCrlUrls;
 };
 
 #endif //_CRL_H
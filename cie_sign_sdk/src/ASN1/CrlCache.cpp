@@ -0,0 +1,368 @@
+/*
+ *  CrlCache.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "CrlCache.h"
+#include "ASN1Exception.h"
+#include "UUCArena.h"
+#include "UUCBufferedReader.h"
+#include "UUCLogger.h"
+
+#include <openssl/sha.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+USE_LOG;
+
+long HTTPConditionalGet(const char* szUrl, const char* szETag, const char* szLastModified, UUCByteArray& response, std::string& etag, std::string& lastModified, bool* pbNotModified);
+
+struct CCrlCache::Entry
+{
+	std::mutex mutex;               // serializza download e consultazione della CRL
+	std::string szUrl;
+	std::unique_ptr<CCrl> pCrl;
+	std::string szETag;
+	std::string szLastModified;
+	time_t nNextUpdate;             // 0: non indicato nella CRL
+	time_t nLastCheck;              // ultima risposta del distribution point
+	bool bDiskChecked;
+
+	Entry() : nNextUpdate(0), nLastCheck(0), bDiskChecked(false) {}
+};
+
+std::mutex CCrlCache::m_mutex;
+std::map<std::string, std::shared_ptr<CCrlCache::Entry> > CCrlCache::m_entries;
+std::string CCrlCache::m_szCacheDir;
+std::atomic<long> CCrlCache::m_nHits(0);
+std::atomic<long> CCrlCache::m_nMisses(0);
+
+void CCrlCache::SetCacheDir(const char* szDir)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_szCacheDir = szDir ? szDir : "";
+}
+
+void CCrlCache::CleanUp()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+}
+
+std::shared_ptr<CCrlCache::Entry> CCrlCache::getEntry(const char* szUrl)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::shared_ptr<Entry>& pEntry = m_entries[szUrl];
+	if(!pEntry)
+	{
+		pEntry = std::make_shared<Entry>();
+		pEntry->szUrl = szUrl;
+	}
+
+	return pEntry;
+}
+
+bool CCrlCache::isStale(const Entry& entry, time_t now)
+{
+	if(entry.nNextUpdate != 0)
+	{
+		if(now < entry.nNextUpdate)
+			return false;
+
+		// prima verifica dopo nextUpdate; poi, se l'emittente non ha ancora pubblicato, una ogni intervallo
+		if(entry.nLastCheck < entry.nNextUpdate)
+			return true;
+	}
+
+	return now - entry.nLastCheck >= CRL_RECHECK_INTERVAL;
+}
+
+void CCrlCache::GetStats(long* pnHits, long* pnMisses)
+{
+	*pnHits = m_nHits;
+	*pnMisses = m_nMisses;
+}
+
+bool CCrlCache::ensureCurrent(Entry& entry)
+{
+	if(!entry.pCrl && !entry.bDiskChecked)
+	{
+		entry.bDiskChecked = true;
+		loadFromDisk(entry);
+	}
+
+	time_t now = time(NULL);
+	if(!entry.pCrl || isStale(entry, now))
+	{
+		m_nMisses++;
+		if(!refresh(entry, now))
+		{
+			// una CRL scaduta che non si riesce a rivalidare non e' attendibile
+			if(!entry.pCrl || (entry.nNextUpdate != 0 && now >= entry.nNextUpdate))
+				return false;
+
+			LOG_MSG((0, "CCrlCache::ensureCurrent", "using cached CRL: %s", entry.szUrl.c_str()));
+		}
+	}
+	else
+	{
+		m_nHits++;
+	}
+
+	return true;
+}
+
+// RFC 5280 5.2.4: la delta si applica a una CRL completa dello stesso emittente
+// con CRLNumber >= BaseCRLNumber, e solo se e' piu' recente della CRL completa
+bool CCrlCache::deltaApplies(const CCrl& base, const CCrl& delta)
+{
+	if(base.isDelta() || !delta.isDelta() || base.getCrlNumber().empty() || delta.getCrlNumber().empty())
+		return false;
+
+	if(base.getIssuer() != delta.getIssuer())
+		return false;
+
+	return CCrl::compareNumbers(base.getCrlNumber(), delta.getBaseCrlNumber()) >= 0 &&
+		   CCrl::compareNumbers(delta.getCrlNumber(), base.getCrlNumber()) > 0;
+}
+
+int CCrlCache::CheckRevocation(const char* szUrl, const char* szDeltaUrl, const CASN1Integer& serialNumber, const char* szDateTime, REVOCATION_INFO* pRevocationInfo)
+{
+	// le CRL restano in cache oltre l'arena della verifica
+	UUCHeapScope heap;
+
+	std::shared_ptr<Entry> pBase = getEntry(szUrl);
+	std::lock_guard<std::mutex> baseLock(pBase->mutex);
+
+	if(!ensureCurrent(*pBase))
+		return REVOCATION_STATUS_NOTLOADED;
+
+	CCrl* pCrl = pBase->pCrl.get();
+
+	// delta indicata dal certificato o, in mancanza, dalla CRL completa
+	std::string szDelta = szDeltaUrl ? szDeltaUrl : "";
+	for(size_t i = 0; szDelta.empty() && i < pCrl->getFreshestCrlUrls().size(); i++)
+	{
+		if(pCrl->getFreshestCrlUrls()[i].compare(0, 4, "http") == 0)
+			szDelta = pCrl->getFreshestCrlUrls()[i];
+	}
+
+	std::shared_ptr<Entry> pDelta;
+	std::unique_lock<std::mutex> deltaLock;
+	if(!szDelta.empty() && szDelta != szUrl)
+	{
+		pDelta = getEntry(szDelta.c_str());
+		deltaLock = std::unique_lock<std::mutex>(pDelta->mutex);
+
+		// senza una delta utilizzabile vale la sola CRL completa, che e' ancora valida
+		if(!ensureCurrent(*pDelta) || !deltaApplies(*pCrl, *pDelta->pCrl))
+		{
+			LOG_MSG((0, "CCrlCache::CheckRevocation", "delta CRL not used: %s", szDelta.c_str()));
+			deltaLock.unlock();
+			pDelta.reset();
+		}
+	}
+
+	// le voci della delta prevalgono su quelle della CRL completa
+	CCrl* pDeltaCrl = pDelta ? pDelta->pCrl.get() : NULL;
+	if(pDeltaCrl && pDeltaCrl->contains(serialNumber))
+		pCrl = pDeltaCrl;
+
+	int nReason = REVOCATION_STATUS_GOOD;
+	pCrl->isRevoked(serialNumber, szDateTime, &nReason, pRevocationInfo);
+
+	if(pDeltaCrl && pRevocationInfo)
+	{
+		size_t nLen = std::min(pDeltaCrl->getThisUpdate().length(), sizeof(pRevocationInfo->szThisUpdate) - 1);
+		memcpy(pRevocationInfo->szThisUpdate, pDeltaCrl->getThisUpdate().c_str(), nLen);
+		pRevocationInfo->szThisUpdate[nLen] = 0;
+	}
+
+	return nReason;
+}
+
+bool CCrlCache::refresh(Entry& entry, time_t now)
+{
+	UUCByteArray response;
+	std::string szETag;
+	std::string szLastModified;
+	bool bNotModified = false;
+
+	// i validatori si inviano solo se c'e' una copia da rivalidare
+	long nRet = HTTPConditionalGet(entry.szUrl.c_str(),
+								   entry.pCrl ? entry.szETag.c_str() : NULL,
+								   entry.pCrl ? entry.szLastModified.c_str() : NULL,
+								   response, szETag, szLastModified, &bNotModified);
+	if(nRet)
+	{
+		LOG_ERR((0, "CCrlCache::refresh", "CRL not available. Error: %x", nRet));
+		return false;
+	}
+
+	if(bNotModified && entry.pCrl)
+	{
+		LOG_DBG((0, "CCrlCache::refresh", "CRL not modified: %s", entry.szUrl.c_str()));
+		entry.nLastCheck = now;
+		return true;
+	}
+
+	if(!load(entry, response))
+		return false;
+
+	entry.szETag = szETag;
+	entry.szLastModified = szLastModified;
+	entry.nLastCheck = now;
+
+	LOG_DBG((0, "CCrlCache::refresh", "CRL downloaded: %s, %d bytes", entry.szUrl.c_str(), response.getLength()));
+
+	saveToDisk(entry, response);
+
+	return true;
+}
+
+bool CCrlCache::load(Entry& entry, const UUCByteArray& crl)
+{
+	try
+	{
+		UUCBufferedReader reader(crl.getContent(), crl.getLength());
+		std::unique_ptr<CCrl> pCrl(new CCrl(reader));
+		time_t nNextUpdate = pCrl->getNextUpdate();
+
+		entry.pCrl = std::move(pCrl);
+		entry.nNextUpdate = nNextUpdate;
+		return true;
+	}
+	catch(CASN1Exception* ex)
+	{
+		LOG_ERR((0, "CCrlCache::load", "invalid CRL: %s", entry.szUrl.c_str()));
+		delete ex;
+	}
+	catch(...)
+	{
+		LOG_ERR((0, "CCrlCache::load", "invalid CRL: %s", entry.szUrl.c_str()));
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Disk tier
+//////////////////////////////////////////////////////////////////////
+
+// <dir>/<sha256(url)>.crl contiene la CRL in DER, .meta url, ETag e Last-Modified (una riga ciascuno)
+std::string CCrlCache::diskPath(const std::string& szUrl, const char* szExtension)
+{
+	std::string szDir;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		szDir = m_szCacheDir;
+	}
+
+	if(szDir.empty())
+		return "";
+
+	BYTE pbtHash[SHA256_DIGEST_LENGTH];
+	SHA256((const BYTE*)szUrl.c_str(), szUrl.length(), pbtHash);
+
+	char szName[SHA256_DIGEST_LENGTH * 2 + 1];
+	for(int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+		sprintf(szName + i * 2, "%02x", pbtHash[i]);
+
+	return szDir + "/" + szName + szExtension;
+}
+
+static bool readLine(FILE* f, std::string& szLine)
+{
+	char szBuffer[1024];
+	if(!fgets(szBuffer, sizeof(szBuffer), f))
+		return false;
+
+	szLine = szBuffer;
+	while(!szLine.empty() && (szLine[szLine.length() - 1] == '\n' || szLine[szLine.length() - 1] == '\r'))
+		szLine.erase(szLine.length() - 1);
+
+	return true;
+}
+
+bool CCrlCache::loadFromDisk(Entry& entry)
+{
+	std::string szCrlPath = diskPath(entry.szUrl, ".crl");
+	if(szCrlPath.empty())
+		return false;
+
+	FILE* pMeta = fopen(diskPath(entry.szUrl, ".meta").c_str(), "r");
+	if(!pMeta)
+		return false;
+
+	std::string szUrl, szETag, szLastModified;
+	bool bMeta = readLine(pMeta, szUrl) && readLine(pMeta, szETag) && readLine(pMeta, szLastModified);
+	fclose(pMeta);
+
+	if(!bMeta || szUrl != entry.szUrl)
+		return false;
+
+	FILE* pFile = fopen(szCrlPath.c_str(), "rb");
+	if(!pFile)
+		return false;
+
+	UUCByteArray crl;
+	BYTE buffer[65536];
+	size_t nRead;
+	while((nRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+		crl.append(buffer, nRead);
+	fclose(pFile);
+
+	if(!load(entry, crl))
+		return false;
+
+	// nLastCheck resta 0: oltre nextUpdate la copia viene rivalidata subito
+	entry.szETag = szETag;
+	entry.szLastModified = szLastModified;
+
+	LOG_DBG((0, "CCrlCache::loadFromDisk", "CRL loaded: %s", entry.szUrl.c_str()));
+
+	return true;
+}
+
+void CCrlCache::saveToDisk(const Entry& entry, const UUCByteArray& crl)
+{
+	std::string szCrlPath = diskPath(entry.szUrl, ".crl");
+	if(szCrlPath.empty())
+		return;
+
+	std::string szMetaPath = diskPath(entry.szUrl, ".meta");
+
+	// file temporanei + rename: un altro processo non vede mai una copia a meta'
+	std::string szCrlTemp = szCrlPath + ".tmp";
+	std::string szMetaTemp = szMetaPath + ".tmp";
+
+	FILE* pFile = fopen(szCrlTemp.c_str(), "wb");
+	FILE* pMeta = fopen(szMetaTemp.c_str(), "w");
+
+	bool bOk = pFile && pMeta;
+	if(bOk)
+	{
+		bOk = fwrite(crl.getContent(), 1, crl.getLength(), pFile) == (size_t)crl.getLength();
+		bOk = fprintf(pMeta, "%s\n%s\n%s\n", entry.szUrl.c_str(), entry.szETag.c_str(), entry.szLastModified.c_str()) > 0 && bOk;
+	}
+
+	if(pFile && fclose(pFile) != 0)
+		bOk = false;
+	if(pMeta && fclose(pMeta) != 0)
+		bOk = false;
+
+	// la CRL prima dei metadati: .meta punta sempre a una CRL completa
+	if(bOk)
+		bOk = rename(szCrlTemp.c_str(), szCrlPath.c_str()) == 0 && rename(szMetaTemp.c_str(), szMetaPath.c_str()) == 0;
+
+	if(!bOk)
+	{
+		LOG_ERR((0, "CCrlCache::saveToDisk", "unable to write: %s", szCrlPath.c_str()));
+		remove(szCrlTemp.c_str());
+		remove(szMetaTemp.c_str());
+	}
+}
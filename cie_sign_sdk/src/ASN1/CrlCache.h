@@ -0,0 +1,80 @@
+/*
+ *  CrlCache.h
+ *
+ *  Cache of the CRLs downloaded from the certificate distribution points.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "Crl.h"
+
+#include <time.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// secondi tra due verifiche di una CRL scaduta o senza nextUpdate
+#define CRL_RECHECK_INTERVAL	300
+
+/*
+ * CRLs keyed by distribution point URL, kept in two tiers:
+ *  - memory: each CRL is parsed once and queried in place by every
+ *    verification that references the same URL;
+ *  - disk (optional, see SetCacheDir): the DER plus its HTTP validators, so
+ *    that a new process does not download the CRL again.
+ *
+ * A CRL is used as it is until its nextUpdate. After that (or, for CRLs
+ * without nextUpdate, every CRL_RECHECK_INTERVAL seconds) it is revalidated
+ * with a conditional GET (If-None-Match / If-Modified-Since): a 304 costs one
+ * round trip and no parsing. A CRL past its nextUpdate that cannot be
+ * revalidated is not used.
+ *
+ * Delta CRLs (RFC 5280 5.2.4, located through the FreshestCRL extension of
+ * the certificate or of the complete CRL) are cached the same way and
+ * layered over the complete CRL they apply to: while the complete CRL is
+ * current only the delta, which has a short nextUpdate, is fetched again.
+ *
+ * Lookups on different URLs run in parallel; concurrent lookups on the same
+ * URL wait for a single download.
+ */
+class CCrlCache
+{
+public:
+	// directory delle copie su disco; NULL o "" = solo memoria
+	static void SetCacheDir(const char* szDir);
+
+	// REVOCATION_STATUS_GOOD, _REVOKED o _SUSPENDED secondo la CRL pubblicata in szUrl,
+	// REVOCATION_STATUS_NOTLOADED se la CRL non e' disponibile.
+	// szDeltaUrl (FreshestCRL del certificato) puo' essere NULL: si usa quello della CRL completa
+	static int CheckRevocation(const char* szUrl, const char* szDeltaUrl, const CASN1Integer& serialNumber, const char* szDateTime, REVOCATION_INFO* pRevocationInfo);
+
+	// consultazioni servite senza rete (memoria o disco) e consultazioni che hanno
+	// richiesto un download o una rivalidazione, dall'avvio del processo
+	static void GetStats(long* pnHits, long* pnMisses);
+
+	// svuota il livello in memoria (i file su disco restano)
+	static void CleanUp();
+
+private:
+	struct Entry;
+
+	static std::shared_ptr<Entry> getEntry(const char* szUrl);
+	static bool isStale(const Entry& entry, time_t now);
+	static bool ensureCurrent(Entry& entry);
+	static bool deltaApplies(const CCrl& base, const CCrl& delta);
+	static bool refresh(Entry& entry, time_t now);
+	static bool load(Entry& entry, const UUCByteArray& crl);
+	static bool loadFromDisk(Entry& entry);
+	static void saveToDisk(const Entry& entry, const UUCByteArray& crl);
+	static std::string diskPath(const std::string& szUrl, const char* szExtension);
+
+	static std::mutex m_mutex;
+	static std::map<std::string, std::shared_ptr<Entry> > m_entries;
+	static std::string m_szCacheDir;
+	static std::atomic<long> m_nHits;
+	static std::atomic<long> m_nMisses;
+};
@@ -0,0 +1,356 @@
+/*
+ *  OCSPCache.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "OCSPCache.h"
+#include "ASN1Exception.h"
+#include "ASN1Integer.h"
+#include "ASN1Octetstring.h"
+#include "ASN1Sequence.h"
+#include "UUCArena.h"
+#include "UUCBufferedReader.h"
+#include "UUCLogger.h"
+
+#include <openssl/sha.h>
+
+#include <stdio.h>
+#include <string.h>
+
+USE_LOG;
+
+long HTTPRequest(UUCByteArray& data, const char* szUrl, const char* szContentType, UUCByteArray& response);
+time_t timeFromASN1(BYTE btTag, const BYTE* pbtValue, size_t nLen);
+
+struct COCSPCache::Entry
+{
+	std::mutex mutex;               // serializza richiesta al responder e consultazione
+	std::string szKey;
+	UUCByteArray response;
+	time_t nThisUpdate;
+	time_t nNextUpdate;             // 0: non indicato nella risposta
+	bool bDiskChecked;
+
+	Entry() : nThisUpdate(0), nNextUpdate(0), bDiskChecked(false) {}
+};
+
+std::mutex COCSPCache::m_mutex;
+std::map<std::string, std::shared_ptr<COCSPCache::Entry> > COCSPCache::m_entries;
+std::string COCSPCache::m_szCacheDir;
+long COCSPCache::m_nMaxAge = OCSP_DEFAULT_MAX_AGE;
+std::atomic<long> COCSPCache::m_nHits(0);
+std::atomic<long> COCSPCache::m_nMisses(0);
+
+static std::string toHex(const BYTE* pbtData, size_t nLen)
+{
+	static const char szDigits[] = "0123456789abcdef";
+
+	std::string szHex;
+	szHex.reserve(nLen * 2);
+	for(size_t i = 0; i < nLen; i++)
+	{
+		szHex += szDigits[pbtData[i] >> 4];
+		szHex += szDigits[pbtData[i] & 0x0F];
+	}
+
+	return szHex;
+}
+
+// issuerNameHash.issuerKeyHash.serialNumber in esadecimale
+static std::string certIdKey(CASN1Sequence& certId)
+{
+	std::string szKey;
+	for(int i = 1; i <= 3; i++)
+	{
+		CASN1Object field(certId.elementAt(i));
+		const UUCByteArray* pValue = field.getValue();
+		if(i > 1)
+			szKey += '.';
+		szKey += toHex(pValue->getContent(), pValue->getLength());
+	}
+
+	return szKey;
+}
+
+void COCSPCache::SetCacheDir(const char* szDir)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_szCacheDir = szDir ? szDir : "";
+}
+
+void COCSPCache::SetMaxAge(long nSeconds)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_nMaxAge = nSeconds < 0 ? 0 : nSeconds;
+}
+
+void COCSPCache::CleanUp()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries.clear();
+}
+
+std::shared_ptr<COCSPCache::Entry> COCSPCache::getEntry(const std::string& szKey)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::shared_ptr<Entry>& pEntry = m_entries[szKey];
+	if(!pEntry)
+	{
+		pEntry = std::make_shared<Entry>();
+		pEntry->szKey = szKey;
+	}
+
+	return pEntry;
+}
+
+bool COCSPCache::isValid(const Entry& entry, time_t now)
+{
+	if(entry.response.getLength() == 0 || entry.nThisUpdate == 0)
+		return false;
+
+	if(entry.nNextUpdate != 0 && now >= entry.nNextUpdate)
+		return false;
+
+	long nMaxAge;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		nMaxAge = m_nMaxAge;
+	}
+
+	if(nMaxAge > 0)
+		return now < entry.nThisUpdate + nMaxAge;
+
+	return entry.nNextUpdate != 0;
+}
+
+void COCSPCache::GetStats(long* pnHits, long* pnMisses)
+{
+	*pnHits = m_nHits;
+	*pnMisses = m_nMisses;
+}
+
+long COCSPCache::GetResponse(const char* szUrl, UUCByteArray& baRequest, UUCByteArray& response)
+{
+	// le risposte restano in cache oltre l'arena della verifica
+	UUCHeapScope heap;
+
+	std::string szKey;
+	if(!requestKey(baRequest, szKey))
+	{
+		m_nMisses++;
+		return HTTPRequest(baRequest, szUrl, "application/ocsp-request", response);
+	}
+
+	std::shared_ptr<Entry> pEntry = getEntry(szKey);
+	std::lock_guard<std::mutex> lock(pEntry->mutex);
+
+	if(pEntry->response.getLength() == 0 && !pEntry->bDiskChecked)
+	{
+		pEntry->bDiskChecked = true;
+		loadFromDisk(*pEntry);
+	}
+
+	if(isValid(*pEntry, time(NULL)))
+	{
+		LOG_DBG((0, "COCSPCache::GetResponse", "cached OCSP response: %s", szKey.c_str()));
+		m_nHits++;
+		response.append(pEntry->response);
+		return 0;
+	}
+
+	m_nMisses++;
+	UUCByteArray fresh;
+	long nRet = HTTPRequest(baRequest, szUrl, "application/ocsp-request", fresh);
+	if(fresh.getLength() > 0 && load(*pEntry, fresh))
+		saveToDisk(*pEntry);
+
+	response.append(fresh);
+	return nRet;
+}
+
+bool COCSPCache::requestKey(const UUCByteArray& baRequest, std::string& szKey)
+{
+	try
+	{
+		UUCBufferedReader reader(baRequest.getContent(), baRequest.getLength());
+		CASN1Sequence ocspRequest(reader);
+		CASN1Sequence tbsRequest(ocspRequest.elementAt(0));
+
+		// version [0] e requestorName [1] opzionali
+		int n = 0;
+		while((tbsRequest.elementAt(n).getTag() & 0xE0) == 0xA0)
+			n++;
+
+		CASN1Sequence requestList(tbsRequest.elementAt(n));
+		if(requestList.size() != 1)
+			return false;
+
+		CASN1Sequence request(requestList.elementAt(0));
+		CASN1Sequence certId(request.elementAt(0));
+		szKey = certIdKey(certId);
+		return true;
+	}
+	catch(CASN1Exception* ex)
+	{
+		delete ex;
+	}
+	catch(...)
+	{
+	}
+
+	LOG_ERR((0, "COCSPCache::requestKey", "invalid OCSP request"));
+	return false;
+}
+
+// true se la risposta e' cacheable: successful, con stato good o revoked per la CertID szKey
+bool COCSPCache::parseResponse(const UUCByteArray& response, const std::string& szKey, time_t* pnThisUpdate, time_t* pnNextUpdate)
+{
+	try
+	{
+		UUCBufferedReader reader(response.getContent(), response.getLength());
+		CASN1Sequence ocspResponse(reader);
+
+		CASN1Integer responseStatus(ocspResponse.elementAt(0));
+		if(responseStatus.getIntValue() != 0)
+			return false;
+
+		CASN1Sequence responseBytes1(ocspResponse.elementAt(1));
+		CASN1Sequence responseBytes(responseBytes1.elementAt(0));
+		CASN1OctetString basicResponse(responseBytes.elementAt(1));
+
+		UUCBufferedReader reader1(*basicResponse.getValue());
+		CASN1Sequence basicOCSPResponse(reader1);
+		CASN1Sequence responseData(basicOCSPResponse.elementAt(0));
+
+		// version [0] opzionale, poi responderID, producedAt, responses
+		int n = responseData.elementAt(0).getTag() == 0xA0 ? 1 : 0;
+		CASN1Sequence responses(responseData.elementAt(n + 2));
+
+		int size = responses.size();
+		for(int i = 0; i < size; i++)
+		{
+			CASN1Sequence singleResponse(responses.elementAt(i));
+			CASN1Sequence certId(singleResponse.elementAt(0));
+			if(certIdKey(certId) != szKey)
+				continue;
+
+			// unknown non si conserva
+			if((singleResponse.elementAt(1).getTag() & 0x0F) > 1)
+				return false;
+
+			CASN1Object thisUpdate(singleResponse.elementAt(2));
+			*pnThisUpdate = timeFromASN1(thisUpdate.getTag(), thisUpdate.getValue()->getContent(), thisUpdate.getValue()->getLength());
+
+			*pnNextUpdate = 0;
+			if(singleResponse.size() > 3 && singleResponse.elementAt(3).getTag() == 0xA0)
+			{
+				CASN1Sequence nextUpdateField(singleResponse.elementAt(3));
+				CASN1Object nextUpdate(nextUpdateField.elementAt(0));
+				*pnNextUpdate = timeFromASN1(nextUpdate.getTag(), nextUpdate.getValue()->getContent(), nextUpdate.getValue()->getLength());
+			}
+
+			return *pnThisUpdate != 0;
+		}
+	}
+	catch(CASN1Exception* ex)
+	{
+		delete ex;
+	}
+	catch(...)
+	{
+	}
+
+	return false;
+}
+
+bool COCSPCache::load(Entry& entry, const UUCByteArray& response)
+{
+	time_t nThisUpdate, nNextUpdate;
+	if(!parseResponse(response, entry.szKey, &nThisUpdate, &nNextUpdate))
+	{
+		LOG_DBG((0, "COCSPCache::load", "OCSP response not cacheable: %s", entry.szKey.c_str()));
+		return false;
+	}
+
+	entry.response = response;
+	entry.nThisUpdate = nThisUpdate;
+	entry.nNextUpdate = nNextUpdate;
+
+	return isValid(entry, time(NULL));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Disk tier
+//////////////////////////////////////////////////////////////////////
+
+// <dir>/<sha256(CertID)>.ocsp contiene la risposta in DER, che riporta la propria CertID
+std::string COCSPCache::diskPath(const std::string& szKey)
+{
+	std::string szDir;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		szDir = m_szCacheDir;
+	}
+
+	if(szDir.empty())
+		return "";
+
+	BYTE pbtHash[SHA256_DIGEST_LENGTH];
+	SHA256((const BYTE*)szKey.c_str(), szKey.length(), pbtHash);
+
+	return szDir + "/" + toHex(pbtHash, sizeof(pbtHash)) + ".ocsp";
+}
+
+bool COCSPCache::loadFromDisk(Entry& entry)
+{
+	std::string szPath = diskPath(entry.szKey);
+	if(szPath.empty())
+		return false;
+
+	FILE* pFile = fopen(szPath.c_str(), "rb");
+	if(!pFile)
+		return false;
+
+	UUCByteArray response;
+	BYTE buffer[8192];
+	size_t nRead;
+	while((nRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+		response.append(buffer, nRead);
+	fclose(pFile);
+
+	if(!load(entry, response))
+		return false;
+
+	LOG_DBG((0, "COCSPCache::loadFromDisk", "OCSP response loaded: %s", entry.szKey.c_str()));
+
+	return true;
+}
+
+void COCSPCache::saveToDisk(const Entry& entry)
+{
+	std::string szPath = diskPath(entry.szKey);
+	if(szPath.empty())
+		return;
+
+	// file temporaneo + rename: un altro processo non vede mai una copia a meta'
+	std::string szTemp = szPath + ".tmp";
+
+	FILE* pFile = fopen(szTemp.c_str(), "wb");
+	bool bOk = pFile != NULL;
+	if(bOk)
+		bOk = fwrite(entry.response.getContent(), 1, entry.response.getLength(), pFile) == (size_t)entry.response.getLength();
+
+	if(pFile && fclose(pFile) != 0)
+		bOk = false;
+
+	if(bOk)
+		bOk = rename(szTemp.c_str(), szPath.c_str()) == 0;
+
+	if(!bOk)
+	{
+		LOG_ERR((0, "COCSPCache::saveToDisk", "unable to write: %s", szPath.c_str()));
+		remove(szTemp.c_str());
+	}
+}
@@ -0,0 +1,77 @@
+/*
+ *  OCSPCache.h
+ *
+ *  Cache of the responses of the OCSP responders.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "UUCByteArray.h"
+
+#include <time.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// eta' massima predefinita di una risposta, in secondi da thisUpdate
+#define OCSP_DEFAULT_MAX_AGE	86400
+
+/*
+ * OCSP responses keyed by the CertID of the request (issuer name hash,
+ * issuer key hash, serial number), kept in two tiers:
+ *  - memory: a certificate verified again gets the response already
+ *    downloaded, without a round trip to the responder;
+ *  - disk (optional, see SetCacheDir): the DER of the response, so that a new
+ *    process does not ask again.
+ *
+ * A response is used until its nextUpdate and for at most the max age
+ * (SetMaxAge) from its thisUpdate; a response without nextUpdate is kept for
+ * the max age only. Only successful responses with a good or revoked status
+ * for the requested CertID are cached.
+ *
+ * Lookups of different certificates run in parallel; concurrent lookups of
+ * the same certificate wait for a single request to the responder.
+ */
+class COCSPCache
+{
+public:
+	// directory delle copie su disco; NULL o "" = solo memoria
+	static void SetCacheDir(const char* szDir);
+
+	// eta' massima in secondi; 0 = fino a nextUpdate, risposte senza nextUpdate non conservate
+	static void SetMaxAge(long nSeconds);
+
+	// OCSPResponse (DER) per baRequest: dalla cache se ancora valida, altrimenti POST a szUrl.
+	// Ritorna 0 o l'errore HTTP
+	static long GetResponse(const char* szUrl, UUCByteArray& baRequest, UUCByteArray& response);
+
+	// richieste servite dalla cache (memoria o disco) e richieste inviate al responder,
+	// dall'avvio del processo
+	static void GetStats(long* pnHits, long* pnMisses);
+
+	// svuota il livello in memoria (i file su disco restano)
+	static void CleanUp();
+
+private:
+	struct Entry;
+
+	static std::shared_ptr<Entry> getEntry(const std::string& szKey);
+	static bool isValid(const Entry& entry, time_t now);
+	static bool requestKey(const UUCByteArray& baRequest, std::string& szKey);
+	static bool parseResponse(const UUCByteArray& response, const std::string& szKey, time_t* pnThisUpdate, time_t* pnNextUpdate);
+	static bool load(Entry& entry, const UUCByteArray& response);
+	static bool loadFromDisk(Entry& entry);
+	static void saveToDisk(const Entry& entry);
+	static std::string diskPath(const std::string& szKey);
+
+	static std::mutex m_mutex;
+	static std::map<std::string, std::shared_ptr<Entry> > m_entries;
+	static std::string m_szCacheDir;
+	static long m_nMaxAge;
+	static std::atomic<long> m_nHits;
+	static std::atomic<long> m_nMisses;
+};
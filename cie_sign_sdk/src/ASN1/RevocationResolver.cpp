@@ -0,0 +1,77 @@
+/*
+ *  RevocationResolver.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "RevocationResolver.h"
+#include "UUCLogger.h"
+
+#include <atomic>
+#include <thread>
+
+USE_LOG;
+
+static std::atomic<long> g_nTimeout(REVOCATION_DEFAULT_TIMEOUT);
+
+CRevocationResolver::CRevocationResolver(const char* szDateTime)
+: m_szDateTime(szDateTime)
+{
+}
+
+int CRevocationResolver::add(CCertificate& cert, REVOCATION_INFO* pRevocationInfo)
+{
+	Item item;
+	item.pCert = &cert;
+	item.pRevocationInfo = pRevocationInfo;
+	item.nStatus = REVOCATION_STATUS_UNKNOWN;
+	m_items.push_back(item);
+
+	return (int)m_items.size() - 1;
+}
+
+void CRevocationResolver::resolve()
+{
+	LOG_DBG((0, "--> CRevocationResolver::resolve", "certificates: %d", (int)m_items.size()));
+
+	if(m_items.empty())
+		return;
+
+	// il primo certificato si verifica nel thread chiamante, gli altri in parallelo
+	std::vector<std::thread> threads;
+	for(size_t i = 1; i < m_items.size(); i++)
+		threads.push_back(std::thread(check, std::ref(m_items[i]), m_szDateTime));
+
+	check(m_items[0], m_szDateTime);
+
+	for(size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+
+	LOG_DBG((0, "<-- CRevocationResolver::resolve", "exit"));
+}
+
+void CRevocationResolver::check(Item& item, const char* szDateTime)
+{
+	// verifyStatus gestisce internamente le proprie eccezioni
+	item.nStatus = item.pCert->verifyStatus(szDateTime, item.pRevocationInfo);
+}
+
+int CRevocationResolver::getStatus(int i) const
+{
+	return m_items[i].nStatus;
+}
+
+int CRevocationResolver::size() const
+{
+	return (int)m_items.size();
+}
+
+void CRevocationResolver::SetTimeout(long nSeconds)
+{
+	g_nTimeout = nSeconds < 0 ? 0 : nSeconds;
+}
+
+long CRevocationResolver::GetTimeout()
+{
+	return g_nTimeout;
+}
@@ -0,0 +1,65 @@
+/*
+ *  RevocationResolver.h
+ *
+ *  Revocation status of the certificates of a signature, checked in parallel.
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+
+#include "Certificate.h"
+
+#include <vector>
+
+// timeout predefinito di una richiesta OCSP o di un download di CRL, in secondi
+#define REVOCATION_DEFAULT_TIMEOUT	60
+
+/*
+ * Collects the certificates of a signature (signer and CA chain) and checks
+ * their revocation status at once, one thread per certificate: the
+ * verification waits for the slowest responder instead of the sum of all of
+ * them. Each check is CCertificate::verifyStatus, so OCSP is tried first and
+ * the CRL is used when the responder fails, times out or answers unknown;
+ * responses and CRLs go through COCSPCache and CCrlCache.
+ *
+ * Every OCSP request and CRL download is bounded by the timeout (SetTimeout).
+ *
+ * The certificates must be distinct and must not be used by other threads
+ * while resolve() runs.
+ */
+class CRevocationResolver
+{
+public:
+	// szDateTime: data di riferimento della verifica, NULL = adesso
+	CRevocationResolver(const char* szDateTime);
+
+	// aggiunge un certificato; pRevocationInfo (puo' essere NULL) riceve i dettagli.
+	// Ritorna l'indice del certificato
+	int add(CCertificate& cert, REVOCATION_INFO* pRevocationInfo);
+
+	// verifica lo stato di tutti i certificati aggiunti
+	void resolve();
+
+	// REVOCATION_STATUS_* del certificato i dopo resolve()
+	int getStatus(int i) const;
+
+	int size() const;
+
+	// timeout in secondi di ogni richiesta; 0 = nessun limite
+	static void SetTimeout(long nSeconds);
+	static long GetTimeout();
+
+private:
+	struct Item
+	{
+		CCertificate* pCert;
+		REVOCATION_INFO* pRevocationInfo;
+		int nStatus;
+	};
+
+	static void check(Item& item, const char* szDateTime);
+
+	const char* m_szDateTime;
+	std::vector<Item> m_items;
+};
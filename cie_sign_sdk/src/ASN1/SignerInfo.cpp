@@ -9,11 +9,13 @@
 #include "../RSA/rsaeuro.h"
 #include "../RSA/rsa.h"
 #include "CertStore.h"
+#include "RevocationResolver.h"
 #include "DigestInfo.h"
 #include <sys/types.h>
 #include "Certificate.h"
 #include "Crl.h"
 #include <map>
+#include <vector>
 #include "../RSA/sha1.h"
 #include "../RSA/sha2.h"
 #include "UUCLogger.h"
@@ -328,6 +330,40 @@ int CSignerInfo::verifyCountersignature(int i, CASN1SetOf& certificates, const c
 
 
 int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerInfo, CASN1SetOf& certificates, const char* szDateTime, REVOCATION_INFO* pRevocationInfo)
+{
+	// content
+	UUCByteArray content;
+	try
+	{
+		CASN1OctetString octetString(source);
+		if(octetString.getTag() == 0x24) // contructed octet string
+		{
+			// elementi letti in sequenza: un elemento troncato solleva un'eccezione
+			const UUCByteArray* pValue = octetString.getValue();
+			UUCBufferedReader reader(*pValue);
+			while(reader.getPosition() < pValue->getLength())
+			{
+				CASN1OctetString element(reader);
+				content.append(element.getValue()->getContent(), element.getLength());
+			}
+		}
+		else	
+		{
+			content.append(octetString.getValue()->getContent(), octetString.getLength());
+		}
+	}
+	catch(...)
+	{
+		// il contenuto firmato non e' leggibile: la firma non e' verificabile
+		LOG_ERR((0, "CSignerInfo::verifySignature", "Invalid content"));
+		return -1;
+	}
+
+	CONTENT_SEGMENTS segments(1, std::make_pair(content.getContent(), (size_t)content.getLength()));
+	return verifySignature(segments, signerInfo, certificates, szDateTime, pRevocationInfo);
+}
+
+int CSignerInfo::verifySignature(const CONTENT_SEGMENTS& content, CSignerInfo& signerInfo, CASN1SetOf& certificates, const char* szDateTime, REVOCATION_INFO* pRevocationInfo)
 {
 	LOG_DBG((0, "--> CSignerInfo::verifySignature", "Verify Revocation: %d", (pRevocationInfo != NULL)));
 
@@ -357,40 +393,19 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 	}
 	
 
+	// stato di revoca del firmatario e dei certificati di CA: le richieste
+	// partono tutte insieme dopo aver ricostruito la catena
+	CRevocationResolver resolver(szDateTime);
+	int nSignerItem = -1;
+	std::vector<int> caItems;
+
 	if(pRevocationInfo)
 	{
 		pRevocationInfo->nRevocationStatus = REVOCATION_STATUS_UNKNOWN;
 
 		// verify revocation status only if the certificate is valid
 		if(bitmask & VERIFIED_CERT_VALIDITY)
-		{
-			int verifyStatus = cert.verifyStatus(szDateTime, pRevocationInfo);
-			
-			switch (verifyStatus) 
-			{
-				case REVOCATION_STATUS_GOOD:
-					bitmask |= VERIFIED_CERT_GOOD;
-					bitmask |= VERIFIED_CRL_LOADED;
-					break;
-					
-				case REVOCATION_STATUS_REVOKED:
-					bitmask |= VERIFIED_CRL_LOADED;
-					bitmask |= VERIFIED_CERT_REVOKED;
-					break;
-					
-				case REVOCATION_STATUS_SUSPENDED:
-					bitmask |= VERIFIED_CERT_SUSPENDED;
-					bitmask |= VERIFIED_CRL_LOADED;
-					break;
-					
-				case REVOCATION_STATUS_UNKNOWN:
-					bitmask |= VERIFIED_CRL_LOADED;
-					break;
-
-				default:
-					break;
-			}
-		}		
+			nSignerItem = resolver.add(cert, pRevocationInfo);
 	}
 
 	
@@ -399,10 +414,11 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 //	UUCByteArray issuer;
 //	issuerName.getNameAsString(issuer);//getField(OID_COMMON_NAME);
 //
-    CCertificate* pCert = &cert;
-    CCertificate* pCACert = CCertStore::GetCertificate(cert);
-    while(pCACert && pCert->verifySignature(*pCACert))
+    vector<CCertificate*> chain;
+    bool bChainComplete = CCertStore::BuildChain(cert, chain);
+    for(size_t i = 0; i < chain.size(); i++)
 	{
+        CCertificate* pCACert = chain[i];
         bitmask |= VERIFIED_CACERT_FOUND;
 
 		//NSLog(@"issuer: %s, SN: %s", issuer.c_str(), serialNumber.toHexString());
@@ -411,37 +427,65 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 		{
 			bitmask |= VERIFIED_CACERT_VALIDITY;
 			if(pRevocationInfo)
-			{
-				int verifyStatus = pCACert->verifyStatus(szDateTime, NULL);
-		
-				switch (verifyStatus) 
-				{
-					case REVOCATION_STATUS_GOOD:
-						bitmask |= VERIFIED_CACERT_GOOD;
-						bitmask |= VERIFIED_CACRL_LOADED;
-						break;
-						
-					case REVOCATION_STATUS_REVOKED:
-						bitmask |= VERIFIED_CACRL_LOADED;
-						bitmask |= VERIFIED_CACERT_REVOKED;
-						break;
-						
-					case REVOCATION_STATUS_SUSPENDED:
-						bitmask |= VERIFIED_CACERT_SUSPENDED;
-						bitmask |= VERIFIED_CACRL_LOADED;
-						break;
-						
-					case REVOCATION_STATUS_UNKNOWN:
-						break;
-				}	
-			}
+				caItems.push_back(resolver.add(*pCACert, NULL));
 		}
-        
-        pCert = pCACert;
-        pCACert = CCertStore::GetCertificate(*pCACert);
+	}
+
+	resolver.resolve();
+
+	if(nSignerItem != -1)
+	{
+		switch (resolver.getStatus(nSignerItem)) 
+		{
+			case REVOCATION_STATUS_GOOD:
+				bitmask |= VERIFIED_CERT_GOOD;
+				bitmask |= VERIFIED_CRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_REVOKED:
+				bitmask |= VERIFIED_CRL_LOADED;
+				bitmask |= VERIFIED_CERT_REVOKED;
+				break;
+				
+			case REVOCATION_STATUS_SUSPENDED:
+				bitmask |= VERIFIED_CERT_SUSPENDED;
+				bitmask |= VERIFIED_CRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_UNKNOWN:
+				bitmask |= VERIFIED_CRL_LOADED;
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	for(size_t i = 0; i < caItems.size(); i++)
+	{
+		switch (resolver.getStatus(caItems[i])) 
+		{
+			case REVOCATION_STATUS_GOOD:
+				bitmask |= VERIFIED_CACERT_GOOD;
+				bitmask |= VERIFIED_CACRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_REVOKED:
+				bitmask |= VERIFIED_CACRL_LOADED;
+				bitmask |= VERIFIED_CACERT_REVOKED;
+				break;
+				
+			case REVOCATION_STATUS_SUSPENDED:
+				bitmask |= VERIFIED_CACERT_SUSPENDED;
+				bitmask |= VERIFIED_CACRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_UNKNOWN:
+				break;
+		}	
 	}
 	
-    if(!pCACert)
+    if(bChainComplete)
     {
         bitmask |= VERIFIED_CERT_CHAIN;
     }
@@ -453,22 +497,14 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 	
 	// verifica la firma
     
-    // OpenSSL
-    UUCByteArray baCert;
-    cert.toByteArray(baCert);
-    
-//    int result;
-//    BIO* bio;
-    X509 *x509 = NULL;
-    
-    const BYTE* content = baCert.getContent();
-    x509 = d2i_X509(NULL, &content, baCert.getLength());
-        
-    EVP_PKEY *evp_pubkey;
-    RSA *rsa_pubkey;
-
-    evp_pubkey  = X509_get_pubkey(x509);
-    rsa_pubkey  = EVP_PKEY_get1_RSA(evp_pubkey);
+    // OpenSSL: X509 e chiave pubblica sono decodificati e posseduti dal certificato
+    EVP_PKEY *evp_pubkey = cert.getPublicKey();
+    RSA *rsa_pubkey = evp_pubkey ? EVP_PKEY_get1_RSA(evp_pubkey) : NULL;
+    if(!rsa_pubkey)
+    {
+        LOG_ERR((0, "<-- CSignerInfo::verifySignature", "Invalid signer public key"));
+        return bitmask;
+    }
 
     //////////////
     
@@ -532,8 +568,6 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
         len = RSA_public_decrypt(encrypted_len, (BYTE*)encrypted, decrypted, rsa_pubkey,RSA_PKCS1_PADDING);
         
         RSA_free(rsa_pubkey);
-        EVP_PKEY_free(evp_pubkey);
-        X509_free(x509);
         
 		// ritorna il DigestInfo pulito, senza padding
 //		retVal = RSAPublicDecrypt(decrypted, &len, (BYTE*)pEncDigest->getContent(), (unsigned int)pEncDigest->getLength(), &rsakey);
@@ -553,28 +587,6 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 			UUCByteArray* pDigestValue = (UUCByteArray*)digest.getValue();
 			//szHex = pDigestValue->toHexString();
 			
-			// content
-			UUCByteArray content;
-			CASN1OctetString octetString(source);
-			//UUCByteArray baoctetstring;
-			//octetString.toByteArray(baoctetstring);
-			//NSLog([NSString stringWithCString:baoctetstring.toHexString()]);
-			
-			if(octetString.getTag() == 0x24) // contructed octet string
-			{
-				CASN1Sequence contentArray(octetString);
-				int size = contentArray.size();
-				for(int i = 0; i < size; i++)
-				{
-					content.append(contentArray.elementAt(i).getValue()->getContent(), contentArray.elementAt(i).getLength());
-				}
-			}
-			else	
-			{
-				content.append(octetString.getValue()->getContent(), octetString.getLength());
-			}
-			
-			
 			BYTE* buff;
 			int bufflen = 0;
 			
@@ -628,8 +640,7 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 			else
 			{
 				// se non ci sono signedattributes l'hash va fatto sul content
-				buff = (BYTE*)content.getContent();
-				bufflen = content.getLength();
+				buff = NULL;
 
 				//LOG_DBG((0, "CSignerInfo::verifySignature", "Buf2: %s, %d", content.toHexString(), bufflen));	
 			}
@@ -656,8 +667,17 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 				sha256_update(&ctx2561, content.getContent(), content.getLength());	
 				sha256_finish(&ctx2561, hash2);
 */
-				sha2(buff, bufflen, hash, 0);
-				sha2(content.getContent(), content.getLength(), hash2, 0);
+				// il content e' letto a parti, senza ricomporlo
+				sha2_context ctx256;
+				sha2_starts(&ctx256, 0);
+				for(size_t i = 0; i < content.size(); i++)
+					sha2_update(&ctx256, content[i].first, content[i].second);
+				sha2_finish(&ctx256, hash2);
+
+				if(buff)
+					sha2(buff, bufflen, hash, 0);
+				else
+					memcpy(hash, hash2, 32);
 /*
 				
 				SHA256_CTX	ctx256;				
@@ -718,20 +738,24 @@ int CSignerInfo::verifySignature(CASN1OctetString& source, CSignerInfo& signerIn
 				SHA1Context sha;
 				
 				SHA1Reset(&sha);
-				
-				SHA1Input(&sha, buff, bufflen);
-				
+				for(size_t i = 0; i < content.size(); i++)
+					SHA1Input(&sha, content[i].first, (unsigned)content[i].second);
 				SHA1Result(&sha);
-				
 				sprintf(szAux, "%08X%08X%08X%08X%08X ", sha.Message_Digest[0], sha.Message_Digest[1], sha.Message_Digest[2], sha.Message_Digest[3], sha.Message_Digest[4]);
+				UUCByteArray contentHash(szAux);
 				
-				UUCByteArray hashaux(szAux);
+				if(buff)
+				{
+					SHA1Reset(&sha);
+					
+					SHA1Input(&sha, buff, bufflen);
+					
+					SHA1Result(&sha);
+					
+					sprintf(szAux, "%08X%08X%08X%08X%08X ", sha.Message_Digest[0], sha.Message_Digest[1], sha.Message_Digest[2], sha.Message_Digest[3], sha.Message_Digest[4]);
+				}
 				
-				SHA1Reset(&sha);
-				SHA1Input(&sha, content.getContent(), content.getLength());
-				SHA1Result(&sha);
-				sprintf(szAux, "%08X%08X%08X%08X%08X ", sha.Message_Digest[0], sha.Message_Digest[1], sha.Message_Digest[2], sha.Message_Digest[3], sha.Message_Digest[4]);
-				UUCByteArray contentHash(szAux);
+				UUCByteArray hashaux(szAux);
 				
 				
 				if(memcmp(hashaux.getContent(), pDigestValue->getContent(), hashaux.getLength()) == 0)
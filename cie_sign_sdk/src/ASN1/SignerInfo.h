@@ -17,6 +17,12 @@
 #include "TimeStampToken.h"
 #include "disigonsdk.h"
 
+#include <utility>
+#include <vector>
+
+// contenuto firmato in piu' parti non contigue (es. gli intervalli /ByteRange di un PDF)
+typedef std::vector<std::pair<const BYTE*, size_t> > CONTENT_SEGMENTS;
+
 class CSignerInfo : public CASN1Sequence  
 {
 public:
@@ -57,6 +63,9 @@ public:
 	
 	static int verifySignature(CASN1OctetString& source, CSignerInfo& sinfo, CASN1SetOf& certificates, const char* date, REVOCATION_INFO* pRevocationInfo);
 
+	// l'hash del contenuto e' calcolato sulle parti, senza copiarle
+	static int verifySignature(const CONTENT_SEGMENTS& content, CSignerInfo& sinfo, CASN1SetOf& certificates, const char* date, REVOCATION_INFO* pRevocationInfo);
+
 };
 
 #endif // !defined(AFX_SIGNERINFO_H__ED6FFA3F_0A25_4A42_A3E5_BC704B9C25B3__INCLUDED_)
@@ -0,0 +1,233 @@
+/* UUCArena.cpp: implementation of the UUCArena class.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "UUCArena.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGN       16
+#define ARENA_MAX_BLOCK   (1024 * 1024)
+
+#define ALIGN_UP(n)       (((n) + (ARENA_ALIGN - 1)) & ~((size_t)ARENA_ALIGN - 1))
+#define BLOCK_HEADER      ALIGN_UP(sizeof(UUCArena::Block))
+
+static thread_local UUCArena* t_pCurrentArena = NULL;
+static thread_local UUCAllocStats t_stats = { 0, 0, 0 };
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+UUCArena::UUCArena(size_t nBlockSize)
+: m_pHead(NULL), m_nBlockSize(nBlockSize), m_nBytesUsed(0), m_nBlockCount(0), m_pLast(NULL), m_nLastLen(0)
+{
+	if(m_nBlockSize < 1024)
+		m_nBlockSize = 1024;
+}
+
+UUCArena::~UUCArena()
+{
+	release();
+}
+
+UUCArena::Block* UUCArena::newBlock(size_t nMinLen)
+{
+	// i blocchi raddoppiano fino a ARENA_MAX_BLOCK; le richieste grandi hanno un blocco dedicato
+	size_t nSize = m_nBlockSize;
+	if(m_pHead && m_pHead->nSize < ARENA_MAX_BLOCK)
+		nSize = m_pHead->nSize * 2;
+
+	if(nSize < nMinLen + BLOCK_HEADER)
+		nSize = nMinLen + BLOCK_HEADER;
+
+	Block* pBlock = (Block*)malloc(nSize);
+	if(pBlock == NULL)
+		throw -5L;
+
+	pBlock->nSize = nSize;
+	pBlock->nUsed = BLOCK_HEADER;
+	m_nBlockCount++;
+
+	if(m_pHead && nMinLen + BLOCK_HEADER > m_nBlockSize && m_pHead->nSize - m_pHead->nUsed > nSize / 4)
+	{
+		// blocco dedicato: si accoda senza sprecare lo spazio residuo del blocco corrente
+		pBlock->pNext = m_pHead->pNext;
+		m_pHead->pNext = pBlock;
+	}
+	else
+	{
+		pBlock->pNext = m_pHead;
+		m_pHead = pBlock;
+	}
+
+	return pBlock;
+}
+
+void* UUCArena::alloc(size_t nLen)
+{
+	if(nLen == 0)
+		nLen = 1;
+
+	size_t nAligned = ALIGN_UP(nLen);
+
+	Block* pBlock = m_pHead;
+	if(pBlock == NULL || pBlock->nSize - pBlock->nUsed < nAligned)
+		pBlock = newBlock(nAligned);
+
+	void* ptr = (unsigned char*)pBlock + pBlock->nUsed;
+	pBlock->nUsed += nAligned;
+	m_nBytesUsed += nAligned;
+
+	m_pLast = ptr;
+	m_nLastLen = nAligned;
+
+	t_stats.nArenaAllocs++;
+
+	return ptr;
+}
+
+void* UUCArena::realloc(void* ptr, size_t nOldLen, size_t nNewLen)
+{
+	if(ptr == NULL)
+		return alloc(nNewLen);
+
+	size_t nAligned = ALIGN_UP(nNewLen);
+
+	// l'ultima allocazione del blocco corrente si puo' estendere sul posto
+	if(ptr == m_pLast && m_pHead && (unsigned char*)m_pHead + m_pHead->nUsed == (unsigned char*)ptr + m_nLastLen)
+	{
+		if(nAligned <= m_nLastLen)
+			return ptr;
+
+		if(m_pHead->nSize - m_pHead->nUsed >= nAligned - m_nLastLen)
+		{
+			m_pHead->nUsed += nAligned - m_nLastLen;
+			m_nBytesUsed += nAligned - m_nLastLen;
+			m_nLastLen = nAligned;
+			return ptr;
+		}
+	}
+
+	if(nNewLen <= nOldLen)
+		return ptr;
+
+	void* pNew = alloc(nNewLen);
+	memcpy(pNew, ptr, nOldLen);
+	return pNew;
+}
+
+void UUCArena::release()
+{
+	Block* pBlock = m_pHead;
+	while(pBlock)
+	{
+		Block* pNext = pBlock->pNext;
+		free(pBlock);
+		pBlock = pNext;
+	}
+
+	m_pHead = NULL;
+	m_nBytesUsed = 0;
+	m_nBlockCount = 0;
+	m_pLast = NULL;
+	m_nLastLen = 0;
+}
+
+size_t UUCArena::getBytesUsed() const
+{
+	return m_nBytesUsed;
+}
+
+size_t UUCArena::getBlockCount() const
+{
+	return m_nBlockCount;
+}
+
+UUCArena* UUCArena::current()
+{
+	return t_pCurrentArena;
+}
+
+void* UUCArena::allocate(size_t nLen, UUCArena** ppOwner)
+{
+	UUCArena* pArena = t_pCurrentArena;
+	if(ppOwner)
+		*ppOwner = pArena;
+
+	if(pArena)
+		return pArena->alloc(nLen);
+
+	void* ptr = malloc(nLen ? nLen : 1);
+	if(ptr == NULL)
+		throw -5L;
+
+	t_stats.nHeapAllocs++;
+	return ptr;
+}
+
+void* UUCArena::reallocate(void* ptr, size_t nOldLen, size_t nNewLen, UUCArena** ppOwner)
+{
+	if(ptr == NULL)
+		return allocate(nNewLen, ppOwner);
+
+	if(*ppOwner)
+		return (*ppOwner)->realloc(ptr, nOldLen, nNewLen);
+
+	void* pNew = ::realloc(ptr, nNewLen ? nNewLen : 1);
+	if(pNew == NULL)
+		throw -5L;
+
+	if(pNew != ptr)
+	{
+		t_stats.nHeapAllocs++;
+		t_stats.nHeapFrees++;
+	}
+	return pNew;
+}
+
+void UUCArena::deallocate(void* ptr, UUCArena* pOwner)
+{
+	// la memoria dell'arena viene rilasciata solo con l'arena
+	if(ptr == NULL || pOwner)
+		return;
+
+	free(ptr);
+	t_stats.nHeapFrees++;
+}
+
+UUCAllocStats& UUCArena::stats()
+{
+	return t_stats;
+}
+
+//////////////////////////////////////////////////////////////////////
+// UUCArenaScope
+//////////////////////////////////////////////////////////////////////
+
+UUCArenaScope::UUCArenaScope(UUCArena& arena)
+: m_pPrevious(t_pCurrentArena)
+{
+	t_pCurrentArena = &arena;
+}
+
+UUCArenaScope::~UUCArenaScope()
+{
+	t_pCurrentArena = m_pPrevious;
+}
+
+//////////////////////////////////////////////////////////////////////
+// UUCHeapScope
+//////////////////////////////////////////////////////////////////////
+
+UUCHeapScope::UUCHeapScope()
+: m_pPrevious(t_pCurrentArena)
+{
+	t_pCurrentArena = NULL;
+}
+
+UUCHeapScope::~UUCHeapScope()
+{
+	t_pCurrentArena = m_pPrevious;
+}
@@ -0,0 +1,102 @@
+/* UUCArena.h: per-operation monotonic allocator for the ASN.1 classes.
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#pragma once
+#include <stddef.h>
+
+#define UUC_ARENA_DEFAULT_BLOCK   16384
+
+// Contatori delle allocazioni fatte dalle classi ASN.1 (per thread).
+struct UUCAllocStats
+{
+	unsigned long nHeapAllocs;
+	unsigned long nHeapFrees;
+	unsigned long nArenaAllocs;
+};
+
+/*
+ * Monotonic arena: memory is carved out of a few large blocks and released
+ * in one step when the arena is destroyed (or release() is called).
+ *
+ * An arena becomes the allocation source for UUCByteArray, the ASN.1
+ * sequences and UUCBufferedReader while a UUCArenaScope for it is alive on
+ * the current thread. Every object created inside the scope must be
+ * destroyed (or copied out) before the arena goes away.
+ * An arena is not thread safe: use one arena per thread/operation.
+ */
+class UUCArena
+{
+public:
+	UUCArena(size_t nBlockSize = UUC_ARENA_DEFAULT_BLOCK);
+	virtual ~UUCArena();
+
+	void* alloc(size_t nLen);
+	void* realloc(void* ptr, size_t nOldLen, size_t nNewLen);
+	void release();
+
+	size_t getBytesUsed() const;
+	size_t getBlockCount() const;
+
+	// arena attiva sul thread corrente (NULL se nessuna)
+	static UUCArena* current();
+
+	// helper usati dalle classi ASN.1: pOwner registra l'arena di provenienza
+	static void* allocate(size_t nLen, UUCArena** ppOwner);
+	static void* reallocate(void* ptr, size_t nOldLen, size_t nNewLen, UUCArena** ppOwner);
+	static void deallocate(void* ptr, UUCArena* pOwner);
+
+	static UUCAllocStats& stats();
+
+private:
+	UUCArena(const UUCArena&);
+	UUCArena& operator = (const UUCArena&);
+
+	struct Block
+	{
+		Block* pNext;
+		size_t nSize;
+		size_t nUsed;
+	};
+
+	Block* newBlock(size_t nMinLen);
+
+	Block* m_pHead;
+	size_t m_nBlockSize;
+	size_t m_nBytesUsed;
+	size_t m_nBlockCount;
+	void*  m_pLast;
+	size_t m_nLastLen;
+
+	friend class UUCArenaScope;
+};
+
+// Rende attiva un'arena sul thread corrente fino alla fine dello scope.
+class UUCArenaScope
+{
+public:
+	UUCArenaScope(UUCArena& arena);
+	~UUCArenaScope();
+
+private:
+	UUCArenaScope(const UUCArenaScope&);
+	UUCArenaScope& operator = (const UUCArenaScope&);
+
+	UUCArena* m_pPrevious;
+};
+
+// Sospende l'arena del thread corrente: gli oggetti che sopravvivono all'operazione
+// (cache, certificati dello store) vanno allocati sullo heap.
+class UUCHeapScope
+{
+public:
+	UUCHeapScope();
+	~UUCHeapScope();
+
+private:
+	UUCHeapScope(const UUCHeapScope&);
+	UUCHeapScope& operator = (const UUCHeapScope&);
+
+	UUCArena* m_pPrevious;
+};
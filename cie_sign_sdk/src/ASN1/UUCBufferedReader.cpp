@@ -5,6 +5,7 @@
 
 #include "definitions.h"
 #include "UUCBufferedReader.h"
+#include "UUCArena.h"
 #include <stdlib.h>
 
 #define MAX_BUF			2000
@@ -34,6 +35,7 @@ UUCBufferedReader::UUCBufferedReader(const char* lpszFilePath)
 }
 */
 UUCBufferedReader::UUCBufferedReader(const UUCByteArray& buffer)
+: m_pStackArena(NULL)
 {
 	m_pbtBuffer = (BYTE*)buffer.getContent();
 	m_nBufLen	= buffer.getLength();
@@ -41,13 +43,13 @@ UUCBufferedReader::UUCBufferedReader(const UUCByteArray& buffer)
 	m_nBufPos	= 0;	
 	m_nIndex	= 0;
 	m_bEOF		= true;
-	m_pnStack   = (unsigned int*)realloc(NULL, MAX_STACK_SIZE * sizeof(unsigned int));
+	m_pnStack   = (unsigned int*)UUCArena::allocate(MAX_STACK_SIZE * sizeof(unsigned int), &m_pStackArena);
 	m_nStackSize = MAX_STACK_SIZE;
 	m_nTop		= -1;	
 }
 
 UUCBufferedReader::UUCBufferedReader(const BYTE* pbtBuffer, int len)
-: m_pbtBuffer(NULL)
+: m_pbtBuffer(NULL), m_pStackArena(NULL)
 {
 	m_pbtBuffer = (BYTE*)pbtBuffer;
 	m_nBufLen	= len;
@@ -55,7 +57,7 @@ UUCBufferedReader::UUCBufferedReader(const BYTE* pbtBuffer, int len)
 	m_nBufPos	= 0;	
 	m_nIndex	= 0;
 	m_bEOF		= true;
-	m_pnStack   = (unsigned int*)realloc(NULL, MAX_STACK_SIZE * sizeof(unsigned int));
+	m_pnStack   = (unsigned int*)UUCArena::allocate(MAX_STACK_SIZE * sizeof(unsigned int), &m_pStackArena);
 	m_nStackSize = MAX_STACK_SIZE;
 	m_nTop		= -1;	
 }
@@ -70,7 +72,7 @@ UUCBufferedReader::~UUCBufferedReader()
 		//if(m_pbtBuffer)
 		//	free(m_pbtBuffer);	
 
-		free(m_pnStack);
+		UUCArena::deallocate(m_pnStack, m_pStackArena);
 	}
 	catch(...)
 	{
@@ -164,7 +166,7 @@ void UUCBufferedReader::mark()
 	if(m_nTop >= m_nStackSize)
 	{
 		m_nStackSize += MAX_STACK_SIZE;
-		m_pnStack = (unsigned int*) realloc(m_pnStack, m_nStackSize * sizeof(unsigned int));
+		m_pnStack = (unsigned int*)UUCArena::reallocate(m_pnStack, (m_nStackSize - MAX_STACK_SIZE) * sizeof(unsigned int), m_nStackSize * sizeof(unsigned int), &m_pStackArena);
 	}
 
 	m_pnStack[m_nTop] = m_nIndex;
@@ -39,4 +39,5 @@ private:
 	unsigned int* m_pnStack;
 	unsigned int  m_nStackSize;
 	int  m_nTop;
+	UUCArena* m_pStackArena;
 };
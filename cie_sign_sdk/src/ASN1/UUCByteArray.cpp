@@ -3,148 +3,207 @@
  */
  
 #include "UUCByteArray.h"
+#include "UUCArena.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <memory.h>
 
 
-#define DEFAULT_CAPACITY  100
+// capacita' minima allocata quando il buffer interno non basta piu'
+#define MIN_HEAP_CAPACITY  64
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
 //////////////////////////////////////////////////////////////////////
 // Construction/Destruction
 //////////////////////////////////////////////////////////////////////
 
 UUCByteArray::UUCByteArray(const BYTE* pbtContent, const unsigned long unLen)
-: m_szHex(NULL)
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
 {	
-	m_unLen = unLen;
-	
-	if(m_unLen > 0)
+	terminate();
+	if(unLen > 0)
+		append(pbtContent, unLen);
+}
+
+UUCByteArray::UUCByteArray(const UUCByteArray& blob)
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
+{
+	terminate();
+	if(blob.getLength() > 0)
+		append(blob.getContent(), blob.getLength());
+}
+
+UUCByteArray::UUCByteArray(UUCByteArray&& blob) noexcept
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
+{
+	moveFrom(blob);
+}
+
+UUCByteArray::UUCByteArray(const char* szHexString)
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
+{
+	load(szHexString);
+}
+
+UUCByteArray::UUCByteArray(const unsigned long nLen)
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
+{
+	terminate();
+	reserve(nLen);
+}
+
+UUCByteArray::UUCByteArray()
+: m_pbtContent(m_btInline), m_unLen(0), m_nCapacity(UUC_INLINE_CAPACITY), m_szHex(NULL), m_pArena(NULL)
+{
+	terminate();
+}
+
+UUCByteArray::~UUCByteArray()
+{
+	releaseBuffer();
+	if(m_szHex)
+		delete[] m_szHex;
+}
+
+UUCByteArray& UUCByteArray::operator = (const UUCByteArray& blob)
+{
+	if(this != &blob)
 	{
-		m_nCapacity = m_unLen;	
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);	
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
-		memcpy(m_pbtContent, pbtContent, m_unLen);
+		m_unLen = 0;
+		terminate();
+		append(blob.getContent(), blob.getLength());
 	}
-	else
+
+	return *this;
+}
+
+UUCByteArray& UUCByteArray::operator = (UUCByteArray&& blob) noexcept
+{
+	if(this != &blob)
 	{
+		releaseBuffer();
+		m_pbtContent = m_btInline;
+		m_nCapacity = UUC_INLINE_CAPACITY;
 		m_unLen = 0;
-		m_nCapacity = DEFAULT_CAPACITY;
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
-	}	
+		m_pArena = NULL;
+		moveFrom(blob);
+	}
+
+	return *this;
 }
 
-UUCByteArray::UUCByteArray(const UUCByteArray& blob)
-: m_szHex(NULL)
+void UUCByteArray::moveFrom(UUCByteArray& blob)
 {
-	m_unLen = blob.getLength();
-	
-	if(m_unLen > 0)
+	// this e' vuoto e usa il buffer interno
+	if(blob.isInline())
 	{
-		m_nCapacity = m_unLen;	
-		//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
-		memcpy(m_pbtContent, blob.getContent(), m_unLen);
+		memcpy(m_btInline, blob.m_btInline, blob.m_unLen);
+		m_unLen = blob.m_unLen;
 	}
 	else
 	{
-		m_unLen = 0;
-		m_nCapacity = DEFAULT_CAPACITY;
-		//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);	
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
-	}	
-	
+		m_pbtContent = blob.m_pbtContent;
+		m_nCapacity = blob.m_nCapacity;
+		m_unLen = blob.m_unLen;
+		m_pArena = blob.m_pArena;
+
+		blob.m_pbtContent = blob.m_btInline;
+		blob.m_nCapacity = UUC_INLINE_CAPACITY;
+		blob.m_pArena = NULL;
+	}
+
+	blob.m_unLen = 0;
+	blob.terminate();
+	terminate();
+}
+
+void UUCByteArray::terminate()
+{
+	// byte di guardia sempre azzerato dopo il contenuto
+	m_pbtContent[m_unLen] = 0;
+}
+
+bool UUCByteArray::isInline() const
+{
+	return m_pbtContent == m_btInline;
+}
 
-	/*
-	m_unLen = blob.getLength();
-	if(m_unLen > 0)
+void UUCByteArray::releaseBuffer()
+{
+	if(!isInline())
+		UUCArena::deallocate(m_pbtContent, m_pArena);
+}
+
+void UUCByteArray::setCapacity(const unsigned long nCapacity)
+{
+	if(nCapacity <= UUC_INLINE_CAPACITY)
+	{
+		if(!isInline())
+		{
+			BYTE* pbtOld = m_pbtContent;
+			memcpy(m_btInline, pbtOld, m_unLen);
+			UUCArena::deallocate(pbtOld, m_pArena);
+			m_pbtContent = m_btInline;
+			m_pArena = NULL;
+		}
+		m_nCapacity = UUC_INLINE_CAPACITY;
+	}
+	else if(isInline())
 	{
-		m_nCapacity = m_unLen;	
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);	
-		memcpy(m_pbtContent, blob.getContent(), m_unLen);
+		BYTE* pbtNew = (BYTE*)UUCArena::allocate(nCapacity + 1, &m_pArena);
+		memcpy(pbtNew, m_btInline, m_unLen);
+		m_pbtContent = pbtNew;
+		m_nCapacity = nCapacity;
 	}
 	else
 	{
-		m_unLen = 0;
-		m_nCapacity = DEFAULT_CAPACITY;
-		m_pbtContent = (BYTE*)malloc(m_nCapacity);		
+		m_pbtContent = (BYTE*)UUCArena::reallocate(m_pbtContent, m_unLen, nCapacity + 1, &m_pArena);
+		m_nCapacity = nCapacity;
 	}
-	*/
-}
 
-UUCByteArray::UUCByteArray(const char* szHexString)
-: m_szHex(NULL)
-{
-	m_unLen = (strlen(szHexString)/2);
-	m_nCapacity = m_unLen;	
-	//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);	
-	m_pbtContent = (BYTE*)malloc(m_nCapacity);
-	if(m_pbtContent == NULL)
-		throw -5L;
-	
-	for(unsigned int i = 0; i < m_unLen; i++)
-	{
-		m_pbtContent[i] = atox((char*)szHexString + (i * 2));
-	}	
+	terminate();
 }
 
-UUCByteArray::UUCByteArray(const unsigned long nLen)
-: m_szHex(NULL)
+void UUCByteArray::grow(const unsigned long nRequired)
 {
-	//m_unLen = nLen;
-	m_unLen = 0;
-	m_nCapacity = nLen;	
-	//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);	
-	m_pbtContent = (BYTE*)malloc(m_nCapacity);
-	if(m_pbtContent == NULL)
-		throw -5L;
-	
+	// crescita geometrica: costo ammortizzato costante per append
+	unsigned long nCapacity = m_nCapacity * 2;
+	if(nCapacity < MIN_HEAP_CAPACITY)
+		nCapacity = MIN_HEAP_CAPACITY;
+	if(nCapacity < nRequired)
+		nCapacity = nRequired;
+
+	setCapacity(nCapacity);
 }
 
-UUCByteArray::UUCByteArray()
-: m_szHex(NULL)
+void UUCByteArray::reserve(const unsigned long nCapacity)
 {
-	m_unLen = 0;
-	m_nCapacity = DEFAULT_CAPACITY;
-	//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);
-	m_pbtContent = (BYTE*)malloc(m_nCapacity);
-	if(m_pbtContent == NULL)
-		throw -5L;
-	
+	if(nCapacity > m_nCapacity)
+		setCapacity(nCapacity);
 }
 
-UUCByteArray::~UUCByteArray()
+void UUCByteArray::shrink_to_fit()
 {
-	//GlobalFree(m_pbtContent);
-	free(m_pbtContent);
-	if(m_szHex)
-		delete m_szHex;
+	if(!isInline() && m_unLen < m_nCapacity)
+		setCapacity(m_unLen);
 }
 
 void UUCByteArray::load(const char* szHexString)
 {
-	m_unLen = (strlen(szHexString)/2);
+	unsigned long nLen = (strlen(szHexString)/2);
 	
-	//GlobalFree(m_pbtContent);
-	free(m_pbtContent);
-	m_nCapacity = m_unLen;	
-	//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);
-	m_pbtContent = (BYTE*)malloc(m_nCapacity);
+	m_unLen = 0;
+	reserve(nLen);
 
-	for(unsigned int i = 0; i < m_unLen; i++)
+	for(unsigned int i = 0; i < nLen; i++)
 	{
 		m_pbtContent[i] = atox((char*)szHexString + (i * 2));
 	}
+
+	m_unLen = nLen;
+	terminate();
 }
 
 const BYTE* UUCByteArray::getContent() const
@@ -157,6 +216,11 @@ unsigned long UUCByteArray::getLength() const
 	return m_unLen;
 }
 
+unsigned long UUCByteArray::getCapacity() const
+{
+	return m_nCapacity;
+}
+
 BYTE UUCByteArray::operator [] (const unsigned int index) const //throw(long)
 {
 	return get(index);
@@ -190,58 +254,52 @@ void UUCByteArray::remove(const unsigned int index) //throw(long)
 		throw (long)ERR_INDEX_OUT_OF_BOUND;
 	}
 
-	for(unsigned int i = index; i < m_unLen - 1; i++)
-		m_pbtContent[i] = m_pbtContent[i + 1];
+	memmove(m_pbtContent + index, m_pbtContent + index + 1, m_unLen - index - 1);
 
 	m_unLen--;
+	terminate();
 }
 
 void UUCByteArray::removeAll()
 {
-	memset(m_pbtContent,0, m_nCapacity);
 	m_unLen = 0;
-
-	//m_nCapacity = DEFAULT_CAPACITY;
-	//GlobalFree(m_pbtContent);
-	//m_pbtContent = (BYTE*)GlobalAlloc(GPTR, m_nCapacity);	
-	//m_pbtContent = (BYTE*)malloc(m_nCapacity);
+	terminate();
 }
 
 void UUCByteArray::append(const BYTE btVal)
 {
 	if(m_unLen == m_nCapacity)
-	{
-		m_nCapacity += DEFAULT_CAPACITY;
-		//m_pbtContent = (BYTE*)GlobalReAlloc(m_pbtContent, m_nCapacity, GMEM_ZEROINIT);
-		m_pbtContent = (BYTE*)realloc(m_pbtContent, m_nCapacity);
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
-	}
+		grow(m_unLen + 1);
 		
 	m_pbtContent[m_unLen] = btVal;
 
 	m_unLen++;
+	terminate();
 }
 
 void UUCByteArray::append(const BYTE* pbtVal, const unsigned int nLen)
 {
+	if(nLen == 0)
+		return;
+
 	if(m_unLen + nLen > m_nCapacity)
 	{
-		m_nCapacity += nLen;
-		//m_pbtContent = (BYTE*)GlobalReAlloc(m_pbtContent, m_nCapacity, GMEM_ZEROINIT);
-		m_pbtContent = (BYTE*)realloc(m_pbtContent, m_nCapacity);
-		if(m_pbtContent == NULL)
-			throw -5L;
-		
+		// pbtVal puo' puntare dentro questo stesso buffer
+		if(pbtVal >= m_pbtContent && pbtVal < m_pbtContent + m_unLen)
+		{
+			unsigned long nOffset = pbtVal - m_pbtContent;
+			grow(m_unLen + nLen);
+			pbtVal = m_pbtContent + nOffset;
+		}
+		else
+		{
+			grow(m_unLen + nLen);
+		}
 	}
 
-	for(unsigned int i = 0; i < nLen; i++)
-	{
-		m_pbtContent[m_unLen] = pbtVal[i];
-		m_unLen++;
-		//append(pbtVal[i]);
-	}	
+	memmove(m_pbtContent + m_unLen, pbtVal, nLen);
+	m_unLen += nLen;
+	terminate();
 }
 
 void UUCByteArray::append(const UUCByteArray& val)
@@ -251,44 +309,29 @@ void UUCByteArray::append(const UUCByteArray& val)
 
 void UUCByteArray::append(const char* szHexString)
 {
-	UUCByteArray ba(szHexString);
-	append(ba.getContent(), ba.getLength());
-}
+	unsigned long nLen = (strlen(szHexString)/2);
+	reserve(m_unLen + nLen);
 
-/*
-void UUCByteArray::toHexString(char* szHexString) const
-{
-	try
-	{
-		char szDigit[3];
-		strcpy(szHexString, "");
-		for(unsigned int i = 0; i < m_unLen; i++)
-		{
-			sprintf(szDigit, "%02X", m_pbtContent[i]);
-			strcat(szHexString, szDigit);
-		}	
-	}
-	catch(...)
+	for(unsigned int i = 0; i < nLen; i++)
 	{
-		throw new UUCException("UUCByteArray:toHexString:Access Violation");
+		m_pbtContent[m_unLen + i] = atox((char*)szHexString + (i * 2));
 	}
+
+	m_unLen += nLen;
+	terminate();
 }
-*/
 
 void UUCByteArray::reverse()
 {
-	BYTE* pbtContent = (BYTE*)malloc(m_unLen);
-	if(m_pbtContent == NULL)
-		throw -5L;
-	
-	for(int i = 0; i < m_unLen; i++)
+	if(m_unLen < 2)
+		return;
+
+	for(unsigned long i = 0, j = m_unLen - 1; i < j; i++, j--)
 	{
-		pbtContent[i] = m_pbtContent[m_unLen - i - 1];
+		BYTE bt = m_pbtContent[i];
+		m_pbtContent[i] = m_pbtContent[j];
+		m_pbtContent[j] = bt;
 	}
-
-	memcpy(m_pbtContent, pbtContent, m_unLen);
-
-	free(pbtContent);
 }
 
 const char* UUCByteArray::toHexString() 
@@ -300,35 +343,23 @@ const char* UUCByteArray::toHexString(int nSize)
 {
 	if(m_szHex)
 	{
-		delete m_szHex;
+		delete[] m_szHex;
 		m_szHex = NULL;
 	}
 
-	if(nSize == 0 || nSize > m_unLen)
+	if(nSize <= 0 || (unsigned long)nSize > m_unLen)
 	{
 		nSize = m_unLen;
 	}
 
-	//m_szHex = new char[(m_unLen + 1) * 2];
 	m_szHex = new char[(nSize + 1) * 2];	
 
-	try
-	{
-		char szDigit[3];
-		strcpy(m_szHex, "");
-		for(unsigned int i = 0; i < nSize; i++)
-		{
-			sprintf(szDigit, "%02X", m_pbtContent[i]);
-			strcat(m_szHex, szDigit);
-		}	
-
-		return m_szHex;
-	}
-	catch(...)
+	for(int i = 0; i < nSize; i++)
 	{
-		//SetLastError(-3);
-		throw -3L;//new UUCException("UUCByteArray:toHexString:Access Violation");
+		m_szHex[i * 2] = HEX_DIGITS[m_pbtContent[i] >> 4];
+		m_szHex[i * 2 + 1] = HEX_DIGITS[m_pbtContent[i] & 0x0F];
 	}
+	m_szHex[nSize * 2] = 0;
 
-	
+	return m_szHex;
 }
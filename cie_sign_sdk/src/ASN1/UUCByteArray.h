@@ -7,21 +7,35 @@
 
 #define ERR_INDEX_OUT_OF_BOUND    0xC0001001L
 
+// valori fino a questa lunghezza (OID, hash, interi brevi) restano nel buffer interno;
+// il contenuto e' sempre seguito da un byte di guardia a 0
+#define UUC_INLINE_CAPACITY       32
+
+class UUCArena;
+
 class UUCByteArray  
 {
 public:
 	UUCByteArray(const BYTE* pbtContent, const unsigned long unLen);
 	UUCByteArray(const UUCByteArray& blob);
+	UUCByteArray(UUCByteArray&& blob) noexcept;
 	UUCByteArray(const char* szHexString);
 	UUCByteArray(const unsigned long nLen);
 	UUCByteArray();
 
+	UUCByteArray& operator = (const UUCByteArray& blob);
+	UUCByteArray& operator = (UUCByteArray&& blob) noexcept;
+
 	void load(const char* szHexString);
 
 	virtual ~UUCByteArray();
 
 	const BYTE* getContent() const;
 	unsigned long getLength() const;
+	unsigned long getCapacity() const;
+
+	void reserve(const unsigned long nCapacity);
+	void shrink_to_fit();
 	
 	void reverse();
 	void append(const BYTE btVal);
@@ -38,8 +52,17 @@ public:
 	const char* toHexString(int nSize);
 
 private:
+	bool isInline() const;
+	void grow(const unsigned long nRequired);
+	void setCapacity(const unsigned long nCapacity);
+	void releaseBuffer();
+	void moveFrom(UUCByteArray& blob);
+	void terminate();
+
 	BYTE* m_pbtContent;
 	unsigned long m_unLen;
 	unsigned long m_nCapacity;
 	char* m_szHex;
+	UUCArena* m_pArena; // arena di provenienza del buffer (NULL = heap)
+	BYTE m_btInline[UUC_INLINE_CAPACITY + 1];
 };
@@ -1,57 +1,142 @@
 
 #include "CertStore.h"
+#include "TrustedList.h"
 #include <stdio.h>
 #include "UUCLogger.h"
+#include "ASN1Exception.h"
+#include "UUCArena.h"
+#include <openssl/sha.h>
 #include <map>
 
 using namespace std;
 
 USE_LOG;
 
-unsigned long getHash(const char* szKey);
+shared_mutex CCertStore::m_storeMutex;
+vector<CCertificate*> CCertStore::m_certificates;
+map<string, CCertificate*> CCertStore::m_bySki;
+map<string, CCertificate*> CCertStore::m_bySubject;
+map<string, CCertificate*> CCertStore::m_byFingerprint;
+map<const CCertificate*, string> CCertStore::m_fingerprints;
+CTrustedListSnapshot* CCertStore::m_pTrustedList = NULL;
+mutex CCertStore::m_trustedListMutex;
+map<string, CCertificate*> CCertStore::m_fromTrustedList;
 
-#ifdef WIN32
+mutex CCertStore::m_cacheMutex;
+map<string, CCertStore::Verification> CCertStore::m_verifications;
+map<const CCertificate*, CCertStore::Chain> CCertStore::m_chains;
+long CCertStore::m_nTTL = CERTSTORE_DEFAULT_TTL;
+atomic<long> CCertStore::m_nHits(0);
+atomic<long> CCertStore::m_nMisses(0);
 
-#else
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#include <dirent.h>
-#include <sys/param.h>
-#endif
+// keyIdentifier della SubjectKeyIdentifier, vuoto se assente
+static string subjectKeyId(CCertificate& certificate)
+{
+    CASN1OctetString subjectKeyIdentifier = certificate.getSubjectKeyIdentifier();
+    if(subjectKeyIdentifier.getLength() == 0)
+        return "";
+
+    // OCTET STRING con il keyIdentifier
+    UUCBufferedReader reader(*subjectKeyIdentifier.getValue());
+    CASN1Object keyIdentifier(reader);
+    const UUCByteArray* pValue = keyIdentifier.getValue();
+    return string((const char*)pValue->getContent(), pValue->getLength());
+}
+
+// keyIdentifier [0] della AuthorityKeyIdentifier, vuoto se assente
+static string authorityKeyId(CCertificate& certificate)
+{
+    try
+    {
+        CASN1OctetString authorityKeyIdentifier = certificate.getAuthorithyKeyIdentifier();
+        if(authorityKeyIdentifier.getLength() == 0)
+            return "";
+
+        UUCBufferedReader reader(*authorityKeyIdentifier.getValue());
+        CASN1Object keyIdentifier(reader);
+        if(keyIdentifier.getTag() != 0x80)
+            return "";
+
+        const UUCByteArray* pValue = keyIdentifier.getValue();
+        return string((const char*)pValue->getContent(), pValue->getLength());
+    }
+    catch(CASN1Exception* ex)
+    {
+        delete ex;
+    }
+    catch(...)
+    {
+    }
+
+    return "";
+}
+
+// SHA-256 del DER
+static string digest(const UUCByteArray& baCert)
+{
+    BYTE pbtHash[SHA256_DIGEST_LENGTH];
+    SHA256(baCert.getContent(), baCert.getLength(), pbtHash);
+    return string((const char*)pbtHash, sizeof(pbtHash));
+}
 
-map<unsigned long, CCertificate*> CCertStore::m_certMap;
+static string digest(CCertificate& certificate)
+{
+    UUCByteArray baCert;
+    certificate.toByteArray(baCert);
+    return digest(baCert);
+}
+
+static string nameKey(CName name)
+{
+    UUCByteArray baName;
+    name.toByteArray(baName);
+    return string((const char*)baName.getContent(), baName.getLength());
+}
 
 
 void CCertStore::AddCertificate(CCertificate& certificate)
 {
     //LOG_DBG((0, "--> CertStore::AddCertificate", ""));
 
-    unsigned long nHash;
+    // i certificati dello store restano fino a CleanUp, oltre l'arena del chiamante
+    UUCHeapScope heap;
 
     try
     {
-        CASN1OctetString subjectKeyIdentifier = certificate.getSubjectKeyIdentifier();
-        
-        if(subjectKeyIdentifier.getLength() > 0)
-        {
-            UUCByteArray* pValue = (UUCByteArray*)subjectKeyIdentifier.getValue();
-            const char* szSki = pValue->toHexString();
-            
-            //LOG_DBG((0, "AddCertificate", "szSki: %s", szSki));
-            
-            nHash = getHash(szSki);
-        }
-        else
+        CCertificate* pCert = new CCertificate(certificate);
+
+        // da qui il certificato viene solo letto, anche da piu' thread
+        pCert->decode();
+
+        string szFingerprint = digest(*pCert);
+        string szSki = subjectKeyId(*pCert);
+        string szSubject = nameKey(pCert->getSubject());
+
+        unique_lock<shared_mutex> lock(m_storeMutex);
+
+        // caricamenti in blocco (trusted list): nessuna scansione dello store
+        if(m_byFingerprint.count(szFingerprint))
         {
-            UUCByteArray baSubject;
-            certificate.getSubject().getNameAsString(baSubject);
-            nHash = getHash((char*)baSubject.getContent());
+            delete pCert;
+            return;
         }
-        
-        CCertificate* pCert = new CCertificate(certificate);
-        
-        m_certMap[nHash] = pCert;
+
+        m_certificates.push_back(pCert);
+        m_byFingerprint[szFingerprint] = pCert;
+        m_fingerprints[pCert] = szFingerprint;
+        if(!szSki.empty())
+            m_bySki[szSki] = pCert;
+        m_bySubject[szSubject] = pCert;
+
+        // un nuovo certificato puo' cambiare le catene gia' costruite
+        lock_guard<mutex> cacheLock(m_cacheMutex);
+        m_verifications.clear();
+        m_chains.clear();
+    }
+    catch(CASN1Exception* ex)
+    {
+        LOG_ERR((0, "CertStore::AddCertificate Exception", ""));
+        delete ex;
     }
     catch(...)
     {
@@ -61,78 +146,253 @@ void CCertStore::AddCertificate(CCertificate& certificate)
     //LOG_DBG((0, "<-- CertStore::AddCertificate", ""));
 }
 
+void CCertStore::SetTrustedList(CTrustedListSnapshot* pSnapshot)
+{
+    unique_lock<shared_mutex> lock(m_storeMutex);
+
+    delete m_pTrustedList;
+    m_pTrustedList = pSnapshot;
+
+    lock_guard<mutex> cacheLock(m_cacheMutex);
+    m_verifications.clear();
+    m_chains.clear();
+}
+
 CCertificate* CCertStore::GetCertificate(CCertificate& certificate)
 {
-    unsigned long nHash;
+    shared_lock<shared_mutex> lock(m_storeMutex);
+    return findIssuer(certificate);
+}
+
+bool CCertStore::VerifySignature(CCertificate& certificate, CCertificate& issuer)
+{
+    shared_lock<shared_mutex> lock(m_storeMutex);
+    return verify(certificate, issuer);
+}
+
+bool CCertStore::BuildChain(CCertificate& certificate, vector<CCertificate*>& chain)
+{
+    shared_lock<shared_mutex> lock(m_storeMutex);
+    return buildChain(certificate, chain, 0);
+}
+
+void CCertStore::SetCacheTTL(long nSeconds)
+{
+    lock_guard<mutex> lock(m_cacheMutex);
+    m_nTTL = nSeconds < 0 ? 0 : nSeconds;
+    m_verifications.clear();
+    m_chains.clear();
+}
+
+void CCertStore::GetStats(long* pnHits, long* pnMisses)
+{
+    *pnHits = m_nHits;
+    *pnMisses = m_nMisses;
+}
+
+void CCertStore::CleanUp()
+{
+    unique_lock<shared_mutex> lock(m_storeMutex);
+
+	for (size_t i = 0; i < m_certificates.size(); i++)
+	{
+		CCertificate* pCert = m_certificates[i];
+		SAFEDELETE(pCert)
+	}
+
+    m_certificates.clear();
+    m_bySki.clear();
+    m_bySubject.clear();
+    m_byFingerprint.clear();
+    m_fingerprints.clear();
 
+    delete m_pTrustedList;
+    m_pTrustedList = NULL;
+
+    // nessuna ricerca in corso: m_storeMutex e' esclusivo
+    for(map<string, CCertificate*>::iterator it = m_fromTrustedList.begin(); it != m_fromTrustedList.end(); ++it)
+        delete it->second;
+    m_fromTrustedList.clear();
+
+    lock_guard<mutex> cacheLock(m_cacheMutex);
+    m_verifications.clear();
+    m_chains.clear();
+}
+
+//////////////////////////////////////////////////////////////////////
+// Con m_storeMutex acquisito
+//////////////////////////////////////////////////////////////////////
+
+CCertificate* CCertStore::findIssuer(CCertificate& certificate)
+{
     try
     {
-        CASN1OctetString autorityKeyIdentifier = certificate.getAuthorithyKeyIdentifier();
-        
-        if(autorityKeyIdentifier.getLength() > 0)
+        CCertificate* pCert = NULL;
+
+        string szAki = authorityKeyId(certificate);
+        if(!szAki.empty())
         {
-            UUCByteArray* pValue = (UUCByteArray*)autorityKeyIdentifier.getValue();
-            pValue->set(0, 0x04);
-            
-            const char* szAki = pValue->toHexString();
-            
-            LOG_DBG((0, "GetCertificate", "szAki: %s", szAki));
-            
-            nHash = getHash(szAki);
+            map<string, CCertificate*>::iterator it = m_bySki.find(szAki);
+            if(it != m_bySki.end())
+                pCert = it->second;
+            else
+                pCert = fromTrustedList(szAki, false);
         }
-        else
+
+        // senza AKI, o CA senza SKI: per DN dell'issuer
+        if(!pCert)
         {
-            UUCByteArray baIssuer;
-            certificate.getIssuer().getNameAsString(baIssuer);
-            nHash = getHash((char*)baIssuer.getContent());
+            string szIssuer = nameKey(certificate.getIssuer());
+            map<string, CCertificate*>::iterator it = m_bySubject.find(szIssuer);
+            if(it != m_bySubject.end())
+                pCert = it->second;
+            else
+                pCert = fromTrustedList(szIssuer, true);
         }
-        
-        CCertificate* pCert = m_certMap[nHash];
+
+        // certificato autofirmato: la catena termina qui
         if(pCert != NULL && pCert->getSerialNumber() == certificate.getSerialNumber())
             return NULL;
-        
+
         return pCert;
     }
+    catch(CASN1Exception* ex)
+    {
+        LOG_ERR((0, "CertStore::GetCertificate Exception", ""));
+        delete ex;
+    }
     catch(...)
     {
-        LOG_ERR((0, "CertStore::AddCertificate Exception", ""));
+        LOG_ERR((0, "CertStore::GetCertificate Exception", ""));
     }
 
     return NULL;
 }
 
-void CCertStore::CleanUp()
+// certificato granted della trusted list con key identifier (o subject DN, bSubject) szKey
+CCertificate* CCertStore::fromTrustedList(const string& szKey, bool bSubject)
 {
-	for (map<unsigned long, CCertificate*>::iterator it = m_certMap.begin(); it != m_certMap.end(); ++it)
-	{
-		CCertificate* pCert = (CCertificate*)it->second;
-		SAFEDELETE(pCert)
-	}
+    if(!m_pTrustedList)
+        return NULL;
+
+    // come AddCertificate: il certificato resta fino a CleanUp
+    UUCHeapScope heap;
+
+    vector<TSL_SERVICE> services;
+    if(bSubject)
+        m_pTrustedList->findSubject(szKey, services);
+    else
+        m_pTrustedList->find(szKey, services);
+
+    for(size_t i = 0; i < services.size(); i++)
+    {
+        if(services[i].nStatus != TSL_STATUS_GRANTED)
+            continue;
+
+        string szFingerprint = digest(services[i].certificate);
+
+        lock_guard<mutex> lock(m_trustedListMutex);
+        map<string, CCertificate*>::iterator it = m_fromTrustedList.find(szFingerprint);
+        if(it != m_fromTrustedList.end())
+            return it->second;
+
+        // decodificato per intero, come i certificati dello store
+        CCertificate* pCert = new CCertificate(services[i].certificate.getContent(), services[i].certificate.getLength());
+        try
+        {
+            pCert->decode();
+        }
+        catch(...)
+        {
+            delete pCert;
+            throw;
+        }
+
+        m_fromTrustedList[szFingerprint] = pCert;
+        return pCert;
+    }
+
+    return NULL;
 }
 
-unsigned long getHash(const char* szKey)
+// precalcolato per i certificati dello store
+string CCertStore::fingerprint(CCertificate& certificate)
 {
-	int h = 0;
-	int off = 0;
-	char* val = (char*)szKey;
-	int len = strlen((char*)szKey);
+    map<const CCertificate*, string>::iterator it = m_fingerprints.find(&certificate);
+    if(it != m_fingerprints.end())
+        return it->second;
 
-	if (len < 16) 
-	{
- 	    for (int i = len ; i > 0; i--) 
-		{
- 			h = (h * 37) + val[off++];
- 	    }
- 	} 
-	else 
-	{
- 	    // only sample some characters
- 	    int skip = len / 8;
- 	    for (int i = len ; i > 0; i -= skip, off += skip) 
-		{
- 			h = (h * 39) + val[off];
- 	    }
- 	}
-
-	return h;	
+    return digest(certificate);
+}
+
+bool CCertStore::verify(CCertificate& certificate, CCertificate& issuer)
+{
+    string szKey = fingerprint(certificate) + fingerprint(issuer);
+    time_t now = time(NULL);
+
+    {
+        lock_guard<mutex> lock(m_cacheMutex);
+        map<string, Verification>::iterator it = m_verifications.find(szKey);
+        if(it != m_verifications.end() && now < it->second.nExpires)
+        {
+            m_nHits++;
+            return it->second.bVerified;
+        }
+    }
+
+    m_nMisses++;
+    bool bVerified = certificate.verifySignature(issuer);
+
+    lock_guard<mutex> lock(m_cacheMutex);
+    if(m_nTTL > 0)
+    {
+        Verification& verification = m_verifications[szKey];
+        verification.bVerified = bVerified;
+        verification.nExpires = now + m_nTTL;
+    }
+
+    return bVerified;
+}
+
+bool CCertStore::buildChain(CCertificate& certificate, vector<CCertificate*>& chain, size_t nDepth)
+{
+    // ciclo tra certificati che si certificano a vicenda
+    if(nDepth > m_certificates.size() + (m_pTrustedList ? m_pTrustedList->size() : 0))
+        return false;
+
+    CCertificate* pIssuer = findIssuer(certificate);
+    if(!pIssuer)
+        return true;
+
+    if(!verify(certificate, *pIssuer))
+        return false;
+
+    chain.push_back(pIssuer);
+
+    // la catena sopra un certificato dello store e' la stessa per tutti i documenti
+    time_t now = time(NULL);
+    {
+        lock_guard<mutex> lock(m_cacheMutex);
+        map<const CCertificate*, Chain>::iterator it = m_chains.find(pIssuer);
+        if(it != m_chains.end() && now < it->second.nExpires)
+        {
+            chain.insert(chain.end(), it->second.certificates.begin(), it->second.certificates.end());
+            return it->second.bComplete;
+        }
+    }
+
+    vector<CCertificate*> issuerChain;
+    bool bComplete = buildChain(*pIssuer, issuerChain, nDepth + 1);
+    chain.insert(chain.end(), issuerChain.begin(), issuerChain.end());
+
+    lock_guard<mutex> lock(m_cacheMutex);
+    if(m_nTTL > 0)
+    {
+        Chain& cached = m_chains[pIssuer];
+        cached.certificates = issuerChain;
+        cached.bComplete = bComplete;
+        cached.nExpires = now + m_nTTL;
+    }
+
+    return bComplete;
 }
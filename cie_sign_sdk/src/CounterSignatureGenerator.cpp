@@ -8,6 +8,7 @@
  */
 
 #include "CounterSignatureGenerator.h"
+#include "SignedDataPatcher.h"
 
 
 CounterSignatureGenerator::CounterSignatureGenerator(CSignedDocument& signedDoc, int signerInfoIndex)
@@ -61,50 +62,19 @@ void CounterSignatureGenerator::toByteArray(UUCByteArray& pkcs7SignedData)
 	CSignerInfo signerInfoCounterSignature(m_signerInfoGenerator.getSignerInfo());
 	
 	CASN1Sequence v;
-	v.addElement(CASN1ObjectIdentifier(szCounterSignatureOID)); // id-aa-timeStampToken
+	v.addElement(CASN1ObjectIdentifier(szCounterSignatureOID)); // id-countersignature
 	CASN1SetOf countersignature;
 	countersignature.addElement(signerInfoCounterSignature);
 	v.addElement(countersignature);
-		
-	CASN1SetOf unauthAttributes;
 	
-	if(m_signerInfo.size() == 7)
-	{
-		unauthAttributes = m_signerInfo.getUnauthenticatedAttributes();
-	}
-
-	unauthAttributes.addElement(v);
-	m_signerInfo.addUnauthenticatedAttributes(unauthAttributes);
-	
-	m_signerInfos.setElementAt(m_signerInfo, m_signerInfoIndex);
+	// il SignedData originale non viene ricostruito: la controfirma e il certificato
+	// vengono inseriti nella codifica esistente riscrivendo solo gli header che li racchiudono
+	UUCByteArray source;
+	m_signedDoc.toByteArray(source);
 	
+	CSignedDataPatcher patcher(source.getContent(), source.getLength());
+	patcher.addUnsignedAttribute(m_signerInfoIndex, v);
 	CCertificate cert(m_signingCertificate);
-	int i = 0;
-	for(i = 0; i < m_certificates.size(); i++)
-	{
-		if(m_certificates.elementAt(i) == cert)
-			break;
-	}
-	
-	if(i == m_certificates.size())
-		m_certificates.addElement(cert);
-	
-	UUCByteArray content;
-	m_signedDoc.getContent(content);
-	
-	// Crea signedData
-	CSignedData signedData(m_digestAlgos,
-						   CContentInfo(CAlgorithmIdentifier(szDataOID), CASN1OctetString(content)),
-						   m_signerInfos,
-						   m_certificates);
-	
-	// Infine crea ContentInfo
-	CContentInfo contentInfo(szSignedDataOID, signedData);
-	
-	contentInfo.toByteArray(pkcs7SignedData);
-	
-
+	patcher.addCertificate(cert);
+	patcher.toByteArray(pkcs7SignedData);
 }
-
-
-
@@ -0,0 +1,255 @@
+/*
+ *  HttpClient.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "HttpClient.h"
+#include "UUCLogger.h"
+#include "curl/curl.h"
+
+#include <mutex>
+#include <string.h>
+#include <strings.h>
+#include <vector>
+
+USE_LOG;
+
+// handle inattivi conservati per le richieste successive
+#define HTTP_MAX_IDLE_HANDLES	32
+// connessioni aperte conservate nello share (il default di curl e' 5)
+#define HTTP_MAX_CONNECTIONS	32
+
+static std::once_flag g_curlInit;
+static std::mutex g_poolMutex;
+static CURLSH* g_pShare = NULL;
+static std::vector<CURL*> g_idleHandles;
+static bool g_bHttp2 = false;
+static std::mutex g_shareLocks[CURL_LOCK_DATA_LAST];
+
+static void LockShare(CURL* /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void* /*userptr*/)
+{
+	g_shareLocks[data].lock();
+}
+
+static void UnlockShare(CURL* /*handle*/, curl_lock_data data, void* /*userptr*/)
+{
+	g_shareLocks[data].unlock();
+}
+
+static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+	UUCByteArray* pData = (UUCByteArray*)userp;
+	size_t realsize = size * nmemb;
+	pData->append((BYTE*)contents, realsize);
+
+	return realsize;
+}
+
+static size_t HeaderCallback(char *buffer, size_t size, size_t nitems, void *userp)
+{
+	CHttpClient::Response* pResponse = (CHttpClient::Response*)userp;
+	size_t realsize = size * nitems;
+
+	std::string szLine(buffer, realsize);
+
+	// nuova risposta (es. dopo un redirect): valgono solo i suoi header
+	if(szLine.compare(0, 5, "HTTP/") == 0)
+	{
+		pResponse->szETag.clear();
+		pResponse->szLastModified.clear();
+	}
+
+	size_t nColon = szLine.find(':');
+	if(nColon != std::string::npos)
+	{
+		std::string szName = szLine.substr(0, nColon);
+		size_t nStart = szLine.find_first_not_of(" \t", nColon + 1);
+		size_t nEnd = szLine.find_last_not_of(" \t\r\n");
+		std::string szValue = (nStart == std::string::npos || nEnd < nStart) ? "" : szLine.substr(nStart, nEnd - nStart + 1);
+
+		if(strcasecmp(szName.c_str(), "ETag") == 0)
+			pResponse->szETag = szValue;
+		else if(strcasecmp(szName.c_str(), "Last-Modified") == 0)
+			pResponse->szLastModified = szValue;
+	}
+
+	return realsize;
+}
+
+static CURL* AcquireHandle(bool* pbHttp2)
+{
+	std::call_once(g_curlInit, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	if(!g_pShare)
+	{
+		g_pShare = curl_share_init();
+		if(g_pShare)
+		{
+			curl_share_setopt(g_pShare, CURLSHOPT_LOCKFUNC, LockShare);
+			curl_share_setopt(g_pShare, CURLSHOPT_UNLOCKFUNC, UnlockShare);
+			curl_share_setopt(g_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+			curl_share_setopt(g_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+			curl_share_setopt(g_pShare, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+		}
+	}
+
+	CURL* ctx;
+	if(!g_idleHandles.empty())
+	{
+		// curl_easy_reset non stacca l'handle dallo share
+		ctx = g_idleHandles.back();
+		g_idleHandles.pop_back();
+	}
+	else
+	{
+		ctx = curl_easy_init();
+		if(ctx && g_pShare)
+			curl_easy_setopt(ctx, CURLOPT_SHARE, g_pShare);
+	}
+
+	*pbHttp2 = g_bHttp2;
+	return ctx;
+}
+
+static void ReleaseHandle(CURL* ctx)
+{
+	// le opzioni si azzerano; connessioni e cache restano
+	curl_easy_reset(ctx);
+
+	{
+		std::lock_guard<std::mutex> lock(g_poolMutex);
+		if(g_idleHandles.size() < HTTP_MAX_IDLE_HANDLES)
+		{
+			g_idleHandles.push_back(ctx);
+			return;
+		}
+	}
+
+	curl_easy_cleanup(ctx);
+}
+
+long CHttpClient::Perform(const Request& request, Response& response)
+{
+	bool bHttp2;
+	CURL* ctx = AcquireHandle(&bHttp2);
+	if(!ctx)
+		return CURLE_FAILED_INIT;
+
+	curl_easy_setopt(ctx, CURLOPT_URL, request.szUrl);
+	curl_easy_setopt(ctx, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(ctx, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(ctx, CURLOPT_MAXCONNECTS, (long)HTTP_MAX_CONNECTIONS);
+	curl_easy_setopt(ctx, CURLOPT_SSL_VERIFYPEER, 0L);
+	if(!request.bVerifyHost)
+		curl_easy_setopt(ctx, CURLOPT_SSL_VERIFYHOST, 0L);
+
+	if(bHttp2)
+	{
+		curl_easy_setopt(ctx, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+		curl_easy_setopt(ctx, CURLOPT_PIPEWAIT, 1L);
+	}
+
+	struct curl_slist *headers = NULL;
+
+	if(request.pData)
+	{
+		curl_easy_setopt(ctx, CURLOPT_POST, 1L);
+		curl_easy_setopt(ctx, CURLOPT_POSTFIELDS, request.pData->getContent());
+		curl_easy_setopt(ctx, CURLOPT_POSTFIELDSIZE, (long)request.pData->getLength());
+
+		// niente "Expect: 100-continue": il corpo parte subito
+		headers = curl_slist_append(headers, "Expect:");
+	}
+	else
+	{
+		curl_easy_setopt(ctx, CURLOPT_HTTPGET, 1L);
+		curl_easy_setopt(ctx, CURLOPT_FOLLOWLOCATION, 1L);
+	}
+
+	std::string szHeader;
+	if(request.szContentType)
+	{
+		szHeader = std::string("Content-Type: ") + request.szContentType;
+		headers = curl_slist_append(headers, szHeader.c_str());
+	}
+
+	if(request.szETag && request.szETag[0])
+	{
+		szHeader = std::string("If-None-Match: ") + request.szETag;
+		headers = curl_slist_append(headers, szHeader.c_str());
+	}
+
+	if(request.szLastModified && request.szLastModified[0])
+	{
+		szHeader = std::string("If-Modified-Since: ") + request.szLastModified;
+		headers = curl_slist_append(headers, szHeader.c_str());
+	}
+
+	if(headers)
+		curl_easy_setopt(ctx, CURLOPT_HTTPHEADER, headers);
+
+	if(request.szUsername && request.szUsername[0])
+	{
+		curl_easy_setopt(ctx, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+		curl_easy_setopt(ctx, CURLOPT_USERNAME, request.szUsername);
+		curl_easy_setopt(ctx, CURLOPT_PASSWORD, request.szPassword ? request.szPassword : "");
+	}
+
+	if(request.szProxy)
+	{
+		curl_easy_setopt(ctx, CURLOPT_PROXY, request.szProxy);
+		curl_easy_setopt(ctx, CURLOPT_PROXYTYPE, CURLPROXY_HTTP);
+
+		if(request.nProxyPort != 0)
+			curl_easy_setopt(ctx, CURLOPT_PROXYPORT, request.nProxyPort);
+
+		if(request.szProxyUsrPass)
+			curl_easy_setopt(ctx, CURLOPT_PROXYUSERPWD, request.szProxyUsrPass);
+	}
+
+	if(request.nTimeout > 0)
+		curl_easy_setopt(ctx, CURLOPT_TIMEOUT, request.nTimeout);
+
+	response.nHttpCode = 0;
+	response.szETag.clear();
+	response.szLastModified.clear();
+	curl_easy_setopt(ctx, CURLOPT_WRITEFUNCTION, WriteCallback);
+	curl_easy_setopt(ctx, CURLOPT_WRITEDATA, (void *)&response.body);
+	curl_easy_setopt(ctx, CURLOPT_HEADERFUNCTION, HeaderCallback);
+	curl_easy_setopt(ctx, CURLOPT_HEADERDATA, (void *)&response);
+
+	CURLcode ret = curl_easy_perform(ctx);
+	if(ret == CURLE_OK)
+		curl_easy_getinfo(ctx, CURLINFO_RESPONSE_CODE, &response.nHttpCode);
+	else
+		LOG_ERR((0, "CHttpClient::Perform", "%s: %s", request.szUrl, curl_easy_strerror(ret)));
+
+	ReleaseHandle(ctx);
+
+	if(headers)
+		curl_slist_free_all(headers);
+
+	return ret;
+}
+
+void CHttpClient::SetHttp2(bool bEnable)
+{
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+	g_bHttp2 = bEnable;
+}
+
+void CHttpClient::CleanUp()
+{
+	std::lock_guard<std::mutex> lock(g_poolMutex);
+
+	for(size_t i = 0; i < g_idleHandles.size(); i++)
+		curl_easy_cleanup(g_idleHandles[i]);
+	g_idleHandles.clear();
+
+	// con richieste in corso lo share handle resta in uso e si libera alla prossima chiamata
+	if(g_pShare && curl_share_cleanup(g_pShare) == CURLSHE_OK)
+		g_pShare = NULL;
+}
@@ -0,0 +1,338 @@
+/*
+ *  PdfPreflight.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "PdfPreflight.h"
+#include "PdfSyntax.h"
+#include "disigonsdk.h"
+
+#include <stdlib.h>
+#include <algorithm>
+
+namespace
+{
+	typedef CPdfSyntax::Dictionary Dictionary;
+
+	const char szHeader[] = "%PDF-";
+
+	void appendUtf8(std::string& out, uint32_t nCodePoint)
+	{
+		if(nCodePoint < 0x80)
+		{
+			out += (char)nCodePoint;
+		}
+		else if(nCodePoint < 0x800)
+		{
+			out += (char)(0xC0 | (nCodePoint >> 6));
+			out += (char)(0x80 | (nCodePoint & 0x3F));
+		}
+		else if(nCodePoint < 0x10000)
+		{
+			out += (char)(0xE0 | (nCodePoint >> 12));
+			out += (char)(0x80 | ((nCodePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (nCodePoint & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (nCodePoint >> 18));
+			out += (char)(0x80 | ((nCodePoint >> 12) & 0x3F));
+			out += (char)(0x80 | ((nCodePoint >> 6) & 0x3F));
+			out += (char)(0x80 | (nCodePoint & 0x3F));
+		}
+	}
+
+	int hexDigit(char c)
+	{
+		if(c >= '0' && c <= '9')
+			return c - '0';
+		if(c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		if(c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+		return -1;
+	}
+
+	// byte di una stringa letterale (...) o esadecimale <...>
+	bool stringBytes(const std::string& token, std::string& bytes)
+	{
+		bytes.clear();
+		if(token.size() < 2)
+			return false;
+		size_t nEnd = token.size() - 1;
+		if(token[0] == '(' && token[nEnd] == ')')
+		{
+			for(size_t i = 1; i < nEnd; i++)
+			{
+				char c = token[i];
+				if(c != '\\')
+				{
+					bytes += c;
+					continue;
+				}
+				if(++i >= nEnd)
+					break;
+				c = token[i];
+				switch(c)
+				{
+				case 'n': bytes += '\n'; break;
+				case 'r': bytes += '\r'; break;
+				case 't': bytes += '\t'; break;
+				case 'b': bytes += '\b'; break;
+				case 'f': bytes += '\f'; break;
+				// fine riga preceduto da \: la stringa continua alla riga successiva
+				case '\r':
+					if(i + 1 < nEnd && token[i + 1] == '\n')
+						i++;
+					break;
+				case '\n':
+					break;
+				default:
+					if(c >= '0' && c <= '7')
+					{
+						int nValue = c - '0';
+						for(int k = 0; k < 2 && i + 1 < nEnd && token[i + 1] >= '0' && token[i + 1] <= '7'; k++)
+							nValue = nValue * 8 + (token[++i] - '0');
+						bytes += (char)(nValue & 0xFF);
+					}
+					else
+					{
+						bytes += c;
+					}
+					break;
+				}
+			}
+			return true;
+		}
+		if(token[0] == '<' && token[nEnd] == '>')
+		{
+			int nHigh = -1;
+			for(size_t i = 1; i < nEnd; i++)
+			{
+				int nDigit = hexDigit(token[i]);
+				if(nDigit < 0)
+					continue;
+				if(nHigh < 0)
+				{
+					nHigh = nDigit;
+				}
+				else
+				{
+					bytes += (char)(nHigh << 4 | nDigit);
+					nHigh = -1;
+				}
+			}
+			if(nHigh >= 0)
+				bytes += (char)(nHigh << 4);
+			return true;
+		}
+		return false;
+	}
+
+	// stringa di testo (ISO 32000-2, 7.9.2.2) in UTF-8: UTF-16BE o UTF-8 con BOM,
+	// altrimenti PDFDocEncoding, letto come Latin-1
+	std::string textString(const std::string& token)
+	{
+		std::string bytes;
+		if(!stringBytes(token, bytes))
+			return std::string();
+
+		std::string text;
+		if(bytes.size() >= 2 && (BYTE)bytes[0] == 0xFE && (BYTE)bytes[1] == 0xFF)
+		{
+			for(size_t i = 2; i + 1 < bytes.size(); i += 2)
+			{
+				uint32_t nUnit = ((BYTE)bytes[i] << 8) | (BYTE)bytes[i + 1];
+				if(nUnit >= 0xD800 && nUnit < 0xDC00 && i + 3 < bytes.size())
+				{
+					uint32_t nLow = ((BYTE)bytes[i + 2] << 8) | (BYTE)bytes[i + 3];
+					if(nLow >= 0xDC00 && nLow < 0xE000)
+					{
+						nUnit = 0x10000 + ((nUnit - 0xD800) << 10) + (nLow - 0xDC00);
+						i += 2;
+					}
+				}
+				appendUtf8(text, nUnit);
+			}
+		}
+		else if(bytes.size() >= 3 && (BYTE)bytes[0] == 0xEF && (BYTE)bytes[1] == 0xBB && (BYTE)bytes[2] == 0xBF)
+		{
+			text = bytes.substr(3);
+		}
+		else
+		{
+			for(size_t i = 0; i < bytes.size(); i++)
+				appendUtf8(text, (BYTE)bytes[i]);
+		}
+		return text;
+	}
+}
+
+CPdfPreflight::CPdfPreflight()
+: m_nRevision(0), m_bEncrypted(false), m_bRebuild(false), m_nDocMdp(0), m_bFormRead(false), m_nRevisions(0), m_nObjects(0)
+{
+}
+
+CPdfPreflight::~CPdfPreflight()
+{
+}
+
+long CPdfPreflight::check(const BYTE* pbtData, size_t nLength)
+{
+	m_nRevision = 0;
+	m_bEncrypted = false;
+	m_bRebuild = false;
+	m_nDocMdp = 0;
+	m_bFormRead = false;
+	m_nRevisions = 0;
+	m_nObjects = 0;
+	m_fields.clear();
+	m_visited.clear();
+
+	if(!pbtData || nLength == 0)
+		return DISIGON_ERROR_INVALID_FILE;
+	// l'intestazione puo' essere preceduta da altri byte, entro i primi 1024
+	const BYTE* pbtHeaderEnd = pbtData + std::min<size_t>(nLength, 1024);
+	if(std::search(pbtData, pbtHeaderEnd, szHeader, szHeader + sizeof(szHeader) - 1) == pbtHeaderEnd)
+		return DISIGON_ERROR_INVALID_FILE;
+
+	// solo xref e trailer: gli aggiornamenti non vanno classificati
+	if(m_map.scan(pbtData, nLength, false) != 0)
+	{
+		m_bRebuild = true;
+		return 0;
+	}
+	m_nRevisions = m_map.count();
+	m_nRevision = m_nRevisions - 1;
+
+	// un startxref dopo l'ultima revisione leggibile e' un aggiornamento danneggiato
+	const BYTE* pbtTail = pbtData + m_map.revision(m_nRevision).nEnd;
+	const BYTE* pbtEnd = pbtData + nLength;
+	m_bRebuild = m_map.brokenOffsets(m_nRevision, &m_nObjects) > 0 ||
+		std::search(pbtTail, pbtEnd, CPdfSyntax::szStartXref, CPdfSyntax::szStartXref + sizeof(CPdfSyntax::szStartXref) - 1) != pbtEnd;
+
+	Dictionary trailer, catalog;
+	if(!CPdfRevisionMap::dictionary(m_map.trailer(m_nRevision), trailer) || !resolve(CPdfSyntax::valueOf(trailer, "Root"), catalog))
+	{
+		m_bRebuild = true;
+		return 0;
+	}
+
+	// stringhe e stream di un documento cifrato non si leggono senza la chiave
+	m_bEncrypted = trailer.count("Encrypt") > 0;
+	if(m_bEncrypted)
+		return 0;
+
+	readDocMdp(catalog);
+	m_bFormRead = true;
+
+	Dictionary acroForm;
+	std::vector<std::string> fields;
+	if(resolve(CPdfSyntax::valueOf(catalog, "AcroForm"), acroForm) && CPdfRevisionMap::array(resolve(CPdfSyntax::valueOf(acroForm, "Fields")), fields))
+	{
+		for(size_t i = 0; i < fields.size(); i++)
+			addField(fields[i], std::string(), false, 0);
+	}
+	m_visited.clear();
+	return 0;
+}
+
+const PdfPreflightField* CPdfPreflight::find(const std::string& name) const
+{
+	for(size_t i = 0; i < m_fields.size(); i++)
+	{
+		if(m_fields[i].name == name)
+			return &m_fields[i];
+	}
+	for(size_t i = 0; i < m_fields.size(); i++)
+	{
+		if(m_fields[i].partialName == name)
+			return &m_fields[i];
+	}
+	return NULL;
+}
+
+std::string CPdfPreflight::resolve(const std::string& value) const
+{
+	uint32_t nNumber;
+	if(!CPdfRevisionMap::reference(value, nNumber))
+		return value;
+	std::string text;
+	return m_map.object(nNumber, m_nRevision, text) ? text : std::string();
+}
+
+bool CPdfPreflight::resolve(const std::string& value, std::map<std::string, std::string>& dict) const
+{
+	return !value.empty() && CPdfRevisionMap::dictionary(resolve(value), dict);
+}
+
+void CPdfPreflight::readDocMdp(const std::map<std::string, std::string>& catalog)
+{
+	// /Perms /DocMDP: firma con un /Reference /TransformMethod /DocMDP
+	Dictionary perms, signature;
+	if(!resolve(CPdfSyntax::valueOf(catalog, "Perms"), perms) || !resolve(CPdfSyntax::valueOf(perms, "DocMDP"), signature))
+		return;
+	m_nDocMdp = 2;
+	std::vector<std::string> references;
+	if(!CPdfRevisionMap::array(resolve(CPdfSyntax::valueOf(signature, "Reference")), references))
+		return;
+	for(size_t i = 0; i < references.size(); i++)
+	{
+		Dictionary reference, params;
+		if(!resolve(references[i], reference) || CPdfSyntax::valueOf(reference, "TransformMethod") != "/DocMDP")
+			continue;
+		if(resolve(CPdfSyntax::valueOf(reference, "TransformParams"), params))
+		{
+			long nPermissions = strtol(resolve(CPdfSyntax::valueOf(params, "P")).c_str(), NULL, 10);
+			if(nPermissions >= 1 && nPermissions <= 3)
+				m_nDocMdp = (int)nPermissions;
+		}
+		break;
+	}
+}
+
+void CPdfPreflight::addField(const std::string& value, const std::string& parentName, bool bInheritedSig, int nDepth)
+{
+	uint32_t nNumber;
+	if(nDepth > PDF_PREFLIGHT_MAX_DEPTH || (CPdfRevisionMap::reference(value, nNumber) && !m_visited.insert(nNumber).second))
+		return;
+	Dictionary dict;
+	if(!resolve(value, dict))
+		return;
+
+	PdfPreflightField field;
+	field.partialName = textString(CPdfSyntax::valueOf(dict, "T"));
+	field.name = parentName.empty() ? field.partialName :
+		field.partialName.empty() ? parentName : parentName + "." + field.partialName;
+	// /FT e' ereditabile
+	std::string fieldType = CPdfSyntax::valueOf(dict, "FT");
+	bool bSig = fieldType.empty() ? bInheritedSig : fieldType == "/Sig";
+
+	// i figli con /T sono campi, gli altri sono i widget del campo
+	Dictionary signature;
+	field.bSigned = resolve(CPdfSyntax::valueOf(dict, "V"), signature);
+	bool bChildFields = false;
+	std::vector<std::string> kids;
+	if(CPdfRevisionMap::array(resolve(CPdfSyntax::valueOf(dict, "Kids")), kids))
+	{
+		for(size_t i = 0; i < kids.size(); i++)
+		{
+			Dictionary kid;
+			if(!resolve(kids[i], kid))
+				continue;
+			if(kid.count("T"))
+			{
+				bChildFields = true;
+				addField(kids[i], field.name, bSig, nDepth + 1);
+			}
+			else if(!field.bSigned)
+			{
+				// alcuni generatori scrivono /V nel widget invece che nel campo
+				field.bSigned = resolve(CPdfSyntax::valueOf(kid, "V"), signature);
+			}
+		}
+	}
+	if(!bChildFields && bSig)
+		m_fields.push_back(field);
+}
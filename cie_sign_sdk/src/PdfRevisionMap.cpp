@@ -0,0 +1,1093 @@
+/*
+ *  PdfRevisionMap.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "PdfRevisionMap.h"
+#include "PdfSyntax.h"
+#include "disigonsdk.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <set>
+
+namespace
+{
+	typedef CPdfSyntax::Dictionary Dictionary;
+
+	// livelli di dizionari e array letti al massimo in un valore
+	const int nMaxDepth = 64;
+
+	const char szEndStream[] = "endstream";
+
+	// sottotipi di annotazione diversi da /Widget (ISO 32000-2, 12.5.6)
+	const char* const annotationSubtypes[] = {
+		"Text", "Link", "FreeText", "Line", "Square", "Circle", "Polygon", "PolyLine",
+		"Highlight", "Underline", "Squiggly", "StrikeOut", "Caret", "Stamp", "Ink", "Popup",
+		"FileAttachment", "Sound", "Movie", "Screen", "PrinterMark", "TrapNet", "Watermark",
+		"3D", "Redact", "Projection", "RichMedia"
+	};
+
+	bool isWhite(BYTE c)
+	{
+		return c == 0 || c == '\t' || c == '\n' || c == '\f' || c == '\r' || c == ' ';
+	}
+
+	bool isDelimiter(BYTE c)
+	{
+		return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+			c == '{' || c == '}' || c == '/' || c == '%';
+	}
+
+	bool isRegular(BYTE c)
+	{
+		return !isWhite(c) && !isDelimiter(c);
+	}
+
+	bool isDigits(const BYTE* pbtToken, size_t nLen)
+	{
+		for(size_t i = 0; i < nLen; i++)
+		{
+			if(pbtToken[i] < '0' || pbtToken[i] > '9')
+				return false;
+		}
+		return nLen > 0;
+	}
+
+	// token PDF letti a partire da una posizione del buffer
+	class CPdfLexer
+	{
+	public:
+		CPdfLexer(const BYTE* pbtData, size_t nLength, size_t nPos = 0)
+		: m_pbtData(pbtData), m_nLength(nLength), m_nPos(nPos < nLength ? nPos : nLength)
+		{
+		}
+
+		size_t pos() const { return m_nPos; }
+
+		bool eof()
+		{
+			skipWhite();
+			return m_nPos >= m_nLength;
+		}
+
+		void skipWhite()
+		{
+			while(m_nPos < m_nLength)
+			{
+				if(isWhite(m_pbtData[m_nPos]))
+				{
+					m_nPos++;
+				}
+				else if(m_pbtData[m_nPos] == '%')
+				{
+					while(m_nPos < m_nLength && m_pbtData[m_nPos] != '\r' && m_pbtData[m_nPos] != '\n')
+						m_nPos++;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+
+		bool keyword(const char* szKeyword)
+		{
+			skipWhite();
+			size_t nLen = strlen(szKeyword);
+			if(m_nLength - m_nPos < nLen || memcmp(m_pbtData + m_nPos, szKeyword, nLen) != 0)
+				return false;
+			if(isRegular((BYTE)szKeyword[nLen - 1]) && m_nPos + nLen < m_nLength && isRegular(m_pbtData[m_nPos + nLen]))
+				return false;
+			m_nPos += nLen;
+			return true;
+		}
+
+		bool integer(int64_t& nValue)
+		{
+			skipWhite();
+			size_t nPos = m_nPos;
+			bool bNegative = false;
+			if(nPos < m_nLength && (m_pbtData[nPos] == '+' || m_pbtData[nPos] == '-'))
+				bNegative = m_pbtData[nPos++] == '-';
+			size_t nDigits = nPos;
+			uint64_t nAbs = 0;
+			while(nPos < m_nLength && m_pbtData[nPos] >= '0' && m_pbtData[nPos] <= '9')
+			{
+				if(nAbs > (uint64_t)INT64_MAX / 10)
+					return false;
+				nAbs = nAbs * 10 + (m_pbtData[nPos++] - '0');
+			}
+			// i numeri reali non sono interi
+			if(nPos == nDigits || nAbs > (uint64_t)INT64_MAX || (nPos < m_nLength && isRegular(m_pbtData[nPos])))
+				return false;
+			m_nPos = nPos;
+			nValue = bNegative ? -(int64_t)nAbs : (int64_t)nAbs;
+			return true;
+		}
+
+		// un valore completo, riferimenti N G R compresi; in pCanonical i suoi token separati
+		// da uno spazio, per confrontare due versioni dello stesso oggetto
+		bool value(std::string* pCanonical)
+		{
+			if(pCanonical)
+				pCanonical->clear();
+			int nLevel = 0;
+			bool bFirst = true;
+			bool bNumber = false;
+			do
+			{
+				size_t nStart;
+				if(!token(nStart))
+					return false;
+				const BYTE* pbtToken = m_pbtData + nStart;
+				size_t nLen = m_nPos - nStart;
+				if(pbtToken[0] == '[' || (nLen == 2 && pbtToken[0] == '<' && pbtToken[1] == '<'))
+					nLevel++;
+				else if(pbtToken[0] == ']' || (nLen == 2 && pbtToken[0] == '>' && pbtToken[1] == '>'))
+					nLevel--;
+				if(nLevel < 0 || nLevel > nMaxDepth)
+					return false;
+				if(pCanonical)
+				{
+					if(!bFirst)
+						pCanonical->push_back(' ');
+					pCanonical->append((const char*)pbtToken, nLen);
+				}
+				bNumber = bFirst && isDigits(pbtToken, nLen);
+				bFirst = false;
+			}
+			while(nLevel > 0);
+
+			if(bNumber)
+			{
+				size_t nPos = m_nPos;
+				int64_t nGeneration;
+				if(integer(nGeneration) && nGeneration >= 0 && keyword("R"))
+				{
+					if(pCanonical)
+						*pCanonical += " " + std::to_string(nGeneration) + " R";
+				}
+				else
+				{
+					m_nPos = nPos;
+				}
+			}
+			return true;
+		}
+
+		bool array(std::vector<std::string>& items)
+		{
+			items.clear();
+			if(!keyword("["))
+				return false;
+			for(;;)
+			{
+				if(keyword("]"))
+					return true;
+				items.push_back(std::string());
+				if(!value(&items.back()))
+					return false;
+			}
+		}
+
+		// coppie nome / valore; i valori sono in forma canonica
+		bool dictionary(Dictionary& dict)
+		{
+			dict.clear();
+			if(!keyword("<<"))
+				return false;
+			for(;;)
+			{
+				if(keyword(">>"))
+					return true;
+				if(m_nPos >= m_nLength || m_pbtData[m_nPos] != '/')
+					return false;
+				size_t nStart = ++m_nPos;
+				while(m_nPos < m_nLength && isRegular(m_pbtData[m_nPos]))
+					m_nPos++;
+				std::string key((const char*)m_pbtData + nStart, m_nPos - nStart);
+				if(!value(&dict[key]))
+					return false;
+			}
+		}
+
+	private:
+		bool token(size_t& nStart)
+		{
+			skipWhite();
+			nStart = m_nPos;
+			if(m_nPos >= m_nLength)
+				return false;
+			BYTE c = m_pbtData[m_nPos];
+			BYTE next = m_nPos + 1 < m_nLength ? m_pbtData[m_nPos + 1] : 0;
+			if((c == '<' && next == '<') || (c == '>' && next == '>'))
+			{
+				m_nPos += 2;
+				return true;
+			}
+			if(c == '[' || c == ']')
+			{
+				m_nPos++;
+				return true;
+			}
+			if(c == '(')
+			{
+				// stringa letterale, con parentesi bilanciate e caratteri di escape
+				int nLevel = 0;
+				while(m_nPos < m_nLength)
+				{
+					BYTE b = m_pbtData[m_nPos++];
+					if(b == '\\')
+					{
+						if(m_nPos < m_nLength)
+							m_nPos++;
+					}
+					else if(b == '(')
+					{
+						nLevel++;
+					}
+					else if(b == ')' && --nLevel == 0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+			if(c == '<')
+			{
+				const void* pEnd = memchr(m_pbtData + m_nPos, '>', m_nLength - m_nPos);
+				if(!pEnd)
+					return false;
+				m_nPos = (const BYTE*)pEnd - m_pbtData + 1;
+				return true;
+			}
+			if(c == '/')
+			{
+				m_nPos++;
+				while(m_nPos < m_nLength && isRegular(m_pbtData[m_nPos]))
+					m_nPos++;
+				return true;
+			}
+			if(!isRegular(c))
+				return false;
+			while(m_nPos < m_nLength && isRegular(m_pbtData[m_nPos]))
+				m_nPos++;
+			return true;
+		}
+
+		const BYTE* m_pbtData;
+		size_t m_nLength;
+		size_t m_nPos;
+	};
+
+	CPdfLexer lexerOf(const std::string& text)
+	{
+		return CPdfLexer((const BYTE*)text.data(), text.size());
+	}
+
+	bool parseDictionary(const std::string& text, Dictionary& dict)
+	{
+		CPdfLexer lexer = lexerOf(text);
+		return lexer.dictionary(dict);
+	}
+
+	bool integerOf(const Dictionary& dict, const char* szKey, int64_t& nValue)
+	{
+		std::string value = CPdfSyntax::valueOf(dict, szKey);
+		CPdfLexer lexer = lexerOf(value);
+		return lexer.integer(nValue) && lexer.eof();
+	}
+
+	bool referenceOf(const std::string& value, uint32_t& nNumber)
+	{
+		CPdfLexer lexer = lexerOf(value);
+		int64_t n, g;
+		if(!lexer.integer(n) || !lexer.integer(g) || !lexer.keyword("R") || !lexer.eof() || n <= 0 || n > UINT32_MAX)
+			return false;
+		nNumber = (uint32_t)n;
+		return true;
+	}
+
+	bool integers(const std::string& value, std::vector<int64_t>& values)
+	{
+		values.clear();
+		CPdfLexer lexer = lexerOf(value);
+		if(!lexer.keyword("["))
+			return false;
+		for(;;)
+		{
+			if(lexer.keyword("]"))
+				return lexer.eof();
+			int64_t n;
+			if(!lexer.integer(n))
+				return false;
+			values.push_back(n);
+		}
+	}
+
+	// array di soli riferimenti (o voce assente); false per ogni altro valore
+	bool references(const std::string& value, std::set<uint32_t>& numbers)
+	{
+		numbers.clear();
+		if(value.empty())
+			return true;
+		CPdfLexer lexer = lexerOf(value);
+		if(!lexer.keyword("["))
+			return false;
+		for(;;)
+		{
+			if(lexer.keyword("]"))
+				return lexer.eof();
+			int64_t n, g;
+			if(!lexer.integer(n) || !lexer.integer(g) || !lexer.keyword("R") || n <= 0 || n > UINT32_MAX)
+				return false;
+			numbers.insert((uint32_t)n);
+		}
+	}
+
+	// true se un riferimento di oldValue manca in newValue; false se i valori sono
+	// array di riferimenti e newValue ne ha solo aggiunti
+	bool removesReferences(const std::string& newValue, const std::string& oldValue)
+	{
+		if(newValue == oldValue)
+			return false;
+		std::set<uint32_t> newNumbers, oldNumbers;
+		if(!references(newValue, newNumbers) || !references(oldValue, oldNumbers))
+			return true;
+		return !std::includes(newNumbers.begin(), newNumbers.end(), oldNumbers.begin(), oldNumbers.end());
+	}
+
+	// predittori PNG (ISO 32000-2, 7.4.4.4)
+	bool unpredict(std::string& data, int64_t nPredictor, int64_t nColumns, int64_t nColors, int64_t nBits)
+	{
+		if(nPredictor <= 1)
+			return true;
+		if(nPredictor < 10 || nColumns <= 0 || nColors <= 0 || nColors > 32 || nBits <= 0 || nBits > 16 ||
+			nColumns > PDF_REVISION_MAX_STREAM)
+			return false;
+
+		size_t nPixel = (size_t)std::max<int64_t>(1, nColors * nBits / 8);
+		size_t nRow = (size_t)((nColumns * nColors * nBits + 7) / 8);
+		std::string out;
+		out.reserve(data.size());
+		std::string previous(nRow, '\0');
+		// ogni riga inizia con il tipo di predittore
+		for(size_t nPos = 0; nPos < data.size(); nPos += nRow + 1)
+		{
+			if(data.size() - nPos < nRow + 1)
+				return false;
+			BYTE nType = (BYTE)data[nPos];
+			std::string row = data.substr(nPos + 1, nRow);
+			for(size_t i = 0; i < nRow; i++)
+			{
+				int a = i >= nPixel ? (BYTE)row[i - nPixel] : 0;
+				int b = (BYTE)previous[i];
+				int c = i >= nPixel ? (BYTE)previous[i - nPixel] : 0;
+				int x = (BYTE)row[i];
+				switch(nType)
+				{
+				case 0:
+					break;
+				case 1:
+					x += a;
+					break;
+				case 2:
+					x += b;
+					break;
+				case 3:
+					x += (a + b) / 2;
+					break;
+				case 4:
+				{
+					int p = a + b - c;
+					int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+					x += pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+					break;
+				}
+				default:
+					return false;
+				}
+				row[i] = (char)(x & 0xFF);
+			}
+			out += row;
+			previous.swap(row);
+		}
+		data.swap(out);
+		return true;
+	}
+
+	bool isAnnotation(const std::string& subtype)
+	{
+		for(size_t i = 0; i < sizeof(annotationSubtypes) / sizeof(annotationSubtypes[0]); i++)
+		{
+			if(subtype == annotationSubtypes[i])
+				return true;
+		}
+		return false;
+	}
+
+	// PDF_UPDATE_* di un oggetto firma, campo o annotazione; 0 per gli altri oggetti
+	int objectKind(const Dictionary& dict)
+	{
+		std::string type = CPdfSyntax::nameOf(dict, "Type");
+		std::string subtype = CPdfSyntax::nameOf(dict, "Subtype");
+		if(type == "Sig" || type == "DocTimeStamp" || CPdfSyntax::nameOf(dict, "FT") == "Sig" ||
+			(dict.count("ByteRange") && dict.count("Contents")))
+			return PDF_UPDATE_SIGNATURE;
+		if(subtype == "Widget" || dict.count("FT") || (dict.count("T") && (dict.count("Kids") || dict.count("Parent"))))
+			return PDF_UPDATE_FORM_FILL;
+		if((type.empty() || type == "Annot") && isAnnotation(subtype))
+			return PDF_UPDATE_ANNOTATION;
+		return 0;
+	}
+
+	// dizionari dei dati di validazione (DSS e VRI, ISO 32000-2, 12.8.4.3)
+	bool isValidationData(const Dictionary& dict)
+	{
+		std::string type = CPdfSyntax::nameOf(dict, "Type");
+		if(type == "DSS" || type == "VRI")
+			return true;
+		if(dict.empty())
+			return false;
+		bool bDss = true;
+		bool bVri = true;
+		for(Dictionary::const_iterator it = dict.begin(); it != dict.end(); ++it)
+		{
+			const std::string& key = it->first;
+			bDss = bDss && (key == "Type" || key == "Certs" || key == "OCSPs" || key == "CRLs" || key == "VRI");
+			// le chiavi di /VRI sono hash SHA-1 in esadecimale
+			bVri = bVri && key.size() == 40 && key.find_first_not_of("0123456789ABCDEFabcdef") == std::string::npos;
+		}
+		return bDss || bVri;
+	}
+
+	// modifiche al dizionario /AcroForm
+	int formChanges(Dictionary newDict, Dictionary oldDict)
+	{
+		int nChanges = 0;
+		if(removesReferences(CPdfSyntax::valueOf(newDict, "Fields"), CPdfSyntax::valueOf(oldDict, "Fields")))
+			nChanges |= PDF_UPDATE_FORM_FILL;
+		// /DR e /DA cambiano con le risorse degli aspetti dei campi compilati o firmati
+		const char* const keys[] = { "Fields", "SigFlags", "DR", "DA", "NeedAppearances" };
+		for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		{
+			newDict.erase(keys[i]);
+			oldDict.erase(keys[i]);
+		}
+		if(newDict != oldDict)
+			nChanges |= PDF_UPDATE_CONTENT;
+		return nChanges;
+	}
+
+	int catalogChanges(Dictionary newDict, Dictionary oldDict)
+	{
+		int nChanges = 0;
+		std::string newForm = CPdfSyntax::valueOf(newDict, "AcroForm");
+		std::string oldForm = CPdfSyntax::valueOf(oldDict, "AcroForm");
+		// un /AcroForm indiretto e' classificato come oggetto a se'
+		uint32_t nForm;
+		if(newForm != oldForm && !referenceOf(newForm, nForm))
+		{
+			Dictionary newFormDict, oldFormDict;
+			if(parseDictionary(newForm, newFormDict) && (oldForm.empty() || parseDictionary(oldForm, oldFormDict)))
+				nChanges |= formChanges(newFormDict, oldFormDict);
+			else
+				nChanges |= PDF_UPDATE_CONTENT;
+		}
+		if(CPdfSyntax::valueOf(newDict, "Perms") != CPdfSyntax::valueOf(oldDict, "Perms"))
+			nChanges |= PDF_UPDATE_SIGNATURE;
+		const char* const keys[] = { "AcroForm", "Perms", "DSS", "Extensions", "Metadata" };
+		for(size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++)
+		{
+			newDict.erase(keys[i]);
+			oldDict.erase(keys[i]);
+		}
+		if(newDict != oldDict)
+			nChanges |= PDF_UPDATE_CONTENT;
+		return nChanges;
+	}
+
+	int pageChanges(Dictionary newDict, Dictionary oldDict)
+	{
+		std::string newAnnots = CPdfSyntax::valueOf(newDict, "Annots");
+		std::string oldAnnots = CPdfSyntax::valueOf(oldDict, "Annots");
+		newDict.erase("Annots");
+		oldDict.erase("Annots");
+		if(newDict != oldDict)
+			return PDF_UPDATE_CONTENT;
+		// le annotazioni aggiunte sono classificate come oggetti nuovi
+		return removesReferences(newAnnots, oldAnnots) ? PDF_UPDATE_ANNOTATION : 0;
+	}
+}
+
+CPdfRevisionMap::CPdfRevisionMap()
+: m_pbtData(NULL), m_nLength(0)
+{
+}
+
+CPdfRevisionMap::~CPdfRevisionMap()
+{
+}
+
+long CPdfRevisionMap::scan(const BYTE* pbtData, size_t nLength, bool bClassify)
+{
+	m_pbtData = pbtData;
+	m_nLength = nLength;
+	m_revisions.clear();
+	m_objectStreams.clear();
+	if(!pbtData || nLength == 0)
+		return DISIGON_ERROR_INVALID_FILE;
+
+	// nei file linearizzati la revisione 0 ha due sezioni xref: quella della prima
+	// pagina, in testa al file, e quella principale
+	size_t nLinearizedLength = 0;
+	size_t nLinearizedXref = linearizedXref(&nLinearizedLength);
+
+	const BYTE* pbtEnd = pbtData + nLength;
+	const BYTE* pbtPattern = (const BYTE*)CPdfSyntax::szStartXref;
+	std::boyer_moore_horspool_searcher<const BYTE*> searcher(pbtPattern, pbtPattern + sizeof(CPdfSyntax::szStartXref) - 1);
+	for(const BYTE* pbtFound = std::search(pbtData, pbtEnd, searcher); pbtFound != pbtEnd;
+		pbtFound = std::search(pbtFound + 1, pbtEnd, searcher))
+	{
+		CPdfLexer lexer(pbtData, nLength, pbtFound - pbtData + sizeof(CPdfSyntax::szStartXref) - 1);
+		int64_t nXref;
+		if(!lexer.integer(nXref) || nXref < 0 || (uint64_t)nXref >= nLength)
+			continue;
+
+		// %%EOF e' un commento: si cerca senza il lexer
+		size_t nEof = lexer.pos();
+		while(nEof < nLength && isWhite(pbtData[nEof]))
+			nEof++;
+		if(nLength - nEof < 5 || memcmp(pbtData + nEof, "%%EOF", 5) != 0)
+			continue;
+		nEof += 5;
+		size_t nEnd = nEof;
+		if(nEnd < nLength && pbtData[nEnd] == '\r')
+			nEnd++;
+		if(nEnd < nLength && pbtData[nEnd] == '\n')
+			nEnd++;
+
+		Revision revision;
+		revision.nXref = (size_t)nXref;
+		revision.nEof = nEof;
+		revision.nEnd = nEnd;
+		revision.bXrefStream = false;
+		revision.nChanges = bClassify ? 0 : -1;
+		if(nLinearizedXref && nEof <= nLinearizedLength)
+		{
+			if(nEnd < nLinearizedLength)
+				continue;
+			if(!readXref(revision.nXref, revision))
+				continue;
+			Revision firstPage;
+			if(readXref(nLinearizedXref, firstPage))
+			{
+				revision.entries.insert(firstPage.entries.begin(), firstPage.entries.end());
+				Dictionary trailer;
+				if(!parseDictionary(revision.trailer, trailer) || !trailer.count("Root"))
+					revision.trailer = firstPage.trailer;
+			}
+		}
+		else if(!readXref(revision.nXref, revision))
+		{
+			continue;
+		}
+		m_revisions.push_back(revision);
+	}
+
+	if(m_revisions.empty())
+		return DISIGON_ERROR_INVALID_FILE;
+
+	if(!bClassify)
+		return 0;
+	for(size_t i = 1; i < m_revisions.size(); i++)
+		m_revisions[i].nChanges = classify(i);
+	return 0;
+}
+
+int CPdfRevisionMap::revisionOf(const int64_t byteRange[4]) const
+{
+	if(byteRange[0] != 0 || byteRange[1] < 0 || byteRange[2] < byteRange[1] || byteRange[3] < 0)
+		return -1;
+	uint64_t nEnd = (uint64_t)byteRange[2] + (uint64_t)byteRange[3];
+	for(size_t i = 0; i < m_revisions.size(); i++)
+	{
+		if(m_revisions[i].nEof <= nEnd && nEnd <= m_revisions[i].nEnd)
+			return (int)i;
+	}
+	return -1;
+}
+
+int CPdfRevisionMap::changesAfter(int nRevision) const
+{
+	int nChanges = 0;
+	for(size_t i = nRevision < 0 ? 0 : (size_t)nRevision + 1; i < m_revisions.size(); i++)
+		nChanges |= m_revisions[i].nChanges;
+	return nChanges;
+}
+
+bool CPdfRevisionMap::object(uint32_t nNumber, size_t nRevision, std::string& dictionary, std::string* pStream) const
+{
+	if(pStream)
+		pStream->clear();
+	if(nRevision >= m_revisions.size())
+		return false;
+	const Entry* pEntry = find(nNumber, nRevision);
+	if(!pEntry)
+		return false;
+	if(pEntry->nType == 1)
+		return objectAt((size_t)pEntry->nOffset, nNumber, dictionary, pStream);
+	if(pEntry->nType == 2 && pEntry->nOffset <= UINT32_MAX)
+		return objectInStream((uint32_t)pEntry->nOffset, pEntry->nIndex, nRevision, dictionary);
+	return false;
+}
+
+bool CPdfRevisionMap::hasStream(uint32_t nNumber, size_t nRevision) const
+{
+	// gli oggetti negli stream di oggetti non sono stream
+	const Entry* pEntry = nRevision < m_revisions.size() ? find(nNumber, nRevision) : NULL;
+	if(!pEntry || pEntry->nType != 1)
+		return false;
+	CPdfLexer lexer(m_pbtData, m_nLength, (size_t)pEntry->nOffset);
+	int64_t n, g;
+	return lexer.integer(n) && n == (int64_t)nNumber && lexer.integer(g) && lexer.keyword("obj") &&
+		lexer.value(NULL) && lexer.keyword("stream");
+}
+
+bool CPdfRevisionMap::decode(const std::string& dictionary, const std::string& stream, std::string& data)
+{
+	Dictionary dict;
+	if(!parseDictionary(dictionary, dict))
+		return false;
+
+	std::string filter = CPdfSyntax::valueOf(dict, "Filter");
+	std::string parms = CPdfSyntax::valueOf(dict, "DecodeParms");
+	if(filter == "[ ]")
+		filter.clear();
+	else if(filter == "[ /FlateDecode ]")
+		filter = "/FlateDecode";
+	if(parms.size() > 4 && parms.compare(0, 2, "[ ") == 0 && parms.compare(parms.size() - 2, 2, " ]") == 0)
+		parms = parms.substr(2, parms.size() - 4);
+
+	if(filter.empty())
+	{
+		data = stream;
+		return true;
+	}
+	if(filter != "/FlateDecode" || !CPdfSyntax::inflate(stream, data, PDF_REVISION_MAX_STREAM))
+		return false;
+
+	Dictionary decodeParms;
+	if(parms.empty() || parms == "null" || !parseDictionary(parms, decodeParms))
+		return true;
+	int64_t nPredictor = 1, nColumns = 1, nColors = 1, nBits = 8;
+	integerOf(decodeParms, "Predictor", nPredictor);
+	integerOf(decodeParms, "Columns", nColumns);
+	integerOf(decodeParms, "Colors", nColors);
+	integerOf(decodeParms, "BitsPerComponent", nBits);
+	return unpredict(data, nPredictor, nColumns, nColors, nBits);
+}
+
+bool CPdfRevisionMap::dictionary(const std::string& text, std::map<std::string, std::string>& entries)
+{
+	return parseDictionary(text, entries);
+}
+
+bool CPdfRevisionMap::array(const std::string& text, std::vector<std::string>& items)
+{
+	CPdfLexer lexer = lexerOf(text);
+	return lexer.array(items) && lexer.eof();
+}
+
+bool CPdfRevisionMap::reference(const std::string& text, uint32_t& nNumber)
+{
+	return referenceOf(text, nNumber);
+}
+
+size_t CPdfRevisionMap::brokenOffsets(size_t nRevision, size_t* pnObjects) const
+{
+	// la voce piu' recente di ogni oggetto
+	std::map<uint32_t, const Entry*> entries;
+	for(size_t i = std::min(nRevision + 1, m_revisions.size()); i > 0; i--)
+	{
+		const std::map<uint32_t, Entry>& revisionEntries = m_revisions[i - 1].entries;
+		for(std::map<uint32_t, Entry>::const_iterator it = revisionEntries.begin(); it != revisionEntries.end(); ++it)
+			entries.insert(std::make_pair(it->first, &it->second));
+	}
+
+	size_t nObjects = 0;
+	size_t nBroken = 0;
+	for(std::map<uint32_t, const Entry*>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		if(it->first == 0 || it->second->nType == 0)
+			continue;
+		nObjects++;
+		if(it->second->nType == 2)
+			continue;
+		CPdfLexer lexer(m_pbtData, m_nLength, (size_t)it->second->nOffset);
+		int64_t n, g;
+		if(it->second->nOffset >= m_nLength || !lexer.integer(n) || n != (int64_t)it->first ||
+			!lexer.integer(g) || !lexer.keyword("obj"))
+			nBroken++;
+	}
+	if(pnObjects)
+		*pnObjects = nObjects;
+	return nBroken;
+}
+
+bool CPdfRevisionMap::readXref(size_t nOffset, Revision& revision) const
+{
+	CPdfLexer lexer(m_pbtData, m_nLength, nOffset);
+	if(lexer.keyword("xref"))
+		return readXrefTable(nOffset, revision);
+	return readXrefStream(nOffset, revision);
+}
+
+bool CPdfRevisionMap::readXrefTable(size_t nOffset, Revision& revision) const
+{
+	CPdfLexer lexer(m_pbtData, m_nLength, nOffset);
+	if(!lexer.keyword("xref"))
+		return false;
+	while(!lexer.keyword("trailer"))
+	{
+		int64_t nFirst, nCount;
+		if(!lexer.integer(nFirst) || !lexer.integer(nCount) || nFirst < 0 || nCount < 0 ||
+			nFirst + nCount > (int64_t)UINT32_MAX || (uint64_t)nCount > (m_nLength - lexer.pos()) / 6)
+			return false;
+		for(int64_t i = 0; i < nCount; i++)
+		{
+			int64_t nEntryOffset, nGeneration;
+			if(!lexer.integer(nEntryOffset) || !lexer.integer(nGeneration) || nEntryOffset < 0 || nGeneration < 0)
+				return false;
+			Entry entry;
+			entry.nGeneration = (uint32_t)nGeneration;
+			entry.nOffset = (uint64_t)nEntryOffset;
+			entry.nIndex = 0;
+			if(lexer.keyword("n"))
+				entry.nType = 1;
+			else if(lexer.keyword("f"))
+				entry.nType = 0;
+			else
+				return false;
+			revision.entries[(uint32_t)(nFirst + i)] = entry;
+		}
+	}
+
+	Dictionary trailer;
+	if(!lexer.value(&revision.trailer) || !parseDictionary(revision.trailer, trailer))
+		return false;
+	revision.bXrefStream = false;
+
+	// file ibridi: gli oggetti compressi sono nello stream /XRefStm, la tabella prevale
+	int64_t nXrefStm;
+	if(integerOf(trailer, "XRefStm", nXrefStm) && nXrefStm > 0 && (uint64_t)nXrefStm < m_nLength)
+	{
+		Revision hybrid;
+		if(readXrefStream((size_t)nXrefStm, hybrid))
+			revision.entries.insert(hybrid.entries.begin(), hybrid.entries.end());
+	}
+	return true;
+}
+
+bool CPdfRevisionMap::readXrefStream(size_t nOffset, Revision& revision) const
+{
+	std::string dictionary, stream, data;
+	Dictionary dict;
+	if(!objectAt(nOffset, 0, dictionary, &stream) || !parseDictionary(dictionary, dict) ||
+		CPdfSyntax::nameOf(dict, "Type") != "XRef" || !decode(dictionary, stream, data))
+		return false;
+
+	std::vector<int64_t> widths, index;
+	int64_t nSize;
+	if(!integers(CPdfSyntax::valueOf(dict, "W"), widths) || widths.size() != 3 || !integerOf(dict, "Size", nSize) || nSize < 0)
+		return false;
+	size_t nRow = 0;
+	for(size_t i = 0; i < widths.size(); i++)
+	{
+		if(widths[i] < 0 || widths[i] > 8)
+			return false;
+		nRow += (size_t)widths[i];
+	}
+	if(nRow == 0)
+		return false;
+	if(!integers(CPdfSyntax::valueOf(dict, "Index"), index))
+	{
+		index.clear();
+		index.push_back(0);
+		index.push_back(nSize);
+	}
+	if(index.size() % 2)
+		return false;
+
+	const BYTE* pbtRow = (const BYTE*)data.data();
+	const BYTE* pbtEnd = pbtRow + data.size();
+	for(size_t i = 0; i < index.size(); i += 2)
+	{
+		if(index[i] < 0 || index[i + 1] < 0 || index[i] + index[i + 1] > (int64_t)UINT32_MAX)
+			return false;
+		for(int64_t j = 0; j < index[i + 1]; j++)
+		{
+			if((size_t)(pbtEnd - pbtRow) < nRow)
+				return false;
+			uint64_t fields[3] = { 1, 0, 0 };
+			for(size_t k = 0; k < 3; k++)
+			{
+				if(widths[k] == 0)
+					continue;
+				fields[k] = 0;
+				for(int64_t b = 0; b < widths[k]; b++)
+					fields[k] = (fields[k] << 8) | *pbtRow++;
+			}
+			// i tipi sconosciuti sono riferimenti nulli
+			if(fields[0] > 2)
+				continue;
+			Entry entry;
+			entry.nType = (int)fields[0];
+			entry.nOffset = fields[1];
+			entry.nGeneration = entry.nType == 2 ? 0 : (uint32_t)fields[2];
+			entry.nIndex = entry.nType == 2 ? (uint32_t)fields[2] : 0;
+			revision.entries[(uint32_t)(index[i] + j)] = entry;
+		}
+	}
+
+	revision.trailer = dictionary;
+	revision.bXrefStream = true;
+	return true;
+}
+
+const CPdfRevisionMap::Entry* CPdfRevisionMap::find(uint32_t nNumber, size_t nRevision) const
+{
+	for(size_t i = std::min(nRevision + 1, m_revisions.size()); i > 0; i--)
+	{
+		std::map<uint32_t, Entry>::const_iterator it = m_revisions[i - 1].entries.find(nNumber);
+		if(it != m_revisions[i - 1].entries.end())
+			return &it->second;
+	}
+	return NULL;
+}
+
+bool CPdfRevisionMap::objectAt(size_t nOffset, uint32_t nNumber, std::string& dictionary, std::string* pStream) const
+{
+	CPdfLexer lexer(m_pbtData, m_nLength, nOffset);
+	int64_t n, g;
+	if(!lexer.integer(n) || !lexer.integer(g) || !lexer.keyword("obj"))
+		return false;
+	// nNumber 0: qualsiasi oggetto (stream xref, di cui non si conosce il numero)
+	if(nNumber != 0 && n != (int64_t)nNumber)
+		return false;
+	if(!lexer.value(&dictionary))
+		return false;
+	if(!pStream)
+		return true;
+	pStream->clear();
+	if(!lexer.keyword("stream"))
+		return true;
+	size_t nStart = lexer.pos();
+	if(nStart < m_nLength && m_pbtData[nStart] == '\r')
+		nStart++;
+	if(nStart < m_nLength && m_pbtData[nStart] == '\n')
+		nStart++;
+	return streamData(dictionary, nStart, *pStream);
+}
+
+bool CPdfRevisionMap::objectInStream(uint32_t nStream, uint32_t nIndex, size_t nRevision, std::string& dictionary) const
+{
+	const Entry* pEntry = find(nStream, nRevision);
+	if(!pEntry || pEntry->nType != 1)
+		return false;
+
+	std::string streamDictionary;
+	if(!objectAt((size_t)pEntry->nOffset, nStream, streamDictionary, NULL))
+		return false;
+	Dictionary dict;
+	int64_t nObjects, nFirst;
+	if(!parseDictionary(streamDictionary, dict) || CPdfSyntax::nameOf(dict, "Type") != "ObjStm" ||
+		!integerOf(dict, "N", nObjects) || !integerOf(dict, "First", nFirst) ||
+		(int64_t)nIndex >= nObjects || nFirst < 0)
+		return false;
+
+	std::map<size_t, std::string>::iterator it = m_objectStreams.find((size_t)pEntry->nOffset);
+	if(it == m_objectStreams.end())
+	{
+		std::string stream, data;
+		if(!objectAt((size_t)pEntry->nOffset, nStream, streamDictionary, &stream) || !decode(streamDictionary, stream, data))
+			return false;
+		it = m_objectStreams.insert(std::make_pair((size_t)pEntry->nOffset, data)).first;
+	}
+
+	// coppie numero / offset, poi gli oggetti a partire da /First
+	const std::string& data = it->second;
+	CPdfLexer header = lexerOf(data);
+	int64_t nNumber = 0, nObjectOffset = 0;
+	for(uint32_t i = 0; i <= nIndex; i++)
+	{
+		if(!header.integer(nNumber) || !header.integer(nObjectOffset))
+			return false;
+	}
+	if(nObjectOffset < 0 || (uint64_t)nFirst + (uint64_t)nObjectOffset >= data.size())
+		return false;
+	CPdfLexer lexer((const BYTE*)data.data(), data.size(), (size_t)(nFirst + nObjectOffset));
+	return lexer.value(&dictionary);
+}
+
+bool CPdfRevisionMap::streamData(const std::string& dictionary, size_t nStart, std::string& data) const
+{
+	Dictionary dict;
+	if(!parseDictionary(dictionary, dict))
+		return false;
+
+	// /Length diretta o indiretta; se non torna con endstream si cerca endstream
+	int64_t nLength = -1;
+	std::string length = CPdfSyntax::valueOf(dict, "Length");
+	uint32_t nLengthObject;
+	if(!integerOf(dict, "Length", nLength) && referenceOf(length, nLengthObject) && !m_revisions.empty())
+	{
+		const Entry* pEntry = find(nLengthObject, m_revisions.size() - 1);
+		std::string value;
+		if(pEntry && pEntry->nType == 1 && objectAt((size_t)pEntry->nOffset, nLengthObject, value, NULL))
+		{
+			CPdfLexer lexer = lexerOf(value);
+			if(!lexer.integer(nLength) || !lexer.eof())
+				nLength = -1;
+		}
+	}
+	if(nLength >= 0 && (uint64_t)nLength <= m_nLength - nStart)
+	{
+		CPdfLexer lexer(m_pbtData, m_nLength, nStart + (size_t)nLength);
+		if(lexer.keyword(szEndStream))
+		{
+			data.assign((const char*)m_pbtData + nStart, (size_t)nLength);
+			return true;
+		}
+	}
+
+	const BYTE* pbtEnd = m_pbtData + m_nLength;
+	const BYTE* pbtFound = std::search(m_pbtData + nStart, pbtEnd,
+		(const BYTE*)szEndStream, (const BYTE*)szEndStream + sizeof(szEndStream) - 1);
+	if(pbtFound == pbtEnd)
+		return false;
+	size_t nEnd = pbtFound - m_pbtData;
+	if(nEnd > nStart && m_pbtData[nEnd - 1] == '\n')
+		nEnd--;
+	if(nEnd > nStart && m_pbtData[nEnd - 1] == '\r')
+		nEnd--;
+	data.assign((const char*)m_pbtData + nStart, nEnd - nStart);
+	return true;
+}
+
+size_t CPdfRevisionMap::linearizedXref(size_t* pnLength) const
+{
+	// il dizionario di linearizzazione e' il primo oggetto, dopo l'intestazione
+	const BYTE* pbtLine = (const BYTE*)memchr(m_pbtData, '\n', std::min<size_t>(m_nLength, 1024));
+	if(!pbtLine)
+		pbtLine = (const BYTE*)memchr(m_pbtData, '\r', std::min<size_t>(m_nLength, 1024));
+	if(!pbtLine)
+		return 0;
+
+	CPdfLexer lexer(m_pbtData, m_nLength, pbtLine - m_pbtData);
+	int64_t n, g, nLength;
+	std::string text;
+	Dictionary dict;
+	if(!lexer.integer(n) || !lexer.integer(g) || !lexer.keyword("obj") || lexer.pos() > 1024 ||
+		!lexer.value(&text) || !parseDictionary(text, dict) || !dict.count("Linearized") ||
+		!integerOf(dict, "L", nLength) || nLength <= 0 || !lexer.keyword("endobj"))
+		return 0;
+	lexer.skipWhite();
+	*pnLength = (size_t)nLength;
+	return lexer.pos();
+}
+
+int CPdfRevisionMap::classify(size_t nRevision) const
+{
+	const Revision& revision = m_revisions[nRevision];
+	Dictionary trailer, oldTrailer;
+	uint32_t nInfo = 0;
+	uint32_t nOldInfo = 0;
+	if(parseDictionary(revision.trailer, trailer))
+		referenceOf(CPdfSyntax::valueOf(trailer, "Info"), nInfo);
+	if(parseDictionary(m_revisions[nRevision - 1].trailer, oldTrailer))
+		referenceOf(CPdfSyntax::valueOf(oldTrailer, "Info"), nOldInfo);
+
+	int nChanges = 0;
+	for(std::map<uint32_t, Entry>::const_iterator it = revision.entries.begin(); it != revision.entries.end(); ++it)
+	{
+		uint32_t nNumber = it->first;
+		if(nNumber == 0)
+			continue;
+
+		std::string newText, oldText, newStream, oldStream;
+		Dictionary newDict, oldDict;
+		bool bOld = object(nNumber, nRevision - 1, oldText, &oldStream);
+		bool bNew = it->second.nType != 0 && object(nNumber, nRevision, newText, &newStream);
+		if(bOld)
+			parseDictionary(oldText, oldDict);
+
+		// oggetto liberato
+		if(!bNew)
+		{
+			if(bOld || it->second.nType != 0)
+			{
+				int nKind = bOld ? objectKind(oldDict) : 0;
+				nChanges |= nKind ? nKind : PDF_UPDATE_CONTENT;
+			}
+			continue;
+		}
+		// oggetto riscritto senza modifiche
+		if(bOld && newText == oldText && newStream == oldStream)
+			continue;
+
+		bool bDict = parseDictionary(newText, newDict);
+		std::string type = CPdfSyntax::nameOf(newDict, "Type");
+		int nKind = objectKind(newDict);
+		// un oggetto esistente conta per quello che era: l'aggiornamento puo' dargli il
+		// /Type dei metadati o le voci di una firma per nascondere una modifica al contenuto
+		if(bOld && (CPdfSyntax::nameOf(oldDict, "Type") != type || objectKind(oldDict) != nKind))
+		{
+			nChanges |= PDF_UPDATE_CONTENT;
+			continue;
+		}
+		if(type == "XRef" || type == "ObjStm" || type == "Metadata" || (nNumber == nInfo && (!bOld || nNumber == nOldInfo)))
+			continue;
+
+		if(nKind)
+		{
+			nChanges |= nKind;
+		}
+		else if(type == "Page")
+		{
+			nChanges |= bOld ? pageChanges(newDict, oldDict) : PDF_UPDATE_CONTENT;
+		}
+		else if(type == "Catalog")
+		{
+			nChanges |= bOld ? catalogChanges(newDict, oldDict) : PDF_UPDATE_CONTENT;
+		}
+		else if(bDict && newDict.count("Fields"))
+		{
+			nChanges |= formChanges(newDict, oldDict);
+		}
+		else if(bDict && isValidationData(newDict) && (!bOld || isValidationData(oldDict)))
+		{
+			continue;
+		}
+		else if(bOld && !bDict && oldText.compare(0, 1, "[") == 0)
+		{
+			// array indiretti di riferimenti (/Annots, /Fields, /Certs): gli elementi
+			// aggiunti sono classificati come oggetti nuovi, quelli tolti come annotazioni
+			std::set<uint32_t> numbers;
+			if(!references(newText, numbers) || !references(oldText, numbers))
+				nChanges |= PDF_UPDATE_CONTENT;
+			else if(removesReferences(newText, oldText))
+				nChanges |= PDF_UPDATE_ANNOTATION;
+		}
+		else if(bOld)
+		{
+			// gli oggetti nuovi contano solo se li usa un oggetto modificato
+			nChanges |= PDF_UPDATE_CONTENT;
+		}
+	}
+	return nChanges;
+}
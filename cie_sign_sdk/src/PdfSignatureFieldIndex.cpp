@@ -0,0 +1,194 @@
+/*
+ *  PdfSignatureFieldIndex.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "PdfSignatureFieldIndex.h"
+
+#ifdef GetObject
+#undef GetObject
+#endif
+
+using namespace PoDoFo;
+
+namespace
+{
+	std::string stringValue(const PdfObject* obj)
+	{
+		if (!obj || !obj->IsString())
+			return std::string();
+		auto view = obj->GetString().GetString();
+		return std::string(view.data(), view.size());
+	}
+
+	bool isName(const PdfObject* obj, const char* szName)
+	{
+		return obj && obj->IsName() && obj->GetName().GetString() == szName;
+	}
+
+	const PdfObject* valueDictionary(const PdfObject& obj)
+	{
+		const PdfObject* value = obj.GetDictionary().FindKey("V");
+		return value && value->IsDictionary() ? value : nullptr;
+	}
+}
+
+PdfSignatureFieldIndex::PdfSignatureFieldIndex(const PdfMemDocument& document)
+{
+	// le /Annots delle pagine indicano dove e' disegnato ogni widget
+	try
+	{
+		const PdfPageCollection& pages = document.GetPages();
+		for (unsigned i = 0; i < pages.GetCount(); i++)
+		{
+			const PdfObject* annots = pages.GetPageAt(i).GetDictionary().FindKey("Annots");
+			if (!annots || !annots->IsArray())
+				continue;
+			const PdfArray& array = annots->GetArray();
+			for (unsigned j = 0; j < array.GetSize(); j++)
+			{
+				if (array[j].IsReference())
+					m_widgetPages.emplace(array[j].GetReference(), static_cast<int>(i));
+			}
+		}
+	}
+	catch (const PdfError&)
+	{
+	}
+
+	try
+	{
+		const PdfObject* acroForm = document.GetCatalog().GetDictionary().FindKey("AcroForm");
+		const PdfObject* fields = acroForm && acroForm->IsDictionary() ? acroForm->GetDictionary().FindKey("Fields") : nullptr;
+		if (fields && fields->IsArray())
+		{
+			const PdfArray& array = fields->GetArray();
+			for (unsigned i = 0; i < array.GetSize(); i++)
+			{
+				const PdfObject* field = array.FindAt(i);
+				if (field)
+					AddField(document, *field, std::string(), false, 0);
+			}
+		}
+	}
+	catch (const PdfError&)
+	{
+	}
+
+	m_visited.clear();
+	m_widgetPages.clear();
+	for (size_t i = 0; i < m_fields.size(); i++)
+	{
+		if (!m_fields[i].name.empty())
+			m_names.emplace(m_fields[i].name, i);
+		if (m_fields[i].value)
+			m_signatures.push_back(&m_fields[i]);
+	}
+}
+
+const PdfSignatureFieldInfo* PdfSignatureFieldIndex::Find(const std::string& name) const
+{
+	auto it = m_names.find(name);
+	return it != m_names.end() ? &m_fields[it->second] : nullptr;
+}
+
+void PdfSignatureFieldIndex::AddField(const PdfMemDocument& document, const PdfObject& field,
+	const std::string& parentName, bool inheritedSig, int depth)
+{
+	if (depth > PDF_SIGNATURE_FIELD_MAX_DEPTH || !field.IsDictionary() || !m_visited.insert(&field).second)
+		return;
+
+	const PdfDictionary& dict = field.GetDictionary();
+	std::string partialName = stringValue(dict.FindKey("T"));
+	std::string name = parentName.empty() ? partialName :
+		partialName.empty() ? parentName : parentName + "." + partialName;
+	// /FT e' ereditabile
+	const PdfObject* fieldType = dict.FindKey("FT");
+	bool isSig = fieldType ? isName(fieldType, "Sig") : inheritedSig;
+
+	// i figli con /T sono campi, gli altri sono i widget del campo
+	std::vector<const PdfObject*> widgets;
+	bool hasChildFields = false;
+	const PdfObject* kids = dict.FindKey("Kids");
+	if (kids && kids->IsArray())
+	{
+		const PdfArray& array = kids->GetArray();
+		for (unsigned i = 0; i < array.GetSize(); i++)
+		{
+			const PdfObject* kid = array.FindAt(i);
+			if (!kid || !kid->IsDictionary())
+				continue;
+			if (kid->GetDictionary().HasKey("T"))
+			{
+				hasChildFields = true;
+				AddField(document, *kid, name, isSig, depth + 1);
+			}
+			else
+				widgets.push_back(kid);
+		}
+	}
+	if (hasChildFields || !isSig)
+		return;
+
+	PdfSignatureFieldInfo info;
+	info.name = name;
+	info.partialName = partialName;
+	info.field = &field;
+	info.widget = widgets.empty() || isName(dict.FindKey("Subtype"), "Widget") ? &field : widgets.front();
+	info.widgetRef = info.widget->GetIndirectReference();
+	info.pageIndex = -1;
+	info.inPageAnnotations = false;
+	info.hasRect = false;
+	info.isSigned = false;
+	info.hasByteRange = false;
+	info.byteRange = {};
+
+	const PdfDictionary& widget = info.widget->GetDictionary();
+	auto page = m_widgetPages.find(info.widgetRef);
+	if (page != m_widgetPages.end())
+	{
+		info.pageIndex = page->second;
+		info.inPageAnnotations = true;
+	}
+	else
+	{
+		const PdfObject* pageObj = widget.GetKey("P");
+		if (pageObj && pageObj->IsReference())
+		{
+			try
+			{
+				info.pageIndex = static_cast<int>(document.GetPages().GetPage(pageObj->GetReference()).GetIndex());
+			}
+			catch (const PdfError&)
+			{
+			}
+		}
+	}
+
+	const PdfObject* rect = widget.FindKey("Rect");
+	if (rect && rect->IsArray() && rect->GetArray().GetSize() == 4)
+	{
+		info.rect = Rect::FromArray(rect->GetArray());
+		info.hasRect = true;
+	}
+
+	// alcuni generatori scrivono /V nel widget invece che nel campo
+	info.value = valueDictionary(field);
+	for (size_t i = 0; !info.value && i < widgets.size(); i++)
+		info.value = valueDictionary(*widgets[i]);
+	if (info.value)
+	{
+		const PdfDictionary& value = info.value->GetDictionary();
+		const PdfObject* contents = value.FindKey("Contents");
+		info.isSigned = contents && !contents->IsNull();
+		const PdfObject* byteRange = value.FindKey("ByteRange");
+		if (byteRange && byteRange->IsArray() && byteRange->GetArray().GetSize() == info.byteRange.size())
+		{
+			info.hasByteRange = true;
+			for (unsigned i = 0; i < info.byteRange.size(); i++)
+				info.hasByteRange = info.hasByteRange && byteRange->GetArray()[i].TryGetNumberLenient(info.byteRange[i]);
+		}
+	}
+	m_fields.push_back(std::move(info));
+}
@@ -1,6 +1,9 @@
 #include "PdfSignatureGenerator.h"
 
-#include "PdfVerifier.h"
+#include "PdfSignatureFieldIndex.h"
+#include "PdfUpdateCompactor.h"
+#include "SignatureFont.h"
+#include "SignatureImage.h"
 #include "UUCLogger.h"
 
 #include "podofo/main/PdfAnnotation.h"
@@ -14,11 +17,18 @@
 #include "podofo/main/PdfSignature.h"
 #include "podofo/main/PdfXObjectForm.h"
 
+#include <openssl/sha.h>
+
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 #ifdef ANDROID
 #include <android/log.h>
 #endif
@@ -31,25 +41,17 @@ namespace {
 
 constexpr const char* kDefaultFilter = "Adobe.PPKLite";
 constexpr const char* kDefaultSubFilter = "ETSI.CAdES.detached";
-
-static std::string getFieldName(PdfField* field)
-{
-    if (!field)
-        return {};
-    auto name = field->GetName();
-    if (!name.has_value())
-        return {};
-    auto view = name->GetString();
-    if (view.empty())
-        return {};
-    return std::string(view.data(), view.size());
-}
+// margine sulla CMS che non e' entrata nel segnaposto (la marca temporale varia)
+constexpr size_t kSignatureSizeMargin = 512;
+// aspetto testuale: corpo massimo e margine interno, in punti
+constexpr double kMaxTextSize = 12.0;
+constexpr double kTextPadding = 2.0;
 
 class ExternalPdfSigner : public PdfSigner
 {
 public:
-    ExternalPdfSigner(std::string filter, std::string subfilter)
-        : m_filter(std::move(filter)), m_subfilter(std::move(subfilter))
+    ExternalPdfSigner(std::string filter, std::string subfilter, size_t signatureSize)
+        : m_signatureSize(signatureSize), m_filter(std::move(filter)), m_subfilter(std::move(subfilter))
     {
     }
 
@@ -67,17 +69,16 @@ public:
 
     void ComputeSignature(charbuff& contents, bool dryrun) override
     {
+        // la CMS che non entra viene respinta da SetSignature, qui si completa col padding
         if (dryrun)
         {
-            contents.assign(kMaxSignatureSize, '\0');
+            contents.assign(m_signatureSize, '\0');
         }
         else
         {
             contents.assign(m_signature.data(), m_signature.size());
-            if (contents.size() < kMaxSignatureSize)
-                contents.resize(kMaxSignatureSize, '\0');
-            else if (contents.size() > kMaxSignatureSize)
-                contents.resize(kMaxSignatureSize);
+            if (contents.size() < m_signatureSize)
+                contents.resize(m_signatureSize, '\0');
         }
     }
 
@@ -98,7 +99,7 @@ public:
     std::string GetSignatureType() const override { return "Sig"; }
 
 private:
-    static constexpr size_t kMaxSignatureSize = 16384;
+    size_t m_signatureSize;
     std::vector<uint8_t> m_buffer;
     std::string m_signature;
     std::string m_filter;
@@ -110,6 +111,11 @@ static PdfString makeString(const char* value)
     return value ? PdfString(value) : PdfString("");
 }
 
+static std::string copyString(const char* value)
+{
+    return value ? std::string(value) : std::string();
+}
+
 static PdfSignature* CreateSignatureField(PdfMemDocument& doc,
     int pageIndex,
     const std::string& fieldName,
@@ -163,13 +169,291 @@ void EnsureRectDictionaryEntry(PdfSignature& signature, const Rect& rect)
     signature.GetDictionary().AddKey(PdfName("Rect"), PdfObject(array));
 }
 
+// immagine della firma gia' codificata, indipendente dal documento
+struct EncodedImage
+{
+    PdfDictionary dictionary;
+    PdfFilterList filters;
+    charbuff data;
+    std::shared_ptr<const EncodedImage> softMask;
+};
+
+// immagini condivise tra documenti, la piu' recente in testa
+constexpr size_t kEncodedImageCacheSize = 8;
+std::mutex g_encodedImagesMutex;
+std::list<std::pair<std::string, std::shared_ptr<const EncodedImage>>> g_encodedImages;
+std::atomic<long> g_encodedImageHits(0);
+std::atomic<long> g_encodedImageMisses(0);
+
+std::shared_ptr<const EncodedImage> findEncodedImage(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(g_encodedImagesMutex);
+    for (auto it = g_encodedImages.begin(); it != g_encodedImages.end(); ++it)
+    {
+        if (it->first == key)
+        {
+            g_encodedImages.splice(g_encodedImages.begin(), g_encodedImages, it);
+            g_encodedImageHits++;
+            return it->second;
+        }
+    }
+    g_encodedImageMisses++;
+    return nullptr;
+}
+
+void storeEncodedImage(const std::string& key, std::shared_ptr<const EncodedImage> image)
+{
+    std::lock_guard<std::mutex> lock(g_encodedImagesMutex);
+    g_encodedImages.remove_if([&key](const auto& entry) { return entry.first == key; });
+    g_encodedImages.emplace_front(key, std::move(image));
+    if (g_encodedImages.size() > kEncodedImageCacheSize)
+        g_encodedImages.pop_back();
+}
+
+// copia dello stream compresso e del dizionario; nullptr se l'immagine
+// dipende da altri oggetti del documento oltre alla SMask
+std::shared_ptr<const EncodedImage> encodeImage(PdfObject& object)
+{
+    PdfObjectStream* stream = object.GetStream();
+    if (!stream || !object.IsDictionary())
+        return nullptr;
+
+    auto image = std::make_shared<EncodedImage>();
+    image->dictionary = object.GetDictionary();
+    image->dictionary.RemoveKey("Length");
+    image->dictionary.RemoveKey("SMask");
+    for (const auto& entry : image->dictionary)
+    {
+        if (entry.second.IsReference())
+            return nullptr;
+    }
+    image->filters = stream->GetFilters();
+    image->data = stream->GetCopy(true);
+
+    PdfObject* softMask = object.GetDictionary().FindKey("SMask");
+    if (softMask)
+    {
+        image->softMask = encodeImage(*softMask);
+        if (!image->softMask)
+            return nullptr;
+    }
+    return image;
+}
+
+PdfObject& importImage(PdfMemDocument& document, const EncodedImage& image)
+{
+    PdfObject& object = document.GetObjects().CreateDictionaryObject();
+    object.GetDictionary() = image.dictionary;
+    if (image.softMask)
+        object.GetDictionary().AddKeyIndirect(PdfName("SMask"), importImage(document, *image.softMask));
+    object.GetOrCreateStream().SetData(bufferview(image.data.data(), image.data.size()), image.filters, true);
+    return object;
+}
+
+// oggetto creato in precedenza nello stesso documento, se esiste ancora
+PdfObject* findDocumentObject(PdfMemDocument& document,
+                              std::map<std::string, PdfReference>& objects,
+                              const std::string& key,
+                              const char* subtype,
+                              bool hasStream = true)
+{
+    auto it = objects.find(key);
+    if (it == objects.end())
+        return nullptr;
+    PdfObject* object = document.GetObjects().GetObject(it->second);
+    if (!object || !object->IsDictionary() || object->HasStream() != hasStream ||
+        object->GetDictionary().FindKeyAsSafe<PdfName>("Subtype") != PdfName(subtype))
+    {
+        objects.erase(it);
+        return nullptr;
+    }
+    return object;
+}
+
+// XObject /Image con i campioni gia' compressi Flate
+PdfObject& createImageObject(PdfMemDocument& document,
+                             uint32_t width,
+                             uint32_t height,
+                             const char* colorSpace,
+                             int bitsPerComponent,
+                             const std::vector<uint8_t>& data)
+{
+    PdfObject& object = document.GetObjects().CreateDictionaryObject(PdfName("XObject"), PdfName("Image"));
+    PdfDictionary& dictionary = object.GetDictionary();
+    dictionary.AddKey(PdfName("Width"), PdfObject(static_cast<int64_t>(width)));
+    dictionary.AddKey(PdfName("Height"), PdfObject(static_cast<int64_t>(height)));
+    dictionary.AddKey(PdfName("ColorSpace"), PdfName(colorSpace));
+    dictionary.AddKey(PdfName("BitsPerComponent"), PdfObject(static_cast<int64_t>(bitsPerComponent)));
+    object.GetOrCreateStream().SetData(bufferview(reinterpret_cast<const char*>(data.data()), data.size()),
+        PdfFilterList{ PdfFilterType::FlateDecode }, true);
+    return object;
+}
+
+// RGBA di un PNG/JPEG, con l'alpha presa dalla SMask creata da podofo
+bool decodeImage(PdfImage& image, charbuff& rgba)
+{
+    rgba = image.GetDecodedCopy(PdfPixelFormat::RGBA);
+    const size_t pixels = static_cast<size_t>(image.GetWidth()) * image.GetHeight();
+    if (rgba.size() < pixels * 4)
+        return false;
+
+    std::unique_ptr<PdfImage> mask;
+    PdfObject* softMask = image.GetObject().GetDictionary().FindKey("SMask");
+    if (softMask && PdfXObject::TryCreateFromObject(*softMask, mask) &&
+        mask->GetWidth() == image.GetWidth() && mask->GetHeight() == image.GetHeight())
+    {
+        charbuff alpha = mask->GetDecodedCopy(PdfPixelFormat::Grayscale);
+        for (size_t i = 0; i < pixels && i < alpha.size(); i++)
+            rgba[i * 4 + 3] = alpha[i];
+    }
+    return true;
+}
+
+std::unique_ptr<PdfImage> signatureImage(PdfMemDocument& document,
+                                         std::map<std::string, PdfReference>& objects,
+                                         const std::string& imageKey,
+                                         const uint8_t* imageData,
+                                         size_t imageLen,
+                                         uint32_t imageWidth,
+                                         uint32_t imageHeight,
+                                         double rectWidth,
+                                         double rectHeight,
+                                         uint32_t dpi)
+{
+    std::unique_ptr<PdfImage> image;
+
+    // l'immagine incorporata dipende anche dai pixel del riquadro
+    uint32_t targetWidth = 0, targetHeight = 0;
+    CSignatureImage::targetSize(rectWidth, rectHeight, dpi, &targetWidth, &targetHeight);
+    const std::string encodedKey = imageKey + ":" + std::to_string(targetWidth) + "x" + std::to_string(targetHeight);
+
+    // stesso documento: un solo XObject per tutti i campi
+    const std::string key = "I" + encodedKey;
+    PdfObject* object = findDocumentObject(document, objects, key, "Image");
+    if (object && PdfXObject::TryCreateFromObject(*object, image))
+        return image;
+
+    // altro documento: lo stream compresso viene copiato senza decodificare l'immagine
+    std::shared_ptr<const EncodedImage> encoded = findEncodedImage(encodedKey);
+    if (encoded && PdfXObject::TryCreateFromObject(importImage(document, *encoded), image))
+    {
+        objects[key] = image->GetObject().GetIndirectReference();
+        return image;
+    }
+
+    bufferview buffer(reinterpret_cast<const char*>(imageData), imageLen);
+    const uint8_t* rgba = imageData;
+    charbuff decoded;
+    if (imageWidth == 0 || imageHeight == 0)
+    {
+        // PNG/JPEG che non supera il riquadro: incorporato come lo codifica podofo
+        PdfMemDocument scratch;
+        std::unique_ptr<PdfImage> source = scratch.CreateImage();
+        source->LoadFromBuffer(buffer);
+        imageWidth = source->GetWidth();
+        imageHeight = source->GetHeight();
+        if ((imageWidth <= targetWidth && imageHeight <= targetHeight) || !decodeImage(*source, decoded))
+        {
+            image = document.CreateImage();
+            image->LoadFromBuffer(buffer);
+            rgba = nullptr;
+        }
+        else
+        {
+            rgba = reinterpret_cast<const uint8_t*>(decoded.data());
+        }
+    }
+
+    if (rgba)
+    {
+        CSignatureImage pipeline(rgba, imageWidth, imageHeight);
+        pipeline.downsample(targetWidth, targetHeight);
+        if (pipeline.encode() != 0)
+            throw std::runtime_error("Unable to compress the signature image");
+
+        PdfObject& imageObject = createImageObject(document, pipeline.width(), pipeline.height(),
+            pipeline.components() == 1 ? "DeviceGray" : "DeviceRGB", pipeline.bitsPerComponent(), pipeline.data());
+        if (!pipeline.softMask().empty())
+        {
+            imageObject.GetDictionary().AddKeyIndirect(PdfName("SMask"),
+                createImageObject(document, pipeline.width(), pipeline.height(), "DeviceGray", 8, pipeline.softMask()));
+        }
+        if (!PdfXObject::TryCreateFromObject(imageObject, image))
+            throw std::runtime_error("Invalid signature image");
+    }
+    objects[key] = image->GetObject().GetIndirectReference();
+
+    encoded = encodeImage(image->GetObject());
+    if (encoded)
+        storeEncodedImage(encodedKey, encoded);
+    return image;
+}
+
+void attachAppearance(PdfSignature& signature, PdfXObjectForm& appearance)
+{
+    bool applied = false;
+    try
+    {
+        PdfAnnotationWidget& widget = signature.MustGetWidget();
+        widget.SetAppearanceStream(appearance);
+        applied = true;
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative", "Appearance applied via widget");
+#endif
+    }
+    catch (const PdfError&)
+    {
+        applied = false;
+    }
+    catch (...)
+    {
+        applied = false;
+    }
+
+    if (!applied)
+    {
+        try
+        {
+            PdfAnnotationWidget* widget = signature.GetWidget();
+            PdfDictionary* dict = widget ? &widget->GetDictionary() : nullptr;
+            if (!dict)
+            {
+                dict = &signature.GetDictionary();
+            }
+            PdfObject* apObj = dict->GetKey("AP");
+            PdfDictionary* apDict = nullptr;
+            if (apObj && apObj->IsDictionary())
+            {
+                apDict = &apObj->GetDictionary();
+            }
+            else
+            {
+                PdfObject newAp{PdfDictionary()};
+                apObj = &dict->AddKey(PdfName("AP"), newAp);
+                apDict = &apObj->GetDictionary();
+            }
+            apDict->AddKeyIndirect(PdfName("N"), appearance.GetObject());
+#ifdef ANDROID
+            __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative", "Appearance applied via fallback dictionary");
+#endif
+        }
+        catch (...)
+        {
+            std::fprintf(stderr, "PdfSignatureGenerator: Unable to attach appearance dictionary\n");
+        }
+    }
+}
+
 void ApplyAppearanceImage(PdfSignature& signature,
                           PdfMemDocument& document,
+                          std::map<std::string, PdfReference>& objects,
+                          const std::string& imageKey,
                           const Rect& rect,
                           const uint8_t* imageData,
                           size_t imageLen,
                           uint32_t imageWidth,
-                          uint32_t imageHeight)
+                          uint32_t imageHeight,
+                          uint32_t dpi)
 {
 #ifdef ANDROID
     __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative",
@@ -188,108 +472,216 @@ void ApplyAppearanceImage(PdfSignature& signature,
 
     try
     {
-        Rect appearanceRect(0.0, 0.0, rectWidth, rectHeight);
-        auto appearance = document.CreateXObjectForm(appearanceRect);
-        PdfPainter painter;
-        painter.SetCanvas(*appearance);
-
-        if (hasRawDimensions)
+        // campi della stessa dimensione condividono anche l'aspetto
+        char size[64];
+        std::snprintf(size, sizeof(size), ":%.2fx%.2f:%u", rectWidth, rectHeight, dpi);
+        const std::string formKey = "F" + imageKey + size;
+
+        std::unique_ptr<PdfXObjectForm> appearance;
+        PdfObject* formObject = findDocumentObject(document, objects, formKey, "Form");
+        if (!formObject || !PdfXObject::TryCreateFromObject(*formObject, appearance))
         {
-            auto image = document.CreateImage();
-            bufferview buffer(reinterpret_cast<const char*>(imageData), imageLen);
-            image->SetData(buffer, imageWidth, imageHeight, PdfPixelFormat::RGBA);
-            double scaleX = rectWidth / static_cast<double>(imageWidth);
-            double scaleY = rectHeight / static_cast<double>(imageHeight);
-            if (scaleX <= 0.0)
-                scaleX = 1.0;
-            if (scaleY <= 0.0)
-                scaleY = 1.0;
+            Rect appearanceRect(0.0, 0.0, rectWidth, rectHeight);
+            appearance = document.CreateXObjectForm(appearanceRect);
+            std::unique_ptr<PdfImage> image = signatureImage(document, objects, imageKey,
+                imageData, imageLen, imageWidth, imageHeight, rectWidth, rectHeight, dpi);
+
+            PdfPainter painter;
+            painter.SetCanvas(*appearance);
+            double scaleX = image->GetWidth() > 0 ? rectWidth / static_cast<double>(image->GetWidth()) : 1.0;
+            double scaleY = image->GetHeight() > 0 ? rectHeight / static_cast<double>(image->GetHeight()) : 1.0;
             painter.DrawImage(*image, 0.0, 0.0, scaleX, scaleY);
-        }
-        else
-        {
-            auto image = document.CreateImage();
-            bufferview buffer(reinterpret_cast<const char*>(imageData), imageLen);
-            image->LoadFromBuffer(buffer);
-            double scaleX = rectWidth / static_cast<double>(image->GetWidth());
-            double scaleY = rectHeight / static_cast<double>(image->GetHeight());
-            if (scaleX <= 0.0)
-                scaleX = 1.0;
-            if (scaleY <= 0.0)
-                scaleY = 1.0;
-            painter.DrawImage(*image, 0.0, 0.0, scaleX, scaleY);
-        }
+            painter.FinishDrawing();
 
-        painter.FinishDrawing();
+            objects[formKey] = appearance->GetObject().GetIndirectReference();
+        }
 
-        bool applied = false;
-        try
-        {
-            PdfAnnotationWidget& widget = signature.MustGetWidget();
-            widget.SetAppearanceStream(*appearance);
-            applied = true;
+        attachAppearance(signature, *appearance);
+    }
+    catch (const PdfError& err)
+    {
 #ifdef ANDROID
-            __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative", "Appearance applied via widget");
+        __android_log_print(ANDROID_LOG_ERROR, "CieSignNative",
+            "PdfSignatureGenerator: Unable to embed signature image: %s", err.what());
+#else
+        std::fprintf(stderr, "PdfSignatureGenerator: Unable to embed signature image: %s\n", err.what());
 #endif
-        }
-        catch (const PdfError&)
+    }
+    catch (...)
+    {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_ERROR, "CieSignNative",
+            "PdfSignatureGenerator: Unable to embed signature image (unknown error)");
+#else
+        std::fprintf(stderr, "PdfSignatureGenerator: Unable to embed signature image (unknown error)\n");
+#endif
+    }
+}
+
+// font Type0 / CIDFontType2 (Identity-H) con i glifi del sottoinsieme
+PdfObject& signatureFont(PdfMemDocument& document,
+                         std::map<std::string, PdfReference>& objects,
+                         const CSignatureFont& font,
+                         const std::string& fontName,
+                         const CSignatureFont::Subset& subset)
+{
+    // stesso documento: i campi con gli stessi glifi condividono il font
+    const std::string key = "T" + fontName + ":" + subset.key;
+    PdfObject* object = findDocumentObject(document, objects, key, "Type0", false);
+    if (object)
+        return *object;
+
+    PdfIndirectObjectList& list = document.GetObjects();
+    const PdfName baseFont(subset.tag + "+" + fontName);
+
+    PdfObject& fontFile = list.CreateDictionaryObject();
+    fontFile.GetDictionary().AddKey(PdfName("Length1"), PdfObject(static_cast<int64_t>(subset.nLength1)));
+    fontFile.GetOrCreateStream().SetData(
+        bufferview(reinterpret_cast<const char*>(subset.fontFile.data()), subset.fontFile.size()),
+        PdfFilterList{ PdfFilterType::FlateDecode }, true);
+
+    PdfArray bbox;
+    for (int i = 0; i < 4; i++)
+        bbox.Add(PdfObject(static_cast<int64_t>(font.bbox()[i])));
+    PdfObject& descriptor = list.CreateDictionaryObject(PdfName("FontDescriptor"));
+    PdfDictionary& descriptorDict = descriptor.GetDictionary();
+    descriptorDict.AddKey(PdfName("FontName"), baseFont);
+    descriptorDict.AddKey(PdfName("Flags"), PdfObject(static_cast<int64_t>(32)));
+    descriptorDict.AddKey(PdfName("FontBBox"), bbox);
+    descriptorDict.AddKey(PdfName("ItalicAngle"), PdfObject(static_cast<int64_t>(0)));
+    descriptorDict.AddKey(PdfName("Ascent"), PdfObject(static_cast<int64_t>(font.ascent())));
+    descriptorDict.AddKey(PdfName("Descent"), PdfObject(static_cast<int64_t>(font.descent())));
+    descriptorDict.AddKey(PdfName("CapHeight"), PdfObject(static_cast<int64_t>(font.ascent())));
+    descriptorDict.AddKey(PdfName("StemV"), PdfObject(static_cast<int64_t>(80)));
+    descriptorDict.AddKeyIndirect(PdfName("FontFile2"), fontFile);
+
+    // /W a gruppi di glifi consecutivi
+    PdfArray widths;
+    for (size_t i = 0; i < subset.widths.size();)
+    {
+        PdfArray run;
+        size_t j = i;
+        do
         {
-            applied = false;
+            run.Add(PdfObject(static_cast<int64_t>(subset.widths[j].second)));
+            j++;
         }
-        catch (...)
+        while (j < subset.widths.size() && subset.widths[j].first == subset.widths[j - 1].first + 1);
+        widths.Add(PdfObject(static_cast<int64_t>(subset.widths[i].first)));
+        widths.Add(run);
+        i = j;
+    }
+
+    PdfDictionary systemInfo;
+    systemInfo.AddKey(PdfName("Registry"), PdfString("Adobe"));
+    systemInfo.AddKey(PdfName("Ordering"), PdfString("Identity"));
+    systemInfo.AddKey(PdfName("Supplement"), PdfObject(static_cast<int64_t>(0)));
+
+    PdfObject& cidFont = list.CreateDictionaryObject(PdfName("Font"), PdfName("CIDFontType2"));
+    PdfDictionary& cidFontDict = cidFont.GetDictionary();
+    cidFontDict.AddKey(PdfName("BaseFont"), baseFont);
+    cidFontDict.AddKey(PdfName("CIDSystemInfo"), systemInfo);
+    cidFontDict.AddKeyIndirect(PdfName("FontDescriptor"), descriptor);
+    cidFontDict.AddKey(PdfName("CIDToGIDMap"), PdfName("Identity"));
+    cidFontDict.AddKey(PdfName("W"), widths);
+
+    PdfObject& toUnicode = list.CreateDictionaryObject();
+    toUnicode.GetOrCreateStream().SetData(bufferview(subset.toUnicode.data(), subset.toUnicode.size()));
+
+    PdfArray descendants;
+    descendants.Add(cidFont.GetIndirectReference());
+    PdfObject& type0 = list.CreateDictionaryObject(PdfName("Font"), PdfName("Type0"));
+    PdfDictionary& type0Dict = type0.GetDictionary();
+    type0Dict.AddKey(PdfName("BaseFont"), baseFont);
+    type0Dict.AddKey(PdfName("Encoding"), PdfName("Identity-H"));
+    type0Dict.AddKey(PdfName("DescendantFonts"), descendants);
+    type0Dict.AddKeyIndirect(PdfName("ToUnicode"), toUnicode);
+
+    objects[key] = type0.GetIndirectReference();
+    return type0;
+}
+
+void ApplyAppearanceText(PdfSignature& signature,
+                         PdfMemDocument& document,
+                         std::map<std::string, PdfReference>& objects,
+                         const CSignatureFont& font,
+                         const std::string& fontName,
+                         const Rect& rect,
+                         const std::vector<std::string>& lines)
+{
+    const double rectWidth = rect.Width;
+    const double rectHeight = rect.Height;
+    if (lines.empty() || rectWidth <= 0 || rectHeight <= 0)
+        return;
+
+    try
+    {
+        std::vector<std::vector<uint32_t>> text;
+        std::vector<uint32_t> characters;
+        int widest = 0;
+        for (const auto& line : lines)
         {
-            applied = false;
+            text.push_back(CSignatureFont::codePoints(line));
+            widest = std::max(widest, font.textWidth(text.back()));
+            characters.insert(characters.end(), text.back().begin(), text.back().end());
         }
 
-        if (!applied)
+        std::shared_ptr<const CSignatureFont::Subset> subset = font.subset(characters);
+        if (!subset)
+            throw std::runtime_error("Unable to subset the signature font");
+        PdfObject& fontObject = signatureFont(document, objects, font, fontName, *subset);
+
+        // il corpo piu' grande (fino a kMaxTextSize) con cui tutte le righe entrano nel riquadro
+        const double padding = std::min(kTextPadding, std::min(rectWidth, rectHeight) / 10.0);
+        const double lineHeight = std::max(font.ascent() - font.descent(), 1000) / 1000.0;
+        double fontSize = std::min(kMaxTextSize, (rectHeight - 2 * padding) / (lineHeight * lines.size()));
+        if (widest > 0)
+            fontSize = std::min(fontSize, (rectWidth - 2 * padding) * 1000.0 / widest);
+
+        std::string content = "q\nBT\n";
+        char operators[96];
+        std::snprintf(operators, sizeof(operators), "/F1 %.2f Tf\n0 g\n", fontSize);
+        content += operators;
+        double baseline = rectHeight - padding - font.ascent() * fontSize / 1000.0;
+        for (const auto& line : text)
         {
-            try
-            {
-                PdfAnnotationWidget* widget = signature.GetWidget();
-                PdfDictionary* dict = widget ? &widget->GetDictionary() : nullptr;
-                if (!dict)
-                {
-                    dict = &signature.GetDictionary();
-                }
-                PdfObject* apObj = dict->GetKey("AP");
-                PdfDictionary* apDict = nullptr;
-                if (apObj && apObj->IsDictionary())
-                {
-                    apDict = &apObj->GetDictionary();
-                }
-                else
-                {
-                    PdfObject newAp{PdfDictionary()};
-                    apObj = &dict->AddKey(PdfName("AP"), newAp);
-                    apDict = &apObj->GetDictionary();
-                }
-                apDict->AddKeyIndirect(PdfName("N"), appearance->GetObject());
-#ifdef ANDROID
-                __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative", "Appearance applied via fallback dictionary");
-#endif
-            }
-            catch (...)
+            std::snprintf(operators, sizeof(operators), "1 0 0 1 %.2f %.2f Tm\n<", padding, baseline);
+            content += operators;
+            for (uint32_t c : line)
             {
-                std::fprintf(stderr, "PdfSignatureGenerator: Unable to attach appearance dictionary\n");
+                std::snprintf(operators, sizeof(operators), "%04X", font.glyph(c));
+                content += operators;
             }
+            content += "> Tj\n";
+            baseline -= lineHeight * fontSize;
         }
+        content += "ET\nQ\n";
+
+        Rect appearanceRect(0.0, 0.0, rectWidth, rectHeight);
+        std::unique_ptr<PdfXObjectForm> appearance = document.CreateXObjectForm(appearanceRect);
+        PdfDictionary fonts;
+        fonts.AddKeyIndirect(PdfName("F1"), fontObject);
+        appearance->GetOrCreateResources().GetDictionary().AddKey(PdfName("Font"), fonts);
+        appearance->GetObject().GetOrCreateStream().SetData(bufferview(content.data(), content.size()));
+
+        attachAppearance(signature, *appearance);
     }
     catch (const PdfError& err)
     {
 #ifdef ANDROID
         __android_log_print(ANDROID_LOG_ERROR, "CieSignNative",
-            "PdfSignatureGenerator: Unable to embed signature image: %s", err.what());
+            "PdfSignatureGenerator: Unable to create the text appearance: %s", err.what());
 #else
-        std::fprintf(stderr, "PdfSignatureGenerator: Unable to embed signature image: %s\n", err.what());
+        std::fprintf(stderr, "PdfSignatureGenerator: Unable to create the text appearance: %s\n", err.what());
 #endif
     }
-    catch (...)
+    catch (const std::exception& err)
     {
 #ifdef ANDROID
         __android_log_print(ANDROID_LOG_ERROR, "CieSignNative",
-            "PdfSignatureGenerator: Unable to embed signature image (unknown error)");
+            "PdfSignatureGenerator: Unable to create the text appearance: %s", err.what());
 #else
-        std::fprintf(stderr, "PdfSignatureGenerator: Unable to embed signature image (unknown error)\n");
+        std::fprintf(stderr, "PdfSignatureGenerator: Unable to create the text appearance: %s\n", err.what());
 #endif
     }
 }
@@ -299,9 +691,16 @@ PdfSignatureGenerator::PdfSignatureGenerator()
     : m_pPdfDocument(nullptr),
       m_pSignatureField(nullptr),
       m_actualLen(0),
+      m_signatureSize(0),
       m_placeholderSize(0),
+      m_requiredSignatureSize(0),
+      m_bSigningPending(false),
+      m_bCompactUpdate(false),
+      m_compactContents(0),
+      m_compactContentsEnd(0),
       m_signatureImageWidth(0),
-      m_signatureImageHeight(0)
+      m_signatureImageHeight(0),
+      m_signatureImageDpi(0)
 {
 }
 
@@ -314,7 +713,15 @@ int PdfSignatureGenerator::Load(const char* pdf, int len)
         m_pPdfDocument = std::make_unique<PdfMemDocument>();
         bufferview buffer(pdf, static_cast<size_t>(len));
         m_pPdfDocument->LoadFromBuffer(buffer);
-        int nSigns = PDFVerifier::GetNumberOfSignatures(m_pPdfDocument.get());
+        m_pFieldIndex.reset();
+        int nSigns = static_cast<int>(GetFieldIndex().GetSignatures().size());
+        // un aggiornamento incrementale del PDF precedente (piu' campi firmati in
+        // sequenza) conserva gli XObject dell'aspetto gia' scritti
+        bool incremental = !m_originalPdfData.empty() &&
+            static_cast<size_t>(len) > m_originalPdfData.size() &&
+            std::memcmp(pdf, m_originalPdfData.data(), m_originalPdfData.size()) == 0;
+        if (!incremental)
+            m_appearanceObjects.clear();
         m_actualLen = len;
         m_originalPdfData.assign(pdf, pdf + len);
         m_streamBuffer = m_originalPdfData;
@@ -324,6 +731,12 @@ int PdfSignatureGenerator::Load(const char* pdf, int len)
         m_pDevice.reset();
         m_signerId.reset();
         m_subFilter = kDefaultSubFilter;
+        m_bSigningPending = false;
+        m_requiredSignatureSize = 0;
+        m_prepareField = nullptr;
+        m_reasonLabel.clear();
+        m_nameLabel.clear();
+        m_locationLabel.clear();
         return nSigns;
     }
     catch (const PdfError&)
@@ -338,29 +751,61 @@ int PdfSignatureGenerator::Load(const char* pdf, int len)
 
 void PdfSignatureGenerator::AddFont(const char* szFontName, const char* szFontPath)
 {
-    (void)szFontName;
-    (void)szFontPath;
+    // il file viene letto una volta per processo, anche da piu' generatori
+    m_pSignatureFont = CSignatureFont::load(szFontPath);
+    if (!m_pSignatureFont)
+    {
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_ERROR, "CieSignNative",
+            "PdfSignatureGenerator: Unable to load font %s", szFontPath ? szFontPath : "");
+#else
+        std::fprintf(stderr, "PdfSignatureGenerator: Unable to load font %s\n", szFontPath ? szFontPath : "");
+#endif
+        m_signatureFontName.clear();
+        return;
+    }
+
+    // nome PDF: senza spazi ne' delimitatori
+    m_signatureFontName.clear();
+    for (const char* p = szFontName ? szFontName : ""; *p; p++)
+    {
+        if (*p > ' ' && *p < 127 && !std::strchr("()<>[]{}/%#", *p))
+            m_signatureFontName += *p;
+    }
+    if (m_signatureFontName.empty())
+        m_signatureFontName = "SignatureFont";
 }
 
 void PdfSignatureGenerator::InitSignature(int pageIndex, const char* szReason,
-    const char* /*szReasonLabel*/, const char* szName,
-    const char* /*szNameLabel*/, const char* szLocation,
-    const char* /*szLocationLabel*/, const char* szFieldName,
+    const char* szReasonLabel, const char* szName,
+    const char* szNameLabel, const char* szLocation,
+    const char* szLocationLabel, const char* szFieldName,
     const char* szSubFilter)
 {
-    InitSignature(pageIndex, 0, 0, 0, 0, szReason, nullptr, szName, nullptr,
-        szLocation, nullptr, szFieldName, szSubFilter, nullptr, nullptr, nullptr, nullptr);
+    InitSignature(pageIndex, 0, 0, 0, 0, szReason, szReasonLabel, szName, szNameLabel,
+        szLocation, szLocationLabel, szFieldName, szSubFilter, nullptr, nullptr, nullptr, nullptr);
 }
 
 void PdfSignatureGenerator::InitSignature(int pageIndex, float left, float bottom,
     float width, float height, const char* szReason,
-    const char* /*szReasonLabel*/, const char* szName,
-    const char* /*szNameLabel*/, const char* szLocation,
-    const char* /*szLocationLabel*/, const char* szFieldName,
+    const char* szReasonLabel, const char* szName,
+    const char* szNameLabel, const char* szLocation,
+    const char* szLocationLabel, const char* szFieldName,
     const char* szSubFilter)
 {
-    InitSignature(pageIndex, left, bottom, width, height, szReason, nullptr, szName,
-        nullptr, szLocation, nullptr, szFieldName, szSubFilter, nullptr, nullptr, nullptr, nullptr);
+    InitSignature(pageIndex, left, bottom, width, height, szReason, szReasonLabel, szName,
+        szNameLabel, szLocation, szLocationLabel, szFieldName, szSubFilter, nullptr, nullptr, nullptr, nullptr);
+}
+
+void PdfSignatureGenerator::GetAppearanceCacheStats(long* pnHits, long* pnMisses)
+{
+    *pnHits = g_encodedImageHits;
+    *pnMisses = g_encodedImageMisses;
+}
+
+void PdfSignatureGenerator::SetSignatureImageResolution(uint32_t dpi)
+{
+    m_signatureImageDpi = dpi;
 }
 
 void PdfSignatureGenerator::SetSignatureImage(const uint8_t* signatureImageData,
@@ -373,20 +818,29 @@ void PdfSignatureGenerator::SetSignatureImage(const uint8_t* signatureImageData,
         m_signatureImage.assign(signatureImageData, signatureImageData + signatureImageLen);
         m_signatureImageWidth = width;
         m_signatureImageHeight = height;
+
+        // chiave dell'aspetto: contenuto e dimensioni dell'immagine
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(signatureImageData, signatureImageLen, digest);
+        char hex[2 * SHA256_DIGEST_LENGTH + 1];
+        for (size_t i = 0; i < SHA256_DIGEST_LENGTH; i++)
+            std::snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+        m_signatureImageKey = std::string(hex) + ":" + std::to_string(width) + "x" + std::to_string(height);
     }
     else
     {
         m_signatureImage.clear();
         m_signatureImageWidth = 0;
         m_signatureImageHeight = 0;
+        m_signatureImageKey.clear();
     }
 }
 
 void PdfSignatureGenerator::InitSignature(int pageIndex, float left, float bottom,
     float width, float height, const char* szReason,
-    const char* /*szReasonLabel*/, const char* szName,
-    const char* /*szNameLabel*/, const char* szLocation,
-    const char* /*szLocationLabel*/, const char* szFieldName,
+    const char* szReasonLabel, const char* szName,
+    const char* szNameLabel, const char* szLocation,
+    const char* szLocationLabel, const char* szFieldName,
     const char* szSubFilter, const char* /*szImagePath*/,
     const char* /*szDescription*/, const char* /*szGraphometricData*/,
     const char* /*szVersion*/)
@@ -407,20 +861,66 @@ void PdfSignatureGenerator::InitSignature(int pageIndex, float left, float botto
     Rect rect(left0, bottom0, width0, height0);
 
     auto fieldName = std::string(szFieldName ? szFieldName : "Signature1");
+    m_reasonLabel = copyString(szReasonLabel);
+    m_nameLabel = copyString(szNameLabel);
+    m_locationLabel = copyString(szLocationLabel);
     PdfSignature* signature = CreateSignatureField(*m_pPdfDocument, pageIndex, fieldName, rect);
     if (!signature)
         throw std::runtime_error("Failed to create signature field");
 
     PrepareSignatureField(*signature, &rect, szReason, szName, szLocation, szSubFilter);
+
+    m_prepareField = [this, pageIndex, left, bottom, width, height, reason = copyString(szReason),
+        name = copyString(szName), location = copyString(szLocation), fieldName,
+        subFilter = copyString(szSubFilter), reasonLabel = m_reasonLabel, nameLabel = m_nameLabel,
+        locationLabel = m_locationLabel]() {
+        InitSignature(pageIndex, left, bottom, width, height, reason.c_str(), reasonLabel.c_str(),
+            name.c_str(), nameLabel.c_str(), location.c_str(), locationLabel.c_str(), fieldName.c_str(),
+            subFilter.c_str(), nullptr, nullptr, nullptr, nullptr);
+        return true;
+    };
+}
+
+void PdfSignatureGenerator::SetSignatureSize(size_t nSize)
+{
+    m_signatureSize = nSize;
+}
+
+void PdfSignatureGenerator::SetCompactUpdate(bool bCompact)
+{
+    m_bCompactUpdate = bCompact;
+}
+
+size_t PdfSignatureGenerator::GetRequiredSignatureSize() const
+{
+    return m_requiredSignatureSize;
+}
+
+void PdfSignatureGenerator::PrepareAgain()
+{
+    // StartSigning ha gia' scritto segnaposto e ByteRange nel documento in memoria:
+    // si riparte dal PDF caricato ripetendo la preparazione del campo
+    std::function<bool()> prepareField = m_prepareField;
+    m_pPdfDocument = std::make_unique<PdfMemDocument>();
+    m_pPdfDocument->LoadFromBuffer(bufferview(m_originalPdfData.data(), m_originalPdfData.size()));
+    m_pFieldIndex.reset();
+    m_pSignatureField = nullptr;
+    m_bSigningPending = false;
+    if (!prepareField || !prepareField())
+        throw std::runtime_error("Unable to prepare the signature field again");
 }
 
 void PdfSignatureGenerator::GetBufferForSignature(UUCByteArray& toSign)
 {
+    if (m_bSigningPending)
+        PrepareAgain();
+
     if (!m_pPdfDocument || !m_pSignatureField)
         throw std::runtime_error("Signature not initialized");
 
+    m_placeholderSize = m_signatureSize != 0 ? m_signatureSize : PDF_SIGNATURE_DEFAULT_SIZE;
     m_pSigningContext = std::make_unique<PdfSigningContext>();
-    m_pSigner = std::make_shared<ExternalPdfSigner>(kDefaultFilter, m_subFilter);
+    m_pSigner = std::make_shared<ExternalPdfSigner>(kDefaultFilter, m_subFilter, m_placeholderSize);
     m_signerId = m_pSigningContext->AddSigner(*m_pSignatureField, m_pSigner);
 
     m_streamBuffer = m_originalPdfData;
@@ -430,40 +930,77 @@ void PdfSignatureGenerator::GetBufferForSignature(UUCByteArray& toSign)
     m_signingResults = PdfSigningResults{};
 
     m_pSigningContext->StartSigning(*m_pPdfDocument, m_pDevice, m_signingResults);
+    m_bSigningPending = true;
+    m_requiredSignatureSize = 0;
+    m_compactContents = 0;
+    m_compactContentsEnd = 0;
+
+    // PoDoFo non scrive stream di oggetti: la revisione viene riscritta e firmata qui,
+    // con la /ByteRange calcolata sul nuovo PDF
+    CPdfUpdateCompactor compactor;
+    if (m_bCompactUpdate && compactor.compact(reinterpret_cast<const BYTE*>(m_streamBuffer.data()),
+            m_streamBuffer.size(), m_originalPdfData.size()))
+    {
+        const int64_t* byteRange = compactor.byteRange();
+        m_streamBuffer.resize(m_originalPdfData.size());
+        m_streamBuffer += compactor.update();
+        m_compactContents = static_cast<size_t>(byteRange[1]);
+        m_compactContentsEnd = static_cast<size_t>(byteRange[2]);
+
+        toSign.removeAll();
+        toSign.append(reinterpret_cast<const BYTE*>(m_streamBuffer.data()),
+            static_cast<unsigned int>(byteRange[1]));
+        toSign.append(reinterpret_cast<const BYTE*>(m_streamBuffer.data()) + byteRange[2],
+            static_cast<unsigned int>(byteRange[3]));
+        return;
+    }
 
     auto it = m_signingResults.Intermediate.find(*m_signerId);
     if (it == m_signingResults.Intermediate.end())
         throw std::runtime_error("Missing intermediate signing buffer");
-    m_placeholderSize = it->second.size();
 
     toSign.removeAll();
     toSign.append(reinterpret_cast<const BYTE*>(it->second.data()),
         static_cast<unsigned int>(it->second.size()));
 }
 
-void PdfSignatureGenerator::SetSignature(const char* signature, int len)
+bool PdfSignatureGenerator::SetSignature(const char* signature, int len)
 {
-    if (!m_pSigningContext || !m_signerId)
+    if (!m_pSigningContext || !m_signerId || !m_bSigningPending)
         throw std::runtime_error("Signing context not initialized");
 
-    PdfSigningResults processed;
-    auto& buffer = processed.Intermediate[*m_signerId];
-    buffer.assign(signature, signature + len);
-    if (m_placeholderSize != 0) {
-        if (buffer.size() < m_placeholderSize) {
-            buffer.resize(m_placeholderSize, '\0');
-        } else if (buffer.size() > m_placeholderSize) {
-            buffer.resize(m_placeholderSize);
+    // una CMS troncata non e' verificabile; la ByteRange e' coperta dalla firma,
+    // quindi un segnaposto piu' grande richiede anche una nuova firma
+    if (static_cast<size_t>(len) > m_placeholderSize)
+    {
+        m_requiredSignatureSize = static_cast<size_t>(len) + kSignatureSizeMargin;
+        return false;
+    }
+
+    if (m_compactContentsEnd != 0)
+    {
+        // CMS in esadecimale all'inizio del segnaposto, il resto resta a zero
+        static const char hex[] = "0123456789ABCDEF";
+        for (int i = 0; i < len; i++)
+        {
+            m_streamBuffer[m_compactContents + 1 + 2 * i] = hex[static_cast<BYTE>(signature[i]) >> 4];
+            m_streamBuffer[m_compactContents + 2 + 2 * i] = hex[static_cast<BYTE>(signature[i]) & 0x0F];
         }
+        m_bSigningPending = false;
+        return true;
     }
 
+    PdfSigningResults processed;
+    processed.Intermediate[*m_signerId].assign(signature, signature + len);
+
     m_pSigningContext->FinishSigning(processed);
-    m_placeholderSize = 0;
+    m_bSigningPending = false;
+    return true;
 }
 
 void PdfSignatureGenerator::GetSignedPdf(UUCByteArray& signature)
 {
-    if (!m_pDevice)
+    if (!m_pDevice || m_bSigningPending)
         throw std::runtime_error("No signed PDF available");
 
     std::string data = m_streamBuffer;
@@ -480,6 +1017,11 @@ bool PdfSignatureGenerator::InitExistingSignatureField(const char* szFieldName,
 {
     if (!szFieldName || !m_pPdfDocument)
         return false;
+    m_prepareField = [this, fieldName = std::string(szFieldName), reason = copyString(szReason),
+        name = copyString(szName), location = copyString(szLocation), subFilter = copyString(szSubFilter)]() {
+        return InitExistingSignatureField(fieldName.c_str(), reason.c_str(), name.c_str(),
+            location.c_str(), subFilter.c_str());
+    };
     PdfSignature* signature = FindSignatureField(szFieldName, true);
     if (!signature)
         return false;
@@ -493,39 +1035,15 @@ bool PdfSignatureGenerator::InitFirstUnsignedSignatureField(const char* szReason
 {
     if (!m_pPdfDocument)
         return false;
-    try
-    {
-        auto iterable = m_pPdfDocument->GetFieldsIterator();
-        for (auto it = iterable.begin(); it != iterable.end(); ++it)
-        {
-            PdfField* field = *it;
-            if (!field || field->GetType() != PdfFieldType::Signature)
-                continue;
-            auto* signature = dynamic_cast<PdfSignature*>(field);
-            if (!signature)
-                continue;
-            if (IsFieldSigned(*signature))
-                continue;
-            return PrepareSignatureField(*signature, nullptr, szReason, szName, szLocation, szSubFilter);
-        }
-    }
-    catch (const PdfError&)
-    {
-        return false;
-    }
-    catch (...)
-    {
+    m_prepareField = [this, reason = copyString(szReason), name = copyString(szName),
+        location = copyString(szLocation), subFilter = copyString(szSubFilter)]() {
+        return InitFirstUnsignedSignatureField(reason.c_str(), name.c_str(), location.c_str(),
+            subFilter.c_str());
+    };
+    PdfSignature* signature = FindSignatureField(std::string(), true);
+    if (!signature)
         return false;
-    }
-    auto legacy = ExtractLegacySignatureFields();
-    if (!legacy.empty())
-    {
-        PdfSignature* signature = CreateFieldFromLegacy(legacy.front());
-        if (!signature)
-            return false;
-        return PrepareSignatureField(*signature, nullptr, szReason, szName, szLocation, szSubFilter);
-    }
-    return false;
+    return PrepareSignatureField(*signature, nullptr, szReason, szName, szLocation, szSubFilter);
 }
 
 std::vector<std::string> PdfSignatureGenerator::ListUnsignedSignatureFieldNames() const
@@ -535,33 +1053,16 @@ std::vector<std::string> PdfSignatureGenerator::ListUnsignedSignatureFieldNames(
         return names;
     try
     {
-        auto iterable = m_pPdfDocument->GetFieldsIterator();
-        for (auto it = iterable.begin(); it != iterable.end(); ++it)
+        for (const auto& info : GetFieldIndex().GetFields())
         {
-            PdfField* field = *it;
-            if (!field || field->GetType() != PdfFieldType::Signature)
-                continue;
-            auto* signature = dynamic_cast<PdfSignature*>(field);
-            if (!signature)
-                continue;
-            if (IsFieldSigned(*signature))
-                continue;
-            auto fieldName = getFieldName(field);
-            if (!fieldName.empty())
-                names.push_back(std::move(fieldName));
+            if (!info.isSigned && !info.name.empty())
+                names.push_back(info.name);
         }
     }
-    catch (const PdfError&)
-    {
-        names.clear();
-    }
     catch (...)
     {
         names.clear();
     }
-    auto legacy = ExtractLegacySignatureFields();
-    for (const auto& info : legacy)
-        names.push_back(info.name);
     return names;
 }
 
@@ -572,32 +1073,34 @@ PdfSignature* PdfSignatureGenerator::FindSignatureField(const std::string& field
         return nullptr;
     try
     {
-        auto iterable = m_pPdfDocument->GetFieldsIterator();
-        for (auto it = iterable.begin(); it != iterable.end(); ++it)
+        const PdfSignatureFieldIndex& index = GetFieldIndex();
+        const PdfSignatureFieldInfo* found = nullptr;
+        if (!fieldName.empty())
+            found = index.Find(fieldName);
+        if (found && requireUnsigned && found->isSigned)
+            found = nullptr;
+        if (!found)
         {
-            PdfField* field = *it;
-            if (!field || field->GetType() != PdfFieldType::Signature)
-                continue;
-            auto* signatureField = dynamic_cast<PdfSignature*>(field);
-            if (!signatureField)
-                continue;
-#ifdef ANDROID
-            auto currentNameDebug = getFieldName(field);
-            __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative",
-                "FindSignatureField saw field name=%s signed=%d",
-                currentNameDebug.c_str(),
-                IsFieldSigned(*signatureField) ? 1 : 0);
-#endif
-            if (!fieldName.empty())
+            // primo campo libero, o nome parziale /T di un campo annidato
+            for (const auto& info : index.GetFields())
             {
-                auto currentName = getFieldName(field);
-                if (currentName != fieldName)
+                if (!fieldName.empty() && info.partialName != fieldName)
+                    continue;
+                if (requireUnsigned && info.isSigned)
                     continue;
+                found = &info;
+                break;
             }
-            if (requireUnsigned && IsFieldSigned(*signatureField))
-                continue;
-            return signatureField;
         }
+#ifdef ANDROID
+        __android_log_print(ANDROID_LOG_DEBUG, "CieSignNative",
+            "FindSignatureField name=%s found=%s signed=%d",
+            fieldName.c_str(),
+            found ? found->name.c_str() : "",
+            found && found->isSigned ? 1 : 0);
+#endif
+        if (found)
+            return GetSignatureField(*found);
     }
     catch (const PdfError&)
     {
@@ -605,40 +1108,42 @@ PdfSignature* PdfSignatureGenerator::FindSignatureField(const std::string& field
     catch (...)
     {
     }
-    if (!fieldName.empty())
+    return nullptr;
+}
+
+const PdfSignatureFieldIndex& PdfSignatureGenerator::GetFieldIndex() const
+{
+    // costruito alla prima ricerca sul documento caricato
+    if (!m_pFieldIndex)
+        m_pFieldIndex = std::make_unique<PdfSignatureFieldIndex>(*m_pPdfDocument);
+    return *m_pFieldIndex;
+}
+
+PdfSignature* PdfSignatureGenerator::GetSignatureField(const PdfSignatureFieldInfo& info)
+{
+    if (info.inPageAnnotations)
     {
-        auto legacyFields = ExtractLegacySignatureFields();
-        auto itLegacy = std::find_if(legacyFields.begin(), legacyFields.end(),
-            [&](const LegacyFieldInfo& info) { return info.name == fieldName; });
-        if (itLegacy != legacyFields.end())
-        {
-            return CreateFieldFromLegacy(*itLegacy);
-        }
+        PdfPage& page = m_pPdfDocument->GetPages().GetPageAt(static_cast<unsigned>(info.pageIndex));
+        auto* widget = dynamic_cast<PdfAnnotationWidget*>(&page.GetAnnotations().GetAnnot(info.widgetRef));
+        if (!widget)
+            return nullptr;
+        return dynamic_cast<PdfSignature*>(&widget->GetField());
     }
-    else
+    // widget non collegato alla pagina: il campo viene ricreato
+    if (info.pageIndex >= 0 && info.hasRect && info.rect.Width > 0.0 && info.rect.Height > 0.0 &&
+        !info.name.empty())
+        return CreateFieldFromLegacy(info);
+    // campo senza aspetto, raggiungibile solo da /Fields
+    auto iterable = m_pPdfDocument->GetFieldsIterator();
+    for (auto it = iterable.begin(); it != iterable.end(); ++it)
     {
-        auto legacyFields = ExtractLegacySignatureFields();
-        if (!legacyFields.empty())
-        {
-            return CreateFieldFromLegacy(legacyFields.front());
-        }
+        PdfField* field = *it;
+        if (field && &field->GetObject() == info.field)
+            return dynamic_cast<PdfSignature*>(field);
     }
     return nullptr;
 }
 
-bool PdfSignatureGenerator::IsFieldSigned(const PdfSignature& signature) const
-{
-    const PdfObject* value = signature.GetValueObject();
-    if (!value || !value->IsDictionary())
-        return false;
-    const PdfObject* contents = value->GetDictionary().GetKey("Contents");
-    if (!contents)
-        return false;
-    if (contents->IsNull())
-        return false;
-    return true;
-}
-
 bool PdfSignatureGenerator::PrepareSignatureField(PdfSignature& signature,
     const Rect* customRect,
     const char* szReason,
@@ -693,103 +1198,49 @@ bool PdfSignatureGenerator::PrepareSignatureField(PdfSignature& signature,
     }
 
     m_pSignatureField = &signature;
+    m_pFieldIndex.reset();
     if (!m_signatureImage.empty() && rectValid)
     {
         ApplyAppearanceImage(signature,
                               *m_pPdfDocument,
+                              m_appearanceObjects,
+                              m_signatureImageKey,
                               rect,
             m_signatureImage.data(),
             m_signatureImage.size(),
             m_signatureImageWidth,
-            m_signatureImageHeight);
+            m_signatureImageHeight,
+            m_signatureImageDpi);
     }
-    m_subFilter = szSubFilter && szSubFilter[0] ? szSubFilter : kDefaultSubFilter;
-    return true;
-}
-
-std::vector<PdfSignatureGenerator::LegacyFieldInfo> PdfSignatureGenerator::ExtractLegacySignatureFields() const
-{
-    std::vector<LegacyFieldInfo> legacy;
-    if (!m_pPdfDocument)
-        return legacy;
-
-    try
+    else if (m_pSignatureFont && rectValid)
     {
-        PdfCatalog& catalog = m_pPdfDocument->GetCatalog();
-        PdfObject* acroObj = catalog.GetDictionary().GetKey("AcroForm");
-        if (!acroObj || !acroObj->IsDictionary())
-            return legacy;
-        PdfObject* fieldsObj = acroObj->GetDictionary().GetKey("Fields");
-        if (!fieldsObj || !fieldsObj->IsArray())
-            return legacy;
-        PdfArray& fieldsArray = fieldsObj->GetArray();
-        PdfPageCollection& pages = m_pPdfDocument->GetPages();
-        PdfIndirectObjectList& objects = m_pPdfDocument->GetObjects();
-
-        for (unsigned int i = 0; i < fieldsArray.GetSize(); ++i)
-        {
-            PdfObject& entry = fieldsArray[i];
-            if (!entry.IsReference())
-                continue;
-            PdfObject* resolved = objects.GetObject(entry.GetReference());
-            if (!resolved || !resolved->IsDictionary())
-                continue;
-            PdfDictionary& dict = resolved->GetDictionary();
-            const PdfObject* subtype = dict.GetKey("Subtype");
-            if (!subtype || !subtype->IsName())
-                continue;
-            if (subtype->GetName().GetString() != "Widget")
-                continue;
-            const PdfObject* fieldType = dict.GetKey("FT");
-            if (!fieldType || !fieldType->IsName())
-                continue;
-            if (fieldType->GetName().GetString() != "Sig")
-                continue;
-            const PdfObject* nameObj = dict.GetKey("T");
-            if (!nameObj || !nameObj->IsString())
-                continue;
-            const PdfObject* rectObj = dict.GetKey("Rect");
-            if (!rectObj || !rectObj->IsArray())
-                continue;
-            const PdfObject* pageObj = dict.GetKey("P");
-            if (!pageObj || !pageObj->IsReference())
-                continue;
-            PdfPage& page = pages.GetPage(pageObj->GetReference());
-            Rect rect;
-            const PdfArray& arr = rectObj->GetArray();
-            double left = 0.0, bottom = 0.0, right = 0.0, top = 0.0;
-            if (!arr.TryGetAtAs(0, left) ||
-                !arr.TryGetAtAs(1, bottom) ||
-                !arr.TryGetAtAs(2, right) ||
-                !arr.TryGetAtAs(3, top))
-            {
-                continue;
-            }
-            rect = Rect(left, bottom, right - left, top - bottom);
-            if (rect.Width <= 0.0 || rect.Height <= 0.0)
-                continue;
-
-            LegacyFieldInfo info;
-            auto nameView = nameObj->GetString().GetString();
-            info.name.assign(nameView.data(), nameView.size());
-            info.rect = rect;
-            info.pageIndex = static_cast<int>(page.GetIndex());
-            info.widgetRef = entry.GetReference();
-            legacy.push_back(std::move(info));
-        }
+        // nome, data, motivo e luogo, ognuno preceduto dalla sua etichetta
+        std::time_t signingTime = std::time(nullptr);
+        std::tm localTime{};
+        localtime_r(&signingTime, &localTime);
+        char date[32];
+        std::strftime(date, sizeof(date), "%d/%m/%Y %H:%M:%S", &localTime);
+
+        std::vector<std::string> lines;
+        auto addLine = [&lines](const std::string& label, const char* value) {
+            if (!value || !value[0])
+                return;
+            lines.push_back(label.empty() ? std::string(value) : label + " " + value);
+        };
+        addLine(m_nameLabel, szName);
+        addLine(std::string(), date);
+        addLine(m_reasonLabel, szReason);
+        addLine(m_locationLabel, szLocation);
+        ApplyAppearanceText(signature, *m_pPdfDocument, m_appearanceObjects, *m_pSignatureFont,
+            m_signatureFontName, rect, lines);
     }
-    catch (const PdfError&)
-    {
-    }
-    catch (...)
-    {
-    }
-    return legacy;
+    m_subFilter = szSubFilter && szSubFilter[0] ? szSubFilter : kDefaultSubFilter;
+    return true;
 }
 
-void PdfSignatureGenerator::RemoveLegacyFieldReferences(const LegacyFieldInfo& info,
-    const PdfReference& widgetRef)
+void PdfSignatureGenerator::RemoveLegacyFieldReferences(const PdfSignatureFieldInfo& info)
 {
+    const PdfReference& widgetRef = info.widgetRef;
     if (!m_pPdfDocument || !widgetRef.IsIndirect())
         return;
     try
@@ -822,7 +1273,7 @@ void PdfSignatureGenerator::RemoveLegacyFieldReferences(const LegacyFieldInfo& i
     }
 }
 
-PdfSignature* PdfSignatureGenerator::CreateFieldFromLegacy(const LegacyFieldInfo& info)
+PdfSignature* PdfSignatureGenerator::CreateFieldFromLegacy(const PdfSignatureFieldInfo& info)
 {
     if (!m_pPdfDocument)
         return nullptr;
@@ -832,7 +1283,9 @@ PdfSignature* PdfSignatureGenerator::CreateFieldFromLegacy(const LegacyFieldInfo
         info.rect);
     if (!signature)
         return nullptr;
-    RemoveLegacyFieldReferences(info, info.widgetRef);
+    RemoveLegacyFieldReferences(info);
+    // info appartiene all'indice, non piu' valido dopo la modifica
+    m_pFieldIndex.reset();
     return signature;
 }
 
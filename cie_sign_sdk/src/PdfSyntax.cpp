@@ -0,0 +1,78 @@
+/*
+ *  PdfSyntax.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "PdfSyntax.h"
+
+#include "cryptopp/filters.h"
+#include "cryptopp/zlib.h"
+
+#include <algorithm>
+
+bool CPdfSyntax::deflate(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+	out.clear();
+	try
+	{
+		CryptoPP::ZlibCompressor compressor(new CryptoPP::VectorSink(out), CryptoPP::Deflator::MAX_DEFLATE_LEVEL);
+		compressor.Put(data.data(), data.size());
+		compressor.MessageEnd();
+	}
+	catch(CryptoPP::Exception&)
+	{
+		out.clear();
+		return false;
+	}
+	return true;
+}
+
+bool CPdfSyntax::deflate(const std::string& data, std::string& out)
+{
+	std::vector<uint8_t> buffer;
+	if(!deflate(std::vector<uint8_t>(data.begin(), data.end()), buffer))
+	{
+		out.clear();
+		return false;
+	}
+	out.assign(buffer.begin(), buffer.end());
+	return true;
+}
+
+bool CPdfSyntax::inflate(const std::string& stream, std::string& data, size_t nMaxLength)
+{
+	std::vector<uint8_t> buffer;
+	try
+	{
+		// a blocchi, per fermarsi presto sugli stream che si espandono troppo
+		CryptoPP::ZlibDecompressor decompressor(new CryptoPP::VectorSink(buffer));
+		for(size_t i = 0; i < stream.size(); i += 4096)
+		{
+			decompressor.Put((const uint8_t*)stream.data() + i, std::min<size_t>(4096, stream.size() - i));
+			if(buffer.size() > nMaxLength)
+				return false;
+		}
+		decompressor.MessageEnd();
+	}
+	catch(CryptoPP::Exception&)
+	{
+		return false;
+	}
+	if(buffer.size() > nMaxLength)
+		return false;
+	data.assign(buffer.begin(), buffer.end());
+	return true;
+}
+
+std::string CPdfSyntax::valueOf(const Dictionary& dict, const char* szKey)
+{
+	Dictionary::const_iterator it = dict.find(szKey);
+	return it != dict.end() ? it->second : std::string();
+}
+
+std::string CPdfSyntax::nameOf(const Dictionary& dict, const char* szKey)
+{
+	std::string value = valueOf(dict, szKey);
+	return value.size() > 1 && value[0] == '/' ? value.substr(1) : std::string();
+}
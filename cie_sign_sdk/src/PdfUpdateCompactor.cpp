@@ -0,0 +1,310 @@
+/*
+ *  PdfUpdateCompactor.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "PdfUpdateCompactor.h"
+#include "PdfSyntax.h"
+#include "UUCLogger.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+USE_LOG;
+
+namespace
+{
+	typedef CPdfSyntax::Dictionary Dictionary;
+
+	// voci del trailer che lo stream xref riscrive
+	const char* const xrefKeys[] = {
+		"Type", "Size", "Index", "W", "Prev", "Filter", "DecodeParms", "Length", "XRefStm", "DL"
+	};
+
+	// in pOffsets la posizione del valore di ogni voce
+	std::string dictionaryText(const Dictionary& dict, std::map<std::string, size_t>* pOffsets = NULL)
+	{
+		std::string text = "<<";
+		for(Dictionary::const_iterator it = dict.begin(); it != dict.end(); ++it)
+		{
+			text += "/" + it->first + " ";
+			if(pOffsets)
+				(*pOffsets)[it->first] = text.size();
+			text += it->second + (std::next(it) != dict.end() ? " " : "");
+		}
+		return text + ">>";
+	}
+
+	// byte necessari per un campo dello stream xref
+	int64_t fieldWidth(uint64_t nValue)
+	{
+		int64_t nWidth = 1;
+		while(nWidth < 8 && (nValue >> (8 * nWidth)) != 0)
+			nWidth++;
+		return nWidth;
+	}
+
+	size_t digits(size_t nValue)
+	{
+		size_t nDigits = 1;
+		while(nValue >= 10)
+		{
+			nValue /= 10;
+			nDigits++;
+		}
+		return nDigits;
+	}
+}
+
+CPdfUpdateCompactor::CPdfUpdateCompactor()
+: m_nByteRange(0), m_nObjectStream(0), m_nXref(0)
+{
+	memset(m_byteRange, 0, sizeof(m_byteRange));
+}
+
+CPdfUpdateCompactor::~CPdfUpdateCompactor()
+{
+}
+
+bool CPdfUpdateCompactor::compact(const BYTE* pbtData, size_t nLength, size_t nBase)
+{
+	m_update.clear();
+	m_entries.clear();
+	memset(m_byteRange, 0, sizeof(m_byteRange));
+	m_nByteRange = 0;
+
+	if(!pbtData || nBase == 0 || nBase >= nLength)
+		return false;
+	// servono solo le voci xref delle ultime due revisioni
+	CPdfRevisionMap map;
+	if(map.scan(pbtData, nLength, false) != 0 || map.count() < 2)
+	{
+		LOG_DBG((0, "CPdfUpdateCompactor::compact", "xref not readable, revisions: %d", (int)map.count()));
+		return false;
+	}
+	const CPdfRevisionMap::Revision& revision = map.revision(map.count() - 1);
+	const CPdfRevisionMap::Revision& previous = map.revision(map.count() - 2);
+	if(revision.nXref < nBase || previous.nEnd > nBase || !previous.bXrefStream)
+		return false;
+
+	Dictionary trailer;
+	if(!CPdfRevisionMap::dictionary(revision.trailer, trailer) || trailer.count("Encrypt"))
+		return false;
+	int64_t nPrev = strtoll(CPdfSyntax::valueOf(trailer, "Prev").c_str(), NULL, 10);
+	if(nPrev <= 0)
+		nPrev = (int64_t)previous.nXref;
+
+	// un aggiornamento che inizia sulla stessa riga di %%EOF non e' leggibile
+	if(pbtData[nBase - 1] != '\n' && pbtData[nBase - 1] != '\r')
+		m_update = "\n";
+	// i numeri della /ByteRange entrano nello spazio riservato se il file non cresce
+	size_t nByteRangeWidth = 1 + 3 * (digits(nLength) + 1);
+	if(!writeObjects(map, nBase, nByteRangeWidth))
+		return false;
+	writeXref(revision.trailer, nBase, (size_t)nPrev);
+	size_t nTotal = nBase + m_update.size();
+	if(nTotal >= nLength)
+		return false;
+
+	m_byteRange[3] = (int64_t)nTotal - m_byteRange[2];
+	char szByteRange[96];
+	int nByteRange = snprintf(szByteRange, sizeof(szByteRange), "0 %lld %lld %lld",
+		(long long)m_byteRange[1], (long long)m_byteRange[2], (long long)m_byteRange[3]);
+	if(nByteRange <= 0 || (size_t)nByteRange > nByteRangeWidth)
+		return false;
+	m_update.replace(m_nByteRange, nByteRange, szByteRange);
+	return true;
+}
+
+bool CPdfUpdateCompactor::writeObjects(const CPdfRevisionMap& map, size_t nBase, size_t nByteRangeWidth)
+{
+	size_t nRevision = map.count() - 1;
+	const CPdfRevisionMap::Revision& revision = map.revision(nRevision);
+	Dictionary trailer;
+	CPdfRevisionMap::dictionary(revision.trailer, trailer);
+	uint32_t nSize = (uint32_t)strtoul(CPdfSyntax::valueOf(trailer, "Size").c_str(), NULL, 10);
+
+	// lo stream xref scritto da PoDoFo cede il numero al nuovo
+	m_nXref = 0;
+	std::vector<uint32_t> direct, compressed;
+	uint32_t nSignature = 0;
+	for(std::map<uint32_t, CPdfRevisionMap::Entry>::const_iterator it = revision.entries.begin(); it != revision.entries.end(); ++it)
+	{
+		uint32_t nNumber = it->first;
+		const CPdfRevisionMap::Entry& entry = it->second;
+		if(nNumber >= nSize)
+			nSize = nNumber + 1;
+		if(nNumber == 0 || entry.nType == 0)
+		{
+			m_entries[nNumber] = entry;
+			continue;
+		}
+		if(entry.nType != 1 || entry.nOffset < nBase)
+			return false;
+		if(revision.bXrefStream && entry.nOffset == revision.nXref)
+		{
+			m_nXref = nNumber;
+			continue;
+		}
+
+		std::string text;
+		Dictionary dict;
+		if(!map.object(nNumber, nRevision, text))
+			return false;
+		bool bSignature = CPdfRevisionMap::dictionary(text, dict) && dict.count("ByteRange") && dict.count("Contents");
+		if(bSignature)
+		{
+			// una sola firma per aggiornamento
+			if(nSignature)
+				return false;
+			nSignature = nNumber;
+		}
+		else if(entry.nGeneration != 0 || map.hasStream(nNumber, nRevision))
+		{
+			direct.push_back(nNumber);
+		}
+		else
+		{
+			compressed.push_back(nNumber);
+		}
+	}
+	if(!nSignature)
+		return false;
+	if(!m_nXref)
+		m_nXref = nSize++;
+	m_nObjectStream = compressed.empty() ? 0 : nSize++;
+
+	// firma per prima: /Contents deve restare nel file, fuori dalla /ByteRange
+	direct.insert(direct.begin(), nSignature);
+	for(size_t i = 0; i < direct.size(); i++)
+	{
+		uint32_t nNumber = direct[i];
+		const CPdfRevisionMap::Entry& entry = revision.entries.at(nNumber);
+		std::string text, stream;
+		Dictionary dict;
+		if(!map.object(nNumber, nRevision, text, &stream))
+			return false;
+
+		CPdfRevisionMap::Entry written = { entry.nGeneration, 1, nBase + m_update.size(), 0 };
+		m_entries[nNumber] = written;
+		std::string header = std::to_string(nNumber) + " " + std::to_string(entry.nGeneration) + " obj\n";
+		if(nNumber == nSignature)
+		{
+			CPdfRevisionMap::dictionary(text, dict);
+			std::string contents = dict["Contents"];
+			if(contents.size() < 2 || contents[0] != '<' || contents[1] == '<' || contents[contents.size() - 1] != '>')
+				return false;
+			// /ByteRange provvisoria, riempita quando si conosce la lunghezza del file
+			dict["ByteRange"] = "[" + std::string(nByteRangeWidth, ' ') + "]";
+			std::map<std::string, size_t> offsets;
+			std::string body = dictionaryText(dict, &offsets);
+			size_t nStart = m_update.size() + header.size();
+			m_nByteRange = nStart + offsets["ByteRange"] + 1;
+			m_byteRange[1] = (int64_t)(nBase + nStart + offsets["Contents"]);
+			m_byteRange[2] = m_byteRange[1] + (int64_t)contents.size();
+			m_update += header + body + "\nendobj\n";
+		}
+		else if(map.hasStream(nNumber, nRevision))
+		{
+			// /Length diretta: l'oggetto della lunghezza puo' finire nello stream di oggetti
+			if(!CPdfRevisionMap::dictionary(text, dict))
+				return false;
+			dict["Length"] = std::to_string(stream.size());
+			m_update += header + dictionaryText(dict) + "\nstream\n" + stream + "\nendstream\nendobj\n";
+		}
+		else
+		{
+			m_update += header + text + "\nendobj\n";
+		}
+	}
+	if(compressed.empty())
+		return true;
+
+	// coppie numero / offset, poi gli oggetti separati da un fine riga
+	std::string pairs, objects, data;
+	for(size_t i = 0; i < compressed.size(); i++)
+	{
+		std::string text;
+		if(!map.object(compressed[i], nRevision, text))
+			return false;
+		pairs += std::to_string(compressed[i]) + " " + std::to_string(objects.size()) + (i + 1 < compressed.size() ? " " : "\n");
+		objects += text + "\n";
+		CPdfRevisionMap::Entry written = { 0, 2, m_nObjectStream, (uint32_t)i };
+		m_entries[compressed[i]] = written;
+	}
+	if(!CPdfSyntax::deflate(pairs + objects, data))
+		return false;
+	CPdfRevisionMap::Entry written = { 0, 1, nBase + m_update.size(), 0 };
+	m_entries[m_nObjectStream] = written;
+	m_update += std::to_string(m_nObjectStream) + " 0 obj\n<</Type /ObjStm /N " + std::to_string(compressed.size()) +
+		" /First " + std::to_string(pairs.size()) + " /Filter /FlateDecode /Length " + std::to_string(data.size()) +
+		">>\nstream\n" + data + "\nendstream\nendobj\n";
+	return true;
+}
+
+void CPdfUpdateCompactor::writeXref(const std::string& trailer, size_t nBase, size_t nPrev)
+{
+	size_t nXref = nBase + m_update.size();
+	CPdfRevisionMap::Entry self = { 0, 1, nXref, 0 };
+	m_entries[m_nXref] = self;
+
+	// tipo 0: prossimo oggetto libero e generazione; 1: offset e generazione; 2: stream e indice
+	uint64_t nMax2 = 0, nMax3 = 0;
+	for(std::map<uint32_t, CPdfRevisionMap::Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		nMax2 = std::max<uint64_t>(nMax2, it->second.nOffset);
+		nMax3 = std::max<uint64_t>(nMax3, it->second.nType == 2 ? it->second.nIndex : it->second.nGeneration);
+	}
+	int64_t widths[3] = { 1, fieldWidth(nMax2), fieldWidth(nMax3) };
+
+	std::string index, rows;
+	uint32_t nFirst = 0, nCount = 0;
+	for(std::map<uint32_t, CPdfRevisionMap::Entry>::const_iterator it = m_entries.begin(); it != m_entries.end(); ++it)
+	{
+		if(nCount && it->first != nFirst + nCount)
+		{
+			index += std::to_string(nFirst) + " " + std::to_string(nCount) + " ";
+			nCount = 0;
+		}
+		if(!nCount)
+			nFirst = it->first;
+		nCount++;
+		const CPdfRevisionMap::Entry& entry = it->second;
+		uint64_t fields[3] = { (uint64_t)entry.nType, entry.nOffset, entry.nType == 2 ? entry.nIndex : entry.nGeneration };
+		for(size_t k = 0; k < 3; k++)
+		{
+			for(int64_t b = widths[k]; b > 0; b--)
+				rows += (char)((fields[k] >> (8 * (b - 1))) & 0xFF);
+		}
+	}
+	index += std::to_string(nFirst) + " " + std::to_string(nCount);
+
+	std::string data;
+	if(!CPdfSyntax::deflate(rows, data))
+		data.clear();
+	Dictionary dict;
+	CPdfRevisionMap::dictionary(trailer, dict);
+	for(size_t i = 0; i < sizeof(xrefKeys) / sizeof(xrefKeys[0]); i++)
+		dict.erase(xrefKeys[i]);
+	dict["Type"] = "/XRef";
+	dict["Size"] = std::to_string(m_entries.rbegin()->first + 1);
+	dict["Index"] = "[" + index + "]";
+	dict["W"] = "[" + std::to_string(widths[0]) + " " + std::to_string(widths[1]) + " " + std::to_string(widths[2]) + "]";
+	dict["Prev"] = std::to_string(nPrev);
+	if(data.empty())
+	{
+		data = rows;
+	}
+	else
+	{
+		dict["Filter"] = "/FlateDecode";
+	}
+	dict["Length"] = std::to_string(data.size());
+	m_update += std::to_string(m_nXref) + " 0 obj\n" + dictionaryText(dict) + "\nstream\n" + data +
+		"\nendstream\nendobj\nstartxref\n" + std::to_string(nXref) + "\n%%EOF\n";
+}
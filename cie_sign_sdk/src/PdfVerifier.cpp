@@ -10,12 +10,24 @@
 #ifndef HP_UX
 
 #include "PdfVerifier.h"
+#include "PdfRevisionMap.h"
+#include "PdfSignatureFieldIndex.h"
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <climits>
 #include <cstring>
+#include <exception>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "ASN1/SignedData.h"
 #include "ASN1/SignerInfo.h"
 #include "SignedDocument.h"
@@ -167,36 +179,6 @@ const PdfObject* findSignatureValueObject(const PdfMemDocument* doc, const PdfOb
     return nullptr;
 }
 
-bool extractFieldRect(const PdfMemDocument* doc, const PdfObject* field, Rect& rect)
-{
-    if (!field || !field->IsDictionary())
-        return false;
-    const PdfObject* rectObj = field->GetDictionary().GetKey(PdfName("Rect"));
-    if (rectObj && rectObj->IsArray())
-    {
-        rect = Rect::FromArray(rectObj->GetArray());
-        return true;
-    }
-    const PdfObject* kids = resolveObject(doc, field->GetDictionary().GetKey(PdfName("Kids")));
-    if (kids && kids->IsArray())
-    {
-        const PdfArray& arr = kids->GetArray();
-        for (unsigned int i = 0; i < arr.GetSize(); ++i)
-        {
-            const PdfObject* kid = resolveObject(doc, &arr[i]);
-            if (!kid || !kid->IsDictionary())
-                continue;
-            const PdfObject* kidRect = kid->GetDictionary().GetKey(PdfName("Rect"));
-            if (kidRect && kidRect->IsArray())
-            {
-                rect = Rect::FromArray(kidRect->GetArray());
-                return true;
-            }
-        }
-    }
-    return false;
-}
-
 bool isSignatureFieldObject(const PdfMemDocument* doc, const PdfObject* obj)
 {
     const PdfObject* field = resolveObject(doc, obj);
@@ -213,92 +195,62 @@ bool isSignatureFieldObject(const PdfMemDocument* doc, const PdfObject* obj)
     return signature && signature->IsDictionary();
 }
 
-bool extractByteRange(const PdfObject* obj, std::array<long long, 4>& range)
-{
-    if (!obj || !obj->IsArray())
-        return false;
-    const PdfArray& arr = obj->GetArray();
-    if (arr.GetSize() != range.size())
-        return false;
-    for (size_t i = 0; i < range.size(); ++i)
-        range[i] = arr.MustFindAt(i).GetNumberLenient();
-    return true;
-}
-
-bool buildSignedContent(const std::array<long long, 4>& range,
+// intervalli della /ByteRange nel PDF caricato, passati all'hash senza copiarli
+bool byteRangeSegments(const std::array<int64_t, 4>& range,
     const char* buffer,
     size_t bufferLength,
-    UUCByteArray& out)
+    CONTENT_SEGMENTS& segments)
 {
     if (!buffer)
         return false;
-    out.removeAll();
+    segments.clear();
     for (size_t i = 0; i < range.size(); i += 2)
     {
-        long long start = range[i];
-        long long len = range[i + 1];
+        int64_t start = range[i];
+        int64_t len = range[i + 1];
         if (start < 0 || len < 0 ||
-            static_cast<unsigned long long>(start + len) > bufferLength)
+            static_cast<uint64_t>(start) > bufferLength ||
+            static_cast<uint64_t>(len) > bufferLength - static_cast<size_t>(start))
             return false;
-        out.append(reinterpret_cast<const BYTE*>(buffer + start),
-            static_cast<unsigned int>(len));
+        segments.push_back(std::make_pair(reinterpret_cast<const BYTE*>(buffer + start),
+            static_cast<size_t>(len)));
     }
     return true;
 }
 
-bool collectSignatureFields(const PdfMemDocument* doc,
-    std::vector<const PdfObject*>& fields)
+void unmapFile(void*& pData, size_t& nSize)
 {
-    if (!doc)
-        return false;
-    const PdfObject* trailer = &doc->GetTrailer().GetObject();
-    if (!trailer || !trailer->IsDictionary())
-        return false;
-    const PdfObject* catalogRef = trailer->GetDictionary().GetKey(PdfName("Root"));
-    const PdfObject* catalog = resolveObject(doc, catalogRef);
-    if (!catalog || !catalog->IsDictionary())
-        return false;
-    const PdfObject* acroFormValue = catalog->GetDictionary().GetKey(PdfName("AcroForm"));
-    if (!acroFormValue)
-        return true;
-    acroFormValue = resolveObject(doc, acroFormValue);
-    if (!acroFormValue || !acroFormValue->IsDictionary())
-        return true;
-    const PdfObject* fieldsValue = acroFormValue->GetDictionary().GetKey(PdfName("Fields"));
-    if (!fieldsValue)
-        return true;
-    fieldsValue = resolveObject(doc, fieldsValue);
-    if (!fieldsValue || !fieldsValue->IsArray())
-        return true;
-    const PdfArray& array = fieldsValue->GetArray();
-    for (unsigned int i = 0; i < array.GetSize(); ++i)
-    {
-        const PdfObject& entry = array[i];
-        const PdfObject* resolved = resolveObject(doc, &entry);
-        if (isSignatureFieldObject(doc, resolved))
-            fields.push_back(resolved);
-    }
-    return true;
+    if (pData)
+        munmap(pData, nSize);
+    pData = NULL;
+    nSize = 0;
 }
 
 } // namespace
 
 PDFVerifier::PDFVerifier()
-: m_pPdfDocument(NULL), m_actualLen(0)
+: m_pPdfDocument(NULL), m_actualLen(0), m_pMappedFile(NULL), m_nMappedSize(0)
 {
 	
 }
 
 PDFVerifier::~PDFVerifier()
 {
+	m_pFieldIndex.reset();
+	m_pRevisionMap.reset();
 	if(m_pPdfDocument)
 		delete m_pPdfDocument;
+	unmapFile(m_pMappedFile, m_nMappedSize);
 }
 
 int PDFVerifier::Load(const char* pdf, int len)
 {
+	m_pFieldIndex.reset();
+	m_pRevisionMap.reset();
 	if(m_pPdfDocument)
 		delete m_pPdfDocument;
+	m_pPdfDocument = NULL;
+	unmapFile(m_pMappedFile, m_nMappedSize);
 	
 	try
 	{
@@ -310,6 +262,7 @@ int PDFVerifier::Load(const char* pdf, int len)
             static_cast<size_t>(m_data.getLength()));
         m_pPdfDocument->LoadFromBuffer(buffer);
         m_szDocBuffer = reinterpret_cast<const char*>(m_data.getContent());
+        m_pFieldIndex.reset(new PdfSignatureFieldIndex(*m_pPdfDocument));
 		
 		return 0;
 	}
@@ -325,33 +278,45 @@ int PDFVerifier::Load(const char* pdf, int len)
 
 int PDFVerifier::Load(const char* szFilePath)
 {
+    m_pFieldIndex.reset();
+    m_pRevisionMap.reset();
     if(m_pPdfDocument)
         delete m_pPdfDocument;
+    m_pPdfDocument = NULL;
+    unmapFile(m_pMappedFile, m_nMappedSize);
+    m_data.removeAll();
     
     try
     {
-        m_pPdfDocument = new PdfMemDocument();
-        m_pPdfDocument->Load(szFilePath);
-        
-        BYTE buffer[BUFFERSIZE];
-        int nRead = 0;
-    
-        FILE* f = fopen(szFilePath, "rb");
-        if(!f)
+        // il file e' mappato in memoria: PoDoFo e la verifica leggono le stesse pagine,
+        // senza una copia del documento
+        int fd = ::open(szFilePath, O_RDONLY);
+        if(fd < 0)
         {
             return DISIGON_ERROR_FILE_NOT_FOUND;
         }
-    
-        m_data.removeAll();
         
-        while(((nRead = fread(buffer, 1, BUFFERSIZE, f)) > 0))
+        struct stat st;
+        void* pData = MAP_FAILED;
+        if(fstat(fd, &st) == 0 && st.st_size > 0 && st.st_size <= INT_MAX)
+            pData = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        
+        ::close(fd);
+        
+        if(pData == MAP_FAILED)
         {
-            m_data.append(buffer, nRead);
+            return -1;
         }
         
-        fclose(f);
-        m_actualLen = m_data.getLength();
-        m_szDocBuffer = (char*)m_data.getContent();
+        m_pMappedFile = pData;
+        m_nMappedSize = static_cast<size_t>(st.st_size);
+        
+        m_pPdfDocument = new PdfMemDocument();
+        m_pPdfDocument->LoadFromBuffer(bufferview(static_cast<const char*>(pData), m_nMappedSize));
+        
+        m_actualLen = static_cast<int>(m_nMappedSize);
+        m_szDocBuffer = static_cast<const char*>(pData);
+        m_pFieldIndex.reset(new PdfSignatureFieldIndex(*m_pPdfDocument));
         
         return 0;
     }
@@ -395,76 +360,148 @@ int PDFVerifier::GetNumberOfSignatures(PdfMemDocument* pPdfDocument)
 {
 	if(!pPdfDocument)
 		return -1;
-    std::vector<const PdfObject*> signatureVector;
-    if (!collectSignatureFields(pPdfDocument, signatureVector))
-        return -1;
-	return static_cast<int>(signatureVector.size());
+	PdfSignatureFieldIndex index(*pPdfDocument);
+	return static_cast<int>(index.GetSignatures().size());
 }
 
 int PDFVerifier::GetNumberOfSignatures()
 {
-	if(!m_pPdfDocument)
+	if(!m_pPdfDocument || !m_pFieldIndex)
 		return -1;
 	
-	return GetNumberOfSignatures(m_pPdfDocument);
+	return static_cast<int>(m_pFieldIndex->GetSignatures().size());
 		
 }
 
 int PDFVerifier::VerifySignature(int index, const char* szDate, char* signatureType, REVOCATION_INFO* pRevocationInfo)
 {
-	if(!m_pPdfDocument)
+	if(!m_pPdfDocument || !m_pFieldIndex)
 		return -1;
-    std::vector<const PdfObject*> signatureVector;
-    if (!collectSignatureFields(m_pPdfDocument, signatureVector))
-        return -1;
-	if(index < 0 || static_cast<size_t>(index) >= signatureVector.size())
+	const std::vector<const PdfSignatureFieldInfo*>& signatures = m_pFieldIndex->GetSignatures();
+	if(index < 0 || static_cast<size_t>(index) >= signatures.size())
 		return 0;
-	return VerifySignature(m_pPdfDocument, signatureVector[index], szDate, signatureType, pRevocationInfo);
+	SignatureVerifyResult signature;
+	ReadSignature(*signatures[index], signature);
+	if (signatureType && signature.nVerifyError != -4)
+		std::strcpy(signatureType, signature.subFilter.c_str());
+	return VerifySignature(signature, szDate, pRevocationInfo);
 }
 
-
-int PDFVerifier::VerifySignature(const PdfMemDocument* pDoc, const PdfObject *const pObj, const char* szDate, char* signatureType, REVOCATION_INFO* pRevocationInfo)
+int PDFVerifier::VerifySignatures(const char* szDate, bool bRevocation, vector<SignatureVerifyResult>& results,
+	const function<void(size_t, SignatureVerifyResult&)>& fnVerified)
 {
-	const PdfObject* field = resolveObject(pDoc, pObj);
-	if (!field || !field->IsDictionary())
+	results.clear();
+	if(!m_pPdfDocument || !m_pFieldIndex)
 		return -1;
-	const PdfObject* keyFTValue = field->GetDictionary().GetKey(PdfName("FT"));
-	if (!keyFTValue)
-		return -2;
-	string value;
-	keyFTValue->ToString(value);
-	if (value != "/Sig")
-		return -3;
-	const PdfObject* keyVValue = field->GetDictionary().GetKey(PdfName("V"));
-	if (!keyVValue)
-		return -4;
-	const PdfObject* signature = resolveObject(pDoc, keyVValue);
-	if (!signature || !signature->IsDictionary())
-		return -6;
-	std::string subfilter;
+
+	// PoDoFo carica gli oggetti alla prima lettura: il documento si legge solo qui
+	const std::vector<const PdfSignatureFieldInfo*>& signatures = m_pFieldIndex->GetSignatures();
+	results.resize(signatures.size());
+	for (size_t i = 0; i < signatures.size(); i++)
+	{
+		ReadSignature(*signatures[i], results[i]);
+		if (results[i].nError)
+			return results[i].nError;
+	}
+	if (results.empty())
+		return 0;
+
+	std::vector<std::exception_ptr> errors(results.size());
+	std::atomic<size_t> nNext(0);
+	auto verify = [&]() {
+		for (size_t i = nNext++; i < results.size(); i = nNext++)
+		{
+			try
+			{
+				results[i].bitmask = VerifySignature(results[i], szDate, bRevocation ? &results[i].revocationInfo : NULL);
+				if (fnVerified)
+					fnVerified(i, results[i]);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	size_t nThreads = std::max(1u, std::thread::hardware_concurrency());
+	nThreads = std::min(std::min(nThreads, static_cast<size_t>(PDF_VERIFY_MAX_THREADS)), results.size());
+
+	// la prima firma si verifica nel thread chiamante, le altre in parallelo
+	std::vector<std::thread> threads;
+	for (size_t t = 1; t < nThreads; t++)
+		threads.push_back(std::thread(verify));
+	verify();
+	for (size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	// come nella verifica in serie, l'eccezione della prima firma in ordine
+	for (size_t i = 0; i < errors.size(); i++)
+	{
+		if (errors[i])
+			std::rethrow_exception(errors[i]);
+	}
+	return 0;
+}
+
+
+void PDFVerifier::ReadSignature(const PdfSignatureFieldInfo& field, SignatureVerifyResult& result)
+{
+	result.signature.removeAll();
+	std::memset(&result.appearance, 0, sizeof(result.appearance));
+	result.nError = 0;
+	result.bitmask = 0;
+	result.subFilter.clear();
+	std::memset(&result.revocationInfo, 0, sizeof(result.revocationInfo));
+	result.byteRange = field.byteRange;
+	result.nVerifyError = 0;
+
+	if (field.hasRect)
+	{
+		result.appearance.left = static_cast<int>(field.rect.GetLeft());
+		result.appearance.bottom = static_cast<int>(field.rect.GetBottom());
+		result.appearance.width = static_cast<int>(field.rect.Width);
+		result.appearance.heigth = static_cast<int>(field.rect.Height);
+	}
+	else
+		result.nError = -4;
+
+	const PdfObject* signature = field.value;
+	if (!signature)
+	{
+		if (!result.nError)
+			result.nError = -6;
+		result.nVerifyError = -4;
+		return;
+	}
 	if (const PdfObject* keySubFilter = signature->GetDictionary().GetKey(PdfName("SubFilter")))
-		keySubFilter->ToString(subfilter);
-	if (signatureType)
-		std::strcpy(signatureType, subfilter.c_str());
-	std::array<long long, 4> byteRange{};
-	const PdfObject* keyByteRange = signature->GetDictionary().GetKey(PdfName("ByteRange"));
-	if (!extractByteRange(keyByteRange, byteRange))
-		return -5;
-	UUCByteArray cmsData;
-	if (!extractContentsData(signature->GetDictionary().GetKey(PdfName("Contents")), cmsData))
-		return -6;
-	CSignedDocument signedDocument(cmsData.getContent(), cmsData.getLength());
+		keySubFilter->ToString(result.subFilter);
+	bool hasContents = extractContentsData(signature->GetDictionary().GetKey(PdfName("Contents")), result.signature);
+	if (!hasContents && !result.nError)
+		result.nError = -6;
+	if (!field.hasByteRange)
+		result.nVerifyError = -5;
+	else if (!hasContents)
+		result.nVerifyError = -6;
+}
+
+
+int PDFVerifier::VerifySignature(const SignatureVerifyResult& signature, const char* szDate, REVOCATION_INFO* pRevocationInfo) const
+{
+	if (signature.nVerifyError)
+		return signature.nVerifyError;
+	CSignedDocument signedDocument(signature.signature.getContent(), signature.signature.getLength());
 	CSignedData signedData(signedDocument.getSignedData());
+	const std::string& subfilter = signature.subFilter;
 	if(subfilter == "/adbe.pkcs7.detached" || subfilter == "/ETSI.CAdES.detached")
 	{
-		UUCByteArray baContent;
-		if (!buildSignedContent(byteRange, m_szDocBuffer, static_cast<size_t>(m_actualLen), baContent))
+		CONTENT_SEGMENTS content;
+		if (!byteRangeSegments(signature.byteRange, m_szDocBuffer, static_cast<size_t>(m_actualLen), content))
 			return -5;
 		CASN1SetOf signerInfos = signedData.getSignerInfos();
 		CSignerInfo signerInfo(signerInfos.elementAt(0));
 		CASN1SetOf certificates = signedData.getCertificates();
-		CASN1OctetString actualContent(baContent);
-		return CSignerInfo::verifySignature(actualContent, signerInfo, certificates, szDate, pRevocationInfo);
+		return CSignerInfo::verifySignature(content, signerInfo, certificates, szDate, pRevocationInfo);
 	}
 	else if(subfilter == "/adbe.pkcs7.sha1")
 	{
@@ -480,41 +517,60 @@ bool PDFVerifier::IsSignatureField(const PdfMemDocument* pDoc, const PdfObject *
 }
 
 
-
-
-int PDFVerifier::GetSignature(int index, UUCByteArray& signedDocument, SignatureAppearanceInfo& signatureInfo)
+int PDFVerifier::GetSignatureCoverage(int index, SignatureCoverage& coverage)
 {
-	if(!m_pPdfDocument)
+	std::memset(&coverage, 0, sizeof(coverage));
+	coverage.nRevision = -1;
+	if(!m_pPdfDocument || !m_pFieldIndex)
 		return -1;
-    std::vector<const PdfObject*> signatureVector;
-    if (!collectSignatureFields(m_pPdfDocument, signatureVector))
-        return -1;
-    if(index < 0 || static_cast<size_t>(index) >= signatureVector.size())
+	const std::vector<const PdfSignatureFieldInfo*>& signatures = m_pFieldIndex->GetSignatures();
+	if(index < 0 || static_cast<size_t>(index) >= signatures.size())
 		return -8;
-	return GetSignature(m_pPdfDocument, signatureVector[index], signedDocument, signatureInfo);
+	const PdfSignatureFieldInfo& field = *signatures[index];
+	if(!field.hasByteRange)
+		return -5;
+
+	if(!m_pRevisionMap)
+	{
+		std::unique_ptr<CPdfRevisionMap> pRevisionMap(new CPdfRevisionMap());
+		long nRet = pRevisionMap->scan(reinterpret_cast<const BYTE*>(m_szDocBuffer), static_cast<size_t>(m_actualLen));
+		if(nRet)
+			return static_cast<int>(nRet);
+		m_pRevisionMap = std::move(pRevisionMap);
+	}
+
+	const int64_t* byteRange = field.byteRange.data();
+	coverage.nRevisions = static_cast<int>(m_pRevisionMap->count());
+	coverage.nRevision = m_pRevisionMap->revisionOf(byteRange);
+	coverage.bWholeDocument = byteRange[0] == 0 && byteRange[2] >= 0 && byteRange[3] >= 0 &&
+		static_cast<uint64_t>(byteRange[2]) + static_cast<uint64_t>(byteRange[3]) == static_cast<uint64_t>(m_actualLen);
+	if(coverage.nRevision >= 0)
+		coverage.nChanges = m_pRevisionMap->changesAfter(coverage.nRevision);
+	else if(!coverage.bWholeDocument)
+		// la firma non termina su una revisione: quello che segue non e' classificabile
+		coverage.nChanges = PDF_UPDATE_CONTENT;
+	return 0;
 }
 
 
-int PDFVerifier::GetSignature(const PdfMemDocument* pDoc, const PdfObject *const pObj, UUCByteArray& signedDocument, SignatureAppearanceInfo& appearanceInfo)
+
+
+int PDFVerifier::GetSignature(int index, UUCByteArray& signedDocument, SignatureAppearanceInfo& signatureInfo)
 {
-	const PdfObject* field = resolveObject(pDoc, pObj);
-	if (!field || !field->IsDictionary())
+	if(!m_pPdfDocument || !m_pFieldIndex)
 		return -1;
-    Rect rect;
-    if (!extractFieldRect(pDoc, field, rect))
+	const std::vector<const PdfSignatureFieldInfo*>& signatures = m_pFieldIndex->GetSignatures();
+    if(index < 0 || static_cast<size_t>(index) >= signatures.size())
+		return -8;
+	SignatureVerifyResult signature;
+	ReadSignature(*signatures[index], signature);
+	if (signature.nError == -4)
 		return -4;
-	appearanceInfo.left = static_cast<int>(rect.GetLeft());
-	appearanceInfo.bottom = static_cast<int>(rect.GetBottom());
-	appearanceInfo.width = static_cast<int>(rect.Width);
-	appearanceInfo.heigth = static_cast<int>(rect.Height);
-	const PdfObject* signature = findSignatureValueObject(pDoc, field);
-	if (!signature || !signature->IsDictionary())
-		return -6;
-	UUCByteArray tempContents;
-	if (!extractContentsData(signature->GetDictionary().GetKey(PdfName("Contents")), tempContents))
-		return -6;
+	signatureInfo = signature.appearance;
+	if (signature.nError)
+		return signature.nError;
 	signedDocument.removeAll();
-	signedDocument.append(tempContents.getContent(), tempContents.getLength());
+	signedDocument.append(signature.signature.getContent(), signature.signature.getLength());
 	return 0;
 }
 
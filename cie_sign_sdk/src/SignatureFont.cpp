@@ -0,0 +1,554 @@
+/*
+ *  SignatureFont.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "SignatureFont.h"
+#include "PdfSyntax.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+// tabelle copiate nel font ridotto, in ordine di tag
+static const char* const SUBSET_TABLES[] = { "cvt ", "fpgm", "glyf", "head", "hhea", "hmtx", "loca", "maxp", "prep" };
+
+// glifi composti (tabella glyf)
+#define ARG_1_AND_2_ARE_WORDS	0x0001
+#define WE_HAVE_A_SCALE			0x0008
+#define MORE_COMPONENTS			0x0020
+#define WE_HAVE_AN_X_AND_Y_SCALE	0x0040
+#define WE_HAVE_A_TWO_BY_TWO	0x0080
+
+namespace
+{
+	std::mutex g_fontsMutex;
+	std::map<std::string, std::shared_ptr<const CSignatureFont>> g_fonts;
+
+	uint16_t readUShort(const uint8_t* p)
+	{
+		return (uint16_t)((p[0] << 8) | p[1]);
+	}
+
+	int16_t readShort(const uint8_t* p)
+	{
+		return (int16_t)readUShort(p);
+	}
+
+	uint32_t readULong(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+	}
+
+	void writeUShort(std::vector<uint8_t>& out, uint16_t n)
+	{
+		out.push_back((uint8_t)(n >> 8));
+		out.push_back((uint8_t)n);
+	}
+
+	void writeULong(std::vector<uint8_t>& out, uint32_t n)
+	{
+		writeUShort(out, (uint16_t)(n >> 16));
+		writeUShort(out, (uint16_t)n);
+	}
+
+	void patchULong(std::vector<uint8_t>& out, size_t nOffset, uint32_t n)
+	{
+		out[nOffset] = (uint8_t)(n >> 24);
+		out[nOffset + 1] = (uint8_t)(n >> 16);
+		out[nOffset + 2] = (uint8_t)(n >> 8);
+		out[nOffset + 3] = (uint8_t)n;
+	}
+
+	// checksum di una tabella, su parole di 4 byte (la tabella e' gia' allineata)
+	uint32_t checksum(const uint8_t* p, size_t nLength)
+	{
+		uint32_t nSum = 0;
+		for(size_t i = 0; i < nLength; i += 4)
+			nSum += readULong(p + i);
+		return nSum;
+	}
+
+	void appendHex(std::string& out, uint16_t n)
+	{
+		char sz[8];
+		snprintf(sz, sizeof(sz), "%04X", n);
+		out += sz;
+	}
+}
+
+CSignatureFont::CSignatureFont()
+: m_glyf(), m_loca(), m_hmtx(), m_cmap(), m_nCmapFormat(0), m_nUnitsPerEm(0), m_nGlyphs(0),
+  m_nHMetrics(0), m_bLongLoca(false), m_nAscent(0), m_nDescent(0), m_bbox()
+{
+}
+
+std::shared_ptr<const CSignatureFont> CSignatureFont::load(const char* szPath)
+{
+	if(!szPath || !szPath[0])
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(g_fontsMutex);
+	auto it = g_fonts.find(szPath);
+	if(it != g_fonts.end())
+		return it->second;
+
+	FILE* f = fopen(szPath, "rb");
+	if(!f)
+		return nullptr;
+
+	std::shared_ptr<CSignatureFont> pFont(new CSignatureFont());
+	uint8_t buffer[8192];
+	size_t nRead;
+	while((nRead = fread(buffer, 1, sizeof(buffer), f)) > 0)
+		pFont->m_data.insert(pFont->m_data.end(), buffer, buffer + nRead);
+	fclose(f);
+
+	if(!pFont->parse())
+		return nullptr;
+
+	g_fonts[szPath] = pFont;
+	return pFont;
+}
+
+bool CSignatureFont::table(const char* szTag, Table& table) const
+{
+	uint16_t nTables = readUShort(&m_data[4]);
+	for(uint16_t i = 0; i < nTables; i++)
+	{
+		const uint8_t* pRecord = &m_data[12 + i * 16];
+		if(memcmp(pRecord, szTag, 4) != 0)
+			continue;
+
+		table.nOffset = readULong(pRecord + 8);
+		table.nLength = readULong(pRecord + 12);
+		return table.nOffset <= m_data.size() && table.nLength <= m_data.size() - table.nOffset;
+	}
+	return false;
+}
+
+bool CSignatureFont::parse()
+{
+	if(m_data.size() < 12)
+		return false;
+
+	// solo contorni TrueType: niente CFF (OTTO) ne' collezioni (ttcf)
+	uint32_t nVersion = readULong(&m_data[0]);
+	if(nVersion != 0x00010000 && nVersion != 0x74727565)
+		return false;
+	if(m_data.size() < 12 + (size_t)readUShort(&m_data[4]) * 16)
+		return false;
+
+	Table head, hhea, maxp;
+	if(!table("head", head) || !table("hhea", hhea) || !table("maxp", maxp) || !table("hmtx", m_hmtx) ||
+		!table("loca", m_loca) || !table("glyf", m_glyf) || !table("cmap", m_cmap))
+		return false;
+	if(head.nLength < 54 || hhea.nLength < 36 || maxp.nLength < 6)
+		return false;
+
+	const uint8_t* pHead = &m_data[head.nOffset];
+	m_nUnitsPerEm = readUShort(pHead + 18);
+	m_bLongLoca = readShort(pHead + 50) == 1;
+	m_nGlyphs = readUShort(&m_data[maxp.nOffset + 4]);
+	m_nHMetrics = readUShort(&m_data[hhea.nOffset + 34]);
+	if(m_nUnitsPerEm == 0 || m_nGlyphs == 0 || m_nHMetrics == 0 || m_nHMetrics > m_nGlyphs)
+		return false;
+	if(m_hmtx.nLength < (uint32_t)m_nHMetrics * 4)
+		return false;
+	if(m_loca.nLength < (uint32_t)(m_nGlyphs + 1) * (m_bLongLoca ? 4 : 2))
+		return false;
+
+	m_nAscent = readShort(&m_data[hhea.nOffset + 4]) * 1000 / m_nUnitsPerEm;
+	m_nDescent = readShort(&m_data[hhea.nOffset + 6]) * 1000 / m_nUnitsPerEm;
+	for(int i = 0; i < 4; i++)
+		m_bbox[i] = readShort(pHead + 36 + i * 2) * 1000 / m_nUnitsPerEm;
+
+	// cmap Unicode: formato 12 (anche fuori dal BMP) o formato 4
+	const uint8_t* pCmap = &m_data[m_cmap.nOffset];
+	if(m_cmap.nLength < 4)
+		return false;
+	uint16_t nSubtables = readUShort(pCmap + 2);
+	if(m_cmap.nLength < 4 + (uint32_t)nSubtables * 8)
+		return false;
+
+	uint32_t nBest = 0;
+	int nBestScore = 0;
+	for(uint16_t i = 0; i < nSubtables; i++)
+	{
+		uint16_t nPlatform = readUShort(pCmap + 4 + i * 8);
+		uint16_t nEncoding = readUShort(pCmap + 6 + i * 8);
+		uint32_t nOffset = readULong(pCmap + 8 + i * 8);
+		if(nOffset > m_cmap.nLength - 4)
+			continue;
+
+		uint16_t nFormat = readUShort(pCmap + nOffset);
+		bool bUnicode = nPlatform == 0 || (nPlatform == 3 && (nEncoding == 1 || nEncoding == 10));
+		int nScore = !bUnicode ? 0 : nFormat == 12 ? 2 : nFormat == 4 ? 1 : 0;
+		if(nScore > nBestScore)
+		{
+			nBest = nOffset;
+			nBestScore = nScore;
+		}
+	}
+	if(nBestScore == 0)
+		return false;
+
+	m_nCmapFormat = readUShort(pCmap + nBest);
+	uint32_t nLength = m_nCmapFormat == 12 ? (nBest + 8 <= m_cmap.nLength ? readULong(pCmap + nBest + 4) : 0) : readUShort(pCmap + nBest + 2);
+	if(nLength < 16 || nLength > m_cmap.nLength - nBest)
+		return false;
+	m_cmap.nOffset += nBest;
+	m_cmap.nLength = nLength;
+
+	if(m_nCmapFormat == 4)
+	{
+		uint32_t nSegments = readUShort(&m_data[m_cmap.nOffset + 6]) / 2;
+		if(16 + nSegments * 8 > m_cmap.nLength)
+			return false;
+	}
+	else if(16 + (uint64_t)readULong(&m_data[m_cmap.nOffset + 12]) * 12 > m_cmap.nLength)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+std::vector<uint32_t> CSignatureFont::codePoints(const std::string& utf8)
+{
+	std::vector<uint32_t> text;
+	const uint8_t* p = (const uint8_t*)utf8.data();
+	const uint8_t* pEnd = p + utf8.size();
+	while(p < pEnd)
+	{
+		uint32_t c = *p++;
+		int nFollow = c >= 0xF0 && c < 0xF8 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+		if((c >= 0x80 && c < 0xC0) || c >= 0xF8)
+		{
+			text.push_back(0xFFFD);
+			continue;
+		}
+
+		c &= 0x7F >> (nFollow ? nFollow + 1 : 0);
+		bool bValid = true;
+		for(int i = 0; i < nFollow; i++)
+		{
+			if(p >= pEnd || (*p & 0xC0) != 0x80)
+			{
+				bValid = false;
+				break;
+			}
+			c = (c << 6) | (*p++ & 0x3F);
+		}
+		text.push_back(bValid && c <= 0x10FFFF ? c : 0xFFFD);
+	}
+	return text;
+}
+
+uint16_t CSignatureFont::glyph(uint32_t nCodePoint) const
+{
+	const uint8_t* pCmap = &m_data[m_cmap.nOffset];
+	if(m_nCmapFormat == 12)
+	{
+		uint32_t nGroups = readULong(pCmap + 12);
+		uint32_t nLow = 0, nHigh = nGroups;
+		while(nLow < nHigh)
+		{
+			uint32_t nMid = (nLow + nHigh) / 2;
+			const uint8_t* pGroup = pCmap + 16 + nMid * 12;
+			if(nCodePoint < readULong(pGroup))
+				nHigh = nMid;
+			else if(nCodePoint > readULong(pGroup + 4))
+				nLow = nMid + 1;
+			else
+			{
+				uint32_t nGlyph = readULong(pGroup + 8) + nCodePoint - readULong(pGroup);
+				return nGlyph < m_nGlyphs ? (uint16_t)nGlyph : 0;
+			}
+		}
+		return 0;
+	}
+
+	if(nCodePoint > 0xFFFF)
+		return 0;
+
+	uint32_t nSegments = readUShort(pCmap + 6) / 2;
+	const uint8_t* pEndCodes = pCmap + 14;
+	const uint8_t* pStartCodes = pEndCodes + nSegments * 2 + 2;
+	const uint8_t* pDeltas = pStartCodes + nSegments * 2;
+	const uint8_t* pRangeOffsets = pDeltas + nSegments * 2;
+	for(uint32_t i = 0; i < nSegments; i++)
+	{
+		if(nCodePoint > readUShort(pEndCodes + i * 2))
+			continue;
+		if(nCodePoint < readUShort(pStartCodes + i * 2))
+			return 0;
+
+		uint16_t nDelta = readUShort(pDeltas + i * 2);
+		uint16_t nRangeOffset = readUShort(pRangeOffsets + i * 2);
+		uint32_t nGlyph;
+		if(nRangeOffset == 0)
+		{
+			nGlyph = (nCodePoint + nDelta) & 0xFFFF;
+		}
+		else
+		{
+			// idRangeOffset e' relativo alla propria posizione nella tabella
+			size_t nIndex = (pRangeOffsets + i * 2 - &m_data[0]) + nRangeOffset + (nCodePoint - readUShort(pStartCodes + i * 2)) * 2;
+			if(nIndex + 2 > (size_t)m_cmap.nOffset + m_cmap.nLength)
+				return 0;
+			nGlyph = readUShort(&m_data[nIndex]);
+			if(nGlyph != 0)
+				nGlyph = (nGlyph + nDelta) & 0xFFFF;
+		}
+		return nGlyph < m_nGlyphs ? (uint16_t)nGlyph : 0;
+	}
+	return 0;
+}
+
+int CSignatureFont::advance(uint16_t nGlyph) const
+{
+	uint16_t nMetric = nGlyph < m_nHMetrics ? nGlyph : m_nHMetrics - 1;
+	return readUShort(&m_data[m_hmtx.nOffset + nMetric * 4]) * 1000 / m_nUnitsPerEm;
+}
+
+int CSignatureFont::textWidth(const std::vector<uint32_t>& text) const
+{
+	int nWidth = 0;
+	for(uint32_t c : text)
+		nWidth += advance(glyph(c));
+	return nWidth;
+}
+
+uint32_t CSignatureFont::glyphOffset(uint16_t nGlyph) const
+{
+	const uint8_t* pLoca = &m_data[m_loca.nOffset];
+	return m_bLongLoca ? readULong(pLoca + nGlyph * 4) : (uint32_t)readUShort(pLoca + nGlyph * 2) * 2;
+}
+
+std::shared_ptr<const CSignatureFont::Subset> CSignatureFont::subset(const std::vector<uint32_t>& text) const
+{
+	// .notdef e i componenti dei glifi composti
+	std::set<uint16_t> glyphs;
+	glyphs.insert(0);
+	for(uint32_t c : text)
+		glyphs.insert(glyph(c));
+
+	std::vector<uint16_t> pending(glyphs.begin(), glyphs.end());
+	while(!pending.empty())
+	{
+		uint16_t nGlyph = pending.back();
+		pending.pop_back();
+
+		uint32_t nStart = glyphOffset(nGlyph);
+		uint32_t nEnd = glyphOffset(nGlyph + 1);
+		if(nEnd <= nStart || nEnd > m_glyf.nLength || nEnd - nStart < 10)
+			continue;
+		const uint8_t* p = &m_data[m_glyf.nOffset + nStart];
+		const uint8_t* pEnd = &m_data[m_glyf.nOffset] + nEnd;
+		if(readShort(p) >= 0)
+			continue;
+
+		uint16_t nFlags;
+		p += 10;
+		do
+		{
+			if(p + 4 > pEnd)
+				break;
+			nFlags = readUShort(p);
+			uint16_t nComponent = readUShort(p + 2);
+			if(nComponent < m_nGlyphs && glyphs.insert(nComponent).second)
+				pending.push_back(nComponent);
+
+			p += 4 + ((nFlags & ARG_1_AND_2_ARE_WORDS) ? 4 : 2);
+			if(nFlags & WE_HAVE_A_SCALE)
+				p += 2;
+			else if(nFlags & WE_HAVE_AN_X_AND_Y_SCALE)
+				p += 4;
+			else if(nFlags & WE_HAVE_A_TWO_BY_TWO)
+				p += 8;
+		}
+		while(nFlags & MORE_COMPONENTS);
+	}
+
+	std::string key;
+	for(uint16_t nGlyph : glyphs)
+	{
+		if(!key.empty())
+			key += ",";
+		key += std::to_string(nGlyph);
+	}
+
+	std::lock_guard<std::mutex> lock(m_subsetsMutex);
+	for(auto it = m_subsets.begin(); it != m_subsets.end(); ++it)
+	{
+		if((*it)->key == key)
+		{
+			m_subsets.splice(m_subsets.begin(), m_subsets, it);
+			return m_subsets.front();
+		}
+	}
+
+	std::shared_ptr<const Subset> pSubset = createSubset(text, std::vector<uint16_t>(glyphs.begin(), glyphs.end()), key);
+	if(!pSubset)
+		return nullptr;
+
+	m_subsets.push_front(pSubset);
+	if(m_subsets.size() > SIGNATURE_FONT_SUBSET_CACHE_SIZE)
+		m_subsets.pop_back();
+	return pSubset;
+}
+
+std::shared_ptr<const CSignatureFont::Subset> CSignatureFont::createSubset(const std::vector<uint32_t>& text,
+	const std::vector<uint16_t>& glyphs, const std::string& key) const
+{
+	std::shared_ptr<Subset> pSubset = std::make_shared<Subset>();
+	pSubset->key = key;
+
+	// prefisso del nome del font (PDF 32000-1, 9.6.4) ricavato dal set di glifi
+	uint32_t nHash = 2166136261u;
+	for(char c : key)
+		nHash = (nHash ^ (uint8_t)c) * 16777619u;
+	for(int i = 0; i < 6; i++, nHash /= 26)
+		pSubset->tag += (char)('A' + nHash % 26);
+
+	// glyf con i soli glifi usati; gli altri restano vuoti e gli id non cambiano
+	std::vector<uint8_t> glyf;
+	std::vector<uint8_t> loca;
+	size_t nNext = 0;
+	for(uint32_t nGlyph = 0; nGlyph < m_nGlyphs; nGlyph++)
+	{
+		writeULong(loca, (uint32_t)glyf.size());
+		if(nNext < glyphs.size() && glyphs[nNext] == nGlyph)
+		{
+			nNext++;
+			uint32_t nStart = glyphOffset((uint16_t)nGlyph);
+			uint32_t nEnd = glyphOffset((uint16_t)(nGlyph + 1));
+			if(nEnd > nStart && nEnd <= m_glyf.nLength)
+			{
+				glyf.insert(glyf.end(), &m_data[m_glyf.nOffset + nStart], &m_data[m_glyf.nOffset] + nEnd);
+				glyf.resize((glyf.size() + 3) & ~(size_t)3, 0);
+			}
+		}
+	}
+	writeULong(loca, (uint32_t)glyf.size());
+
+	std::vector<std::pair<const char*, std::vector<uint8_t>>> tables;
+	for(const char* szTag : SUBSET_TABLES)
+	{
+		std::vector<uint8_t> data;
+		Table source;
+		if(strcmp(szTag, "glyf") == 0)
+			data.swap(glyf);
+		else if(strcmp(szTag, "loca") == 0)
+			data.swap(loca);
+		else if(table(szTag, source))
+			data.assign(&m_data[source.nOffset], &m_data[source.nOffset] + source.nLength);
+		else
+			continue;
+
+		if(strcmp(szTag, "head") == 0)
+		{
+			// checkSumAdjustment ricalcolato alla fine, loca sempre a 32 bit
+			patchULong(data, 8, 0);
+			data[50] = 0;
+			data[51] = 1;
+		}
+		tables.push_back(std::make_pair(szTag, std::move(data)));
+	}
+
+	uint16_t nTables = (uint16_t)tables.size();
+	uint16_t nSelector = 0;
+	while((2u << nSelector) <= nTables)
+		nSelector++;
+
+	std::vector<uint8_t> font;
+	writeULong(font, 0x00010000);
+	writeUShort(font, nTables);
+	writeUShort(font, (uint16_t)(16 << nSelector));
+	writeUShort(font, nSelector);
+	writeUShort(font, (uint16_t)(nTables * 16 - (16 << nSelector)));
+
+	size_t nOffset = 12 + nTables * 16;
+	size_t nHeadOffset = 0;
+	for(const auto& entry : tables)
+	{
+		std::vector<uint8_t> padded(entry.second);
+		padded.resize((padded.size() + 3) & ~(size_t)3, 0);
+		font.insert(font.end(), entry.first, entry.first + 4);
+		writeULong(font, checksum(padded.data(), padded.size()));
+		writeULong(font, (uint32_t)nOffset);
+		writeULong(font, (uint32_t)entry.second.size());
+		if(strcmp(entry.first, "head") == 0)
+			nHeadOffset = nOffset;
+		nOffset += padded.size();
+	}
+	for(const auto& entry : tables)
+	{
+		font.insert(font.end(), entry.second.begin(), entry.second.end());
+		font.resize((font.size() + 3) & ~(size_t)3, 0);
+	}
+	patchULong(font, nHeadOffset + 8, 0xB1B0AFBA - checksum(font.data(), font.size()));
+
+	pSubset->nLength1 = font.size();
+	if(!CPdfSyntax::deflate(font, pSubset->fontFile))
+		return nullptr;
+
+	for(uint16_t nGlyph : glyphs)
+		pSubset->widths.push_back(std::make_pair(nGlyph, advance(nGlyph)));
+
+	// ToUnicode: un carattere per glifo, in UTF-16BE
+	std::map<uint16_t, uint32_t> unicode;
+	for(uint32_t c : text)
+	{
+		uint16_t nGlyph = glyph(c);
+		if(nGlyph != 0)
+			unicode.insert(std::make_pair(nGlyph, c));
+	}
+
+	std::string& cmap = pSubset->toUnicode;
+	cmap = "/CIDInit /ProcSet findresource begin\n"
+		"12 dict begin\n"
+		"begincmap\n"
+		"/CIDSystemInfo << /Registry (Adobe) /Ordering (UCS) /Supplement 0 >> def\n"
+		"/CMapName /Adobe-Identity-UCS def\n"
+		"/CMapType 2 def\n"
+		"1 begincodespacerange\n"
+		"<0000> <FFFF>\n"
+		"endcodespacerange\n";
+	auto it = unicode.begin();
+	while(it != unicode.end())
+	{
+		// al massimo 100 voci per blocco
+		size_t nBlock = std::min<size_t>(100, std::distance(it, unicode.end()));
+		cmap += std::to_string(nBlock) + " beginbfchar\n";
+		for(size_t i = 0; i < nBlock; i++, ++it)
+		{
+			cmap += "<";
+			appendHex(cmap, it->first);
+			cmap += "> <";
+			if(it->second > 0xFFFF)
+			{
+				uint32_t c = it->second - 0x10000;
+				appendHex(cmap, (uint16_t)(0xD800 + (c >> 10)));
+				appendHex(cmap, (uint16_t)(0xDC00 + (c & 0x3FF)));
+			}
+			else
+			{
+				appendHex(cmap, (uint16_t)it->second);
+			}
+			cmap += ">\n";
+		}
+		cmap += "endbfchar\n";
+	}
+	cmap += "endcmap\n"
+		"CMapName currentdict /CMap defineresource pop\n"
+		"end\n"
+		"end\n";
+
+	return pSubset;
+}
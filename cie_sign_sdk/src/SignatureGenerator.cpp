@@ -14,6 +14,8 @@
 #include "RSA/sha2.h"
 #include "CertStore.h"
 
+#include <openssl/evp.h>
+#include <openssl/x509.h>
 
 #include <string>
 
@@ -117,10 +119,154 @@ bool CSignatureGenerator::GetCAdES()
 	return m_bCAdES;
 }
 
+std::atomic<size_t> CSignatureGenerator::m_nLastTimeStampTokenSize(0);
+
+// OID di 9 byte (content type, signing time, message digest, data, signedData)
+#define DER_OID_SIZE			11
+// OID di 11 byte (signingCertificateV2, timeStampToken)
+#define DER_OID_LONG_SIZE		13
+// AlgorithmIdentifier con parametri NULL
+#define DER_ALGORITHM_SIZE		15
+// UTCTime YYMMDDHHMMSSZ
+#define DER_UTCTIME_SIZE		15
+// INTEGER version
+#define DER_VERSION_SIZE		3
+
+namespace
+{
+	// lunghezza DER di un TLV con nLength byte di contenuto
+	size_t derLength(size_t nLength)
+	{
+		size_t nHeader = 2;
+		if(nLength > 0x7F)
+		{
+			for(size_t n = nLength; n > 0; n >>= 8)
+				nHeader++;
+		}
+
+		return nHeader + nLength;
+	}
+}
+
+void CSignatureGenerator::SetAlias(char* alias)
+{
+	CSignatureGeneratorBase::SetAlias(alias);
+
+	// un altro alias puo' indicare un altro certificato
+	m_signerCertificate.removeAll();
+	m_signerId.removeAll();
+}
+
+void CSignatureGenerator::Reset()
+{
+	m_data.removeAll();
+	m_signerInfos.removeAll();
+	m_certificates.removeAll();
+	m_digestAlgos.removeAll();
+	m_signerInfoGenerator.reset();
+}
+
+size_t CSignatureGenerator::PredictSignatureSize(const UUCByteArray& signerCertificate, const std::vector<UUCByteArray>& chain, int nHashAlgo, size_t nTimeStampTokenSize)
+{
+	const unsigned char* p = signerCertificate.getContent();
+	X509* pX509 = d2i_X509(NULL, &p, signerCertificate.getLength());
+	if(!pX509)
+		return 0;
+
+	int nIssuer = i2d_X509_NAME(X509_get_issuer_name(pX509), NULL);
+	int nSerial = i2d_ASN1_INTEGER(X509_get_serialNumber(pX509), NULL);
+	EVP_PKEY* pKey = X509_get_pubkey(pX509);
+	int nSignature = pKey ? EVP_PKEY_size(pKey) : 0;
+	EVP_PKEY_free(pKey);
+	X509_free(pX509);
+
+	if(nIssuer <= 0 || nSerial <= 0 || nSignature <= 0)
+		return 0;
+
+	// hash del contenuto: SHA256 o l'hash SHA1 esadecimale di 24 byte
+	size_t nDigest = nHashAlgo == CKM_SHA1_RSA_PKCS ? 24 : 32;
+
+	// attributi firmati: contentType, signingTime, messageDigest, signingCertificateV2
+	size_t nContentType = derLength(DER_OID_SIZE + derLength(DER_OID_SIZE));
+	size_t nSigningTime = derLength(DER_OID_SIZE + derLength(DER_UTCTIME_SIZE));
+	size_t nMessageDigest = derLength(DER_OID_SIZE + derLength(derLength(nDigest)));
+	size_t nIssuerSerial = derLength(derLength(derLength(derLength(nIssuer))) + nSerial);
+	size_t nCertId = derLength(DER_ALGORITHM_SIZE + derLength(32) + nIssuerSerial);
+	size_t nSigningCertificate = derLength(DER_OID_LONG_SIZE + derLength(derLength(derLength(nCertId))));
+	size_t nSignedAttributes = derLength(nContentType + nSigningTime + nMessageDigest + nSigningCertificate);
+
+	size_t nUnsignedAttributes = 0;
+	if(nTimeStampTokenSize > 0)
+		nUnsignedAttributes = derLength(derLength(DER_OID_LONG_SIZE + derLength(nTimeStampTokenSize)));
+
+	size_t nSignerInfo = derLength(DER_VERSION_SIZE + derLength(nIssuer + nSerial) + DER_ALGORITHM_SIZE +
+		nSignedAttributes + DER_ALGORITHM_SIZE + derLength(nSignature) + nUnsignedAttributes);
+
+	size_t nCertificates = signerCertificate.getLength();
+	for(size_t i = 0; i < chain.size(); i++)
+		nCertificates += chain[i].getLength();
+
+	size_t nSignedData = derLength(DER_VERSION_SIZE + derLength(DER_ALGORITHM_SIZE) + derLength(DER_OID_SIZE) +
+		derLength(nCertificates) + derLength(nSignerInfo));
+
+	return derLength(DER_OID_SIZE + derLength(nSignedData));
+}
+
+long CSignatureGenerator::GetSignatureSize(size_t* pnSize)
+{
+	CCertificate* pSignerCertificate;
+	UUCByteArray id;
+	long nRes = getSignerCertificate(&pSignerCertificate, id);
+	if(nRes)
+	{
+		LOG_ERR((0, "CSignatureGenerator::GetSignatureSize", "GetCertificate error: %x", nRes));
+		return nRes;
+	}
+	delete pSignerCertificate;
+
+	// la dimensione della marca varia di poco tra una risposta e l'altra della stessa TSA
+	size_t nTimeStampTokenSize = 0;
+	if(m_pTSAClient != NULL)
+	{
+		size_t nLast = m_nLastTimeStampTokenSize;
+		nTimeStampTokenSize = nLast ? nLast + 256 : TSA_TOKEN_SIZE_ESTIMATE;
+	}
+
+	*pnSize = PredictSignatureSize(m_signerCertificate, std::vector<UUCByteArray>(), m_bCAdES ? CKM_SHA256_RSA_PKCS : m_nHashAlgo, nTimeStampTokenSize);
+	if(*pnSize == 0)
+		return DISIGON_ERROR_CERT_INVALID;
+
+	LOG_DBG((0, "CSignatureGenerator::GetSignatureSize", "%d", (int)*pnSize));
+
+	return 0;
+}
+
+long CSignatureGenerator::getSignerCertificate(CCertificate** ppCertificate, UUCByteArray& id)
+{
+	if(m_signerCertificate.getLength() == 0)
+	{
+		UUCByteArray signerId;
+		long nRes = m_pSigner->GetCertificate(m_szAlias, ppCertificate, signerId);
+		if(nRes)
+			return nRes;
+
+		(*ppCertificate)->toByteArray(m_signerCertificate);
+		m_signerId.append(signerId);
+	}
+	else
+	{
+		*ppCertificate = new CCertificate(m_signerCertificate.getContent(), m_signerCertificate.getLength());
+	}
+
+	id.append(m_signerId);
+
+	return 0;
+}
+
 long CSignatureGenerator::GetCertificate(CCertificate** ppCertificate)
 {
     UUCByteArray id;
-    long nRes = m_pSigner->GetCertificate(m_szAlias, ppCertificate, id);
+    long nRes = getSignerCertificate(ppCertificate, id);
     if(nRes)
     {
         LOG_ERR((0, "CSignatureGenerator::Generate", "GetCertificate error: %x", nRes));
@@ -137,7 +283,7 @@ long CSignatureGenerator::Generate(UUCByteArray& pkcs7SignedData, BOOL bDetached
 
 	UUCByteArray id;
 	CCertificate* pSignerCertificate;
-	long nRes = m_pSigner->GetCertificate(m_szAlias, &pSignerCertificate, id);
+	long nRes = getSignerCertificate(&pSignerCertificate, id);
 	if(nRes)
 	{
 		LOG_ERR((0, "CSignatureGenerator::Generate", "GetCertificate error: %x", nRes));
@@ -355,6 +501,10 @@ long CSignatureGenerator::Generate(UUCByteArray& pkcs7SignedData, BOOL bDetached
         if (ptst)
         {
 			m_signerInfoGenerator.setTimestampToken(ptst);
+
+			UUCByteArray tst;
+			ptst->toByteArray(tst);
+			m_nLastTimeStampTokenSize = tst.getLength();
         }
 		else
 		{
@@ -0,0 +1,181 @@
+/*
+ *  SignatureImage.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "SignatureImage.h"
+#include "PdfSyntax.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// differenza massima tra i canali di un pixel considerato grigio
+#define GRAY_TOLERANCE			8
+// grigi trattati come nero o bianco per l'immagine a 1 bit
+#define BILEVEL_BLACK			32
+#define BILEVEL_WHITE			223
+
+CSignatureImage::CSignatureImage(const uint8_t* pRgba, uint32_t nWidth, uint32_t nHeight)
+: m_rgba(pRgba, pRgba + (size_t)nWidth * nHeight * 4), m_nWidth(nWidth), m_nHeight(nHeight),
+  m_nComponents(3), m_nBitsPerComponent(8)
+{
+}
+
+void CSignatureImage::targetSize(double fWidth, double fHeight, uint32_t nDpi, uint32_t* pnWidth, uint32_t* pnHeight)
+{
+	if(nDpi == 0)
+		nDpi = SIGNATURE_IMAGE_DEFAULT_DPI;
+
+	// 72 punti per pollice
+	double fWidthPx = ceil(fWidth * nDpi / 72.0);
+	double fHeightPx = ceil(fHeight * nDpi / 72.0);
+
+	// limitati prima della conversione: fuori da [1, UINT32_MAX] (o NaN) il cast non e' definito
+	*pnWidth = !(fWidthPx >= 1) ? 1 : fWidthPx >= UINT32_MAX ? UINT32_MAX : (uint32_t)fWidthPx;
+	*pnHeight = !(fHeightPx >= 1) ? 1 : fHeightPx >= UINT32_MAX ? UINT32_MAX : (uint32_t)fHeightPx;
+}
+
+void CSignatureImage::downsample(uint32_t nWidth, uint32_t nHeight)
+{
+	if(nWidth == 0 || nWidth > m_nWidth)
+		nWidth = m_nWidth;
+	if(nHeight == 0 || nHeight > m_nHeight)
+		nHeight = m_nHeight;
+	if(nWidth == m_nWidth && nHeight == m_nHeight)
+		return;
+
+	std::vector<uint8_t> target((size_t)nWidth * nHeight * 4);
+	uint8_t* pTarget = target.data();
+
+	for(uint32_t ty = 0; ty < nHeight; ty++)
+	{
+		uint32_t y0 = (uint32_t)((uint64_t)ty * m_nHeight / nHeight);
+		uint32_t y1 = (uint32_t)((uint64_t)(ty + 1) * m_nHeight / nHeight);
+		if(y1 <= y0)
+			y1 = y0 + 1;
+
+		for(uint32_t tx = 0; tx < nWidth; tx++)
+		{
+			uint32_t x0 = (uint32_t)((uint64_t)tx * m_nWidth / nWidth);
+			uint32_t x1 = (uint32_t)((uint64_t)(tx + 1) * m_nWidth / nWidth);
+			if(x1 <= x0)
+				x1 = x0 + 1;
+
+			// colori pesati con l'alpha: i pixel trasparenti non scuriscono i bordi
+			uint64_t nAlpha = 0, nRed = 0, nGreen = 0, nBlue = 0;
+			for(uint32_t y = y0; y < y1; y++)
+			{
+				const uint8_t* p = m_rgba.data() + ((size_t)y * m_nWidth + x0) * 4;
+				for(uint32_t x = x0; x < x1; x++, p += 4)
+				{
+					nRed += (uint64_t)p[0] * p[3];
+					nGreen += (uint64_t)p[1] * p[3];
+					nBlue += (uint64_t)p[2] * p[3];
+					nAlpha += p[3];
+				}
+			}
+
+			uint64_t nCount = (uint64_t)(y1 - y0) * (x1 - x0);
+			if(nAlpha > 0)
+			{
+				pTarget[0] = (uint8_t)((nRed + nAlpha / 2) / nAlpha);
+				pTarget[1] = (uint8_t)((nGreen + nAlpha / 2) / nAlpha);
+				pTarget[2] = (uint8_t)((nBlue + nAlpha / 2) / nAlpha);
+			}
+			else
+			{
+				pTarget[0] = pTarget[1] = pTarget[2] = 0xFF;
+			}
+			pTarget[3] = (uint8_t)((nAlpha + nCount / 2) / nCount);
+			pTarget += 4;
+		}
+	}
+
+	m_rgba.swap(target);
+	m_nWidth = nWidth;
+	m_nHeight = nHeight;
+}
+
+int CSignatureImage::encode()
+{
+	size_t nPixels = (size_t)m_nWidth * m_nHeight;
+
+	bool bOpaque = true;
+	bool bGray = true;
+	bool bBilevel = true;
+	for(size_t i = 0; i < nPixels; i++)
+	{
+		const uint8_t* p = m_rgba.data() + i * 4;
+		if(p[3] != 0xFF)
+			bOpaque = false;
+		if(p[3] == 0)
+			continue;
+
+		if(abs(p[0] - p[1]) > GRAY_TOLERANCE || abs(p[1] - p[2]) > GRAY_TOLERANCE || abs(p[0] - p[2]) > GRAY_TOLERANCE)
+		{
+			bGray = false;
+			bBilevel = false;
+		}
+		else if(p[1] > BILEVEL_BLACK && p[1] < BILEVEL_WHITE)
+		{
+			bBilevel = false;
+		}
+	}
+
+	m_nComponents = bGray ? 1 : 3;
+	m_nBitsPerComponent = bBilevel ? 1 : 8;
+
+	// righe di campioni; sotto i pixel trasparenti il bianco comprime meglio
+	std::vector<uint8_t> samples;
+	if(bBilevel)
+	{
+		size_t nRow = (m_nWidth + 7) / 8;
+		samples.assign(nRow * m_nHeight, 0);
+		for(uint32_t y = 0; y < m_nHeight; y++)
+		{
+			for(uint32_t x = 0; x < m_nWidth; x++)
+			{
+				const uint8_t* p = m_rgba.data() + ((size_t)y * m_nWidth + x) * 4;
+				// 1 = bianco in DeviceGray
+				if(p[3] == 0 || p[1] >= 128)
+					samples[y * nRow + x / 8] |= (uint8_t)(0x80 >> (x % 8));
+			}
+		}
+	}
+	else
+	{
+		samples.reserve(nPixels * m_nComponents);
+		for(size_t i = 0; i < nPixels; i++)
+		{
+			const uint8_t* p = m_rgba.data() + i * 4;
+			if(p[3] == 0)
+			{
+				samples.insert(samples.end(), m_nComponents, 0xFF);
+			}
+			else if(bGray)
+			{
+				samples.push_back((uint8_t)((p[0] * 299 + p[1] * 587 + p[2] * 114 + 500) / 1000));
+			}
+			else
+			{
+				samples.insert(samples.end(), p, p + 3);
+			}
+		}
+	}
+
+	if(!CPdfSyntax::deflate(samples, m_data))
+		return -1;
+
+	m_softMask.clear();
+	if(!bOpaque)
+	{
+		std::vector<uint8_t> alpha(nPixels);
+		for(size_t i = 0; i < nPixels; i++)
+			alpha[i] = m_rgba[i * 4 + 3];
+		if(!CPdfSyntax::deflate(alpha, m_softMask))
+			return -1;
+	}
+
+	return 0;
+}
@@ -17,8 +17,23 @@
 #include "ASN1/AlgorithmIdentifier.h"
 #include "Certificate.h"
 #include "ASN1/IssuerAndSerialNumber.h"
+#include "UUCLogger.h"
+
+USE_LOG;
+
+// Attribute ::= SEQUENCE { attrType OID, attrValues SET OF value }
+static CASN1Sequence makeAttribute(const char* szOID, const CASN1Object& value)
+{
+	CASN1Sequence attribute;
+	attribute.addElement(CASN1ObjectIdentifier(szOID));
+	CASN1SetOf values;
+	values.addElement(value);
+	attribute.addElement(values);
+	return attribute;
+}
 
 SignedDataGeneratorEx::SignedDataGeneratorEx(CSignedDocument& sd)
+: m_pPatcher(NULL)
 {
 	m_signerInfos = sd.getSignerInfos();
 	m_certificates = sd.getCertificates();
@@ -28,8 +43,19 @@ SignedDataGeneratorEx::SignedDataGeneratorEx(CSignedDocument& sd)
 		sd.getContent(m_content);
 }
 
+SignedDataGeneratorEx::SignedDataGeneratorEx(const BYTE* pkcs7SignedData, int len)
+: m_pPatcher(new CSignedDataPatcher(pkcs7SignedData, len))
+{
+}
+
+SignedDataGeneratorEx::SignedDataGeneratorEx(FILE* pPkcs7File)
+: m_pPatcher(new CSignedDataPatcher(pPkcs7File))
+{
+}
+
 SignedDataGeneratorEx::~SignedDataGeneratorEx()
 {
+	delete m_pPatcher;
 }
 
 bool SignedDataGeneratorEx::isDetached()
@@ -45,6 +71,23 @@ void SignedDataGeneratorEx::setContent(const BYTE* content, int len)
 	
 void SignedDataGeneratorEx::addSigners(CSignedDocument& sd)
 {
+	if(m_pPatcher)
+	{
+		CASN1SetOf signerInfos = sd.getSignerInfos();
+		for(int i = 0; i < signerInfos.size(); i++)
+			m_pPatcher->addSignerInfo(signerInfos.elementAt(i));
+
+		CASN1SetOf certificates = sd.getCertificates();
+		for(int i = 0; i < certificates.size(); i++)
+			m_pPatcher->addCertificate(certificates.elementAt(i));
+
+		CASN1SetOf digestAlgos = sd.getDigestAlgos();
+		for(int i = 0; i < digestAlgos.size(); i++)
+			m_pPatcher->addDigestAlgorithm(digestAlgos.elementAt(i));
+
+		return;
+	}
+
 	CASN1SetOf signerInfos = sd.getSignerInfos();
 	int size = signerInfos.size();
 	for(int i = 0; i <  size; i++)
@@ -66,6 +109,12 @@ void SignedDataGeneratorEx::addCounterSignature(CSignerInfo& signerInfoRef, CSig
 	// il signeddocument contiene solo un signerinfo ritornato dal webservice
 	CSignerInfo signerInfoToAdd = counterSignature.getSignerInfos().elementAt(0);
 	
+	if(m_pPatcher)
+	{
+		spliceCounterSignature(signerInfoRef, signerInfoToAdd, counterSignature);
+		return;
+	}
+
 	int size = m_signerInfos.size();
 	
 	
@@ -99,6 +148,12 @@ void SignedDataGeneratorEx::addCounterSignature(CSignerInfo& signerInfoRef, CSig
 	CTimeStampToken tst(tsr.getTimeStampToken());
 	signerInfoToAdd.setTimeStampToken(tst);
 	
+	if(m_pPatcher)
+	{
+		spliceCounterSignature(signerInfoRef, signerInfoToAdd, counterSignature);
+		return;
+	}
+
 	int size = m_signerInfos.size();
 	
 	
@@ -124,6 +179,19 @@ void SignedDataGeneratorEx::addCounterSignature(CSignerInfo& signerInfoRef, CSig
 //	NSLog(@"Warning: signerInfo reference not found when adding a countersignature");
 }
 
+void SignedDataGeneratorEx::spliceCounterSignature(CSignerInfo& signerInfoRef, CSignerInfo& signerInfoToAdd, CSignedDocument& counterSignature)
+{
+	if(!m_pPatcher->addUnsignedAttribute(signerInfoRef, makeAttribute(szCounterSignatureOID, signerInfoToAdd)))
+	{
+		LOG_ERR((0, "SignedDataGeneratorEx::addCounterSignature", "signerInfo reference not found"));
+		return;
+	}
+
+	CASN1SetOf certificates = counterSignature.getCertificates();
+	for(int i = 0; i < certificates.size(); i++)
+		m_pPatcher->addCertificate(certificates.elementAt(i));
+}
+
 bool SignedDataGeneratorEx::addCounterSignature(CSignerInfo& signerInfo, CSignerInfo& signerInfoRef, CSignerInfo& counterSignature)
 {
 	if(signerInfo == signerInfoRef)
@@ -151,8 +219,19 @@ bool SignedDataGeneratorEx::addCounterSignature(CSignerInfo& signerInfo, CSigner
 
 void SignedDataGeneratorEx::setTimestamp(CTimeStampResponse& tsr, int signerInfoIndex)
 {
-	CSignerInfo si = m_signerInfos.elementAt(signerInfoIndex);
 	CTimeStampToken tst = tsr.getTimeStampToken();
+	setTimestamp(tst, signerInfoIndex);
+}
+
+void SignedDataGeneratorEx::setTimestamp(CTimeStampToken& tst, int signerInfoIndex)
+{
+	if(m_pPatcher)
+	{
+		m_pPatcher->addUnsignedAttribute(signerInfoIndex, makeAttribute(szTimestampTokenOID, tst));
+		return;
+	}
+
+	CSignerInfo si = m_signerInfos.elementAt(signerInfoIndex);
 	si.setTimeStampToken(tst);
 	m_signerInfos.setElementAt(si, signerInfoIndex);
 }
@@ -160,6 +239,13 @@ void SignedDataGeneratorEx::setTimestamp(CTimeStampResponse& tsr, int signerInfo
 
 void SignedDataGeneratorEx::toByteArray(UUCByteArray& pkcs7SignedData)
 {
+	if(m_pPatcher)
+	{
+		// solo gli header che racchiudono le modifiche vengono riscritti
+		m_pPatcher->toByteArray(pkcs7SignedData);
+		return;
+	}
+
 	// Crea signedData
 	CSignedData* pSignedData;
 	if(m_content.getLength() == 0) // detached
@@ -186,4 +272,19 @@ void SignedDataGeneratorEx::toByteArray(UUCByteArray& pkcs7SignedData)
 	contentInfo.toByteArray(pkcs7SignedData);	
 	
 	delete pSignedData;
-}
\ No newline at end of file
+}
+
+long SignedDataGeneratorEx::writeTo(FILE* pOut)
+{
+	if(!m_pPatcher)
+	{
+		UUCByteArray pkcs7SignedData;
+		toByteArray(pkcs7SignedData);
+		if(fwrite(pkcs7SignedData.getContent(), 1, pkcs7SignedData.getLength(), pOut) != pkcs7SignedData.getLength())
+			return DISIGON_ERROR_INVALID_FILE;
+
+		return 0;
+	}
+
+	return m_pPatcher->writeTo(pOut);
+}
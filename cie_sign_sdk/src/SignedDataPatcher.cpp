@@ -0,0 +1,678 @@
+/*
+ *  SignedDataPatcher.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "SignedDataPatcher.h"
+#include "definitions.h"
+#include "disigonsdk.h"
+#include "ASN1/ASN1ObjectIdentifier.h"
+#include "ASN1/ASN1Exception.h"
+#include "UUCLogger.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <algorithm>
+
+#define TAG_SEQUENCE            0x30
+#define TAG_SET                 0x31
+#define TAG_CONTEXT_0           0xA0
+#define TAG_CONTEXT_1           0xA1
+
+#define COPY_CHUNK              65536
+
+USE_LOG;
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CSignedDataPatcher::CSignedDataPatcher(const BYTE* pkcs7SignedData, size_t len)
+: m_pBuffer(pkcs7SignedData), m_pFile(NULL), m_nLength(len), m_bLocated(false), m_bHasCertificates(false)
+{
+}
+
+CSignedDataPatcher::CSignedDataPatcher(FILE* pFile)
+: m_pBuffer(NULL), m_pFile(pFile), m_nLength(0), m_bLocated(false), m_bHasCertificates(false)
+{
+	if(fseeko(m_pFile, 0, SEEK_END) == 0)
+	{
+		off_t nSize = ftello(m_pFile);
+		if(nSize > 0)
+			m_nLength = (size_t)nSize;
+	}
+}
+
+CSignedDataPatcher::~CSignedDataPatcher()
+{
+}
+
+//////////////////////////////////////////////////////////////////////
+// TLV scanning
+//////////////////////////////////////////////////////////////////////
+
+void CSignedDataPatcher::read(size_t nOffset, BYTE* pBuffer, size_t nLen)
+{
+	if(nOffset > m_nLength || nLen > m_nLength - nOffset)
+		throw CASN1ParsingException();
+
+	if(m_pBuffer)
+	{
+		memcpy(pBuffer, m_pBuffer + nOffset, nLen);
+		return;
+	}
+
+	if(fseeko(m_pFile, (off_t)nOffset, SEEK_SET) != 0 || fread(pBuffer, 1, nLen, m_pFile) != nLen)
+		throw CASN1ParsingException();
+}
+
+void CSignedDataPatcher::readBytes(const Node& node, UUCByteArray& bytes)
+{
+	size_t nLen = node.end() - node.nOffset;
+	bytes.removeAll();
+	bytes.reserve((unsigned long)nLen);
+
+	BYTE pbtChunk[4096];
+	for(size_t nPos = node.nOffset; nPos < node.end(); )
+	{
+		size_t nChunk = std::min(sizeof(pbtChunk), node.end() - nPos);
+		read(nPos, pbtChunk, nChunk);
+		bytes.append(pbtChunk, (unsigned int)nChunk);
+		nPos += nChunk;
+	}
+}
+
+CSignedDataPatcher::Node CSignedDataPatcher::readNode(size_t nOffset, int nDepth)
+{
+	// un header occupa al massimo tag (qualche byte) + 1 + sizeof(size_t)
+	BYTE pbtHeader[16];
+	size_t nAvailable = std::min(sizeof(pbtHeader), m_nLength > nOffset ? m_nLength - nOffset : 0);
+	if(nAvailable < 2)
+		throw CASN1ParsingException();
+
+	read(nOffset, pbtHeader, nAvailable);
+
+	Node node;
+	node.nOffset = nOffset;
+	node.nDepth = nDepth;
+	node.btTag = pbtHeader[0];
+	node.bIndefinite = false;
+
+	size_t i = 1;
+	if((pbtHeader[0] & 0x1F) == 0x1F)
+	{
+		// tag in forma estesa
+		while(i < nAvailable && (pbtHeader[i] & 0x80))
+			i++;
+		i++;
+	}
+
+	node.nTagLen = i;
+	if(i >= nAvailable)
+		throw CASN1ParsingException();
+
+	BYTE btLen = pbtHeader[i++];
+	if(btLen == 0x80)
+	{
+		// lunghezza indefinita: il contenuto termina con l'EOC 00 00
+		if((node.btTag & 0x20) == 0)
+			throw CASN1ParsingException();
+
+		node.bIndefinite = true;
+		node.nHeaderLen = i;
+
+		size_t nPos = node.contentStart();
+		BYTE pbtEoc[2];
+		for(;;)
+		{
+			read(nPos, pbtEoc, 2);
+			if(pbtEoc[0] == 0 && pbtEoc[1] == 0)
+				break;
+
+			nPos = readNode(nPos, nDepth + 1).end();
+		}
+
+		node.nContentLen = nPos - node.contentStart();
+		return node;
+	}
+
+	size_t nContentLen = btLen;
+	if(btLen & 0x80)
+	{
+		size_t nLenBytes = btLen & 0x7F;
+		if(nLenBytes > sizeof(size_t) || i + nLenBytes > nAvailable)
+			throw CASN1ParsingException();
+
+		nContentLen = 0;
+		for(size_t j = 0; j < nLenBytes; j++)
+			nContentLen = (nContentLen << 8) | pbtHeader[i++];
+	}
+
+	node.nHeaderLen = i;
+	node.nContentLen = nContentLen;
+
+	if(nContentLen > m_nLength - nOffset - i)
+		throw CASN1ParsingException();
+
+	return node;
+}
+
+void CSignedDataPatcher::children(const Node& parent, std::vector<Node>& nodes)
+{
+	nodes.clear();
+
+	size_t nPos = parent.contentStart();
+	while(nPos < parent.contentEnd())
+	{
+		Node child = readNode(nPos, parent.nDepth + 1);
+		if(child.end() > parent.contentEnd())
+			throw CASN1ParsingException();
+
+		nodes.push_back(child);
+		nPos = child.end();
+	}
+}
+
+void CSignedDataPatcher::locate()
+{
+	if(m_bLocated)
+		return;
+
+	// ContentInfo ::= SEQUENCE { contentType, [0] EXPLICIT SignedData }
+	Node contentInfo = readNode(0, 0);
+	if(contentInfo.btTag != TAG_SEQUENCE)
+		throw CASN1ParsingException();
+
+	std::vector<Node> nodes;
+	children(contentInfo, nodes);
+	if(nodes.size() < 2 || nodes[1].btTag != TAG_CONTEXT_0)
+		throw CASN1ParsingException();
+
+	Node content = nodes[1];
+	children(content, nodes);
+	if(nodes.empty() || nodes[0].btTag != TAG_SEQUENCE)
+		throw CASN1ParsingException();
+
+	Node signedData = nodes[0];
+
+	// SignedData ::= SEQUENCE { version, digestAlgorithms, encapContentInfo,
+	//                           [0] certificates OPTIONAL, [1] crls OPTIONAL, signerInfos }
+	children(signedData, nodes);
+	if(nodes.size() < 4 || nodes[1].btTag != TAG_SET || nodes.back().btTag != TAG_SET)
+		throw CASN1ParsingException();
+
+	m_digestAlgos = nodes[1];
+	m_encapContentInfo = nodes[2];
+	m_signerInfos = nodes.back();
+	m_bHasCertificates = nodes[3].btTag == TAG_CONTEXT_0;
+	if(m_bHasCertificates)
+		m_certificates = nodes[3];
+
+	m_signedDataPath.clear();
+	m_signedDataPath.push_back(contentInfo);
+	m_signedDataPath.push_back(content);
+	m_signedDataPath.push_back(signedData);
+
+	children(m_signerInfos, m_signerInfoNodes);
+
+	m_bLocated = true;
+
+	LOG_DBG((0, "CSignedDataPatcher::locate", "signerInfos: %d, certificates: %d", (int)m_signerInfoNodes.size(), m_bHasCertificates));
+}
+
+bool CSignedDataPatcher::contains(const Node& set, const UUCByteArray& encoded)
+{
+	std::vector<Node> nodes;
+	children(set, nodes);
+
+	UUCByteArray bytes;
+	for(size_t i = 0; i < nodes.size(); i++)
+	{
+		if(nodes[i].end() - nodes[i].nOffset != encoded.getLength())
+			continue;
+
+		readBytes(nodes[i], bytes);
+		if(memcmp(bytes.getContent(), encoded.getContent(), encoded.getLength()) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+bool CSignedDataPatcher::findSignerInfo(const NodePath& path, const UUCByteArray& encoded, NodePath& found)
+{
+	const Node& signerInfo = path.back();
+
+	UUCByteArray bytes;
+	if(signerInfo.end() - signerInfo.nOffset == encoded.getLength())
+	{
+		readBytes(signerInfo, bytes);
+		if(memcmp(bytes.getContent(), encoded.getContent(), encoded.getLength()) == 0)
+		{
+			found = path;
+			return true;
+		}
+	}
+
+	// controfirme: unsignedAttrs -> Attribute { countersignature OID, SET OF SignerInfo }
+	std::vector<Node> nodes;
+	children(signerInfo, nodes);
+	if(nodes.empty() || nodes.back().btTag != TAG_CONTEXT_1)
+		return false;
+
+	UUCByteArray oid;
+	CASN1ObjectIdentifier(szCounterSignatureOID).toByteArray(oid);
+
+	NodePath attributePath(path);
+	attributePath.push_back(nodes.back());
+
+	std::vector<Node> attributes;
+	children(nodes.back(), attributes);
+	for(size_t i = 0; i < attributes.size(); i++)
+	{
+		std::vector<Node> fields;
+		children(attributes[i], fields);
+		if(fields.size() != 2 || fields[0].end() - fields[0].nOffset != oid.getLength())
+			continue;
+
+		readBytes(fields[0], bytes);
+		if(memcmp(bytes.getContent(), oid.getContent(), oid.getLength()) != 0)
+			continue;
+
+		NodePath setPath(attributePath);
+		setPath.push_back(attributes[i]);
+		setPath.push_back(fields[1]);
+
+		std::vector<Node> countersignatures;
+		children(fields[1], countersignatures);
+		for(size_t j = 0; j < countersignatures.size(); j++)
+		{
+			NodePath counterPath(setPath);
+			counterPath.push_back(countersignatures[j]);
+			if(findSignerInfo(counterPath, encoded, found))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// Edits
+//////////////////////////////////////////////////////////////////////
+
+void CSignedDataPatcher::append(const NodePath& ancestors, size_t nPos, int nDepth, BYTE btWrapTag, const UUCByteArray& data)
+{
+	std::pair<size_t, int> key(nPos, nDepth);
+	std::map<std::pair<size_t, int>, Insertion>::iterator it = m_insertions.find(key);
+	if(it == m_insertions.end())
+	{
+		Insertion insertion;
+		insertion.nPos = nPos;
+		insertion.nDepth = nDepth;
+		insertion.btWrapTag = btWrapTag;
+		insertion.ancestors = ancestors;
+		it = m_insertions.insert(std::make_pair(key, insertion)).first;
+	}
+
+	it->second.data.append(data);
+}
+
+void CSignedDataPatcher::addToSignerInfo(const NodePath& path, const UUCByteArray& attribute)
+{
+	const Node& signerInfo = path.back();
+
+	std::vector<Node> nodes;
+	children(signerInfo, nodes);
+
+	if(!nodes.empty() && nodes.back().btTag == TAG_CONTEXT_1)
+	{
+		// unsignedAttrs presenti: l'attributo si accoda al loro contenuto
+		NodePath ancestors(path);
+		ancestors.push_back(nodes.back());
+		append(ancestors, nodes.back().contentEnd(), nodes.back().nDepth, 0, attribute);
+	}
+	else
+	{
+		// unsignedAttrs [1] IMPLICIT SET OF Attribute in coda al SignerInfo
+		append(path, signerInfo.contentEnd(), signerInfo.nDepth + 1, TAG_CONTEXT_1, attribute);
+	}
+}
+
+int CSignedDataPatcher::getSignerInfoCount()
+{
+	locate();
+	return (int)m_signerInfoNodes.size();
+}
+
+void CSignedDataPatcher::getSignerInfo(int signerInfoIndex, UUCByteArray& signerInfo)
+{
+	locate();
+	if(signerInfoIndex < 0 || signerInfoIndex >= (int)m_signerInfoNodes.size())
+		throw CASN1ObjectNotFoundException("CSignedDataPatcher");
+
+	readBytes(m_signerInfoNodes[signerInfoIndex], signerInfo);
+}
+
+void CSignedDataPatcher::addUnsignedAttribute(int signerInfoIndex, const CASN1Object& attribute)
+{
+	locate();
+	if(signerInfoIndex < 0 || signerInfoIndex >= (int)m_signerInfoNodes.size())
+		throw CASN1ObjectNotFoundException("CSignedDataPatcher");
+
+	NodePath path(m_signedDataPath);
+	path.push_back(m_signerInfos);
+	path.push_back(m_signerInfoNodes[signerInfoIndex]);
+
+	UUCByteArray encoded;
+	attribute.toByteArray(encoded);
+	addToSignerInfo(path, encoded);
+}
+
+bool CSignedDataPatcher::addUnsignedAttribute(const CASN1Object& signerInfoRef, const CASN1Object& attribute)
+{
+	locate();
+
+	UUCByteArray ref;
+	signerInfoRef.toByteArray(ref);
+
+	NodePath path(m_signedDataPath);
+	path.push_back(m_signerInfos);
+
+	NodePath found;
+	for(size_t i = 0; i < m_signerInfoNodes.size(); i++)
+	{
+		NodePath signerInfoPath(path);
+		signerInfoPath.push_back(m_signerInfoNodes[i]);
+		if(findSignerInfo(signerInfoPath, ref, found))
+		{
+			UUCByteArray encoded;
+			attribute.toByteArray(encoded);
+			addToSignerInfo(found, encoded);
+			return true;
+		}
+	}
+
+	LOG_ERR((0, "CSignedDataPatcher::addUnsignedAttribute", "signerInfo reference not found"));
+	return false;
+}
+
+void CSignedDataPatcher::addSignerInfo(const CASN1Object& signerInfo)
+{
+	locate();
+
+	UUCByteArray encoded;
+	signerInfo.toByteArray(encoded);
+
+	NodePath ancestors(m_signedDataPath);
+	ancestors.push_back(m_signerInfos);
+	append(ancestors, m_signerInfos.contentEnd(), m_signerInfos.nDepth, 0, encoded);
+}
+
+void CSignedDataPatcher::addCertificate(const CASN1Object& certificate)
+{
+	locate();
+
+	UUCByteArray encoded;
+	certificate.toByteArray(encoded);
+
+	for(size_t i = 0; i < m_addedCertificates.size(); i++)
+	{
+		if(m_addedCertificates[i].getLength() == encoded.getLength() &&
+		   memcmp(m_addedCertificates[i].getContent(), encoded.getContent(), encoded.getLength()) == 0)
+			return;
+	}
+
+	if(m_bHasCertificates && contains(m_certificates, encoded))
+		return;
+
+	m_addedCertificates.push_back(encoded);
+
+	NodePath ancestors(m_signedDataPath);
+	if(m_bHasCertificates)
+	{
+		ancestors.push_back(m_certificates);
+		append(ancestors, m_certificates.contentEnd(), m_certificates.nDepth, 0, encoded);
+	}
+	else
+	{
+		// certificates [0] IMPLICIT subito dopo encapContentInfo
+		append(ancestors, m_encapContentInfo.end(), m_encapContentInfo.nDepth, TAG_CONTEXT_0, encoded);
+	}
+}
+
+void CSignedDataPatcher::addDigestAlgorithm(const CASN1Object& digestAlgorithm)
+{
+	locate();
+
+	UUCByteArray encoded;
+	digestAlgorithm.toByteArray(encoded);
+
+	for(size_t i = 0; i < m_addedDigestAlgos.size(); i++)
+	{
+		if(m_addedDigestAlgos[i].getLength() == encoded.getLength() &&
+		   memcmp(m_addedDigestAlgos[i].getContent(), encoded.getContent(), encoded.getLength()) == 0)
+			return;
+	}
+
+	if(contains(m_digestAlgos, encoded))
+		return;
+
+	m_addedDigestAlgos.push_back(encoded);
+
+	NodePath ancestors(m_signedDataPath);
+	ancestors.push_back(m_digestAlgos);
+	append(ancestors, m_digestAlgos.contentEnd(), m_digestAlgos.nDepth, 0, encoded);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Output
+//////////////////////////////////////////////////////////////////////
+
+static size_t encodeLength(size_t nLen, BYTE* pbtOut)
+{
+	if(nLen < 0x80)
+	{
+		pbtOut[0] = (BYTE)nLen;
+		return 1;
+	}
+
+	size_t nBytes = 0;
+	for(size_t nAux = nLen; nAux > 0; nAux >>= 8)
+		nBytes++;
+
+	pbtOut[0] = (BYTE)(0x80 | nBytes);
+	for(size_t i = 0; i < nBytes; i++)
+		pbtOut[nBytes - i] = (BYTE)(nLen >> (8 * i));
+
+	return nBytes + 1;
+}
+
+bool CSignedDataPatcher::emit(const BYTE* pData, size_t nLen, UUCByteArray* pArray, FILE* pOut)
+{
+	if(nLen == 0)
+		return true;
+
+	if(pArray)
+	{
+		pArray->append(pData, (unsigned int)nLen);
+		return true;
+	}
+
+	return fwrite(pData, 1, nLen, pOut) == nLen;
+}
+
+bool CSignedDataPatcher::copy(size_t nFrom, size_t nTo, UUCByteArray* pArray, FILE* pOut)
+{
+	if(m_pBuffer)
+		return emit(m_pBuffer + nFrom, nTo - nFrom, pArray, pOut);
+
+	BYTE* pbtChunk = new BYTE[COPY_CHUNK];
+	bool bOk = true;
+	for(size_t nPos = nFrom; bOk && nPos < nTo; )
+	{
+		size_t nChunk = std::min((size_t)COPY_CHUNK, nTo - nPos);
+		read(nPos, pbtChunk, nChunk);
+		bOk = emit(pbtChunk, nChunk, pArray, pOut);
+		nPos += nChunk;
+	}
+
+	delete[] pbtChunk;
+	return bOk;
+}
+
+namespace
+{
+	// un header da riscrivere (0) o un inserimento (1) nel flusso di uscita
+	struct PatchEvent
+	{
+		size_t nOffset;
+		int nKind;
+		int nDepth;
+		size_t nSkip;
+		UUCByteArray data;
+	};
+
+	bool operator < (const PatchEvent& a, const PatchEvent& b)
+	{
+		if(a.nOffset != b.nOffset)
+			return a.nOffset < b.nOffset;
+
+		// a parita' di offset l'inserimento chiude l'elemento precedente: va prima dell'header
+		if(a.nKind != b.nKind)
+			return a.nKind > b.nKind;
+
+		// inserimenti sullo stesso offset: prima il piu' annidato
+		return a.nDepth > b.nDepth;
+	}
+}
+
+bool CSignedDataPatcher::write(UUCByteArray* pArray, FILE* pOut)
+{
+	if(!m_insertions.empty())
+		locate();
+
+	std::map<size_t, std::pair<Node, size_t> > grown;   // offset -> (elemento, byte aggiunti)
+	std::vector<PatchEvent> events;
+	size_t nOutLen = m_nLength;
+
+	std::map<std::pair<size_t, int>, Insertion>::const_iterator it;
+	for(it = m_insertions.begin(); it != m_insertions.end(); ++it)
+	{
+		const Insertion& insertion = it->second;
+
+		PatchEvent event;
+		event.nOffset = insertion.nPos;
+		event.nKind = 1;
+		event.nDepth = insertion.nDepth;
+		event.nSkip = 0;
+
+		if(insertion.btWrapTag)
+		{
+			BYTE pbtHeader[1 + 1 + sizeof(size_t)];
+			pbtHeader[0] = insertion.btWrapTag;
+			size_t nHeaderLen = 1 + encodeLength(insertion.data.getLength(), pbtHeader + 1);
+			event.data.append(pbtHeader, (unsigned int)nHeaderLen);
+		}
+		event.data.append(insertion.data);
+
+		for(size_t i = 0; i < insertion.ancestors.size(); i++)
+		{
+			const Node& node = insertion.ancestors[i];
+			std::map<size_t, std::pair<Node, size_t> >::iterator g = grown.find(node.nOffset);
+			if(g == grown.end())
+				grown[node.nOffset] = std::make_pair(node, (size_t)event.data.getLength());
+			else
+				g->second.second += event.data.getLength();
+		}
+
+		nOutLen += event.data.getLength();
+		events.push_back(event);
+	}
+
+	// dal piu' annidato: se l'header di un elemento si allunga (0x7F -> 0x80,
+	// 0xFF -> 0x100, ...) crescono anche tutti gli elementi che lo contengono
+	std::vector<std::pair<Node, size_t>*> nested;
+	std::map<size_t, std::pair<Node, size_t> >::iterator g;
+	for(g = grown.begin(); g != grown.end(); ++g)
+		nested.push_back(&g->second);
+	std::stable_sort(nested.begin(), nested.end(),
+		[](const std::pair<Node, size_t>* a, const std::pair<Node, size_t>* b) { return a->first.nDepth > b->first.nDepth; });
+
+	for(size_t i = 0; i < nested.size(); i++)
+	{
+		const Node& node = nested[i]->first;
+		if(node.bIndefinite)
+			continue;
+
+		BYTE pbtLength[1 + sizeof(size_t)];
+		size_t nHeaderGrowth = node.nTagLen + encodeLength(node.nContentLen + nested[i]->second, pbtLength) - node.nHeaderLen;
+		for(size_t j = i + 1; nHeaderGrowth && j < nested.size(); j++)
+		{
+			const Node& outer = nested[j]->first;
+			if(outer.nDepth < node.nDepth && outer.nOffset < node.nOffset && node.nOffset < outer.end())
+				nested[j]->second += nHeaderGrowth;
+		}
+	}
+
+	// solo gli header degli elementi cresciuti vengono riscritti
+	for(g = grown.begin(); g != grown.end(); ++g)
+	{
+		const Node& node = g->second.first;
+		if(node.bIndefinite)
+			continue;
+
+		PatchEvent event;
+		event.nOffset = node.nOffset;
+		event.nKind = 0;
+		event.nDepth = node.nDepth;
+		event.nSkip = node.nHeaderLen;
+
+		BYTE pbtHeader[16 + 1 + sizeof(size_t)];
+		if(node.nTagLen > 16)
+			throw CASN1ParsingException();
+
+		read(node.nOffset, pbtHeader, node.nTagLen);
+		size_t nHeaderLen = node.nTagLen + encodeLength(node.nContentLen + g->second.second, pbtHeader + node.nTagLen);
+		event.data.append(pbtHeader, (unsigned int)nHeaderLen);
+
+		nOutLen += nHeaderLen;
+		nOutLen -= node.nHeaderLen;
+		events.push_back(event);
+	}
+
+	std::sort(events.begin(), events.end());
+
+	if(pArray)
+		pArray->reserve((unsigned long)(pArray->getLength() + nOutLen));
+
+	size_t nCursor = 0;
+	for(size_t i = 0; i < events.size(); i++)
+	{
+		const PatchEvent& event = events[i];
+		if(!copy(nCursor, event.nOffset, pArray, pOut) ||
+		   !emit(event.data.getContent(), event.data.getLength(), pArray, pOut))
+			return false;
+
+		nCursor = event.nOffset + event.nSkip;
+	}
+
+	return copy(nCursor, m_nLength, pArray, pOut);
+}
+
+void CSignedDataPatcher::toByteArray(UUCByteArray& pkcs7SignedData)
+{
+	write(&pkcs7SignedData, NULL);
+}
+
+long CSignedDataPatcher::writeTo(FILE* pOut)
+{
+	if(!write(NULL, pOut) || fflush(pOut) != 0)
+	{
+		LOG_ERR((0, "CSignedDataPatcher::writeTo", "write failed"));
+		return DISIGON_ERROR_INVALID_FILE;
+	}
+
+	return 0;
+}
@@ -37,6 +37,27 @@ CSignerInfoGenerator::~CSignerInfoGenerator()
 	//	delete m_pCounterSignature;
 }
 
+void CSignerInfoGenerator::reset()
+{
+	m_content.removeAll();
+	m_contentHash.removeAll();
+	m_signingCertificate.removeAll();
+	m_signature.removeAll();
+	m_signedAttributes.removeAll();
+	m_unsignedAttributes.removeAll();
+	m_certificateHash.removeAll();
+	m_timeStampToken.removeAll();
+	m_counterSignatures.removeAll();
+
+	if(m_pIssuer)
+		delete m_pIssuer;
+	m_pIssuer = NULL;
+
+	if(m_pSerialNumber)
+		delete m_pSerialNumber;
+	m_pSerialNumber = NULL;
+}
+
 void CSignerInfoGenerator::setContentHash(const BYTE* hash, int hashlen)
 {
 	m_contentHash.append(hash, hashlen);
@@ -0,0 +1,328 @@
+/*
+ *  TimestampUpgrader.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "TimestampUpgrader.h"
+#include "SignedDataGeneratorEx.h"
+#include "SignedDataPatcher.h"
+#include "ASN1/SignerInfo.h"
+#include "ASN1/UUCBufferedReader.h"
+#include "disigonsdk.h"
+#include "UUCLogger.h"
+
+#include <openssl/sha.h>
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+
+USE_LOG;
+
+struct CTimestampUpgrader::Job
+{
+	TIMESTAMP_UPGRADE_RESULT* pResult;
+	std::vector<int> signerInfos;
+	std::vector<UUCByteArray> digests;
+};
+
+//////////////////////////////////////////////////////////////////////
+// Construction/Destruction
+//////////////////////////////////////////////////////////////////////
+
+CTimestampUpgrader::CTimestampUpgrader(CTSAClient& tsaClient)
+: m_tsaClient(tsaClient), m_nPrepareThreads(2), m_nInFlight(8)
+{
+}
+
+CTimestampUpgrader::~CTimestampUpgrader()
+{
+}
+
+void CTimestampUpgrader::setPolicyID(const char* szPolicyID)
+{
+	m_szPolicyID = szPolicyID ? szPolicyID : "";
+}
+
+void CTimestampUpgrader::setOutputDir(const char* szOutputDir)
+{
+	m_szOutputDir = szOutputDir ? szOutputDir : "";
+}
+
+void CTimestampUpgrader::setThreads(int nPrepareThreads, int nInFlight)
+{
+	m_nPrepareThreads = nPrepareThreads > 0 ? nPrepareThreads : 1;
+	m_nInFlight = nInFlight > 0 ? nInFlight : 1;
+}
+
+void CTimestampUpgrader::addFile(const char* szPath)
+{
+	m_files.push_back(szPath);
+}
+
+int CTimestampUpgrader::addDirectory(const char* szDir)
+{
+	DIR* pDir = opendir(szDir);
+	if(!pDir)
+	{
+		LOG_ERR((0, "CTimestampUpgrader::addDirectory", "opendir failed: %s", szDir));
+		return 0;
+	}
+
+	int nAdded = 0;
+	while(struct dirent* pEntry = readdir(pDir))
+	{
+		size_t nLen = strlen(pEntry->d_name);
+		if(nLen < 4 || strcasecmp(pEntry->d_name + nLen - 4, ".p7m") != 0)
+			continue;
+
+		m_files.push_back(std::string(szDir) + "/" + pEntry->d_name);
+		nAdded++;
+	}
+	closedir(pDir);
+
+	return nAdded;
+}
+
+std::string CTimestampUpgrader::outputPath(const std::string& szInputPath)
+{
+	if(m_szOutputDir.empty())
+		return szInputPath;
+
+	size_t nSlash = szInputPath.find_last_of('/');
+	return m_szOutputDir + "/" + (nSlash == std::string::npos ? szInputPath : szInputPath.substr(nSlash + 1));
+}
+
+//////////////////////////////////////////////////////////////////////
+// Stages
+//////////////////////////////////////////////////////////////////////
+
+void CTimestampUpgrader::prepare(Job& job)
+{
+	TIMESTAMP_UPGRADE_RESULT* pResult = job.pResult;
+
+	FILE* pFile = fopen(pResult->szInputPath.c_str(), "rb");
+	if(!pFile)
+	{
+		pResult->nError = DISIGON_ERROR_FILE_NOT_FOUND;
+		return;
+	}
+
+	try
+	{
+		// solo gli header fino ai signerInfo vengono letti: il contenuto non viene caricato
+		CSignedDataPatcher patcher(pFile);
+		int nCount = patcher.getSignerInfoCount();
+		for(int i = 0; i < nCount; i++)
+		{
+			UUCByteArray encoded;
+			patcher.getSignerInfo(i, encoded);
+
+			UUCBufferedReader reader(encoded);
+			CSignerInfo signerInfo(reader);
+			if(signerInfo.hasTimeStampToken())
+			{
+				pResult->nSkipped++;
+				continue;
+			}
+
+			// la marca temporale della firma (CAdES-T) e' calcolata sul valore della firma
+			CASN1OctetString signature(signerInfo.getEncryptedDigest());
+			const UUCByteArray* pValue = signature.getValue();
+
+			BYTE pbtDigest[SHA256_DIGEST_LENGTH];
+			SHA256(pValue->getContent(), pValue->getLength(), pbtDigest);
+
+			job.signerInfos.push_back(i);
+			job.digests.push_back(UUCByteArray(pbtDigest, SHA256_DIGEST_LENGTH));
+		}
+	}
+	catch(...)
+	{
+		LOG_ERR((0, "CTimestampUpgrader::prepare", "invalid p7m: %s", pResult->szInputPath.c_str()));
+		pResult->nError = DISIGON_ERROR_INVALID_FILE;
+	}
+
+	fclose(pFile);
+}
+
+void CTimestampUpgrader::timestamp(Job& job)
+{
+	TIMESTAMP_UPGRADE_RESULT* pResult = job.pResult;
+
+	std::vector<CTimeStampToken*> tokens;
+	for(size_t i = 0; i < job.digests.size(); i++)
+	{
+		CTimeStampToken* pTimeStampToken = NULL;
+		long nRet = m_tsaClient.GetTimeStampToken(job.digests[i], m_szPolicyID.empty() ? NULL : m_szPolicyID.c_str(), &pTimeStampToken);
+		if(nRet != 0 || pTimeStampToken == NULL)
+		{
+			LOG_ERR((0, "CTimestampUpgrader::timestamp", "TSA error %lx: %s", nRet, pResult->szInputPath.c_str()));
+			pResult->nError = DISIGON_ERROR_TSA;
+			break;
+		}
+
+		tokens.push_back(pTimeStampToken);
+	}
+
+	FILE* pFile = NULL;
+	if(pResult->nError == 0)
+	{
+		pFile = fopen(pResult->szInputPath.c_str(), "rb");
+		if(!pFile)
+			pResult->nError = DISIGON_ERROR_FILE_NOT_FOUND;
+	}
+
+	if(pResult->nError == 0)
+	{
+		// il file originale resta intatto finche' il nuovo non e' completo
+		std::string szTempPath = pResult->szOutputPath + ".tmp";
+		FILE* pOut = fopen(szTempPath.c_str(), "wb");
+		if(!pOut)
+		{
+			pResult->nError = DISIGON_ERROR_INVALID_FILE;
+		}
+		else
+		{
+			try
+			{
+				SignedDataGeneratorEx generator(pFile);
+				for(size_t i = 0; i < tokens.size(); i++)
+					generator.setTimestamp(*tokens[i], job.signerInfos[i]);
+
+				pResult->nError = generator.writeTo(pOut);
+			}
+			catch(...)
+			{
+				pResult->nError = DISIGON_ERROR_INVALID_FILE;
+			}
+
+			if(fclose(pOut) != 0 && pResult->nError == 0)
+				pResult->nError = DISIGON_ERROR_INVALID_FILE;
+
+			if(pResult->nError == 0 && rename(szTempPath.c_str(), pResult->szOutputPath.c_str()) != 0)
+				pResult->nError = DISIGON_ERROR_INVALID_FILE;
+
+			if(pResult->nError != 0)
+				remove(szTempPath.c_str());
+			else
+				pResult->nTimestamped = (int)tokens.size();
+		}
+	}
+
+	if(pFile)
+		fclose(pFile);
+
+	for(size_t i = 0; i < tokens.size(); i++)
+		delete tokens[i];
+}
+
+int CTimestampUpgrader::run(std::vector<TIMESTAMP_UPGRADE_RESULT>& results)
+{
+	results.clear();
+	results.resize(m_files.size());
+
+	std::vector<Job> jobs(m_files.size());
+	for(size_t i = 0; i < m_files.size(); i++)
+	{
+		results[i].szInputPath = m_files[i];
+		results[i].szOutputPath = outputPath(m_files[i]);
+		results[i].nError = 0;
+		results[i].nTimestamped = 0;
+		results[i].nSkipped = 0;
+		jobs[i].pResult = &results[i];
+	}
+
+	// con l'output dir conta solo il nome del file: a/x.p7m e b/x.p7m si sovrascriverebbero
+	std::map<std::string, size_t> outputs;
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		std::pair<std::map<std::string, size_t>::iterator, bool> inserted =
+			outputs.insert(std::make_pair(results[i].szOutputPath, i));
+		if(inserted.second)
+			continue;
+
+		LOG_ERR((0, "CTimestampUpgrader::run", "%s and %s both write %s", results[inserted.first->second].szInputPath.c_str(),
+			results[i].szInputPath.c_str(), results[i].szOutputPath.c_str()));
+		results[inserted.first->second].nError = DISIGON_ERROR_OUTPUT_CONFLICT;
+		results[i].nError = DISIGON_ERROR_OUTPUT_CONFLICT;
+	}
+
+	// coda limitata tra preparazione e richieste alla TSA
+	std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	std::deque<size_t> queue;
+	size_t nCapacity = (size_t)m_nInFlight * 2;
+	int nPreparing = m_nPrepareThreads;
+	std::atomic<size_t> nNext(0);
+
+	std::vector<std::thread> threads;
+	for(int t = 0; t < m_nPrepareThreads; t++)
+	{
+		threads.push_back(std::thread([&]() {
+			for(size_t i = nNext++; i < jobs.size(); i = nNext++)
+			{
+				if(jobs[i].pResult->nError == 0)
+					prepare(jobs[i]);
+
+				// sul posto, senza firme da marcare, non c'e' niente da scrivere
+				if(jobs[i].pResult->nError != 0 || (jobs[i].digests.empty() && m_szOutputDir.empty()))
+					continue;
+
+				std::unique_lock<std::mutex> lock(mutex);
+				notFull.wait(lock, [&]() { return queue.size() < nCapacity; });
+				queue.push_back(i);
+				notEmpty.notify_one();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if(--nPreparing == 0)
+				notEmpty.notify_all();
+		}));
+	}
+
+	for(int t = 0; t < m_nInFlight; t++)
+	{
+		threads.push_back(std::thread([&]() {
+			for(;;)
+			{
+				size_t i;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					notEmpty.wait(lock, [&]() { return !queue.empty() || nPreparing == 0; });
+					if(queue.empty())
+						return;
+
+					i = queue.front();
+					queue.pop_front();
+					notFull.notify_one();
+				}
+
+				timestamp(jobs[i]);
+			}
+		}));
+	}
+
+	for(size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	int nFailed = 0;
+	for(size_t i = 0; i < results.size(); i++)
+	{
+		if(results[i].nError != 0)
+			nFailed++;
+	}
+
+	LOG_DBG((0, "CTimestampUpgrader::run", "files: %d, failed: %d", (int)results.size(), nFailed));
+
+	return nFailed;
+}
@@ -0,0 +1,846 @@
+/*
+ *  TrustedList.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "TrustedList.h"
+#include "CertStore.h"
+#include "HttpClient.h"
+#include "Base64.h"
+#include "ASN1/ASN1Exception.h"
+#include "disigonsdk.h"
+#include "UUCLogger.h"
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+USE_LOG;
+
+#define TSL_SERVICE_TYPE_PREFIX		"http://uri.etsi.org/TrstSvc/Svctype/"
+#define TSL_SERVICE_STATUS_PREFIX	"http://uri.etsi.org/TrstSvc/TrustedList/Svcstatus/"
+#define TSL_LEGACY_STATUS_PREFIX	"http://uri.etsi.org/TrstSvc/Svcstatus/"
+#define TSL_TYPE_LOTL				"EUlistofthelists"
+
+// secondi per scaricare una trusted list
+#define TSL_DOWNLOAD_TIMEOUT		120
+
+//////////////////////////////////////////////////////////////////////
+// Formato della snapshot:
+// Header | sorgente | Entry ordinate per key identifier | Subject ordinati | certificati DER
+//////////////////////////////////////////////////////////////////////
+
+#define TSL_SNAPSHOT_MAGIC			"CIETSLSN"
+#define TSL_SNAPSHOT_VERSION		2
+#define TSL_SNAPSHOT_BYTE_ORDER		0x01020304
+#define TSL_KEYID_SIZE				32
+
+struct CTrustedListSnapshot::Header
+{
+	char szMagic[8];
+	uint32_t nVersion;
+	uint32_t nByteOrder;
+	uint64_t nFileSize;
+	int64_t nNextUpdate;
+	uint32_t nSourceLength;
+	uint32_t nEntries;
+	uint64_t nIndexOffset;
+	uint64_t nSubjectOffset;
+	uint64_t nDataOffset;
+};
+
+struct CTrustedListSnapshot::Entry
+{
+	BYTE keyId[TSL_KEYID_SIZE];
+	uint8_t nKeyIdLength;
+	uint8_t nType;
+	uint8_t nStatus;
+	uint8_t reserved[5];
+	int64_t nStatusStartingTime;
+	uint64_t nCertOffset;       // dall'inizio dei certificati
+	uint64_t nCertLength;
+};
+
+// SHA-1 del subject DN del certificato di un'Entry
+struct CTrustedListSnapshot::Subject
+{
+	BYTE subject[SHA_DIGEST_LENGTH];
+	uint32_t nEntry;
+};
+
+static_assert(sizeof(CTrustedListSnapshot::Header) == 64, "snapshot header layout");
+static_assert(sizeof(CTrustedListSnapshot::Entry) == 64, "snapshot entry layout");
+static_assert(sizeof(CTrustedListSnapshot::Subject) == 24, "snapshot subject layout");
+
+// key identifier nell'indice: oltre TSL_KEYID_SIZE byte se ne usa lo SHA-1
+static std::string indexKey(const std::string& szKeyId)
+{
+	if(szKeyId.size() <= TSL_KEYID_SIZE)
+		return szKeyId;
+
+	BYTE pbtHash[SHA_DIGEST_LENGTH];
+	SHA1((const BYTE*)szKeyId.data(), szKeyId.size(), pbtHash);
+	return std::string((const char*)pbtHash, sizeof(pbtHash));
+}
+
+static int compareKey(const CTrustedListSnapshot::Entry& entry, const std::string& szKey)
+{
+	size_t nLength = std::min((size_t)entry.nKeyIdLength, szKey.size());
+	int nCmp = memcmp(entry.keyId, szKey.data(), nLength);
+	if(nCmp != 0)
+		return nCmp;
+
+	return (int)entry.nKeyIdLength - (int)szKey.size();
+}
+
+static std::string subjectKey(const std::string& szSubject)
+{
+	BYTE pbtHash[SHA_DIGEST_LENGTH];
+	SHA1((const BYTE*)szSubject.data(), szSubject.size(), pbtHash);
+	return std::string((const char*)pbtHash, sizeof(pbtHash));
+}
+
+static bool operator < (const CTrustedListSnapshot::Subject& a, const CTrustedListSnapshot::Subject& b)
+{
+	int nCmp = memcmp(a.subject, b.subject, sizeof(a.subject));
+	return nCmp < 0 || (nCmp == 0 && a.nEntry < b.nEntry);
+}
+
+//////////////////////////////////////////////////////////////////////
+// Lettura dell'XML
+//////////////////////////////////////////////////////////////////////
+
+// per nome locale: i prefissi dei namespace variano da una lista all'altra
+static bool isElement(xmlNodePtr pNode, const char* szName)
+{
+	return pNode->type == XML_ELEMENT_NODE && xmlStrcmp(pNode->name, BAD_CAST szName) == 0;
+}
+
+static xmlNodePtr nextElement(xmlNodePtr pNode, const char* szName)
+{
+	for(; pNode; pNode = pNode->next)
+	{
+		if(isElement(pNode, szName))
+			return pNode;
+	}
+
+	return NULL;
+}
+
+static xmlNodePtr firstElement(xmlNodePtr pParent, const char* szName)
+{
+	return pParent ? nextElement(pParent->children, szName) : NULL;
+}
+
+static std::string content(xmlNodePtr pNode)
+{
+	if(!pNode)
+		return "";
+
+	xmlChar* szContent = xmlNodeGetContent(pNode);
+	std::string szText = szContent ? (const char*)szContent : "";
+	xmlFree(szContent);
+
+	size_t nStart = szText.find_first_not_of(" \t\r\n");
+	if(nStart == std::string::npos)
+		return "";
+
+	return szText.substr(nStart, szText.find_last_not_of(" \t\r\n") - nStart + 1);
+}
+
+static bool endsWith(const std::string& szText, const char* szSuffix)
+{
+	size_t nLength = strlen(szSuffix);
+	return szText.size() >= nLength && szText.compare(szText.size() - nLength, nLength, szSuffix) == 0;
+}
+
+// xsd:dateTime in UTC, es. 2026-03-01T10:00:00Z
+static time_t parseDateTime(const std::string& szDateTime)
+{
+	struct tm t;
+	memset(&t, 0, sizeof(t));
+	if(sscanf(szDateTime.c_str(), "%4d-%2d-%2dT%2d:%2d:%2d", &t.tm_year, &t.tm_mon, &t.tm_mday, &t.tm_hour, &t.tm_min, &t.tm_sec) != 6)
+		return 0;
+
+	t.tm_year -= 1900;
+	t.tm_mon -= 1;
+	return timegm(&t);
+}
+
+static int serviceType(const std::string& szType)
+{
+	if(szType == TSL_SERVICE_TYPE_PREFIX "CA/QC")
+		return TSL_SERVICE_CA_QC;
+
+	if(szType == TSL_SERVICE_TYPE_PREFIX "TSA/QTST")
+		return TSL_SERVICE_TSA_QTST;
+
+	return 0;
+}
+
+static int serviceStatus(const std::string& szStatus)
+{
+	struct Status
+	{
+		const char* szPrefix;
+		const char* szName;
+		int nStatus;
+	};
+
+	// gli stati pre-eIDAS (TS 119 612 v1) hanno il prefisso senza TrustedList
+	static const Status statuses[] = {
+		{ TSL_SERVICE_STATUS_PREFIX, "granted", TSL_STATUS_GRANTED },
+		{ TSL_SERVICE_STATUS_PREFIX, "recognisedatnationallevel", TSL_STATUS_GRANTED },
+		{ TSL_SERVICE_STATUS_PREFIX, "setbynationallaw", TSL_STATUS_GRANTED },
+		{ TSL_SERVICE_STATUS_PREFIX, "withdrawn", TSL_STATUS_WITHDRAWN },
+		{ TSL_SERVICE_STATUS_PREFIX, "deprecatedatnationallevel", TSL_STATUS_WITHDRAWN },
+		{ TSL_SERVICE_STATUS_PREFIX, "deprecatedbynationallaw", TSL_STATUS_WITHDRAWN },
+		{ TSL_LEGACY_STATUS_PREFIX, "undersupervision", TSL_STATUS_GRANTED },
+		{ TSL_LEGACY_STATUS_PREFIX, "supervisionincessation", TSL_STATUS_GRANTED },
+		{ TSL_LEGACY_STATUS_PREFIX, "accredited", TSL_STATUS_GRANTED },
+		{ TSL_LEGACY_STATUS_PREFIX, "supervisionceased", TSL_STATUS_WITHDRAWN },
+		{ TSL_LEGACY_STATUS_PREFIX, "supervisionrevoked", TSL_STATUS_WITHDRAWN },
+		{ TSL_LEGACY_STATUS_PREFIX, "accreditationceased", TSL_STATUS_WITHDRAWN },
+		{ TSL_LEGACY_STATUS_PREFIX, "accreditationrevoked", TSL_STATUS_WITHDRAWN },
+	};
+
+	for(size_t i = 0; i < sizeof(statuses) / sizeof(statuses[0]); i++)
+	{
+		size_t nPrefix = strlen(statuses[i].szPrefix);
+		if(szStatus.compare(0, nPrefix, statuses[i].szPrefix) == 0 && szStatus.compare(nPrefix, std::string::npos, statuses[i].szName) == 0)
+			return statuses[i].nStatus;
+	}
+
+	return TSL_STATUS_UNKNOWN;
+}
+
+static bool decodeBase64(const std::string& szText, UUCByteArray& data)
+{
+	std::string szEncoded;
+	szEncoded.reserve(szText.size());
+	for(size_t i = 0; i < szText.size(); i++)
+	{
+		if(!isspace((unsigned char)szText[i]))
+			szEncoded += szText[i];
+	}
+
+	if(szEncoded.empty() || szEncoded.size() % 4 != 0)
+		return false;
+
+	std::vector<BYTE> buffer(base64_decoded_size((int)szEncoded.size()));
+	int nLength = base64_decode_binary(buffer.data(), szEncoded.c_str());
+	if(nLength <= 0)
+		return false;
+
+	data.append(buffer.data(), nLength);
+	return true;
+}
+
+// SubjectKeyIdentifier; se manca, SHA-1 della subjectPublicKey (RFC 5280, 4.2.1.2)
+static bool keyIdentifier(const UUCByteArray& certificate, std::string& szKeyId)
+{
+	const BYTE* pbtDer = certificate.getContent();
+	X509* pX509 = d2i_X509(NULL, &pbtDer, certificate.getLength());
+	if(!pX509)
+		return false;
+
+	const ASN1_OCTET_STRING* pSki = X509_get0_subject_key_id(pX509);
+	if(pSki)
+	{
+		szKeyId.assign((const char*)ASN1_STRING_get0_data(pSki), ASN1_STRING_length(pSki));
+	}
+	else
+	{
+		BYTE pbtHash[EVP_MAX_MD_SIZE];
+		unsigned int nLength = 0;
+		X509_pubkey_digest(pX509, EVP_sha1(), pbtHash, &nLength);
+		szKeyId.assign((const char*)pbtHash, nLength);
+	}
+
+	X509_free(pX509);
+	return true;
+}
+
+// subject DN (DER) del certificato
+static bool subjectName(const UUCByteArray& certificate, std::string& szSubject)
+{
+	const BYTE* pbtDer = certificate.getContent();
+	X509* pX509 = d2i_X509(NULL, &pbtDer, certificate.getLength());
+	if(!pX509)
+		return false;
+
+	BYTE* pbtName = NULL;
+	int nLength = i2d_X509_NAME(X509_get_subject_name(pX509), &pbtName);
+	if(nLength > 0)
+		szSubject.assign((const char*)pbtName, nLength);
+
+	OPENSSL_free(pbtName);
+	X509_free(pX509);
+	return nLength > 0;
+}
+
+static bool addCertificate(const BYTE* pbtCertificate, size_t nLength)
+{
+	try
+	{
+		CCertificate certificate(pbtCertificate, (long)nLength);
+		CCertStore::AddCertificate(certificate);
+		return true;
+	}
+	catch(CASN1Exception* ex)
+	{
+		LOG_ERR((0, "CTrustedList::addCertificate", "invalid certificate"));
+		delete ex;
+	}
+	catch(...)
+	{
+		LOG_ERR((0, "CTrustedList::addCertificate", "invalid certificate"));
+	}
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTrustedList
+//////////////////////////////////////////////////////////////////////
+
+CTrustedList::CTrustedList()
+: m_nNextUpdate(0)
+{
+}
+
+CTrustedList::~CTrustedList()
+{
+}
+
+long CTrustedList::parse(const BYTE* pbtXml, size_t nLength)
+{
+	// nessun accesso alla rete per DTD ed entita' esterne; gli errori vanno nel log
+	xmlDocPtr pDoc = xmlReadMemory((const char*)pbtXml, (int)nLength, NULL, NULL, XML_PARSE_NONET | XML_PARSE_NOBLANKS | XML_PARSE_HUGE | XML_PARSE_NOERROR | XML_PARSE_NOWARNING);
+	if(!pDoc)
+	{
+		LOG_ERR((0, "CTrustedList::parse", "invalid XML"));
+		return DISIGON_ERROR_TSL_PARSE;
+	}
+
+	xmlNodePtr pRoot = xmlDocGetRootElement(pDoc);
+	xmlNodePtr pScheme = pRoot && isElement(pRoot, "TrustServiceStatusList") ? firstElement(pRoot, "SchemeInformation") : NULL;
+	if(!pScheme)
+	{
+		LOG_ERR((0, "CTrustedList::parse", "not a trusted list"));
+		xmlFreeDoc(pDoc);
+		return DISIGON_ERROR_TSL_INVALID;
+	}
+
+	time_t nNextUpdate = parseDateTime(content(firstElement(firstElement(pScheme, "NextUpdate"), "dateTime")));
+	if(nNextUpdate != 0 && (m_nNextUpdate == 0 || nNextUpdate < m_nNextUpdate))
+		m_nNextUpdate = nNextUpdate;
+
+	// LOTL: trusted list XML, esclusa la LOTL stessa
+	xmlNodePtr pPointers = firstElement(pScheme, "PointersToOtherTSL");
+	for(xmlNodePtr pPointer = firstElement(pPointers, "OtherTSLPointer"); pPointer; pPointer = nextElement(pPointer->next, "OtherTSLPointer"))
+	{
+		std::string szLocation = content(firstElement(pPointer, "TSLLocation"));
+		std::string szMimeType;
+		std::string szTSLType;
+
+		xmlNodePtr pInfo = firstElement(pPointer, "AdditionalInformation");
+		for(xmlNodePtr pOther = firstElement(pInfo, "OtherInformation"); pOther; pOther = nextElement(pOther->next, "OtherInformation"))
+		{
+			for(xmlNodePtr pNode = pOther->children; pNode; pNode = pNode->next)
+			{
+				if(isElement(pNode, "MimeType"))
+					szMimeType = content(pNode);
+				else if(isElement(pNode, "TSLType"))
+					szTSLType = content(pNode);
+			}
+		}
+
+		if(!szLocation.empty() && szMimeType.find("xml") != std::string::npos && !endsWith(szTSLType, TSL_TYPE_LOTL))
+			m_pointers.push_back(szLocation);
+	}
+
+	xmlNodePtr pProviders = firstElement(pRoot, "TrustServiceProviderList");
+	for(xmlNodePtr pProvider = firstElement(pProviders, "TrustServiceProvider"); pProvider; pProvider = nextElement(pProvider->next, "TrustServiceProvider"))
+	{
+		xmlNodePtr pServices = firstElement(pProvider, "TSPServices");
+		for(xmlNodePtr pService = firstElement(pServices, "TSPService"); pService; pService = nextElement(pService->next, "TSPService"))
+		{
+			xmlNodePtr pInfo = firstElement(pService, "ServiceInformation");
+			int nType = serviceType(content(firstElement(pInfo, "ServiceTypeIdentifier")));
+			if(!nType)
+				continue;
+
+			int nStatus = serviceStatus(content(firstElement(pInfo, "ServiceStatus")));
+			time_t nStatusStartingTime = parseDateTime(content(firstElement(pInfo, "StatusStartingTime")));
+
+			xmlNodePtr pIdentity = firstElement(pInfo, "ServiceDigitalIdentity");
+			for(xmlNodePtr pId = firstElement(pIdentity, "DigitalId"); pId; pId = nextElement(pId->next, "DigitalId"))
+			{
+				xmlNodePtr pCertificate = firstElement(pId, "X509Certificate");
+				if(!pCertificate)
+					continue;
+
+				TSL_SERVICE service;
+				service.nType = nType;
+				service.nStatus = nStatus;
+				service.nStatusStartingTime = nStatusStartingTime;
+				if(!decodeBase64(content(pCertificate), service.certificate) || !keyIdentifier(service.certificate, service.szKeyId))
+				{
+					LOG_ERR((0, "CTrustedList::parse", "invalid X509Certificate"));
+					continue;
+				}
+
+				m_services.push_back(std::move(service));
+			}
+		}
+	}
+
+	xmlFreeDoc(pDoc);
+	return 0;
+}
+
+long CTrustedList::fetch(const char* szLocation, UUCByteArray& data)
+{
+	if(strncmp(szLocation, "http://", 7) == 0 || strncmp(szLocation, "https://", 8) == 0)
+	{
+		CHttpClient::Request request(szLocation);
+		request.nTimeout = TSL_DOWNLOAD_TIMEOUT;
+
+		CHttpClient::Response response;
+		long nRet = CHttpClient::Perform(request, response);
+		if(nRet != 0 || response.nHttpCode != 200)
+		{
+			LOG_ERR((0, "CTrustedList::fetch", "%s: error %ld, HTTP %ld", szLocation, nRet, response.nHttpCode));
+			return DISIGON_ERROR_TSL_LOAD;
+		}
+
+		data.append(response.body);
+		return 0;
+	}
+
+	FILE* pFile = fopen(szLocation, "rb");
+	if(!pFile)
+	{
+		LOG_ERR((0, "CTrustedList::fetch", "unable to open: %s", szLocation));
+		return DISIGON_ERROR_TSL_LOAD;
+	}
+
+	BYTE buffer[65536];
+	size_t nRead;
+	while((nRead = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+		data.append(buffer, (unsigned int)nRead);
+
+	bool bOk = !ferror(pFile);
+	fclose(pFile);
+
+	return bOk ? 0 : DISIGON_ERROR_TSL_LOAD;
+}
+
+long CTrustedList::load(const char* szLocation)
+{
+	UUCByteArray data;
+	long nRet = fetch(szLocation, data);
+	if(nRet)
+		return nRet;
+
+	size_t nFirstPointer = m_pointers.size();
+	nRet = parse(data.getContent(), data.getLength());
+	if(nRet)
+		return nRet;
+
+	if(m_szSource.empty())
+		m_szSource = szLocation;
+
+	// un solo livello: le liste nazionali puntano solo alla LOTL
+	std::vector<std::string> pointers(m_pointers.begin() + nFirstPointer, m_pointers.end());
+	for(size_t i = 0; i < pointers.size(); i++)
+	{
+		UUCByteArray list;
+		nRet = fetch(pointers[i].c_str(), list);
+		if(!nRet)
+			nRet = parse(list.getContent(), list.getLength());
+
+		// una lista mancante renderebbe la snapshot incompleta fino alla NextUpdate
+		if(nRet)
+		{
+			LOG_ERR((0, "CTrustedList::load", "%s: error %lX", pointers[i].c_str(), nRet));
+			return nRet;
+		}
+	}
+
+	LOG_DBG((0, "CTrustedList::load", "%s: %d certificates", szLocation, (int)m_services.size()));
+
+	return 0;
+}
+
+long CTrustedList::writeSnapshot(const char* szPath) const
+{
+	typedef CTrustedListSnapshot::Header Header;
+	typedef CTrustedListSnapshot::Entry Entry;
+	typedef CTrustedListSnapshot::Subject Subject;
+
+	std::vector<size_t> order(m_services.size());
+	std::vector<std::string> keys(m_services.size());
+	for(size_t i = 0; i < m_services.size(); i++)
+	{
+		order[i] = i;
+		keys[i] = indexKey(m_services[i].szKeyId);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+
+	// lo stesso certificato in piu' servizi viene scritto una volta
+	UUCByteArray certificates;
+	std::map<std::string, uint64_t> offsets;
+	std::vector<Entry> index(order.size());
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		const TSL_SERVICE& service = m_services[order[i]];
+		std::string szDer((const char*)service.certificate.getContent(), service.certificate.getLength());
+
+		std::map<std::string, uint64_t>::iterator it = offsets.find(szDer);
+		if(it == offsets.end())
+		{
+			it = offsets.insert(std::make_pair(szDer, (uint64_t)certificates.getLength())).first;
+			certificates.append(service.certificate);
+		}
+
+		Entry& entry = index[i];
+		memset(&entry, 0, sizeof(entry));
+		memcpy(entry.keyId, keys[order[i]].data(), keys[order[i]].size());
+		entry.nKeyIdLength = (uint8_t)keys[order[i]].size();
+		entry.nType = (uint8_t)service.nType;
+		entry.nStatus = (uint8_t)service.nStatus;
+		entry.nStatusStartingTime = service.nStatusStartingTime;
+		entry.nCertOffset = it->second;
+		entry.nCertLength = service.certificate.getLength();
+	}
+
+	std::vector<Subject> subjects(index.size());
+	for(size_t i = 0; i < order.size(); i++)
+	{
+		Subject& subject = subjects[i];
+		memset(&subject, 0, sizeof(subject));
+		std::string szSubject;
+		if(subjectName(m_services[order[i]].certificate, szSubject))
+			memcpy(subject.subject, subjectKey(szSubject).data(), sizeof(subject.subject));
+		subject.nEntry = (uint32_t)i;
+	}
+
+	std::sort(subjects.begin(), subjects.end());
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.szMagic, TSL_SNAPSHOT_MAGIC, sizeof(header.szMagic));
+	header.nVersion = TSL_SNAPSHOT_VERSION;
+	header.nByteOrder = TSL_SNAPSHOT_BYTE_ORDER;
+	header.nNextUpdate = m_nNextUpdate;
+	header.nSourceLength = (uint32_t)m_szSource.size();
+	header.nEntries = (uint32_t)index.size();
+	// indice allineato a 8 byte: le Entry vengono lette sul posto
+	header.nIndexOffset = (sizeof(Header) + m_szSource.size() + 7) & ~(uint64_t)7;
+	header.nSubjectOffset = header.nIndexOffset + index.size() * sizeof(Entry);
+	header.nDataOffset = header.nSubjectOffset + subjects.size() * sizeof(Subject);
+	header.nFileSize = header.nDataOffset + certificates.getLength();
+
+	static const BYTE padding[8] = { 0 };
+
+	// file temporaneo + rename: chi ha gia' mappato la snapshot precedente continua a leggerla
+	std::string szTemp = std::string(szPath) + ".tmp";
+
+	FILE* pFile = fopen(szTemp.c_str(), "wb");
+	bool bOk = pFile != NULL;
+	if(bOk)
+	{
+		size_t nPadding = header.nIndexOffset - sizeof(Header) - m_szSource.size();
+		bOk = fwrite(&header, sizeof(header), 1, pFile) == 1 &&
+			fwrite(m_szSource.data(), 1, m_szSource.size(), pFile) == m_szSource.size() &&
+			fwrite(padding, 1, nPadding, pFile) == nPadding &&
+			(index.empty() || fwrite(index.data(), sizeof(Entry), index.size(), pFile) == index.size()) &&
+			(subjects.empty() || fwrite(subjects.data(), sizeof(Subject), subjects.size(), pFile) == subjects.size()) &&
+			fwrite(certificates.getContent(), 1, certificates.getLength(), pFile) == (size_t)certificates.getLength();
+	}
+
+	if(pFile && fclose(pFile) != 0)
+		bOk = false;
+
+	if(bOk)
+		bOk = rename(szTemp.c_str(), szPath) == 0;
+
+	if(!bOk)
+	{
+		LOG_ERR((0, "CTrustedList::writeSnapshot", "unable to write: %s", szPath));
+		remove(szTemp.c_str());
+		return DISIGON_ERROR_TSL_LOAD;
+	}
+
+	return 0;
+}
+
+int CTrustedList::addToCertStore() const
+{
+	int nAdded = 0;
+	for(size_t i = 0; i < m_services.size(); i++)
+	{
+		const TSL_SERVICE& service = m_services[i];
+		if(service.nStatus == TSL_STATUS_GRANTED && addCertificate(service.certificate.getContent(), service.certificate.getLength()))
+			nAdded++;
+	}
+
+	return nAdded;
+}
+
+// la snapshot resta mappata: i certificati vengono decodificati quando lo store li trova
+static bool setTrustedList(const char* szLocation, const char* szSnapshotPath)
+{
+	std::unique_ptr<CTrustedListSnapshot> pSnapshot(new CTrustedListSnapshot());
+	if(pSnapshot->open(szSnapshotPath) != 0 || pSnapshot->getSource() != szLocation || time(NULL) >= pSnapshot->getNextUpdate())
+		return false;
+
+	LOG_DBG((0, "CTrustedList::LoadCertStore", "%s: %d services", szSnapshotPath, pSnapshot->size()));
+	CCertStore::SetTrustedList(pSnapshot.release());
+	return true;
+}
+
+long CTrustedList::LoadCertStore(const char* szLocation, const char* szSnapshotPath)
+{
+	if(setTrustedList(szLocation, szSnapshotPath))
+		return 0;
+
+	CTrustedList tsl;
+	long nRet = tsl.load(szLocation);
+	if(nRet)
+		return nRet;
+
+	if(tsl.getServices().empty())
+		return DISIGON_ERROR_TSL_INVALID;
+
+	// snapshot non scrivibile: la lista vale comunque per questo processo
+	if(tsl.writeSnapshot(szSnapshotPath) == 0 && setTrustedList(szLocation, szSnapshotPath))
+		return 0;
+
+	tsl.addToCertStore();
+	LOG_DBG((0, "CTrustedList::LoadCertStore", "%s: %d services", szLocation, (int)tsl.getServices().size()));
+
+	return 0;
+}
+
+const std::vector<TSL_SERVICE>& CTrustedList::getServices() const
+{
+	return m_services;
+}
+
+const std::vector<std::string>& CTrustedList::getPointers() const
+{
+	return m_pointers;
+}
+
+time_t CTrustedList::getNextUpdate() const
+{
+	return m_nNextUpdate;
+}
+
+const std::string& CTrustedList::getSource() const
+{
+	return m_szSource;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CTrustedListSnapshot
+//////////////////////////////////////////////////////////////////////
+
+CTrustedListSnapshot::CTrustedListSnapshot()
+: m_pbtData(NULL), m_nSize(0)
+{
+}
+
+CTrustedListSnapshot::~CTrustedListSnapshot()
+{
+	close();
+}
+
+long CTrustedListSnapshot::open(const char* szPath)
+{
+	close();
+
+	int fd = ::open(szPath, O_RDONLY);
+	if(fd < 0)
+		return DISIGON_ERROR_FILE_NOT_FOUND;
+
+	struct stat st;
+	void* pData = MAP_FAILED;
+	if(fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header))
+		pData = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	::close(fd);
+
+	if(pData == MAP_FAILED)
+	{
+		LOG_ERR((0, "CTrustedListSnapshot::open", "unable to map: %s", szPath));
+		return DISIGON_ERROR_TSL_INVALID;
+	}
+
+	m_pbtData = (BYTE*)pData;
+	m_nSize = st.st_size;
+
+	// da qui gli accessi restano nei limiti del file
+	const Header* pHeader = header();
+	bool bValid = memcmp(pHeader->szMagic, TSL_SNAPSHOT_MAGIC, sizeof(pHeader->szMagic)) == 0 &&
+		pHeader->nVersion == TSL_SNAPSHOT_VERSION &&
+		pHeader->nByteOrder == TSL_SNAPSHOT_BYTE_ORDER &&
+		pHeader->nFileSize == m_nSize &&
+		pHeader->nIndexOffset % 8 == 0 &&
+		pHeader->nIndexOffset >= sizeof(Header) + (uint64_t)pHeader->nSourceLength &&
+		pHeader->nIndexOffset <= m_nSize &&
+		pHeader->nEntries <= (m_nSize - pHeader->nIndexOffset) / (sizeof(Entry) + sizeof(Subject)) &&
+		pHeader->nSubjectOffset == pHeader->nIndexOffset + (uint64_t)pHeader->nEntries * sizeof(Entry) &&
+		pHeader->nDataOffset == pHeader->nSubjectOffset + (uint64_t)pHeader->nEntries * sizeof(Subject);
+
+	uint64_t nDataSize = bValid ? m_nSize - pHeader->nDataOffset : 0;
+	for(uint32_t i = 0; bValid && i < pHeader->nEntries; i++)
+	{
+		const Entry* pEntry = entry(i);
+		bValid = pEntry->nKeyIdLength <= TSL_KEYID_SIZE &&
+			pEntry->nCertOffset <= nDataSize && pEntry->nCertLength <= nDataSize - pEntry->nCertOffset;
+
+		// find() cerca per bisezione
+		if(bValid && i > 0)
+		{
+			std::string szKey((const char*)pEntry->keyId, pEntry->nKeyIdLength);
+			bValid = compareKey(*entry(i - 1), szKey) <= 0;
+		}
+
+		// anche l'indice dei subject, per findSubject()
+		const Subject* pSubject = subject(i);
+		bValid = bValid && pSubject->nEntry < pHeader->nEntries && (i == 0 || !(*pSubject < *subject(i - 1)));
+	}
+
+	if(!bValid)
+	{
+		LOG_ERR((0, "CTrustedListSnapshot::open", "invalid snapshot: %s", szPath));
+		close();
+		return DISIGON_ERROR_TSL_INVALID;
+	}
+
+	return 0;
+}
+
+void CTrustedListSnapshot::close()
+{
+	if(m_pbtData)
+		munmap(m_pbtData, m_nSize);
+
+	m_pbtData = NULL;
+	m_nSize = 0;
+}
+
+const CTrustedListSnapshot::Header* CTrustedListSnapshot::header() const
+{
+	return (const Header*)m_pbtData;
+}
+
+const CTrustedListSnapshot::Entry* CTrustedListSnapshot::entry(int nIndex) const
+{
+	return (const Entry*)(m_pbtData + header()->nIndexOffset) + nIndex;
+}
+
+const CTrustedListSnapshot::Subject* CTrustedListSnapshot::subject(int nIndex) const
+{
+	return (const Subject*)(m_pbtData + header()->nSubjectOffset) + nIndex;
+}
+
+int CTrustedListSnapshot::size() const
+{
+	return m_pbtData ? (int)header()->nEntries : 0;
+}
+
+time_t CTrustedListSnapshot::getNextUpdate() const
+{
+	return m_pbtData ? (time_t)header()->nNextUpdate : 0;
+}
+
+std::string CTrustedListSnapshot::getSource() const
+{
+	if(!m_pbtData)
+		return "";
+
+	return std::string((const char*)m_pbtData + sizeof(Header), header()->nSourceLength);
+}
+
+bool CTrustedListSnapshot::getService(int nIndex, TSL_SERVICE& service) const
+{
+	if(nIndex < 0 || nIndex >= size())
+		return false;
+
+	const Entry* pEntry = entry(nIndex);
+	service.nType = pEntry->nType;
+	service.nStatus = pEntry->nStatus;
+	service.nStatusStartingTime = (time_t)pEntry->nStatusStartingTime;
+	service.szKeyId.assign((const char*)pEntry->keyId, pEntry->nKeyIdLength);
+
+	UUCByteArray certificate(m_pbtData + header()->nDataOffset + pEntry->nCertOffset, (unsigned long)pEntry->nCertLength);
+	service.certificate = std::move(certificate);
+	return true;
+}
+
+int CTrustedListSnapshot::find(const std::string& szKeyId, std::vector<TSL_SERVICE>& services) const
+{
+	if(!m_pbtData)
+		return 0;
+
+	std::string szKey = indexKey(szKeyId);
+	const Entry* pBegin = entry(0);
+	const Entry* pEnd = pBegin + header()->nEntries;
+	const Entry* pEntry = std::lower_bound(pBegin, pEnd, szKey,
+		[](const Entry& entry, const std::string& szKey) { return compareKey(entry, szKey) < 0; });
+
+	int nFound = 0;
+	for(; pEntry != pEnd && compareKey(*pEntry, szKey) == 0; pEntry++, nFound++)
+	{
+		services.push_back(TSL_SERVICE());
+		getService((int)(pEntry - pBegin), services.back());
+	}
+
+	return nFound;
+}
+
+int CTrustedListSnapshot::findSubject(const std::string& szSubject, std::vector<TSL_SERVICE>& services) const
+{
+	if(!m_pbtData)
+		return 0;
+
+	Subject key;
+	memcpy(key.subject, subjectKey(szSubject).data(), sizeof(key.subject));
+	key.nEntry = 0;
+	const Subject* pBegin = subject(0);
+	const Subject* pEnd = pBegin + header()->nEntries;
+
+	int nFound = 0;
+	for(const Subject* pSubject = std::lower_bound(pBegin, pEnd, key);
+		pSubject != pEnd && memcmp(pSubject->subject, key.subject, sizeof(key.subject)) == 0; pSubject++, nFound++)
+	{
+		services.push_back(TSL_SERVICE());
+		getService((int)pSubject->nEntry, services.back());
+	}
+
+	return nFound;
+}
@@ -0,0 +1,549 @@
+/*
+ *  VerifyDaemon.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "VerifyDaemon.h"
+#include "VerifyReport.h"
+#include "CertStore.h"
+#include "ASN1/CrlCache.h"
+#include "ASN1/OCSPCache.h"
+#include "ASN1/UUCArena.h"
+#include "disigonsdk.h"
+#include "UUCLogger.h"
+
+#include <libxml/parser.h>
+#include <openssl/ssl.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <grp.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// lunghezza massima di una riga di richiesta
+#define VERIFYD_MAX_REQUEST		(PATH_MAX + 32)
+
+// attesa massima della richiesta o dell'invio della risposta, in secondi
+#define VERIFYD_IO_TIMEOUT		30
+
+USE_LOG;
+
+namespace {
+
+// un client che chiude la connessione non deve terminare il processo con SIGPIPE
+void noSigPipe(int nSocket)
+{
+#ifdef SO_NOSIGPIPE
+	int nOn = 1;
+	setsockopt(nSocket, SOL_SOCKET, SO_NOSIGPIPE, &nOn, sizeof(nOn));
+#else
+	(void)nSocket;
+#endif
+}
+
+bool socketAddress(const std::string& szPath, struct sockaddr_un& address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(szPath.empty() || szPath.length() >= sizeof(address.sun_path))
+		return false;
+
+	memcpy(address.sun_path, szPath.c_str(), szPath.length());
+	return true;
+}
+
+int connectTo(const std::string& szPath)
+{
+	struct sockaddr_un address;
+	if(!socketAddress(szPath, address))
+		return -1;
+
+	int nSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(nSocket < 0)
+		return -1;
+
+	noSigPipe(nSocket);
+	if(connect(nSocket, (struct sockaddr*)&address, sizeof(address)) != 0)
+	{
+		close(nSocket);
+		return -1;
+	}
+
+	return nSocket;
+}
+
+bool sendLine(int nSocket, const std::string& szLine)
+{
+	std::string szData = szLine + "\n";
+	size_t nSent = 0;
+	while(nSent < szData.length())
+	{
+		ssize_t n = send(nSocket, szData.data() + nSent, szData.length() - nSent, MSG_NOSIGNAL);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return false;
+		nSent += n;
+	}
+
+	return true;
+}
+
+// riga senza il terminatore; false su EOF, errore o riga oltre nMaxLength
+bool readLine(int nSocket, std::string& szLine, size_t nMaxLength)
+{
+	szLine.clear();
+	char buffer[512];
+	while(true)
+	{
+		ssize_t n = recv(nSocket, buffer, sizeof(buffer), 0);
+		if(n < 0 && errno == EINTR)
+			continue;
+		if(n <= 0)
+			return false;
+
+		char* pEnd = (char*)memchr(buffer, '\n', n);
+		szLine.append(buffer, pEnd ? pEnd - buffer : n);
+		if(szLine.length() > nMaxLength)
+			return false;
+		if(pEnd)
+			return true;
+	}
+}
+
+std::string cacheStats(void (*pfnGetStats)(long*, long*))
+{
+	long nHits, nMisses;
+	pfnGetStats(&nHits, &nMisses);
+
+	char szStats[64];
+	snprintf(szStats, sizeof(szStats), "{\"hits\":%ld,\"misses\":%ld}", nHits, nMisses);
+	return szStats;
+}
+
+} // namespace
+
+//////////////////////////////////////////////////////////////////////
+// CVerifyDaemon
+//////////////////////////////////////////////////////////////////////
+
+CVerifyDaemon::CVerifyDaemon()
+: m_nThreads(4), m_nQueueSize(VERIFYD_DEFAULT_QUEUE_SIZE), m_nListenSocket(-1),
+  m_bRunning(false), m_bAccepting(false), m_nServed(0), m_nRejected(0)
+{
+	m_stopPipe[0] = m_stopPipe[1] = -1;
+}
+
+CVerifyDaemon::~CVerifyDaemon()
+{
+	stop();
+}
+
+void CVerifyDaemon::setThreads(int nThreads)
+{
+	m_nThreads = nThreads > 0 ? nThreads : 1;
+}
+
+void CVerifyDaemon::setQueueSize(int nQueueSize)
+{
+	m_nQueueSize = nQueueSize > 0 ? nQueueSize : 1;
+}
+
+void CVerifyDaemon::setSocketGroup(const char* szGroup)
+{
+	m_szSocketGroup = szGroup ? szGroup : "";
+}
+
+bool CVerifyDaemon::isRunning() const
+{
+	return m_bRunning.load();
+}
+
+long CVerifyDaemon::start(const char* szSocketPath)
+{
+	if(m_bRunning)
+		return DISIGON_ERROR_UNEXPECTED;
+
+	struct sockaddr_un address;
+	if(!szSocketPath || !socketAddress(szSocketPath, address))
+	{
+		LOG_ERR((0, "CVerifyDaemon::start", "invalid socket path: %s", szSocketPath ? szSocketPath : "(null)"));
+		return DISIGON_ERROR_DAEMON_SOCKET;
+	}
+
+	// un socket rimasto da un'istanza terminata si rimuove, uno attivo no
+	struct stat info;
+	if(stat(szSocketPath, &info) == 0 && S_ISSOCK(info.st_mode))
+	{
+		int nSocket = connectTo(szSocketPath);
+		if(nSocket >= 0)
+		{
+			close(nSocket);
+			LOG_ERR((0, "CVerifyDaemon::start", "daemon already running: %s", szSocketPath));
+			return DISIGON_ERROR_DAEMON_SOCKET;
+		}
+		unlink(szSocketPath);
+	}
+
+	gid_t nGroup = (gid_t)-1;
+	if(!m_szSocketGroup.empty())
+	{
+		struct group* pGroup = getgrnam(m_szSocketGroup.c_str());
+		if(!pGroup)
+		{
+			LOG_ERR((0, "CVerifyDaemon::start", "unknown group: %s", m_szSocketGroup.c_str()));
+			return DISIGON_ERROR_DAEMON_SOCKET;
+		}
+		nGroup = pGroup->gr_gid;
+	}
+
+	// chi puo' connettersi fa verificare al demone qualsiasi file che il demone legge:
+	// il socket e' del solo utente (o del gruppo configurato) prima di accettare connessioni
+	m_nListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	bool bBound = m_nListenSocket >= 0 &&
+		bind(m_nListenSocket, (struct sockaddr*)&address, sizeof(address)) == 0;
+	if(!bBound ||
+		(nGroup != (gid_t)-1 && chown(szSocketPath, (uid_t)-1, nGroup) != 0) ||
+		chmod(szSocketPath, nGroup != (gid_t)-1 ? 0660 : 0600) != 0 ||
+		listen(m_nListenSocket, m_nQueueSize) != 0 ||
+		pipe(m_stopPipe) != 0)
+	{
+		LOG_ERR((0, "CVerifyDaemon::start", "socket %s: %s", szSocketPath, strerror(errno)));
+		if(m_nListenSocket >= 0)
+			close(m_nListenSocket);
+		if(bBound)
+			unlink(szSocketPath);
+		m_nListenSocket = -1;
+		return DISIGON_ERROR_DAEMON_SOCKET;
+	}
+
+	fcntl(m_nListenSocket, F_SETFD, FD_CLOEXEC);
+	fcntl(m_stopPipe[0], F_SETFD, FD_CLOEXEC);
+	fcntl(m_stopPipe[1], F_SETFD, FD_CLOEXEC);
+	m_szSocketPath = szSocketPath;
+
+	// inizializzazioni che altrimenti pagherebbe la prima verifica
+	OPENSSL_init_ssl(0, NULL);
+	xmlInitParser();
+
+	// disigon_verify_init azzera lo stato globale del proxy: i contesti si creano qui, in serie
+	for(int i = 0; i < m_nThreads; i++)
+		m_contexts.push_back(disigon_verify_init());
+
+	m_bAccepting = true;
+	m_bRunning = true;
+	for(int i = 0; i < m_nThreads; i++)
+		m_workers.push_back(std::thread(&CVerifyDaemon::workerLoop, this, i));
+	m_acceptThread = std::thread(&CVerifyDaemon::acceptLoop, this);
+
+	LOG_MSG((0, "CVerifyDaemon::start", "listening on %s, %d threads, queue %d", szSocketPath, m_nThreads, m_nQueueSize));
+	return 0;
+}
+
+void CVerifyDaemon::stop()
+{
+	if(!m_bRunning)
+		return;
+
+	char c = 0;
+	while(write(m_stopPipe[1], &c, 1) < 0 && errno == EINTR)
+		;
+
+	m_acceptThread.join();
+	for(size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+
+	for(size_t i = 0; i < m_contexts.size(); i++)
+		disigon_verify_cleanup(m_contexts[i]);
+	m_contexts.clear();
+
+	close(m_stopPipe[0]);
+	close(m_stopPipe[1]);
+	m_stopPipe[0] = m_stopPipe[1] = -1;
+	m_bRunning = false;
+
+	LOG_MSG((0, "CVerifyDaemon::stop", "stopped, %ld requests served", (long)m_nServed));
+}
+
+void CVerifyDaemon::acceptLoop()
+{
+	struct pollfd fds[2];
+	fds[0].fd = m_nListenSocket;
+	fds[0].events = POLLIN;
+	fds[1].fd = m_stopPipe[0];
+	fds[1].events = POLLIN;
+
+	while(true)
+	{
+		if(poll(fds, 2, -1) < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			LOG_ERR((0, "CVerifyDaemon::acceptLoop", "poll: %s", strerror(errno)));
+			break;
+		}
+
+		if(fds[1].revents)
+			break;
+
+		if(!(fds[0].revents & POLLIN))
+			continue;
+
+		int nSocket = accept(m_nListenSocket, NULL, NULL);
+		if(nSocket < 0)
+			continue;
+
+		fcntl(nSocket, F_SETFD, FD_CLOEXEC);
+		noSigPipe(nSocket);
+		struct timeval timeout = { VERIFYD_IO_TIMEOUT, 0 };
+		setsockopt(nSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(nSocket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if((int)m_queue.size() < m_nQueueSize)
+			{
+				m_queue.push_back(nSocket);
+				m_queueReady.notify_one();
+				continue;
+			}
+		}
+
+		// coda piena: il client riprova piu' tardi invece di accumularsi nel backlog
+		m_nRejected++;
+		sendLine(nSocket, "BUSY");
+		close(nSocket);
+	}
+
+	// nessuna nuova connessione; i worker esauriscono la coda e terminano
+	close(m_nListenSocket);
+	m_nListenSocket = -1;
+	unlink(m_szSocketPath.c_str());
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bAccepting = false;
+	m_queueReady.notify_all();
+}
+
+void CVerifyDaemon::workerLoop(int nWorker)
+{
+	// allocazioni ASN.1 di una richiesta, rilasciate tutte alla fine della richiesta
+	UUCArena arena;
+
+	while(true)
+	{
+		int nSocket;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_queueReady.wait(lock, [this] { return !m_queue.empty() || !m_bAccepting; });
+			if(m_queue.empty())
+				return;
+
+			nSocket = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		{
+			UUCArenaScope scope(arena);
+			serve(nWorker, nSocket);
+		}
+		arena.release();
+		close(nSocket);
+	}
+}
+
+void CVerifyDaemon::serve(int nWorker, int nSocket)
+{
+	std::string szRequest;
+	if(!readLine(nSocket, szRequest, VERIFYD_MAX_REQUEST))
+		return;
+	if(!szRequest.empty() && szRequest[szRequest.length() - 1] == '\r')
+		szRequest.erase(szRequest.length() - 1);
+
+	char szError[32];
+	if(szRequest == "PING")
+	{
+		sendLine(nSocket, "OK");
+	}
+	else if(szRequest == "STATS")
+	{
+		sendLine(nSocket, "OK " + stats());
+	}
+	else if(szRequest.compare(0, 7, "VERIFY ") == 0 && szRequest.length() > 10 &&
+		(szRequest[7] == '0' || szRequest[7] == '1') && szRequest[8] == ' ')
+	{
+		std::string szResult;
+		verify(nWorker, szRequest.c_str() + 9, szRequest[7] == '1', szResult);
+		m_nServed++;
+		sendLine(nSocket, "OK " + szResult);
+	}
+	else
+	{
+		LOG_ERR((0, "CVerifyDaemon::serve", "invalid request: %.64s", szRequest.c_str()));
+		snprintf(szError, sizeof(szError), "ERR 0x%lx", (unsigned long)DISIGON_ERROR_UNEXPECTED);
+		sendLine(nSocket, szError);
+	}
+}
+
+std::string CVerifyDaemon::stats()
+{
+	size_t nQueued;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		nQueued = m_queue.size();
+	}
+
+	char szCounters[160];
+	snprintf(szCounters, sizeof(szCounters),
+		"{\"threads\":%d,\"queue_size\":%d,\"queued\":%zu,\"served\":%ld,\"rejected\":%ld",
+		m_nThreads, m_nQueueSize, nQueued, (long)m_nServed, (long)m_nRejected);
+
+	return std::string(szCounters) +
+		",\"cert_store\":" + cacheStats(CCertStore::GetStats) +
+		",\"ocsp\":" + cacheStats(COCSPCache::GetStats) +
+		",\"crl\":" + cacheStats(CCrlCache::GetStats) + "}";
+}
+
+long CVerifyDaemon::verify(int nWorker, const char* szPath, bool bRevocation, std::string& szResult)
+{
+	DISIGON_CTX ctx = m_contexts[nWorker];
+	disigon_verify_set(ctx, DISIGON_OPT_INPUTFILE, (void*)szPath);
+	disigon_verify_set(ctx, DISIGON_OPT_VERIFY_REVOCATION, (void*)(long)(bRevocation ? 1 : 0));
+
+	VERIFY_RESULT result;
+	memset(&result, 0, sizeof(result));
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	long nRet = disigon_verify_verify(ctx, &result);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	bool bValid = nRet == 0;
+	int nCount = 0;
+
+	char szBuffer[96];
+	snprintf(szBuffer, sizeof(szBuffer), ",\"type\":%d,\"error\":\"0x%lx\",\"ms\":%.3f,\"signatures\":[",
+		result.nResultType, (unsigned long)nRet, ms);
+	szResult = "{\"path\":" + CVerifyReport::jsonString(szPath) + szBuffer;
+
+	SIGNER_INFOS* pSignerInfos = result.verifyInfo.pSignerInfos;
+	if(nRet == 0 && pSignerInfos)
+	{
+		nCount = pSignerInfos->nCount;
+		for(int i = 0; i < pSignerInfos->nCount; i++)
+		{
+			const SIGNER_INFO& signerInfo = pSignerInfos->pSignerInfo[i];
+			bValid = bValid && CVerifyReport::signerValid(signerInfo.bitmask);
+			szResult += std::string(i ? "," : "") + CVerifyReport::signerJson(signerInfo);
+		}
+	}
+
+	szResult += std::string("],\"valid\":") + (bValid && nCount > 0 ? "true" : "false") + "}";
+
+	disigon_verify_cleanup_result(&result);
+	return nRet;
+}
+
+//////////////////////////////////////////////////////////////////////
+// CVerifyClient
+//////////////////////////////////////////////////////////////////////
+
+CVerifyClient::CVerifyClient(const char* szSocketPath)
+: m_szSocketPath(szSocketPath ? szSocketPath : ""), m_nRetries(VERIFYD_DEFAULT_RETRIES), m_nDelayMs(10)
+{
+}
+
+CVerifyClient::~CVerifyClient()
+{
+}
+
+void CVerifyClient::setRetries(int nRetries, int nDelayMs)
+{
+	m_nRetries = nRetries > 0 ? nRetries : 0;
+	m_nDelayMs = nDelayMs > 0 ? nDelayMs : 1;
+}
+
+long CVerifyClient::verify(const char* szPath, bool bRevocation, std::string& szResult)
+{
+	// il demone ha la propria directory corrente
+	char szAbsolutePath[PATH_MAX];
+	if(!realpath(szPath, szAbsolutePath))
+		snprintf(szAbsolutePath, sizeof(szAbsolutePath), "%s", szPath);
+
+	return request(std::string("VERIFY ") + (bRevocation ? "1 " : "0 ") + szAbsolutePath, szResult);
+}
+
+long CVerifyClient::getStats(std::string& szResult)
+{
+	return request("STATS", szResult);
+}
+
+long CVerifyClient::ping()
+{
+	std::string szResult;
+	return request("PING", szResult);
+}
+
+long CVerifyClient::request(const std::string& szRequest, std::string& szResult)
+{
+	if(szRequest.find('\n') != std::string::npos)
+		return DISIGON_ERROR_INVALID_FILE;
+
+	int nDelayMs = m_nDelayMs;
+	for(int nAttempt = 0; ; nAttempt++)
+	{
+		std::string szResponse;
+		long nRet = transact(szRequest, szResponse);
+		if(nRet != 0)
+			return nRet;
+
+		if(szResponse == "BUSY")
+		{
+			if(nAttempt >= m_nRetries)
+				return DISIGON_ERROR_DAEMON_BUSY;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(nDelayMs));
+			nDelayMs *= 2;
+			continue;
+		}
+
+		if(szResponse == "OK" || szResponse.compare(0, 3, "OK ") == 0)
+		{
+			szResult = szResponse.length() > 3 ? szResponse.substr(3) : "";
+			return 0;
+		}
+
+		if(szResponse.compare(0, 4, "ERR ") == 0)
+			return (long)strtoul(szResponse.c_str() + 4, NULL, 16);
+
+		return DISIGON_ERROR_UNEXPECTED;
+	}
+}
+
+long CVerifyClient::transact(const std::string& szRequest, std::string& szResponse)
+{
+	int nSocket = connectTo(m_szSocketPath);
+	if(nSocket < 0)
+		return DISIGON_ERROR_DAEMON_SOCKET;
+
+	// se il demone ha gia' risposto BUSY e chiuso, l'invio fallisce ma la risposta e' leggibile
+	sendLine(nSocket, szRequest);
+	bool bRead = readLine(nSocket, szResponse, (size_t)-1);
+	close(nSocket);
+
+	return bRead ? 0 : DISIGON_ERROR_DAEMON_SOCKET;
+}
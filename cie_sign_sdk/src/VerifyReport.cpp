@@ -0,0 +1,69 @@
+/*
+ *  VerifyReport.cpp
+ *
+ *  SPDX-License-Identifier: BSD-3-Clause
+ */
+
+#include "VerifyReport.h"
+
+#include <stdio.h>
+
+std::string CVerifyReport::jsonString(const char* szValue)
+{
+	std::string szOut = "\"";
+	for(const unsigned char* p = (const unsigned char*)szValue; *p; p++)
+	{
+		switch(*p)
+		{
+		case '"':  szOut += "\\\""; break;
+		case '\\': szOut += "\\\\"; break;
+		case '\n': szOut += "\\n"; break;
+		case '\r': szOut += "\\r"; break;
+		case '\t': szOut += "\\t"; break;
+		default:
+			if(*p < 0x20)
+			{
+				char szEscaped[8];
+				snprintf(szEscaped, sizeof(szEscaped), "\\u%04x", *p);
+				szOut += szEscaped;
+			}
+			else
+			{
+				szOut += (char)*p;
+			}
+		}
+	}
+
+	return szOut + "\"";
+}
+
+const char* CVerifyReport::revocationStatus(long bitmask)
+{
+	// valore negativo: errore di verifica, nessun bit significativo
+	if(bitmask < 0)
+		return "unknown";
+	if(bitmask & VERIFIED_CERT_REVOKED)
+		return "revoked";
+	if(bitmask & VERIFIED_CERT_SUSPENDED)
+		return "suspended";
+	if(bitmask & VERIFIED_CERT_GOOD)
+		return "good";
+	return "unknown";
+}
+
+bool CVerifyReport::signerValid(long bitmask)
+{
+	const long required = VERIFIED_SIGNATURE | VERIFIED_CERT_VALIDITY | VERIFIED_CACERT_FOUND | VERIFIED_CERT_CHAIN;
+	return bitmask >= 0 && (bitmask & required) == required &&
+		(bitmask & (VERIFIED_CERT_REVOKED | VERIFIED_CERT_SUSPENDED)) == 0;
+}
+
+std::string CVerifyReport::signerJson(const SIGNER_INFO& signerInfo)
+{
+	char szBuffer[96];
+	snprintf(szBuffer, sizeof(szBuffer), ",\"bitmask\":\"0x%06lx\",\"valid\":%s,\"revocation\":\"%s\"}",
+		(unsigned long)signerInfo.bitmask, signerValid(signerInfo.bitmask) ? "true" : "false",
+		revocationStatus(signerInfo.bitmask));
+
+	return "{\"cn\":" + jsonString(signerInfo.szCN) + szBuffer;
+}
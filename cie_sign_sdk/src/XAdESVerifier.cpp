@@ -1,9 +1,11 @@
 
 #include "XAdESVerifier.h"
 #include "CertStore.h"
+#include "RevocationResolver.h"
 
 
 #include <string.h>
+#include <vector>
 #define MAX_FILENAME 250
 
 xmlXPathObjectPtr getRequestedNode(xmlChar* path, xmlXPathContextPtr xpathCtx);
@@ -98,45 +100,29 @@ int CXAdESVerifier::verifySignature(int index, const char* szDateTime, REVOCATIO
 		bitmask |= VERIFIED_SHA256;
 	}
 
+	// stato di revoca del firmatario e dei certificati di CA: le richieste
+	// partono tutte insieme dopo aver ricostruito la catena
+	CRevocationResolver resolver(szDateTime);
+	int nSignerItem = -1;
+	std::vector<int> caItems;
+
 	if(pRevocationInfo)
 	{
 		pRevocationInfo->nRevocationStatus = REVOCATION_STATUS_UNKNOWN;
 		// verify revocation status only if the certificate is valid
 		if(bitmask & VERIFIED_CERT_VALIDITY)
-		{
-			int verifyStatus = pSignatureInfo->pX509Cert->verifyStatus(szDateTime, pRevocationInfo);
-			
-			switch (verifyStatus) 
-			{
-				case REVOCATION_STATUS_GOOD:
-					bitmask |= VERIFIED_CERT_GOOD;
-					bitmask |= VERIFIED_CRL_LOADED;
-					break;
-					
-				case REVOCATION_STATUS_REVOKED:
-					bitmask |= VERIFIED_CRL_LOADED;
-					bitmask |= VERIFIED_CERT_REVOKED;
-					break;
-					
-				case REVOCATION_STATUS_SUSPENDED:
-					bitmask |= VERIFIED_CERT_SUSPENDED;
-					bitmask |= VERIFIED_CRL_LOADED;
-					break;
-					
-				case REVOCATION_STATUS_UNKNOWN:
-					break;
-			}
-		}
+			nSignerItem = resolver.add(*pSignatureInfo->pX509Cert, pRevocationInfo);
 	}
 	
 	// verifica la cert chain
 //	UUCByteArray issuer;
 //	pSignatureInfo->pX509Cert->getIssuer().getNameAsString(issuer);//getField(OID_COMMON_NAME);
 	
-    CCertificate* pCert = pSignatureInfo->pX509Cert;
-	CCertificate* pCACert = CCertStore::GetCertificate(*pSignatureInfo->pX509Cert);
-    while(pCACert && pCert->verifySignature(*pCACert))
+    vector<CCertificate*> chain;
+    bool bChainComplete = CCertStore::BuildChain(*pSignatureInfo->pX509Cert, chain);
+    for(size_t i = 0; i < chain.size(); i++)
     {
+        CCertificate* pCACert = chain[i];
         bitmask |= VERIFIED_CACERT_FOUND;
 
         //NSLog(@"issuer: %s, SN: %s", issuer.c_str(), serialNumber.toHexString());
@@ -145,37 +131,61 @@ int CXAdESVerifier::verifySignature(int index, const char* szDateTime, REVOCATIO
         {
             bitmask |= VERIFIED_CACERT_VALIDITY;
             if(pRevocationInfo)
-            {
-                int verifyStatus = pCACert->verifyStatus(szDateTime, NULL);
-        
-                switch (verifyStatus)
-                {
-                    case REVOCATION_STATUS_GOOD:
-                        bitmask |= VERIFIED_CACERT_GOOD;
-                        bitmask |= VERIFIED_CACRL_LOADED;
-                        break;
-                        
-                    case REVOCATION_STATUS_REVOKED:
-                        bitmask |= VERIFIED_CACRL_LOADED;
-                        bitmask |= VERIFIED_CACERT_REVOKED;
-                        break;
-                        
-                    case REVOCATION_STATUS_SUSPENDED:
-                        bitmask |= VERIFIED_CACERT_SUSPENDED;
-                        bitmask |= VERIFIED_CACRL_LOADED;
-                        break;
-                        
-                    case REVOCATION_STATUS_UNKNOWN:
-                        break;
-                }
-            }
+                caItems.push_back(resolver.add(*pCACert, NULL));
+        }
+    }
+
+    resolver.resolve();
+
+	if(nSignerItem != -1)
+	{
+		switch (resolver.getStatus(nSignerItem)) 
+		{
+			case REVOCATION_STATUS_GOOD:
+				bitmask |= VERIFIED_CERT_GOOD;
+				bitmask |= VERIFIED_CRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_REVOKED:
+				bitmask |= VERIFIED_CRL_LOADED;
+				bitmask |= VERIFIED_CERT_REVOKED;
+				break;
+				
+			case REVOCATION_STATUS_SUSPENDED:
+				bitmask |= VERIFIED_CERT_SUSPENDED;
+				bitmask |= VERIFIED_CRL_LOADED;
+				break;
+				
+			case REVOCATION_STATUS_UNKNOWN:
+				break;
+		}
+	}
+
+    for(size_t i = 0; i < caItems.size(); i++)
+    {
+        switch (resolver.getStatus(caItems[i]))
+        {
+            case REVOCATION_STATUS_GOOD:
+                bitmask |= VERIFIED_CACERT_GOOD;
+                bitmask |= VERIFIED_CACRL_LOADED;
+                break;
+                
+            case REVOCATION_STATUS_REVOKED:
+                bitmask |= VERIFIED_CACRL_LOADED;
+                bitmask |= VERIFIED_CACERT_REVOKED;
+                break;
+                
+            case REVOCATION_STATUS_SUSPENDED:
+                bitmask |= VERIFIED_CACERT_SUSPENDED;
+                bitmask |= VERIFIED_CACRL_LOADED;
+                break;
+                
+            case REVOCATION_STATUS_UNKNOWN:
+                break;
         }
-        
-        pCert = pCACert;
-        pCACert = CCertStore::GetCertificate(*pCACert);
     }
     
-    if(!pCACert)
+    if(bChainComplete)
     {
         bitmask |= VERIFIED_CERT_CHAIN;
     }
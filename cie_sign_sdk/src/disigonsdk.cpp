@@ -8,6 +8,12 @@
 #include "ASN1/TimeStampData.h"
 #include "ASN1/TimeStampResponse.h"
 #include "CertStore.h"
+#include "ASN1/CrlCache.h"
+#include "ASN1/OCSPCache.h"
+#include "ASN1/RevocationResolver.h"
+#include "ASN1/UUCArena.h"
+#include "HttpClient.h"
+#include "TrustedList.h"
 #include "PdfVerifier.h"
 #include "PdfSignatureGenerator.h"
 #include "XAdESGenerator.h"
@@ -149,7 +155,7 @@ long sign_pdf(DISIGON_SIGN_CONTEXT* pContext, UUCByteArray& data);
 long sign_xml(DISIGON_SIGN_CONTEXT* pContext, UUCByteArray& data);
 
 
-//long load_tsl(const char* szTSLUrl, const char* szCACertDir);
+long load_tsl(const char* szTSLUrl, const char* szCACertDir);
 
 long HTTPRequest(UUCByteArray& data, const char* szUrl, const char* szContentType, UUCByteArray& response);
 
@@ -169,6 +175,40 @@ long disigon_set(int option, void* value)
         g_bCACertDirSet = true;
         break;
 
+    case DISIGON_OPT_CRL_CACHE_DIR:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_CRL_CACHE_DIR: %s", (char*)value));
+        CCrlCache::SetCacheDir((char*)value);
+        break;
+
+    case DISIGON_OPT_OCSP_CACHE_DIR:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_OCSP_CACHE_DIR: %s", (char*)value));
+        COCSPCache::SetCacheDir((char*)value);
+        break;
+
+    case DISIGON_OPT_OCSP_MAX_AGE:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_OCSP_MAX_AGE: %ld", (long)value));
+        COCSPCache::SetMaxAge((long)value);
+        break;
+
+    case DISIGON_OPT_HTTP2:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_HTTP2: %ld", (long)value));
+        CHttpClient::SetHttp2((long)value != 0);
+        break;
+
+    case DISIGON_OPT_REVOCATION_TIMEOUT:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_REVOCATION_TIMEOUT: %ld", (long)value));
+        CRevocationResolver::SetTimeout((long)value);
+        break;
+
+    case DISIGON_OPT_CERT_CACHE_TTL:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_CERT_CACHE_TTL: %ld", (long)value));
+        CCertStore::SetCacheTTL((long)value);
+        break;
+
+    case DISIGON_OPT_TSL_URL:
+        LOG_DBG((0, "disigon_set", "set DISIGON_OPT_TSL_URL: %s", (char*)value));
+        return load_tsl((char*)value, g_szCACertDir);
+
     
     case DISIGON_OPT_LOG_FILE:
         SET_LOG_FILE((char*)value);
@@ -207,10 +247,28 @@ long disigon_set_string(int option, char* value)
     return disigon_set(option, (void*)value);
 }
 
+// certificati di CA e TSA qualificate della trusted list nel CCertStore,
+// tramite la snapshot TSL_SNAPSHOT_FILE nella directory dei certificati di CA
+long load_tsl(const char* szTSLUrl, const char* szCACertDir)
+{
+    if(!g_bCACertDirSet)
+        return DISIGON_ERROR_TSL_CACERTDIR_NOT_SET;
+
+    std::string szSnapshot = std::string(szCACertDir) + "/" + TSL_SNAPSHOT_FILE;
+
+    long nRet = CTrustedList::LoadCertStore(szTSLUrl, szSnapshot.c_str());
+    if(nRet)
+        LOG_ERR((0, "load_tsl", "%s: error %lX", szTSLUrl, nRet));
+
+    return nRet;
+}
 
 void disigon_cleanup()
 {
     CCertStore::CleanUp();
+    CCrlCache::CleanUp();
+    COCSPCache::CleanUp();
+    CHttpClient::CleanUp();
 }
 
 DISIGON_CTX disigon_sign_init(void)
@@ -768,6 +826,11 @@ long disigon_verify_verify(DISIGON_CTX ctx, VERIFY_RESULT* pVerifyResult)
 
     int nPos;
 
+    // alberi ASN.1 della verifica in un'arena rilasciata in un colpo solo, quella
+    // del chiamante se ne ha una attiva (CVerifyDaemon, una per worker)
+    UUCArena arena;
+    UUCArenaScope arenaScope(UUCArena::current() ? *UUCArena::current() : arena);
+
     long nRes = 0;
     switch(nFileType)
     {
@@ -2010,26 +2073,47 @@ long sign_pdf(DISIGON_SIGN_CONTEXT* pContext, UUCByteArray& data)
     
     LOG_DBG((0, "sign_pdf", "InitSignature OK"));
 
-    UUCByteArray buffer;
-    sigGen.GetBufferForSignature(buffer);
-
-    pContext->pSignatureGenerator->SetData(buffer);
-
     pContext->pSignatureGenerator->SetHashAlgo(pContext->nHashAlgo);
 
-    LOG_DBG((0, "sign_pdf", "Generate"));
+    // segnaposto /Contents dimensionato sulla CMS attesa invece dei 16 KB fissi
+    size_t nSignatureSize = 0;
+    if(pContext->pSignatureGenerator->GetSignatureSize(&nSignatureSize) == 0)
+        sigGen.SetSignatureSize(nSignatureSize);
 
     UUCByteArray signature;
-    long nRes = pContext->pSignatureGenerator->Generate(signature, true, pContext->bVerifyCert);
-    if(nRes)
+    for(int nAttempt = 0; ; nAttempt++)
     {
-        LOG_ERR((0, "sign_pdf", "Generate NOK: %x", nRes));
-        return nRes;
-    }
+        UUCByteArray buffer;
+        sigGen.GetBufferForSignature(buffer);
+
+        pContext->pSignatureGenerator->SetData(buffer);
+
+        LOG_DBG((0, "sign_pdf", "Generate"));
+
+        long nRes = pContext->pSignatureGenerator->Generate(signature, true, pContext->bVerifyCert);
+        if(nRes)
+        {
+            LOG_ERR((0, "sign_pdf", "Generate NOK: %x", nRes));
+            return nRes;
+        }
+
+        LOG_DBG((0, "sign_pdf", "Generate OK"));
+
+        if(sigGen.SetSignature((char*)signature.getContent(), signature.getLength()))
+            break;
+
+        // CMS piu' grande del previsto: nuovo segnaposto e nuova firma
+        if(nAttempt > 0)
+        {
+            LOG_ERR((0, "sign_pdf", "Signature too large: %d", signature.getLength()));
+            return DISIGON_ERROR_PDF_SIGNATURE_SIZE;
+        }
 
-    LOG_DBG((0, "sign_pdf", "Generate OK"));
+        LOG_MSG((0, "sign_pdf", "Signature %d bytes, placeholder %d", signature.getLength(), (int)nSignatureSize));
 
-    sigGen.SetSignature((char*)signature.getContent(), signature.getLength());
+        sigGen.SetSignatureSize(sigGen.GetRequiredSignatureSize());
+        pContext->pSignatureGenerator->Reset();
+    }
 
     LOG_DBG((0, "sign_pdf", "Set Signature OK"));
 
@@ -2082,28 +2166,13 @@ long verify_pdf(DISIGON_VERIFY_CONTEXT* pContext, UUCByteArray& data, VERIFY_INF
     pVerifyInfo->pSignerInfos->pSignerInfo = new SIGNER_INFO[signatureCount];
 
     
-    for(int i = 0; i < signatureCount; i++)
+    // le firme sono lette tutte prima di verificarle; la verifica e il SIGNER_INFO
+    // di ciascuna sono fatti su piu' thread, ognuno scrive solo il proprio elemento
+    vector<SignatureVerifyResult> results;
+    nRes = pdfVerifier.VerifySignatures(NULL, pContext->bVerifyCRL ? true : false, results,
+        [&](size_t i, SignatureVerifyResult& result)
     {
-        
-        UUCByteArray sig;
-        
-#ifndef HP_UX
-        SignatureAppearanceInfo sai;
-        nRes = pdfVerifier.GetSignature(i, sig, sai);
-#else
-        nRes = pdfVerifier.GetSignature(i, sig);//, sai);
-#endif
-
-        if(nRes)
-        {
-            //delete *(pVerifyInfo->pSignerInfos->pSignerInfo);
-            delete pVerifyInfo->pSignerInfos->pSignerInfo;
-            LOG_ERR((0, "<-- verify_pdf", "Context: %p, Error: %x", pContext, nRes));
-            return nRes;
-        }
-
-        
-        CSignedDocument sd(sig.getContent(), sig.getLength());
+        CSignedDocument sd(result.signature.getContent(), result.signature.getLength());
 
         CCertificate cert = sd.getSignerCertificate(0);
         CSignerInfo si = sd.getSignerInfo(0);
@@ -2115,10 +2184,12 @@ long verify_pdf(DISIGON_VERIFY_CONTEXT* pContext, UUCByteArray& data, VERIFY_INF
         pSI->nCounterSignatureCount = 0;
         pSI->pRevocationInfo = NULL;
         if(pContext->bVerifyCRL)
+        {
             pSI->pRevocationInfo = new REVOCATION_INFO;
+            *pSI->pRevocationInfo = result.revocationInfo;
+        }
         
-        char sigType[256];
-        pSI->bitmask = pdfVerifier.VerifySignature(i, NULL, sigType, pSI->pRevocationInfo);
+        pSI->bitmask = result.bitmask;
         
         //strcpy(pContext->szPdfSubfilter, sigType);
 
@@ -2251,6 +2322,14 @@ long verify_pdf(DISIGON_VERIFY_CONTEXT* pContext, UUCByteArray& data, VERIFY_INF
 
         //pVerifyInfo->pSignerInfos->pSignerInfo[i] = pSI;
 
+    });
+
+    if(nRes)
+    {
+        //delete *(pVerifyInfo->pSignerInfos->pSignerInfo);
+        delete pVerifyInfo->pSignerInfos->pSignerInfo;
+        LOG_ERR((0, "<-- verify_pdf", "Context: %p, Error: %x", pContext, nRes));
+        return nRes;
     }
 
     LOG_MSG((0, "<-- verify_pdf", "Context: %p", pContext));
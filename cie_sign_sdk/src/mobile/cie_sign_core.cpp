@@ -6,6 +6,7 @@
 #include "CIESigner.h"
 #include "SignatureGenerator.h"
 #include "PdfSignatureGenerator.h"
+#include "PdfPreflight.h"
 #include "XAdESGenerator.h"
 #include "ASN1/UUCByteArray.h"
 #include "Util/Array.h"
@@ -38,6 +39,14 @@
 namespace {
 
 constexpr HRESULT kTransmitOk = 0;
+
+// cie_sign_check_pdf estimates: PoDoFo parsing and hashing on a mid-range phone,
+// NFC session at the speeds seen with the CIE
+constexpr uint64_t kCheckBytesPerMs = 40 * 1024;
+constexpr uint64_t kCheckObjectsPerMs = 100;
+constexpr uint64_t kCheckRebuildFactor = 3;
+constexpr uint64_t kCheckCardSessionMs = 2500;   // secure messaging, PIN and certificate
+constexpr uint64_t kCheckCardSignatureMs = 1000; // one RSA signature on the chip
 constexpr std::array<uint8_t, 4> kMockAtrPrefix = {'M', 'O', 'C', 'K'};
 
 using namespace cie::mobile::mock_signer;
@@ -351,6 +360,25 @@ cie_status sign_pkcs7(cie_sign_ctx_impl *ctx,
     return copy_to_result(ctx, pkcs7, result);
 }
 
+// CIE_PDF_ISSUE_* of the document itself, shared by cie_sign_check_pdf and sign_pdf
+uint32_t document_issues(CPdfPreflight &preflight, const uint8_t *input, size_t input_len)
+{
+    if (preflight.check(reinterpret_cast<const BYTE *>(input), input_len) != 0) {
+        return CIE_PDF_ISSUE_NOT_PDF;
+    }
+    uint32_t issues = 0;
+    if (preflight.encrypted()) {
+        issues |= CIE_PDF_ISSUE_ENCRYPTED;
+    }
+    if (preflight.docMdp() == 1) {
+        issues |= CIE_PDF_ISSUE_NO_CHANGES;
+    }
+    if (preflight.needsRebuild()) {
+        issues |= CIE_PDF_ISSUE_XREF_REBUILD;
+    }
+    return issues;
+}
+
 cie_status sign_pdf(cie_sign_ctx_impl *ctx,
                     CSignatureGenerator &generator,
                     const cie_sign_request *request,
@@ -361,6 +389,19 @@ cie_status sign_pdf(cie_sign_ctx_impl *ctx,
         return CIE_STATUS_INVALID_INPUT;
     }
 
+    // a document cie_sign_check_pdf reports as blocked is not signed; a missing
+    // header is left to the PDF parser
+    CPdfPreflight preflight;
+    uint32_t issues = document_issues(preflight, request->input, request->input_len);
+    if (issues & CIE_PDF_ISSUE_ENCRYPTED) {
+        ctx->last_error = "Encrypted PDF";
+        return CIE_STATUS_INVALID_INPUT;
+    }
+    if (issues & CIE_PDF_ISSUE_NO_CHANGES) {
+        ctx->last_error = "PDF certified without changes allowed (DocMDP /P 1)";
+        return CIE_STATUS_INVALID_INPUT;
+    }
+
     PdfSignatureGenerator pdfGenerator;
     int signatureCount = pdfGenerator.Load(
         reinterpret_cast<const char *>(request->input),
@@ -380,6 +421,15 @@ cie_status sign_pdf(cie_sign_ctx_impl *ctx,
                                    signatureImageLen,
                                    request->pdf.signature_image_width,
                                    request->pdf.signature_image_height);
+    pdfGenerator.SetSignatureImageResolution(request->pdf.signature_image_dpi);
+    pdfGenerator.SetCompactUpdate(request->pdf.compact_update != 0);
+    if (request->pdf.signature_font_path && request->pdf.signature_font_path[0]) {
+        // the file name without extension becomes the PDF font name
+        std::string fontPath = request->pdf.signature_font_path;
+        std::string fontName = fontPath.substr(fontPath.find_last_of("/\\") + 1);
+        fontName = fontName.substr(0, fontName.find_last_of('.'));
+        pdfGenerator.AddFont(fontName.c_str(), fontPath.c_str());
+    }
 
     std::vector<std::string> requestedFields = collect_field_ids(&request->pdf);
 #ifdef ANDROID
@@ -396,19 +446,37 @@ cie_status sign_pdf(cie_sign_ctx_impl *ctx,
     UUCByteArray latestSignedPdf;
 
     auto finalizeSignature = [&](bool reloadAfter) -> cie_status {
-        UUCByteArray bufferToSign;
-        pdfGenerator.GetBufferForSignature(bufferToSign);
-        generator.SetData(bufferToSign);
         generator.SetHashAlgo(CKM_SHA256_RSA_PKCS);
 
-        UUCByteArray pkcs7;
-        long rc = generator.Generate(pkcs7, 1, 0);
-        if (rc != CKR_OK) {
-            return map_error(ctx, "PDF signature generation", rc);
+        // /Contents sized on the expected CMS; the certificate is read once per generator
+        size_t signatureSize = 0;
+        if (generator.GetSignatureSize(&signatureSize) == CKR_OK) {
+            pdfGenerator.SetSignatureSize(signatureSize);
         }
 
-        pdfGenerator.SetSignature(reinterpret_cast<const char *>(pkcs7.getContent()),
-                                  static_cast<int>(pkcs7.getLength()));
+        for (int attempt = 0;; ++attempt) {
+            UUCByteArray bufferToSign;
+            pdfGenerator.GetBufferForSignature(bufferToSign);
+            generator.Reset();
+            generator.SetData(bufferToSign);
+
+            UUCByteArray pkcs7;
+            long rc = generator.Generate(pkcs7, 1, 0);
+            if (rc != CKR_OK) {
+                return map_error(ctx, "PDF signature generation", rc);
+            }
+
+            if (pdfGenerator.SetSignature(reinterpret_cast<const char *>(pkcs7.getContent()),
+                                          static_cast<int>(pkcs7.getLength()))) {
+                break;
+            }
+            if (attempt > 0) {
+                ctx->last_error = "PDF signature larger than its placeholder";
+                return CIE_STATUS_INTERNAL_ERROR;
+            }
+            // the placeholder was too small: lay the field out again and sign anew
+            pdfGenerator.SetSignatureSize(pdfGenerator.GetRequiredSignatureSize());
+        }
 
         latestSignedPdf.removeAll();
         pdfGenerator.GetSignedPdf(latestSignedPdf);
@@ -790,6 +858,81 @@ cie_status cie_sign_verify_pin(cie_sign_ctx *public_ctx,
     }
 }
 
+cie_status cie_sign_check_pdf(const uint8_t *input,
+                              size_t input_len,
+                              const cie_pdf_options *options,
+                              cie_pdf_check_result *result)
+{
+    if (!input || input_len == 0 || !result) {
+        return CIE_STATUS_INVALID_INPUT;
+    }
+
+    char *names = result->signable_fields;
+    size_t namesCapacity = result->signable_fields_capacity;
+    std::memset(result, 0, sizeof(*result));
+    result->signable_fields = names;
+    result->signable_fields_capacity = namesCapacity;
+
+    try {
+        CPdfPreflight preflight;
+        result->issues = document_issues(preflight, input, input_len);
+        if (result->issues & CIE_PDF_ISSUE_NOT_PDF) {
+            return CIE_STATUS_OK;
+        }
+        result->revisions = static_cast<uint32_t>(preflight.revisions());
+        result->docmdp_permissions = static_cast<uint32_t>(preflight.docMdp());
+
+        std::string signable;
+        uint32_t unsignedFields = 0;
+        for (const PdfPreflightField &field : preflight.fields()) {
+            ++result->signature_fields;
+            if (field.bSigned) {
+                ++result->signed_fields;
+                continue;
+            }
+            ++unsignedFields;
+            signable.append(field.name);
+            signable.push_back('\0');
+        }
+
+        // the same fields sign_pdf would pick
+        std::vector<std::string> requestedFields = collect_field_ids(options);
+        if (!requestedFields.empty()) {
+            if (preflight.formRead()) {
+                for (const std::string &id : requestedFields) {
+                    const PdfPreflightField *field = preflight.find(id);
+                    if (!field) {
+                        result->issues |= CIE_PDF_ISSUE_FIELD_MISSING;
+                    } else if (field->bSigned) {
+                        result->issues |= CIE_PDF_ISSUE_FIELD_SIGNED;
+                    }
+                }
+            }
+            result->signatures_to_apply = static_cast<uint32_t>(requestedFields.size());
+        } else {
+            result->signatures_to_apply = unsignedFields ? unsignedFields : 1;
+        }
+
+        // the document is loaded and hashed again for every signature
+        uint64_t documentMs = input_len / kCheckBytesPerMs + preflight.objects() / kCheckObjectsPerMs;
+        if (preflight.needsRebuild()) {
+            documentMs *= kCheckRebuildFactor;
+        }
+        documentMs *= result->signatures_to_apply;
+        uint64_t cardMs = kCheckCardSessionMs + kCheckCardSignatureMs * result->signatures_to_apply;
+        result->estimated_document_ms = static_cast<uint32_t>(std::min<uint64_t>(documentMs, UINT32_MAX));
+        result->estimated_card_ms = static_cast<uint32_t>(std::min<uint64_t>(cardMs, UINT32_MAX));
+
+        result->signable_fields_len = signable.size();
+        if (names && namesCapacity >= signable.size()) {
+            std::memcpy(names, signable.data(), signable.size());
+        }
+        return CIE_STATUS_OK;
+    } catch (...) {
+        return CIE_STATUS_INTERNAL_ERROR;
+    }
+}
+
 const char *cie_sign_get_last_error(cie_sign_ctx *public_ctx)
 {
     auto *ctx = reinterpret_cast<cie_sign_ctx_impl *>(public_ctx);
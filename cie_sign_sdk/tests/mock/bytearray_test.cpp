@@ -0,0 +1,164 @@
+#include "ASN1/UUCByteArray.h"
+#include "test_support.h"
+
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// contenuto 0, 1, 2, ... di nLen byte
+UUCByteArray sequence(unsigned long nLen)
+{
+    UUCByteArray value;
+    for (unsigned long i = 0; i < nLen; i++)
+        value.append(static_cast<BYTE>(i));
+    return value;
+}
+
+bool isSequence(const UUCByteArray& value, unsigned long nLen, unsigned long first = 0)
+{
+    if (value.getLength() != nLen)
+        return false;
+    for (unsigned long i = 0; i < nLen; i++)
+        if (value.getContent()[i] != static_cast<BYTE>(first + i))
+            return false;
+    return true;
+}
+
+// byte di guardia a 0 dopo il contenuto
+bool terminated(const UUCByteArray& value)
+{
+    return value.getContent()[value.getLength()] == 0;
+}
+
+bool outOfBound(UUCByteArray& value, unsigned int index)
+{
+    try {
+        value.remove(index);
+    } catch (long error) {
+        return error == static_cast<long>(ERR_INDEX_OUT_OF_BOUND);
+    }
+    return false;
+}
+
+} // namespace
+
+int main()
+{
+    // buffer interno fino a UUC_INLINE_CAPACITY byte
+    UUCByteArray empty;
+    expect(empty.getLength() == 0 && empty.getCapacity() == UUC_INLINE_CAPACITY && terminated(empty), "empty array inline");
+
+    UUCByteArray small;
+    const BYTE* inlineBuffer = small.getContent();
+    for (unsigned long i = 0; i < UUC_INLINE_CAPACITY; i++)
+        small.append(static_cast<BYTE>(i));
+    expect(small.getContent() == inlineBuffer && small.getCapacity() == UUC_INLINE_CAPACITY, "full inline buffer not reallocated");
+    expect(isSequence(small, UUC_INLINE_CAPACITY) && terminated(small), "inline content");
+
+    // un byte in piu' lascia il buffer interno, con il contenuto
+    small.append(static_cast<BYTE>(UUC_INLINE_CAPACITY));
+    expect(small.getContent() != inlineBuffer && small.getCapacity() > UUC_INLINE_CAPACITY, "growth leaves the inline buffer");
+    expect(isSequence(small, UUC_INLINE_CAPACITY + 1) && terminated(small), "content kept by the growth");
+
+    UUCByteArray large = sequence(1000);
+    expect(isSequence(large, 1000) && terminated(large) && large.getCapacity() >= 1000, "geometric growth");
+
+    // reserve / shrink_to_fit
+    UUCByteArray reserved = sequence(10);
+    reserved.reserve(500);
+    expect(reserved.getCapacity() >= 500 && isSequence(reserved, 10) && terminated(reserved), "reserve keeps the content");
+    reserved.reserve(100);
+    expect(reserved.getCapacity() >= 500, "smaller reserve ignored");
+    const BYTE* reservedBuffer = reserved.getContent();
+    for (unsigned long i = 10; i < 500; i++)
+        reserved.append(static_cast<BYTE>(i));
+    expect(reserved.getContent() == reservedBuffer && isSequence(reserved, 500), "appends within the reserved capacity");
+
+    reserved.removeAll();
+    reserved.append(sequence(100));
+    reserved.shrink_to_fit();
+    expect(reserved.getCapacity() == 100 && isSequence(reserved, 100) && terminated(reserved), "shrink to the length");
+    reserved.removeAll();
+    reserved.append(sequence(5));
+    reserved.shrink_to_fit();
+    expect(reserved.getCapacity() == UUC_INLINE_CAPACITY && isSequence(reserved, 5) && terminated(reserved),
+           "shrink back to the inline buffer");
+    reserved.shrink_to_fit();
+    expect(reserved.getCapacity() == UUC_INLINE_CAPACITY && isSequence(reserved, 5), "shrink of an inline array");
+
+    UUCByteArray sized(static_cast<unsigned long>(200));
+    expect(sized.getLength() == 0 && sized.getCapacity() >= 200 && terminated(sized), "constructor with capacity");
+
+    // move: il buffer allocato passa di mano, quello interno viene copiato
+    UUCByteArray heap = sequence(100);
+    const BYTE* heapBuffer = heap.getContent();
+    UUCByteArray stolen(std::move(heap));
+    expect(stolen.getContent() == heapBuffer && isSequence(stolen, 100) && terminated(stolen), "move construct takes the buffer");
+    expect(heap.getLength() == 0 && heap.getCapacity() == UUC_INLINE_CAPACITY && terminated(heap), "moved-from array empty");
+    heap.append(sequence(50));
+    expect(isSequence(heap, 50), "moved-from array reusable");
+
+    UUCByteArray shortValue = sequence(8);
+    UUCByteArray copied(std::move(shortValue));
+    expect(isSequence(copied, 8) && copied.getCapacity() == UUC_INLINE_CAPACITY && terminated(copied), "move from inline storage");
+    expect(shortValue.getLength() == 0 && terminated(shortValue), "inline moved-from array empty");
+
+    UUCByteArray target = sequence(300);
+    UUCByteArray source = sequence(70);
+    const BYTE* sourceBuffer = source.getContent();
+    target = std::move(source);
+    expect(target.getContent() == sourceBuffer && isSequence(target, 70) && terminated(target), "move assign takes the buffer");
+    expect(source.getLength() == 0 && source.getCapacity() == UUC_INLINE_CAPACITY, "move assign empties the source");
+
+    UUCByteArray inlineSource = sequence(3);
+    target = std::move(inlineSource);
+    expect(isSequence(target, 3) && target.getCapacity() == UUC_INLINE_CAPACITY && terminated(target),
+           "move assign from inline storage releases the buffer");
+
+    UUCByteArray& alias = target;
+    target = std::move(alias);
+    expect(isSequence(target, 3) && terminated(target), "self move assign");
+    UUCByteArray& heapAlias = stolen;
+    stolen = std::move(heapAlias);
+    expect(stolen.getContent() == heapBuffer && isSequence(stolen, 100), "self move assign of an allocated buffer");
+
+    const UUCByteArray& copyAlias = stolen;
+    stolen = copyAlias;
+    expect(isSequence(stolen, 100), "self copy assign");
+
+    // append del proprio contenuto, con e senza riallocazione
+    UUCByteArray twice = sequence(10);
+    twice.append(twice);
+    const UUCByteArray ten = sequence(10);
+    expect(twice.getLength() == 20 && std::memcmp(twice.getContent(), ten.getContent(), 10) == 0 &&
+           std::memcmp(twice.getContent() + 10, ten.getContent(), 10) == 0 && terminated(twice), "self append within the capacity");
+
+    UUCByteArray grown = sequence(UUC_INLINE_CAPACITY);
+    grown.append(grown);
+    expect(grown.getLength() == 2 * UUC_INLINE_CAPACITY && terminated(grown) &&
+           std::memcmp(grown.getContent(), grown.getContent() + UUC_INLINE_CAPACITY, UUC_INLINE_CAPACITY) == 0,
+           "self append leaving the inline buffer");
+
+    UUCByteArray part = sequence(1000);
+    part.reserve(1000);
+    part.shrink_to_fit();
+    part.append(part.getContent() + 500, 500);
+    expect(part.getLength() == 1500 && part.getContent()[1000] == static_cast<BYTE>(500) &&
+           part.getContent()[1499] == static_cast<BYTE>(999) && terminated(part), "append of a slice across a reallocation");
+
+    // remove
+    UUCByteArray removed = sequence(10);
+    removed.remove(0);
+    expect(isSequence(removed, 9, 1) && terminated(removed), "remove the first byte");
+    removed.remove(8);
+    expect(isSequence(removed, 8, 1) && terminated(removed), "remove the last byte");
+    removed.remove(3);
+    expect(removed.getLength() == 7 && removed.getContent()[2] == 3 && removed.getContent()[3] == 5 && terminated(removed),
+           "remove a middle byte");
+    expect(outOfBound(removed, 7), "remove past the end");
+    expect(outOfBound(empty, 0), "remove from an empty array");
+    expect(removed.getLength() == 7, "failed remove leaves the content");
+
+    return testResult("bytearray_test");
+}
@@ -0,0 +1,174 @@
+#include "CertStore.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Certificate with its key; issuer == nullptr makes it self-signed.
+struct Cert {
+    EVP_PKEY* key = nullptr;
+    X509* x509 = nullptr;
+
+    Cert(const char* commonName, long serial, const Cert* issuer, bool keyIds, EVP_PKEY* signingKey = nullptr)
+    {
+        key = makeRsaKey();
+        x509 = X509_new();
+        X509_set_version(x509, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(x509), serial);
+        X509_gmtime_adj(X509_getm_notBefore(x509), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(x509), 86400);
+        X509_NAME* name = X509_get_subject_name(x509);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>(commonName), -1, -1, 0);
+        X509_set_issuer_name(x509, issuer ? X509_get_subject_name(issuer->x509) : name);
+        X509_set_pubkey(x509, key);
+        if (keyIds) {
+            addExtension(x509, x509, NID_subject_key_identifier, "hash");
+            addExtension(x509, issuer ? issuer->x509 : x509, NID_authority_key_identifier, "keyid:always");
+        }
+        X509_sign(x509, signingKey ? signingKey : issuer ? issuer->key : key, EVP_sha256());
+    }
+
+    ~Cert()
+    {
+        X509_free(x509);
+        EVP_PKEY_free(key);
+    }
+
+    CCertificate certificate() const
+    {
+        unsigned char* der = nullptr;
+        int len = i2d_X509(x509, &der);
+        CCertificate out(der, len);
+        OPENSSL_free(der);
+        return out;
+    }
+};
+
+bool isSubject(const CCertificate* cert, const Cert& expected)
+{
+    CCertificate copy(*cert);
+    CCertificate other = expected.certificate();
+    return copy.getSubject() == other.getSubject() && copy.getSerialNumber() == other.getSerialNumber();
+}
+
+bool chainIs(const std::vector<CCertificate*>& chain, const std::vector<const Cert*>& expected)
+{
+    if (chain.size() != expected.size())
+        return false;
+    for (size_t i = 0; i < chain.size(); i++)
+        if (!isSubject(chain[i], *expected[i]))
+            return false;
+    return true;
+}
+
+} // namespace
+
+int main()
+{
+    Cert root("Test Root CA", 1, nullptr, true);
+    Cert intermediate("Test Issuing CA", 2, &root, true);
+    // stesso DN dell'intermedia, chiave diversa: si distingue solo per SKI
+    Cert sameName("Test Issuing CA", 3, &root, true);
+    Cert legacy("Test Legacy CA", 4, nullptr, false);
+
+    Cert signer("Signer", 0x100, &intermediate, true);
+    Cert otherSigner("Other signer", 0x101, &sameName, true);
+    Cert legacySigner("Legacy signer", 0x102, &legacy, false);
+    Cert stranger("Stranger", 0x103, nullptr, false);
+    EVP_PKEY* forgeryKey = makeRsaKey();
+    Cert forged("Forged signer", 0x104, &intermediate, true, forgeryKey);
+
+    for (const Cert* ca : {&root, &intermediate, &sameName, &legacy}) {
+        CCertificate cert = ca->certificate();
+        CCertStore::AddCertificate(cert);
+    }
+    CCertificate duplicate = root.certificate();
+    CCertStore::AddCertificate(duplicate);
+
+    // catena per SKI/AKI, anche con due CA dallo stesso DN
+    std::vector<CCertificate*> chain;
+    CCertificate signerCert = signer.certificate();
+    expect(CCertStore::BuildChain(signerCert, chain), "signer chain complete");
+    expect(chainIs(chain, {&intermediate, &root}), "signer chain: issuing CA, root");
+
+    chain.clear();
+    CCertificate otherCert = otherSigner.certificate();
+    expect(CCertStore::BuildChain(otherCert, chain), "other signer chain complete");
+    expect(chainIs(chain, {&sameName, &root}), "issuer told apart by SKI");
+
+    // senza AKI: issuer per DN
+    chain.clear();
+    CCertificate legacyCert = legacySigner.certificate();
+    expect(CCertStore::BuildChain(legacyCert, chain), "legacy chain complete");
+    expect(chainIs(chain, {&legacy}), "issuer found by DN");
+
+    // firma non valida: catena interrotta
+    chain.clear();
+    CCertificate forgedCert = forged.certificate();
+    expect(!CCertStore::BuildChain(forgedCert, chain), "forged chain incomplete");
+    expect(chain.empty(), "forged certificate has no chain");
+    expect(!CCertStore::BuildChain(forgedCert, chain), "forged chain incomplete (cached)");
+
+    // issuer assente; radice autofirmata
+    chain.clear();
+    CCertificate strangerCert = stranger.certificate();
+    expect(CCertStore::BuildChain(strangerCert, chain) && chain.empty(), "unknown issuer: empty chain");
+    CCertificate rootCert = root.certificate();
+    expect(CCertStore::GetCertificate(rootCert) == nullptr, "root has no issuer");
+    expect(isSubject(CCertStore::GetCertificate(signerCert), intermediate), "issuer lookup");
+
+    // esiti in cache e senza cache
+    bool cached = true;
+    for (int i = 0; i < 50; i++) {
+        CCertificate fresh = signer.certificate();
+        chain.clear();
+        cached = CCertStore::BuildChain(fresh, chain) && chainIs(chain, {&intermediate, &root}) && cached;
+    }
+    expect(cached, "repeated chain builds");
+
+    CCertStore::SetCacheTTL(0);
+    chain.clear();
+    expect(CCertStore::BuildChain(signerCert, chain) && chainIs(chain, {&intermediate, &root}), "chain without cache");
+    expect(!CCertStore::VerifySignature(forgedCert, *CCertStore::GetCertificate(forgedCert)), "forgery rejected without cache");
+    CCertStore::SetCacheTTL(CERTSTORE_DEFAULT_TTL);
+
+    // verifiche concorrenti mentre si aggiungono certificati
+    std::atomic<int> ok(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 40; i++) {
+                CCertificate leaf = (t % 2 ? otherSigner : signer).certificate();
+                std::vector<CCertificate*> built;
+                if (CCertStore::BuildChain(leaf, built) &&
+                    chainIs(built, {t % 2 ? &sameName : &intermediate, &root}))
+                    ok++;
+            }
+        });
+    threads.emplace_back([&] {
+        for (int i = 0; i < 20; i++) {
+            CCertificate again = intermediate.certificate();
+            CCertStore::AddCertificate(again);
+        }
+    });
+    for (std::thread& thread : threads)
+        thread.join();
+    expect(ok == 320, "concurrent chain builds");
+
+    CCertStore::CleanUp();
+    expect(CCertStore::GetCertificate(signerCert) == nullptr, "store empty after CleanUp");
+    EVP_PKEY_free(forgeryKey);
+
+    return testResult("cert_store_test");
+}
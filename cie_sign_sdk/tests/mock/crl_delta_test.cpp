@@ -0,0 +1,187 @@
+#include "mock_http_server.h"
+#include "ASN1/CrlCache.h"
+#include "ASN1/ASN1Integer.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+struct Revoked {
+    long serial;
+    int reason;
+};
+
+// baseNumber != 0 makes a delta CRL (critical DeltaCRLIndicator)
+std::vector<uint8_t> makeCrl(const TestIssuer& issuer, long number, long baseNumber,
+                             const std::vector<Revoked>& revoked, const std::string& freshestUrl,
+                             long validity)
+{
+    X509_CRL* crl = X509_CRL_new();
+    X509_CRL_set_version(crl, 1);
+    X509_CRL_set_issuer_name(crl, issuer.name());
+
+    time_t now = std::time(nullptr);
+    ASN1_TIME* lastUpdate = ASN1_TIME_adj(nullptr, now, 0, -60);
+    ASN1_TIME* nextUpdate = ASN1_TIME_adj(nullptr, now, 0, validity);
+    X509_CRL_set1_lastUpdate(crl, lastUpdate);
+    X509_CRL_set1_nextUpdate(crl, nextUpdate);
+    ASN1_TIME_free(lastUpdate);
+    ASN1_TIME_free(nextUpdate);
+
+    for (const Revoked& entry : revoked) {
+        X509_REVOKED* item = X509_REVOKED_new();
+        ASN1_INTEGER* serial = ASN1_INTEGER_new();
+        ASN1_INTEGER_set(serial, entry.serial);
+        X509_REVOKED_set_serialNumber(item, serial);
+        ASN1_INTEGER_free(serial);
+
+        ASN1_TIME* date = ASN1_TIME_adj(nullptr, now, -1, 0);
+        X509_REVOKED_set_revocationDate(item, date);
+        ASN1_TIME_free(date);
+
+        ASN1_ENUMERATED* reason = ASN1_ENUMERATED_new();
+        ASN1_ENUMERATED_set(reason, entry.reason);
+        X509_REVOKED_add1_ext_i2d(item, NID_crl_reason, reason, 0, 0);
+        ASN1_ENUMERATED_free(reason);
+
+        X509_CRL_add0_revoked(crl, item);
+    }
+
+    ASN1_INTEGER* crlNumber = ASN1_INTEGER_new();
+    ASN1_INTEGER_set(crlNumber, number);
+    X509_CRL_add1_ext_i2d(crl, NID_crl_number, crlNumber, 0, 0);
+    ASN1_INTEGER_free(crlNumber);
+
+    if (baseNumber) {
+        ASN1_INTEGER* base = ASN1_INTEGER_new();
+        ASN1_INTEGER_set(base, baseNumber);
+        X509_CRL_add1_ext_i2d(crl, NID_delta_crl, base, 1, 0);
+        ASN1_INTEGER_free(base);
+    }
+
+    if (!freshestUrl.empty()) {
+        X509V3_CTX ctx;
+        X509V3_set_ctx_nodb(&ctx);
+        X509V3_set_ctx(&ctx, nullptr, nullptr, nullptr, crl, 0);
+        std::string value = "URI:" + freshestUrl;
+        X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &ctx, NID_freshest_crl, value.c_str());
+        X509_CRL_add_ext(crl, ext, -1);
+        X509_EXTENSION_free(ext);
+    }
+
+    X509_CRL_sort(crl);
+    X509_CRL_sign(crl, issuer.key, EVP_sha256());
+
+    unsigned char* der = nullptr;
+    int len = i2d_X509_CRL(crl, &der);
+    std::vector<uint8_t> out(der, der + (len > 0 ? len : 0));
+    OPENSSL_free(der);
+    X509_CRL_free(crl);
+    return out;
+}
+
+int check(const std::string& url, const char* deltaUrl, long serial)
+{
+    BYTE value[4] = {static_cast<BYTE>(serial >> 24), static_cast<BYTE>(serial >> 16),
+                     static_cast<BYTE>(serial >> 8), static_cast<BYTE>(serial)};
+    int skip = 0;
+    while (skip < 3 && value[skip] == 0 && !(value[skip + 1] & 0x80))
+        skip++;
+    CASN1Integer serialNumber(value + skip, 4 - skip);
+    return CCrlCache::CheckRevocation(url.c_str(), deltaUrl, serialNumber, nullptr, nullptr);
+}
+
+const int kKeyCompromise = 1;
+const int kCertificateHold = 6;
+const int kRemoveFromCrl = 8;
+
+} // namespace
+
+int main()
+{
+    MockHttpServer server;
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the HTTP stand-in\n");
+        return 1;
+    }
+
+    TestIssuer issuer("Test CRL issuer");
+    const std::string baseUrl = server.url("/base.crl");
+    const std::string deltaUrl = server.url("/delta.crl");
+
+    // CRL completa n. 10: 0x1001 revocato, 0x1002 sospeso; la delta n. 11 revoca 0x1003
+    // e toglie la sospensione di 0x1002
+    server.setResource("/base.crl", makeCrl(issuer, 10, 0,
+                                            {{0x1001, kKeyCompromise}, {0x1002, kCertificateHold}},
+                                            deltaUrl, 86400));
+    server.setResource("/delta.crl", makeCrl(issuer, 11, 10,
+                                             {{0x1003, kKeyCompromise}, {0x1002, kRemoveFromCrl}},
+                                             "", 3600));
+
+    // delta trovata tramite FreshestCRL della CRL completa
+    expect(check(baseUrl, nullptr, 0x1001) == REVOCATION_STATUS_REVOKED, "base entry revoked");
+    expect(check(baseUrl, nullptr, 0x1002) == REVOCATION_STATUS_GOOD, "hold removed by the delta");
+    expect(check(baseUrl, nullptr, 0x1003) == REVOCATION_STATUS_REVOKED, "delta entry revoked");
+    expect(check(baseUrl, nullptr, 0x1004) == REVOCATION_STATUS_GOOD, "unknown serial good");
+    expect(server.requestCount("/base.crl") == 1, "base CRL downloaded once");
+    expect(server.requestCount("/delta.crl") == 1, "delta CRL downloaded once");
+
+    // delta che richiede una CRL completa piu' recente: ignorata
+    server.setResource("/delta-newer-base.crl", makeCrl(issuer, 13, 12, {{0x1003, kKeyCompromise}}, "", 3600));
+    const std::string newerBaseDelta = server.url("/delta-newer-base.crl");
+    expect(check(baseUrl, newerBaseDelta.c_str(), 0x1003) == REVOCATION_STATUS_GOOD, "delta for a newer base ignored");
+    expect(check(baseUrl, newerBaseDelta.c_str(), 0x1002) == REVOCATION_STATUS_SUSPENDED, "base used alone");
+
+    // delta di un altro emittente: ignorata
+    TestIssuer other("Another CRL issuer");
+    server.setResource("/delta-other.crl", makeCrl(other, 11, 10, {{0x1001, kRemoveFromCrl}}, "", 3600));
+    const std::string otherDelta = server.url("/delta-other.crl");
+    expect(check(baseUrl, otherDelta.c_str(), 0x1001) == REVOCATION_STATUS_REVOKED, "delta of another issuer ignored");
+
+    // CRL completa ancora valida, delta scaduta e ripubblicata: si riscarica solo la delta
+    server.setResource("/short-base.crl", makeCrl(issuer, 20, 0, {{0x2001, kKeyCompromise}}, "", 86400));
+    server.setResource("/short-delta.crl", makeCrl(issuer, 21, 20, {}, "", 1));
+    const std::string shortBase = server.url("/short-base.crl");
+    const std::string shortDelta = server.url("/short-delta.crl");
+    expect(check(shortBase, shortDelta.c_str(), 0x2002) == REVOCATION_STATUS_GOOD, "short delta, not revoked");
+    sleep(2);
+    server.setResource("/short-delta.crl", makeCrl(issuer, 22, 20, {{0x2002, kKeyCompromise}}, "", 3600));
+    expect(check(shortBase, shortDelta.c_str(), 0x2002) == REVOCATION_STATUS_REVOKED, "new delta picked up");
+    expect(server.requestCount("/short-base.crl") == 1, "current base not fetched again");
+    expect(server.requestCount("/short-delta.crl") == 2, "expired delta fetched again");
+
+    // livello su disco: un nuovo processo non riscarica CRL ancora valide
+    char dir[] = "/tmp/crl_delta_test_XXXXXX";
+    if (mkdtemp(dir)) {
+        CCrlCache::CleanUp();
+        CCrlCache::SetCacheDir(dir);
+        server.resetCounts();
+        expect(check(baseUrl, nullptr, 0x1003) == REVOCATION_STATUS_REVOKED, "delta applied (disk run)");
+
+        CCrlCache::CleanUp();
+        expect(check(baseUrl, nullptr, 0x1003) == REVOCATION_STATUS_REVOKED, "delta applied from disk");
+        expect(check(baseUrl, nullptr, 0x1002) == REVOCATION_STATUS_GOOD, "removeFromCRL applied from disk");
+        expect(server.requestCount("/base.crl") == 1, "base CRL served from disk");
+        expect(server.requestCount("/delta.crl") == 1, "delta CRL served from disk");
+
+        std::string cleanup = std::string("rm -rf ") + dir;
+        std::system(cleanup.c_str());
+        CCrlCache::SetCacheDir(nullptr);
+    }
+
+    CCrlCache::CleanUp();
+    server.stop();
+
+    return testResult("crl_delta_test");
+}
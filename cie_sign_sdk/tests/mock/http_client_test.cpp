@@ -0,0 +1,127 @@
+#include "mock_http_server.h"
+#include "HttpClient.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> bytes(const std::string& text)
+{
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+bool equals(const UUCByteArray& data, const std::vector<uint8_t>& expected)
+{
+    return data.getLength() == expected.size() &&
+           std::equal(expected.begin(), expected.end(), data.getContent());
+}
+
+long post(const std::string& url, const std::vector<uint8_t>& body, CHttpClient::Response& response)
+{
+    UUCByteArray data(body.data(), body.size());
+    CHttpClient::Request request(url.c_str());
+    request.pData = &data;
+    request.szContentType = "application/octet-stream";
+    return CHttpClient::Perform(request, response);
+}
+
+} // namespace
+
+int main()
+{
+    MockHttpServer server;
+    server.setResource("/resource", bytes("first version"));
+    server.setHandler("/echo", [](const std::vector<uint8_t>& body, int*) {
+        return std::vector<uint8_t>(body.rbegin(), body.rend());
+    });
+    server.setHandler("/slow", [](const std::vector<uint8_t>&, int*) {
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        return bytes("late");
+    });
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the HTTP stand-in\n");
+        return 1;
+    }
+
+    // GET con validatori: ETag restituito, 304 se invariato
+    const std::string resource = server.url("/resource");
+    CHttpClient::Response first;
+    expect(CHttpClient::Perform(CHttpClient::Request(resource.c_str()), first) == 0, "GET performed");
+    expect(first.nHttpCode == 200 && equals(first.body, bytes("first version")), "GET body");
+    expect(!first.szETag.empty(), "ETag returned");
+
+    CHttpClient::Request conditional(resource.c_str());
+    conditional.szETag = first.szETag.c_str();
+    CHttpClient::Response notModified;
+    expect(CHttpClient::Perform(conditional, notModified) == 0 && notModified.nHttpCode == 304, "304 on a matching ETag");
+
+    server.setResource("/resource", bytes("second version"));
+    CHttpClient::Response modified;
+    expect(CHttpClient::Perform(conditional, modified) == 0 && modified.nHttpCode == 200 &&
+           equals(modified.body, bytes("second version")) && modified.szETag != first.szETag, "200 after an update");
+
+    // codici HTTP di errore: la richiesta riesce, il codice e' nella risposta
+    const std::string missing = server.url("/missing");
+    CHttpClient::Response notFound;
+    expect(CHttpClient::Perform(CHttpClient::Request(missing.c_str()), notFound) == 0 && notFound.nHttpCode == 404, "404 reported");
+
+    // richieste in sequenza sulla stessa connessione (CleanUp chiude quelle aperte)
+    CHttpClient::CleanUp();
+    server.resetCounts();
+    const std::string echo = server.url("/echo");
+    bool echoed = true;
+    for (int i = 0; i < 20; i++) {
+        std::vector<uint8_t> body = bytes("request " + std::to_string(i) + std::string(2000, 'x'));
+        CHttpClient::Response response;
+        echoed = post(echo, body, response) == 0 && response.nHttpCode == 200 &&
+                 equals(response.body, std::vector<uint8_t>(body.rbegin(), body.rend())) && echoed;
+    }
+    expect(echoed, "POST bodies echoed");
+    expect(server.connectionCount() == 1, "sequential requests reuse one connection");
+
+    // richieste concorrenti: risposte corrette, connessioni riusate tra i thread
+    server.resetCounts();
+    std::atomic<int> ok(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 25; i++) {
+                std::vector<uint8_t> body = bytes("thread " + std::to_string(t) + " request " + std::to_string(i));
+                CHttpClient::Response response;
+                if (post(echo, body, response) == 0 &&
+                    equals(response.body, std::vector<uint8_t>(body.rbegin(), body.rend())))
+                    ok++;
+            }
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    expect(ok == 200, "concurrent requests answered");
+    expect(server.connectionCount() <= 8, "at most one connection per thread");
+
+    // timeout
+    const std::string slow = server.url("/slow");
+    CHttpClient::Request slowRequest(slow.c_str());
+    UUCByteArray empty;
+    slowRequest.pData = &empty;
+    slowRequest.nTimeout = 1;
+    CHttpClient::Response late;
+    auto start = std::chrono::steady_clock::now();
+    expect(CHttpClient::Perform(slowRequest, late) != 0, "timeout reported");
+    expect(std::chrono::steady_clock::now() - start < std::chrono::seconds(3), "timeout honoured");
+
+    // server non raggiungibile
+    server.stop();
+    CHttpClient::Response refused;
+    expect(CHttpClient::Perform(CHttpClient::Request(resource.c_str()), refused) != 0, "connection error reported");
+
+    CHttpClient::CleanUp();
+
+    return testResult("http_client_test");
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+// TSA shared by timestamp_upgrader_test and the cades_t_upgrade tool.
+
+#include "TSAClient.h"
+#include "ASN1/TimeStampRequest.h"
+#include "ASN1/TimeStampResponse.h"
+#include "definitions.h"
+
+#include <openssl/evp.h>
+#include <openssl/objects.h>
+#include <openssl/ts.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+// Stand-in TSA: answers RFC 3161 requests in process with a throw-away
+// self-signed timeStamping certificate. An optional delay simulates the
+// round trip to a remote TSA so the effect of pipelining can be measured.
+class LocalTSAClient : public CTSAClient
+{
+public:
+    explicit LocalTSAClient(int latencyMs)
+        : m_latencyMs(latencyMs), m_key(nullptr), m_cert(nullptr)
+    {
+        EVP_PKEY_CTX *keyCtx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+        EVP_PKEY_keygen_init(keyCtx);
+        EVP_PKEY_CTX_set_rsa_keygen_bits(keyCtx, 2048);
+        EVP_PKEY_keygen(keyCtx, &m_key);
+        EVP_PKEY_CTX_free(keyCtx);
+
+        m_cert = X509_new();
+        X509_set_version(m_cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(m_cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(m_cert), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(m_cert), 3600L * 24 * 365);
+        X509_set_pubkey(m_cert, m_key);
+
+        X509_NAME *name = X509_get_subject_name(m_cert);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char *>("Local stand-in TSA"), -1, -1, 0);
+        X509_set_issuer_name(m_cert, name);
+
+        X509V3_CTX extCtx;
+        X509V3_set_ctx_nodb(&extCtx);
+        X509V3_set_ctx(&extCtx, m_cert, m_cert, nullptr, nullptr, 0);
+        X509_EXTENSION *eku = X509V3_EXT_conf_nid(nullptr, &extCtx, NID_ext_key_usage,
+                                                  const_cast<char *>("critical,timeStamping"));
+        X509_add_ext(m_cert, eku, -1);
+        X509_EXTENSION_free(eku);
+
+        X509_sign(m_cert, m_key, EVP_sha256());
+    }
+
+    LocalTSAClient(const LocalTSAClient&) = delete;
+    LocalTSAClient& operator=(const LocalTSAClient&) = delete;
+
+    ~LocalTSAClient() override
+    {
+        X509_free(m_cert);
+        EVP_PKEY_free(m_key);
+    }
+
+    long GetTimeStampToken(UUCByteArray &digest, const char *szPolicyID,
+                           CTimeStampToken **ppTimeStampToken) override
+    {
+        *ppTimeStampToken = nullptr;
+        if (m_latencyMs > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(m_latencyMs));
+
+        CASN1Integer nonce(1);
+        CTimeStampRequest request(szSHA256OID, digest, szPolicyID, nonce);
+        UUCByteArray encoded;
+        request.toByteArray(encoded);
+
+        TS_RESP_CTX *ctx = TS_RESP_CTX_new();
+        TS_RESP_CTX_set_signer_cert(ctx, m_cert);
+        TS_RESP_CTX_set_signer_key(ctx, m_key);
+        TS_RESP_CTX_add_md(ctx, EVP_sha256());
+        TS_RESP_CTX_set_serial_cb(ctx, &LocalTSAClient::nextSerial, this);
+
+        ASN1_OBJECT *policy = OBJ_txt2obj(szPolicyID ? szPolicyID : "1.3.6.1.4.1.4146.2.3", 1);
+        TS_RESP_CTX_set_def_policy(ctx, policy);
+        ASN1_OBJECT_free(policy);
+
+        BIO *requestBio = BIO_new_mem_buf(encoded.getContent(), static_cast<int>(encoded.getLength()));
+        TS_RESP *response = TS_RESP_create_response(ctx, requestBio);
+        BIO_free(requestBio);
+        TS_RESP_CTX_free(ctx);
+        if (!response)
+            return -1;
+
+        unsigned char *der = nullptr;
+        int derLen = i2d_TS_RESP(response, &der);
+        TS_RESP_free(response);
+        if (derLen <= 0)
+            return -1;
+
+        long ret = -1;
+        try {
+            CTimeStampResponse tsResponse(der, derLen);
+            if (tsResponse.getPKIStatusInfo().getStatus().getIntValue() == 0) {
+                *ppTimeStampToken = new CTimeStampToken(tsResponse.getTimeStampToken());
+                ret = 0;
+            }
+        } catch (...) {
+        }
+        OPENSSL_free(der);
+        return ret;
+    }
+
+    X509 *certificate() const { return m_cert; }
+
+private:
+    static ASN1_INTEGER *nextSerial(TS_RESP_CTX *, void *data)
+    {
+        LocalTSAClient *self = static_cast<LocalTSAClient *>(data);
+        ASN1_INTEGER *serial = ASN1_INTEGER_new();
+        ASN1_INTEGER_set(serial, static_cast<long>(++self->m_serial));
+        return serial;
+    }
+
+    int m_latencyMs;
+    EVP_PKEY *m_key;
+    X509 *m_cert;
+    std::atomic<long> m_serial{0};
+};
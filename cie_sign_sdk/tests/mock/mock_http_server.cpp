@@ -0,0 +1,286 @@
+#include "mock_http_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+bool sendAll(int fd, const void* data, size_t len)
+{
+    const char* p = static_cast<const char*>(data);
+    while (len > 0) {
+        ssize_t sent = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (sent <= 0)
+            return false;
+        p += sent;
+        len -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+std::string lower(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+} // namespace
+
+MockHttpServer::MockHttpServer()
+    : listenFd_(-1), port_(0), running_(false), connections_(0), version_(0) {}
+
+MockHttpServer::~MockHttpServer()
+{
+    stop();
+}
+
+bool MockHttpServer::start()
+{
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0)
+        return false;
+
+    int one = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(addr);
+    if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd_, 64) != 0 ||
+        ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+
+    port_ = ntohs(addr.sin_port);
+    running_ = true;
+    acceptThread_ = std::thread(&MockHttpServer::acceptLoop, this);
+    return true;
+}
+
+void MockHttpServer::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+        for (int fd : clients_)
+            ::shutdown(fd, SHUT_RDWR);
+    }
+
+    ::shutdown(listenFd_, SHUT_RDWR);
+    ::close(listenFd_);
+    acceptThread_.join();
+    for (std::thread& worker : workers_)
+        worker.join();
+    workers_.clear();
+}
+
+std::string MockHttpServer::url(const std::string& path) const
+{
+    return "http://127.0.0.1:" + std::to_string(port_) + path;
+}
+
+void MockHttpServer::setResource(const std::string& path, const std::vector<uint8_t>& body)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Resource& resource = resources_[path];
+    resource.body = body;
+    resource.etag = "\"v" + std::to_string(++version_) + "\"";
+}
+
+void MockHttpServer::setHandler(const std::string& path, Handler handler)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    resources_[path].handler = std::move(handler);
+}
+
+int MockHttpServer::requestCount(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = resources_.find(path);
+    return it == resources_.end() ? 0 : it->second.requests;
+}
+
+int MockHttpServer::notModifiedCount(const std::string& path) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = resources_.find(path);
+    return it == resources_.end() ? 0 : it->second.notModified;
+}
+
+int MockHttpServer::connectionCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return connections_;
+}
+
+void MockHttpServer::resetCounts()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    connections_ = 0;
+    for (auto& entry : resources_) {
+        entry.second.requests = 0;
+        entry.second.notModified = 0;
+    }
+}
+
+void MockHttpServer::acceptLoop()
+{
+    for (;;) {
+        int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_) {
+            ::close(fd);
+            return;
+        }
+        connections_++;
+        clients_.push_back(fd);
+        workers_.emplace_back(&MockHttpServer::serve, this, fd);
+    }
+}
+
+void MockHttpServer::serve(int fd)
+{
+    std::string buffer;
+    while (serveOne(fd, buffer)) {
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    clients_.erase(std::remove(clients_.begin(), clients_.end(), fd), clients_.end());
+    ::close(fd);
+}
+
+// Reads and answers one request; false when the connection is over.
+bool MockHttpServer::serveOne(int fd, std::string& buffer)
+{
+    char chunk[8192];
+    size_t headerEnd;
+    while ((headerEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+            return false;
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+
+    std::string head = buffer.substr(0, headerEnd);
+    buffer.erase(0, headerEnd + 4);
+
+    size_t lineEnd = head.find("\r\n");
+    std::string requestLine = head.substr(0, lineEnd);
+    size_t sp1 = requestLine.find(' ');
+    size_t sp2 = requestLine.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos)
+        return false;
+
+    std::string method = requestLine.substr(0, sp1);
+    std::string path = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+
+    std::map<std::string, std::string> headers;
+    size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos)
+            end = head.size();
+        std::string line = head.substr(pos, end - pos);
+        size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            size_t value = line.find_first_not_of(' ', colon + 1);
+            headers[lower(line.substr(0, colon))] = value == std::string::npos ? "" : line.substr(value);
+        }
+        pos = end + 2;
+    }
+
+    size_t contentLength = 0;
+    auto it = headers.find("content-length");
+    if (it != headers.end())
+        contentLength = static_cast<size_t>(std::strtoul(it->second.c_str(), nullptr, 10));
+
+    it = headers.find("expect");
+    if (it != headers.end() && lower(it->second) == "100-continue" && buffer.size() < contentLength) {
+        static const char kContinue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        if (!sendAll(fd, kContinue, sizeof(kContinue) - 1))
+            return false;
+    }
+
+    while (buffer.size() < contentLength) {
+        ssize_t received = ::recv(fd, chunk, sizeof(chunk), 0);
+        if (received <= 0)
+            return false;
+        buffer.append(chunk, static_cast<size_t>(received));
+    }
+
+    std::vector<uint8_t> body(buffer.begin(), buffer.begin() + contentLength);
+    buffer.erase(0, contentLength);
+
+    if (!respond(fd, method, path, headers, body))
+        return false;
+
+    it = headers.find("connection");
+    return it == headers.end() || lower(it->second) != "close";
+}
+
+bool MockHttpServer::respond(int fd, const std::string& method, const std::string& path,
+                             const std::map<std::string, std::string>& headers,
+                             const std::vector<uint8_t>& body)
+{
+    int status = 404;
+    std::string etag;
+    std::vector<uint8_t> payload;
+    Handler handler;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = resources_.find(path);
+        if (it != resources_.end()) {
+            Resource& resource = it->second;
+            resource.requests++;
+            if (method == "POST" && resource.handler) {
+                handler = resource.handler;
+            } else if (method == "GET" && !resource.etag.empty()) {
+                etag = resource.etag;
+                auto match = headers.find("if-none-match");
+                if (match != headers.end() && match->second == etag) {
+                    resource.notModified++;
+                    status = 304;
+                } else {
+                    status = 200;
+                    payload = resource.body;
+                }
+            }
+        }
+    }
+
+    if (handler) {
+        status = 200;
+        payload = handler(body, &status);
+    }
+
+    const char* reason = status == 200 ? "OK" : status == 304 ? "Not Modified" : "Error";
+    std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\n";
+    if (!etag.empty())
+        head += "ETag: " + etag + "\r\n";
+    head += "Content-Length: " + std::to_string(status == 304 ? 0 : payload.size()) + "\r\n\r\n";
+
+    // una sola scrittura: header e corpo separati pagano Nagle + delayed ACK sul keep-alive
+    if (status != 304)
+        head.append(payload.begin(), payload.end());
+    return sendAll(fd, head.data(), head.size());
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server on 127.0.0.1 standing in for CRL distribution
+// points, OCSP responders and TSAs in tests. Connections are kept alive.
+class MockHttpServer {
+public:
+    // POST handler: returns the response body and sets the status code
+    using Handler = std::function<std::vector<uint8_t>(const std::vector<uint8_t>& body, int* status)>;
+
+    MockHttpServer();
+    ~MockHttpServer();
+
+    bool start();
+    void stop();
+
+    std::string url(const std::string& path) const;
+
+    // GET resource with an ETag that changes on every update;
+    // If-None-Match with the current ETag gets 304
+    void setResource(const std::string& path, const std::vector<uint8_t>& body);
+    void setHandler(const std::string& path, Handler handler);
+
+    int requestCount(const std::string& path) const;
+    int notModifiedCount(const std::string& path) const;
+    int connectionCount() const;
+    void resetCounts();
+
+private:
+    struct Resource {
+        std::vector<uint8_t> body;
+        std::string etag;
+        Handler handler;
+        int requests = 0;
+        int notModified = 0;
+    };
+
+    void acceptLoop();
+    void serve(int fd);
+    bool serveOne(int fd, std::string& buffer);
+    bool respond(int fd, const std::string& method, const std::string& path,
+                 const std::map<std::string, std::string>& headers,
+                 const std::vector<uint8_t>& body);
+
+    int listenFd_;
+    int port_;
+    bool running_;
+    int connections_;
+    int version_;
+    mutable std::mutex mutex_;
+    std::map<std::string, Resource> resources_;
+    std::thread acceptThread_;
+    std::vector<std::thread> workers_;
+    std::vector<int> clients_;
+};
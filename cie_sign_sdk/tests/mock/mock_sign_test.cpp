@@ -1,5 +1,6 @@
 #include "mobile/cie_sign.h"
 #include "mock_transport.h"
+#include "PdfRevisionMap.h"
 #include "PdfSignatureGenerator.h"
 #include "PdfVerifier.h"
 #include <algorithm>
@@ -10,6 +11,7 @@
 #include <cstdlib>
 #include <fstream>
 #include <iterator>
+#include <map>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -182,7 +184,8 @@ void assert_signature_field_present_on_disk(const char* path, size_t expectedCou
     assert(signatureCount == expectedCount);
 }
 
-void verify_signed_pdf(const std::vector<uint8_t>& pdf)
+// ritorna il numero di firme verificate
+int verify_signed_pdf(const std::vector<uint8_t>& pdf)
 {
     PDFVerifier verifier;
     int loadResult = verifier.Load(reinterpret_cast<const char*>(pdf.data()),
@@ -214,6 +217,135 @@ void verify_signed_pdf(const std::vector<uint8_t>& pdf)
         ++signatureIndex;
     }
     assert(verifiedAny);
+
+    // verifica in parallelo: stesse firme, nell'ordine dei campi
+    std::vector<SignatureVerifyResult> results;
+    std::vector<int> verifiedOn(signatureIndex, 0);
+    int rc = verifier.VerifySignatures(nullptr, false, results,
+        [&](size_t i, SignatureVerifyResult&) { verifiedOn[i]++; });
+    assert(rc == 0);
+    assert(static_cast<int>(results.size()) == signatureIndex);
+    for (int i = 0; i < signatureIndex; ++i)
+    {
+        UUCByteArray cmsArray;
+        SignatureAppearanceInfo info{};
+        int signatureRc = verifier.GetSignature(i, cmsArray, info);
+        assert(signatureRc == 0);
+        assert(results[i].signature.getLength() == cmsArray.getLength());
+        assert(std::equal(cmsArray.getContent(), cmsArray.getContent() + cmsArray.getLength(),
+                          results[i].signature.getContent()));
+        int bitmask = verifier.VerifySignature(i, nullptr, nullptr, nullptr);
+        assert(results[i].bitmask == bitmask);
+        assert(verifiedOn[i] == 1);
+
+        // ogni firma termina su un %%EOF; l'ultima copre il file intero
+        SignatureCoverage coverage{};
+        int coverageRc = verifier.GetSignatureCoverage(i, coverage);
+        assert(coverageRc == 0);
+        assert(coverage.nRevision >= 0 && coverage.nRevision < coverage.nRevisions);
+        if (i == signatureIndex - 1)
+        {
+            assert(coverage.bWholeDocument);
+            assert(coverage.nRevision == coverage.nRevisions - 1);
+            assert(coverage.nChanges == 0);
+        }
+    }
+    return signatureIndex;
+}
+
+// eccezioni di fnVerified: le altre firme sono comunque verificate, il chiamante
+// riceve l'eccezione della prima firma nell'ordine dei campi
+void verify_callback_errors(const std::vector<uint8_t>& pdf)
+{
+    PDFVerifier verifier;
+    int loadResult = verifier.Load(reinterpret_cast<const char*>(pdf.data()),
+                                   static_cast<int>(pdf.size()));
+    assert(loadResult == 0);
+
+    std::vector<SignatureVerifyResult> expected;
+    int rc = verifier.VerifySignatures(nullptr, false, expected);
+    assert(rc == 0 && expected.size() >= 2);
+
+    std::vector<SignatureVerifyResult> results;
+    std::vector<int> verifiedOn(expected.size(), 0);
+    bool thrown = false;
+    try
+    {
+        verifier.VerifySignatures(nullptr, false, results,
+            [&](size_t i, SignatureVerifyResult&) {
+                verifiedOn[i]++;
+                if (i == 1)
+                    throw std::runtime_error("signature 1");
+            });
+    }
+    catch (const std::runtime_error& err)
+    {
+        thrown = std::string(err.what()) == "signature 1";
+    }
+    assert(thrown);
+    assert(results.size() == expected.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        assert(verifiedOn[i] == 1);
+        assert(results[i].bitmask == expected[i].bitmask);
+    }
+
+    // tutte le callback falliscono: si riceve quella della firma 0, anche se
+    // un altro thread ha finito prima
+    std::string firstError;
+    try
+    {
+        verifier.VerifySignatures(nullptr, false, results,
+            [](size_t i, SignatureVerifyResult&) {
+                throw std::runtime_error("signature " + std::to_string(i));
+            });
+    }
+    catch (const std::runtime_error& err)
+    {
+        firstError = err.what();
+    }
+    assert(firstError == "signature 0");
+}
+
+// controlli di cie_sign_check_pdf prima e dopo la firma del campo fieldId
+void check_pdf_preflight(const std::vector<uint8_t>& pdf, const std::vector<uint8_t>& signedPdf, const char* fieldId)
+{
+    cie_pdf_options options{};
+    options.field_ids = &fieldId;
+    options.field_ids_len = 1;
+
+    char names[256];
+    cie_pdf_check_result check{};
+    check.signable_fields = names;
+    check.signable_fields_capacity = sizeof(names);
+    cie_status status = cie_sign_check_pdf(pdf.data(), pdf.size(), &options, &check);
+    assert(status == CIE_STATUS_OK);
+    assert((check.issues & CIE_PDF_BLOCKING_ISSUES) == 0);
+    assert(check.revisions == 1 && check.signature_fields == 1 && check.signed_fields == 0);
+    assert(check.signatures_to_apply == 1 && check.estimated_card_ms > 0);
+    assert(check.signable_fields_len > 0 && check.signable_fields_len <= sizeof(names));
+    assert(std::string(names).find(fieldId) != std::string::npos);
+
+    const char* missing = "NoSuchField";
+    options.field_ids = &missing;
+    status = cie_sign_check_pdf(pdf.data(), pdf.size(), &options, &check);
+    assert(status == CIE_STATUS_OK && (check.issues & CIE_PDF_ISSUE_FIELD_MISSING));
+
+    options.field_ids = &fieldId;
+    status = cie_sign_check_pdf(signedPdf.data(), signedPdf.size(), &options, &check);
+    assert(status == CIE_STATUS_OK && (check.issues & CIE_PDF_ISSUE_FIELD_SIGNED));
+    assert(check.revisions == 2 && check.signed_fields == 1 && check.signable_fields_len == 0);
+
+    // senza campi richiesti non c'e' un campo da firmare: se ne crea uno nuovo
+    status = cie_sign_check_pdf(signedPdf.data(), signedPdf.size(), nullptr, &check);
+    assert(status == CIE_STATUS_OK && (check.issues & CIE_PDF_BLOCKING_ISSUES) == 0);
+    assert(check.signatures_to_apply == 1);
+
+    const uint8_t notPdf[] = "not a pdf";
+    status = cie_sign_check_pdf(notPdf, sizeof(notPdf) - 1, nullptr, &check);
+    assert(status == CIE_STATUS_OK && check.issues == CIE_PDF_ISSUE_NOT_PDF);
+    status = cie_sign_check_pdf(nullptr, 0, nullptr, &check);
+    assert(status == CIE_STATUS_INVALID_INPUT);
 }
 
 bool has_appearance_entry(const std::vector<uint8_t>& pdf)
@@ -259,6 +391,43 @@ void assert_single_field_with_appearance(const char* path)
     assert(apPresent);
 }
 
+// PDF 1.5+ di una pagina indicizzato da uno stream xref (oggetto 5), senza campi firma
+std::vector<uint8_t> makeXrefStreamPdf()
+{
+    std::string pdf = "%PDF-1.7\n%\xE2\xE3\xCF\xD3\n";
+    std::vector<size_t> offsets;
+    auto object = [&](const std::string& body)
+    {
+        offsets.push_back(pdf.size());
+        pdf += std::to_string(offsets.size()) + " 0 obj\n" + body + "\nendobj\n";
+    };
+    const std::string content = "BT /F1 24 Tf 72 700 Td (Xref stream) Tj ET";
+    object("<< /Type /Catalog /Pages 2 0 R >>");
+    object("<< /Type /Pages /Kids [ 3 0 R ] /Count 1 >>");
+    object("<< /Type /Page /Parent 2 0 R /MediaBox [ 0 0 612 792 ] /Contents 4 0 R "
+           "/Resources << /Font << /F1 << /Type /Font /Subtype /Type1 /BaseFont /Helvetica >> >> >> >>");
+    object("<< /Length " + std::to_string(content.size()) + " >>\nstream\n" + content + "\nendstream");
+
+    // voci /W [ 1 4 2 ] non compresse: oggetto 0 libero, poi gli oggetti 1-5
+    size_t xref = pdf.size();
+    offsets.push_back(xref);
+    std::string rows;
+    auto row = [&](uint8_t type, size_t offset, uint16_t generation)
+    {
+        rows.push_back(static_cast<char>(type));
+        for (int shift = 24; shift >= 0; shift -= 8)
+            rows.push_back(static_cast<char>(offset >> shift));
+        rows.push_back(static_cast<char>(generation >> 8));
+        rows.push_back(static_cast<char>(generation));
+    };
+    row(0, 0, 65535);
+    for (size_t offset : offsets)
+        row(1, offset, 0);
+    pdf += "5 0 obj\n<< /Type /XRef /Size 6 /Root 1 0 R /W [ 1 4 2 ] /Length " + std::to_string(rows.size()) +
+           " >>\nstream\n" + rows + "\nendstream\nendobj\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+    return std::vector<uint8_t>(pdf.begin(), pdf.end());
+}
+
 static std::vector<uint8_t> loadFixture(const char* path)
 {
     std::string fullPath = std::string(CIE_SIGN_SDK_SOURCE_DIR) + "/" + path;
@@ -268,6 +437,183 @@ static std::vector<uint8_t> loadFixture(const char* path)
     return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
 }
 
+// firma del campo con PdfSignatureGenerator; l'aspetto non dipende dalla CMS
+std::vector<uint8_t> sign_field(PdfSignatureGenerator& generator, const char* fieldId)
+{
+    bool initialized = generator.InitExistingSignatureField(fieldId, "Mock reason", "Mock user", "Mock city", nullptr);
+    assert(initialized);
+    UUCByteArray toSign;
+    generator.GetBufferForSignature(toSign);
+    const char cms[] = { 0x30, 0x00 };
+    bool stored = generator.SetSignature(cms, static_cast<int>(sizeof(cms)));
+    assert(stored);
+    UUCByteArray signedPdf;
+    generator.GetSignedPdf(signedPdf);
+    return std::vector<uint8_t>(signedPdf.getContent(), signedPdf.getContent() + signedPdf.getLength());
+}
+
+struct FieldAppearance
+{
+    PoDoFo::PdfReference form;
+    std::vector<PoDoFo::PdfReference> images;
+};
+
+// /AP /N di ogni campo firma e gli XObject immagine che disegna, nell'ordine dei campi
+std::vector<FieldAppearance> field_appearances(PoDoFo::PdfMemDocument& document)
+{
+    using namespace PoDoFo;
+    std::vector<FieldAppearance> appearances;
+    auto iterable = document.GetFieldsIterator();
+    for (auto it = iterable.begin(); it != iterable.end(); ++it)
+    {
+        PdfField* field = *it;
+        if (!field || field->GetType() != PdfFieldType::Signature)
+            continue;
+        PdfAnnotationWidget* widget = dynamic_cast<PdfSignature*>(field)->GetWidget();
+        assert(widget != nullptr);
+        const PdfObject* ap = widget->GetDictionary().FindKey("AP");
+        assert(ap && ap->IsDictionary());
+        const PdfObject* normal = ap->GetDictionary().GetKey("N");
+        assert(normal && normal->IsReference());
+
+        FieldAppearance appearance;
+        appearance.form = normal->GetReference();
+        const PdfObject* form = document.GetObjects().GetObject(appearance.form);
+        assert(form && form->IsDictionary());
+        const PdfObject* resources = form->GetDictionary().FindKey("Resources");
+        const PdfObject* xobjects = resources ? resources->GetDictionary().FindKey("XObject") : nullptr;
+        assert(xobjects && xobjects->IsDictionary());
+        for (const auto& entry : xobjects->GetDictionary())
+        {
+            if (entry.second.IsReference())
+                appearance.images.push_back(entry.second.GetReference());
+        }
+        assert(!appearance.images.empty());
+        appearances.push_back(appearance);
+    }
+    return appearances;
+}
+
+// PDF di una pagina con un campo firma e, ai numeri indicati, un XObject immagine
+// e un XObject form estranei alla firma
+std::vector<uint8_t> makePdfWithObjects(uint32_t imageNumber, uint32_t formNumber)
+{
+    std::map<uint32_t, std::string> objects;
+    objects[1] = "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [ 4 0 R ] /SigFlags 3 >> >>";
+    objects[2] = "<< /Type /Pages /Kids [ 3 0 R ] /Count 1 >>";
+    objects[3] = "<< /Type /Page /Parent 2 0 R /MediaBox [ 0 0 612 792 ] /Annots [ 4 0 R ] >>";
+    objects[4] = "<< /T (SignatureField1) /FT /Sig /Type /Annot /Subtype /Widget /F 4 "
+                 "/Rect [ 61.2 79.2 306 174.24 ] /P 3 0 R >>";
+    objects[imageNumber] = "<< /Type /XObject /Subtype /Image /Width 3 /Height 3 /ColorSpace /DeviceGray "
+                           "/BitsPerComponent 8 /Length 9 >>\nstream\n\x80\x80\x80\x80\x80\x80\x80\x80\x80\nendstream";
+    objects[formNumber] = "<< /Type /XObject /Subtype /Form /BBox [ 0 0 10 10 ] /Length 0 >>\nstream\n\nendstream";
+
+    std::string pdf = "%PDF-1.7\n%\xE2\xE3\xCF\xD3\n";
+    std::map<uint32_t, size_t> offsets;
+    for (const auto& object : objects)
+    {
+        offsets[object.first] = pdf.size();
+        pdf += std::to_string(object.first) + " 0 obj\n" + object.second + "\nendobj\n";
+    }
+    size_t xref = pdf.size();
+    pdf += "xref\n0 1\n0000000000 65535 f \n";
+    char line[32];
+    for (const auto& offset : offsets)
+    {
+        std::snprintf(line, sizeof(line), "%010zu 00000 n \n", offset.second);
+        pdf += std::to_string(offset.first) + " 1\n" + line;
+    }
+    pdf += "trailer\n<< /Size " + std::to_string(offsets.rbegin()->first + 1) + " /Root 1 0 R >>\n"
+           "startxref\n" + std::to_string(xref) + "\n%%EOF\n";
+    return std::vector<uint8_t>(pdf.begin(), pdf.end());
+}
+
+// aspetto con immagine: un solo XObject per i campi di un documento, la codifica
+// riusata dal documento successivo, nessun riferimento del documento precedente dopo Load
+void check_shared_appearance(const std::vector<uint8_t>& multiFieldPdf, const std::vector<uint8_t>& singleFieldPdf)
+{
+    using namespace PoDoFo;
+
+    // RGBA mai usato prima nel processo, per contare le codifiche
+    const uint32_t width = 96;
+    const uint32_t height = 40;
+    std::vector<uint8_t> rgba(width * height * 4);
+    for (size_t i = 0; i < width * height; ++i)
+    {
+        rgba[i * 4] = static_cast<uint8_t>(i * 7);
+        rgba[i * 4 + 1] = static_cast<uint8_t>(i / width * 5);
+        rgba[i * 4 + 2] = 0x40;
+        rgba[i * 4 + 3] = 0xFF;
+    }
+
+    long hits0 = 0, misses0 = 0;
+    PdfSignatureGenerator::GetAppearanceCacheStats(&hits0, &misses0);
+
+    // due campi della stessa dimensione, firmati in sequenza come fa cie_sign_execute
+    PdfSignatureGenerator generator;
+    int loadResult = generator.Load(reinterpret_cast<const char*>(multiFieldPdf.data()), static_cast<int>(multiFieldPdf.size()));
+    assert(loadResult >= 0);
+    generator.SetSignatureImage(rgba.data(), rgba.size(), width, height);
+    std::vector<uint8_t> firstSigned = sign_field(generator, "SignatureField1");
+    loadResult = generator.Load(reinterpret_cast<const char*>(firstSigned.data()), static_cast<int>(firstSigned.size()));
+    assert(loadResult >= 0);
+    generator.SetSignatureImage(rgba.data(), rgba.size(), width, height);
+    std::vector<uint8_t> bothSigned = sign_field(generator, "SignatureField2");
+
+    long hits = 0, misses = 0;
+    PdfSignatureGenerator::GetAppearanceCacheStats(&hits, &misses);
+    assert(misses == misses0 + 1 && hits == hits0);
+
+    PdfMemDocument multiDocument;
+    multiDocument.LoadFromBuffer(bufferview(reinterpret_cast<const char*>(bothSigned.data()), bothSigned.size()));
+    std::vector<FieldAppearance> fields = field_appearances(multiDocument);
+    assert(fields.size() == 2);
+    assert(fields[0].form == fields[1].form);
+    assert(fields[0].images.size() == 1 && fields[0].images == fields[1].images);
+    const PdfObject* sharedImage = multiDocument.GetObjects().GetObject(fields[0].images[0]);
+    assert(sharedImage && sharedImage->HasStream());
+    charbuff sharedData = sharedImage->GetStream()->GetCopy(true);
+
+    // altro documento: lo stream compresso arriva dalla cache
+    PdfSignatureGenerator other;
+    loadResult = other.Load(reinterpret_cast<const char*>(singleFieldPdf.data()), static_cast<int>(singleFieldPdf.size()));
+    assert(loadResult >= 0);
+    other.SetSignatureImage(rgba.data(), rgba.size(), width, height);
+    std::vector<uint8_t> otherSigned = sign_field(other, "SignatureField1");
+    PdfSignatureGenerator::GetAppearanceCacheStats(&hits, &misses);
+    assert(hits == hits0 + 1 && misses == misses0 + 1);
+
+    PdfMemDocument otherDocument;
+    otherDocument.LoadFromBuffer(bufferview(reinterpret_cast<const char*>(otherSigned.data()), otherSigned.size()));
+    std::vector<FieldAppearance> otherFields = field_appearances(otherDocument);
+    assert(otherFields.size() == 1 && otherFields[0].images.size() == 1);
+    const PdfObject* importedImage = otherDocument.GetObjects().GetObject(otherFields[0].images[0]);
+    assert(importedImage && importedImage->HasStream());
+    assert(importedImage->GetStream()->GetCopy(true) == sharedData);
+    assert(importedImage->GetDictionary().FindKeyAsSafe<int64_t>("Width") ==
+           sharedImage->GetDictionary().FindKeyAsSafe<int64_t>("Width"));
+
+    // documento non collegato con un'immagine e un form agli stessi numeri di
+    // oggetto: dopo Load i riferimenti del documento precedente non valgono piu'
+    const uint32_t imageNumber = fields[0].images[0].ObjectNumber();
+    const uint32_t formNumber = fields[0].form.ObjectNumber();
+    assert(imageNumber > 4 && formNumber > 4 && imageNumber != formNumber);
+    std::vector<uint8_t> unrelated = makePdfWithObjects(imageNumber, formNumber);
+    loadResult = generator.Load(reinterpret_cast<const char*>(unrelated.data()), static_cast<int>(unrelated.size()));
+    assert(loadResult >= 0);
+    generator.SetSignatureImage(rgba.data(), rgba.size(), width, height);
+    std::vector<uint8_t> unrelatedSigned = sign_field(generator, "SignatureField1");
+
+    PdfMemDocument unrelatedDocument;
+    unrelatedDocument.LoadFromBuffer(bufferview(reinterpret_cast<const char*>(unrelatedSigned.data()), unrelatedSigned.size()));
+    std::vector<FieldAppearance> unrelatedFields = field_appearances(unrelatedDocument);
+    assert(unrelatedFields.size() == 1 && unrelatedFields[0].images.size() == 1);
+    assert(unrelatedFields[0].form.ObjectNumber() != formNumber);
+    assert(unrelatedFields[0].images[0].ObjectNumber() != imageNumber);
+    const PdfObject* freshImage = unrelatedDocument.GetObjects().GetObject(unrelatedFields[0].images[0]);
+    assert(freshImage && freshImage->GetStream()->GetCopy(true) == sharedData);
+}
+
 } // namespace
 
 int main() {
@@ -368,6 +714,7 @@ int main() {
     std::vector<uint8_t> signedPdf(result.output, result.output + result.output_len);
     write_bytes_to_file(signedPdf, "mock_signed.pdf");
     verify_signed_pdf(signedPdf);
+    check_pdf_preflight(pdf, signedPdf, fieldId);
     assert(has_appearance_entry(signedPdf));
     if (signedPdf.size() <= pdf.size()) {
         std::fprintf(stderr, "Signed PDF not larger than original\n");
@@ -404,6 +751,16 @@ int main() {
     assert(verifierMatches);
     assert_single_field_with_appearance("mock_signed.pdf");
 
+    // file mappato in memoria: i segmenti /ByteRange si hashano senza copia,
+    // l'esito deve coincidere con quello del PDF caricato dal buffer
+    PDFVerifier bufferVerifier;
+    int bufferLoadResult = bufferVerifier.Load(reinterpret_cast<const char*>(signedPdf.data()), static_cast<int>(signedPdf.size()));
+    assert(bufferLoadResult == 0);
+    int mappedBitmask = verifier.VerifySignature(0, nullptr, nullptr, nullptr);
+    int bufferBitmask = bufferVerifier.VerifySignature(0, nullptr, nullptr, nullptr);
+    assert(mappedBitmask >= 0 && (mappedBitmask & VERIFIED_SIGNATURE));
+    assert(mappedBitmask == bufferBitmask);
+
     // Scenario 2: PDF senza campi firma -> creazione di un nuovo campo
     std::puts("Scenario 2: signing PDF without existing fields (new field)");
     auto pdfNoField = loadFixture("data/fixtures/sample_no_field.pdf");
@@ -450,8 +807,66 @@ int main() {
     }
     std::vector<uint8_t> multiSigned(result.output, result.output + result.output_len);
     write_bytes_to_file(multiSigned, "mock_signed_multi.pdf");
-    verify_signed_pdf(multiSigned);
-    // Multi-signature layout validated via verify_signed_pdf
+    // un campo per firma: VerifySignatures usa piu' thread
+    int multiSignatures = verify_signed_pdf(multiSigned);
+    assert(multiSignatures == 2);
+    verify_callback_errors(multiSigned);
+    check_shared_appearance(pdfMulti, pdf);
+
+    // Scenario 4: PDF con stream xref firmato con compact_update, confrontato con
+    // l'aggiornamento scritto da PoDoFo
+    std::puts("Scenario 4: compact update on a PDF with an xref stream");
+    auto xrefStreamPdf = makeXrefStreamPdf();
+    req.input = xrefStreamPdf.data();
+    req.input_len = xrefStreamPdf.size();
+    req.pdf.left = 0.1f;
+    req.pdf.bottom = 0.1f;
+    req.pdf.width = 0.4f;
+    req.pdf.height = 0.12f;
+    std::vector<uint8_t> updates[2];
+    for (int compact = 0; compact < 2; ++compact)
+    {
+        req.pdf.compact_update = compact;
+        result.output_len = 0;
+        status = cie_sign_execute(ctx, &req, &result);
+        if (status != CIE_STATUS_OK || result.output_len == 0) {
+            std::fprintf(stderr, "Scenario 4 failed: compact=%d status=%d len=%zu (%s)\n",
+                         compact, status, result.output_len, cie_sign_get_last_error(ctx));
+            cie_sign_ctx_destroy(ctx);
+            return 10;
+        }
+        updates[compact].assign(result.output, result.output + result.output_len);
+    }
+    req.pdf.compact_update = 0;
+    const std::vector<uint8_t>& compactPdf = updates[1];
+    assert(compactPdf.size() < updates[0].size());
+    assert(std::equal(xrefStreamPdf.begin(), xrefStreamPdf.end(), compactPdf.begin()));
+
+    // revisione aggiunta con stream di oggetti e stream xref
+    CPdfRevisionMap revisions;
+    long scanRc = revisions.scan(compactPdf.data(), compactPdf.size());
+    assert(scanRc == 0);
+    assert(revisions.count() == 2);
+    const CPdfRevisionMap::Revision& update = revisions.revision(1);
+    assert(update.bXrefStream && update.nEnd == compactPdf.size());
+    assert(std::any_of(update.entries.begin(), update.entries.end(),
+        [](const std::pair<const uint32_t, CPdfRevisionMap::Entry>& entry) { return entry.second.nType == 2; }));
+
+    // la firma riscritta sulla nuova /ByteRange e' valida e copre tutto il file
+    write_bytes_to_file(compactPdf, "mock_signed_compact.pdf");
+    verify_signed_pdf(compactPdf);
+    PDFVerifier compactVerifier;
+    int compactLoad = compactVerifier.Load(reinterpret_cast<const char*>(compactPdf.data()),
+                                           static_cast<int>(compactPdf.size()));
+    assert(compactLoad == 0);
+    assert(compactVerifier.GetNumberOfSignatures() == 1);
+    int compactBitmask = compactVerifier.VerifySignature(0, nullptr, nullptr, nullptr);
+    assert(compactBitmask & VERIFIED_SIGNATURE);
+    SignatureCoverage compactCoverage{};
+    int compactCoverageRc = compactVerifier.GetSignatureCoverage(0, compactCoverage);
+    assert(compactCoverageRc == 0);
+    assert(compactCoverage.bWholeDocument && compactCoverage.nRevision == 1 && compactCoverage.nRevisions == 2);
+    assert_signature_field_present_on_disk("mock_signed_compact.pdf", 1);
 
     cie_sign_ctx_destroy(ctx);
     return 0;
@@ -0,0 +1,242 @@
+#include "mock_http_server.h"
+#include "ASN1/OCSPCache.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/ocsp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Status returned by the stand-in responder for a serial.
+struct Answer {
+    int status;       // V_OCSP_CERTSTATUS_*
+    long validity;    // seconds to nextUpdate, 0 = no nextUpdate
+};
+
+class Responder {
+public:
+    explicit Responder(const TestIssuer& issuer) : issuer_(issuer) {}
+
+    void set(long serial, Answer answer)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        answers_[serial] = answer;
+    }
+
+    std::vector<uint8_t> respond(const std::vector<uint8_t>& body, int* status)
+    {
+        const unsigned char* p = body.data();
+        OCSP_REQUEST* request = d2i_OCSP_REQUEST(nullptr, &p, static_cast<long>(body.size()));
+        if (!request || OCSP_request_onereq_count(request) != 1) {
+            OCSP_REQUEST_free(request);
+            *status = 400;
+            return {};
+        }
+
+        OCSP_CERTID* id = OCSP_onereq_get0_id(OCSP_request_onereq_get0(request, 0));
+        ASN1_INTEGER* serial = nullptr;
+        OCSP_id_get0_info(nullptr, nullptr, nullptr, &serial, id);
+
+        Answer answer = {V_OCSP_CERTSTATUS_UNKNOWN, 3600};
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = answers_.find(ASN1_INTEGER_get(serial));
+            if (it != answers_.end())
+                answer = it->second;
+        }
+
+        // lo stesso tempo di risposta anche per richieste concorrenti
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        time_t now = std::time(nullptr);
+        ASN1_TIME* thisUpdate = ASN1_TIME_adj(nullptr, now, 0, 0);
+        ASN1_TIME* nextUpdate = answer.validity ? ASN1_TIME_adj(nullptr, now, 0, answer.validity) : nullptr;
+        ASN1_TIME* revocationTime = answer.status == V_OCSP_CERTSTATUS_REVOKED ? ASN1_TIME_adj(nullptr, now, -1, 0) : nullptr;
+
+        OCSP_BASICRESP* basic = OCSP_BASICRESP_new();
+        OCSP_basic_add1_status(basic, id, answer.status, OCSP_REVOKED_STATUS_KEYCOMPROMISE,
+                               revocationTime, thisUpdate, nextUpdate);
+        OCSP_basic_sign(basic, issuer_.cert, issuer_.key, EVP_sha256(), nullptr, 0);
+        OCSP_RESPONSE* response = OCSP_response_create(OCSP_RESPONSE_STATUS_SUCCESSFUL, basic);
+
+        unsigned char* der = nullptr;
+        int len = i2d_OCSP_RESPONSE(response, &der);
+        std::vector<uint8_t> out(der, der + (len > 0 ? len : 0));
+
+        OPENSSL_free(der);
+        OCSP_RESPONSE_free(response);
+        OCSP_BASICRESP_free(basic);
+        ASN1_TIME_free(revocationTime);
+        ASN1_TIME_free(nextUpdate);
+        ASN1_TIME_free(thisUpdate);
+        OCSP_REQUEST_free(request);
+        return out;
+    }
+
+private:
+    const TestIssuer& issuer_;
+    std::mutex mutex_;
+    std::map<long, Answer> answers_;
+};
+
+UUCByteArray makeRequest(const TestIssuer& issuer, long serialNumber)
+{
+    ASN1_INTEGER* serial = ASN1_INTEGER_new();
+    ASN1_INTEGER_set(serial, serialNumber);
+    OCSP_CERTID* id = OCSP_cert_id_new(EVP_sha1(), X509_get_subject_name(issuer.cert),
+                                       X509_get0_pubkey_bitstr(issuer.cert), serial);
+    ASN1_INTEGER_free(serial);
+
+    OCSP_REQUEST* request = OCSP_REQUEST_new();
+    OCSP_request_add0_id(request, id);
+
+    unsigned char* der = nullptr;
+    int len = i2d_OCSP_REQUEST(request, &der);
+    UUCByteArray out(der, len > 0 ? len : 0);
+
+    OPENSSL_free(der);
+    OCSP_REQUEST_free(request);
+    return out;
+}
+
+// V_OCSP_CERTSTATUS_* della risposta ottenuta, -1 se assente o non valida
+int lookup(const std::string& url, const TestIssuer& issuer, long serial)
+{
+    UUCByteArray request = makeRequest(issuer, serial);
+    UUCByteArray response;
+    if (COCSPCache::GetResponse(url.c_str(), request, response) != 0 || response.getLength() == 0)
+        return -1;
+
+    const unsigned char* p = response.getContent();
+    OCSP_RESPONSE* ocsp = d2i_OCSP_RESPONSE(nullptr, &p, static_cast<long>(response.getLength()));
+    OCSP_BASICRESP* basic = ocsp ? OCSP_response_get1_basic(ocsp) : nullptr;
+    int status = -1;
+    if (basic) {
+        int reason = 0;
+        status = OCSP_single_get0_status(OCSP_resp_get0(basic, 0), &reason, nullptr, nullptr, nullptr);
+    }
+
+    OCSP_BASICRESP_free(basic);
+    OCSP_RESPONSE_free(ocsp);
+    return status;
+}
+
+} // namespace
+
+int main()
+{
+    TestIssuer issuer("Test OCSP issuer");
+    Responder responder(issuer);
+
+    MockHttpServer server;
+    server.setHandler("/ocsp", [&responder](const std::vector<uint8_t>& body, int* status) {
+        return responder.respond(body, status);
+    });
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the HTTP stand-in\n");
+        return 1;
+    }
+    const std::string url = server.url("/ocsp");
+
+    responder.set(0x101, {V_OCSP_CERTSTATUS_GOOD, 3600});
+    responder.set(0x102, {V_OCSP_CERTSTATUS_REVOKED, 3600});
+    responder.set(0x103, {V_OCSP_CERTSTATUS_UNKNOWN, 3600});
+    responder.set(0x104, {V_OCSP_CERTSTATUS_GOOD, 0});
+    responder.set(0x105, {V_OCSP_CERTSTATUS_GOOD, 1});
+
+    // lo stesso certificato verificato 50 volte: una sola richiesta
+    bool allGood = true;
+    for (int i = 0; i < 50; i++)
+        allGood = lookup(url, issuer, 0x101) == V_OCSP_CERTSTATUS_GOOD && allGood;
+    expect(allGood, "good status from every lookup");
+    expect(server.requestCount("/ocsp") == 1, "one request for 50 lookups");
+
+    // anche lo stato revoked si conserva
+    server.resetCounts();
+    expect(lookup(url, issuer, 0x102) == V_OCSP_CERTSTATUS_REVOKED, "revoked status");
+    expect(lookup(url, issuer, 0x102) == V_OCSP_CERTSTATUS_REVOKED, "revoked status (cached)");
+    expect(server.requestCount("/ocsp") == 1, "revoked response cached");
+
+    // unknown non si conserva
+    server.resetCounts();
+    expect(lookup(url, issuer, 0x103) == V_OCSP_CERTSTATUS_UNKNOWN, "unknown status");
+    expect(lookup(url, issuer, 0x103) == V_OCSP_CERTSTATUS_UNKNOWN, "unknown status again");
+    expect(server.requestCount("/ocsp") == 2, "unknown response not cached");
+
+    // verifiche concorrenti dello stesso certificato: una sola richiesta
+    server.resetCounts();
+    responder.set(0x106, {V_OCSP_CERTSTATUS_GOOD, 3600});
+    std::atomic<int> concurrentGood(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 16; i++)
+        threads.emplace_back([&] {
+            if (lookup(url, issuer, 0x106) == V_OCSP_CERTSTATUS_GOOD)
+                concurrentGood++;
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    expect(concurrentGood == 16, "good status in every thread");
+    expect(server.requestCount("/ocsp") == 1, "one request for concurrent lookups");
+
+    // senza nextUpdate vale l'eta' massima; con eta' massima 0 non si conserva
+    server.resetCounts();
+    lookup(url, issuer, 0x104);
+    lookup(url, issuer, 0x104);
+    expect(server.requestCount("/ocsp") == 1, "response without nextUpdate kept for the max age");
+    COCSPCache::SetMaxAge(0);
+    lookup(url, issuer, 0x104);
+    lookup(url, issuer, 0x104);
+    expect(server.requestCount("/ocsp") == 3, "response without nextUpdate not kept without max age");
+    COCSPCache::SetMaxAge(OCSP_DEFAULT_MAX_AGE);
+
+    // oltre nextUpdate la risposta si richiede di nuovo
+    server.resetCounts();
+    lookup(url, issuer, 0x105);
+    sleep(2);
+    lookup(url, issuer, 0x105);
+    expect(server.requestCount("/ocsp") == 2, "response past nextUpdate requested again");
+
+    // oltre l'eta' massima, anche prima di nextUpdate (0x101 risale a prima della pausa)
+    server.resetCounts();
+    COCSPCache::SetMaxAge(2);
+    lookup(url, issuer, 0x101);
+    lookup(url, issuer, 0x101);
+    expect(server.requestCount("/ocsp") == 1, "response older than the max age requested again");
+    COCSPCache::SetMaxAge(OCSP_DEFAULT_MAX_AGE);
+
+    // livello su disco: un nuovo processo non ripete la richiesta
+    char dir[] = "/tmp/ocsp_cache_test_XXXXXX";
+    if (mkdtemp(dir)) {
+        COCSPCache::CleanUp();
+        COCSPCache::SetCacheDir(dir);
+        server.resetCounts();
+        expect(lookup(url, issuer, 0x102) == V_OCSP_CERTSTATUS_REVOKED, "revoked status (disk run)");
+
+        COCSPCache::CleanUp();
+        expect(lookup(url, issuer, 0x102) == V_OCSP_CERTSTATUS_REVOKED, "revoked status from disk");
+        expect(server.requestCount("/ocsp") == 1, "response served from disk");
+
+        std::string cleanup = std::string("rm -rf ") + dir;
+        std::system(cleanup.c_str());
+        COCSPCache::SetCacheDir(nullptr);
+    }
+
+    COCSPCache::CleanUp();
+    server.stop();
+
+    return testResult("ocsp_cache_test");
+}
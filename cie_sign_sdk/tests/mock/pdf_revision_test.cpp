@@ -0,0 +1,374 @@
+#include "PdfRevisionMap.h"
+#include "PdfSyntax.h"
+#include "PdfUpdateCompactor.h"
+#include "disigonsdk.h"
+#include "test_support.h"
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+// PDF scritto a mano, una revisione alla volta, con gli offset corretti
+class PdfWriter
+{
+public:
+    PdfWriter() : m_data("%PDF-1.7\n%\xE2\xE3\xCF\xD3\n"), m_prev(0) {}
+
+    const std::string& data() const { return m_data; }
+    const BYTE* bytes() const { return reinterpret_cast<const BYTE*>(m_data.data()); }
+
+    void object(int number, const std::string& body)
+    {
+        m_offsets[number] = m_data.size();
+        m_data += std::to_string(number) + " 0 obj\n" + body + "\nendobj\n";
+    }
+
+    void stream(int number, const std::string& dictionary, const std::string& data)
+    {
+        object(number, "<< " + dictionary + " /Length " + std::to_string(data.size()) + " >>\nstream\n" + data + "\nendstream");
+    }
+
+    size_t offset(int number) const { return m_offsets.at(number); }
+    size_t prev() const { return m_prev; }
+
+    // tabella xref classica; restituisce la fine della revisione
+    size_t xrefTable(const std::string& trailer)
+    {
+        size_t xref = m_data.size();
+        m_data += "xref\n";
+        if (!m_prev)
+            m_data += "0 1\n0000000000 65535 f \n";
+        char line[32];
+        for (const auto& entry : m_offsets) {
+            m_data += std::to_string(entry.first) + " 1\n";
+            std::snprintf(line, sizeof(line), "%010zu 00000 n \n", entry.second);
+            m_data += line;
+        }
+        m_data += "trailer\n<< " + trailer + (m_prev ? " /Prev " + std::to_string(m_prev) : std::string()) + " >>\n";
+        return finish(xref);
+    }
+
+    // stream xref gia' scritto come oggetto
+    size_t xrefStream(int number)
+    {
+        return finish(offset(number));
+    }
+
+private:
+    size_t finish(size_t xref)
+    {
+        m_data += "startxref\n" + std::to_string(xref) + "\n%%EOF\n";
+        m_prev = xref;
+        m_offsets.clear();
+        return m_data.size();
+    }
+
+    std::string m_data;
+    std::map<int, size_t> m_offsets;
+    size_t m_prev;
+};
+
+std::string deflate(const std::string& data)
+{
+    std::string out;
+    CPdfSyntax::deflate(data, out);
+    return out;
+}
+
+void writeBase(PdfWriter& pdf)
+{
+    pdf.object(1, "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [ 5 0 R ] /SigFlags 3 >> >>");
+    pdf.object(2, "<< /Type /Pages /Kids [ 3 0 R ] /Count 1 >>");
+    pdf.object(3, "<< /Type /Page /Parent 2 0 R /MediaBox [ 0 0 612 792 ] /Contents 4 0 R /Annots [ 5 0 R ] >>");
+    pdf.stream(4, "", "BT /F1 12 Tf (Hello) Tj ET");
+    pdf.object(5, "<< /FT /Sig /T (Signature1) /Type /Annot /Subtype /Widget /Rect [ 0 0 0 0 ] /P 3 0 R >>");
+    pdf.object(9, "<< /Producer (test) >>");
+}
+
+const char* const kSigned =
+    "<< /FT /Sig /T (Signature1) /Type /Annot /Subtype /Widget /Rect [ 0 0 0 0 ] /P 3 0 R /V 6 0 R >>";
+const char* const kSignature =
+    "<< /Type /Sig /Filter /Adobe.PPKLite /SubFilter /ETSI.CAdES.detached /ByteRange [ 0 10 20 30 ] /Contents <00> >>";
+
+void testIncrementalUpdates()
+{
+    PdfWriter pdf;
+    writeBase(pdf);
+    size_t end0 = pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    // firma: campo, dizionario /Sig e /Info
+    pdf.object(5, kSigned);
+    pdf.object(6, kSignature);
+    pdf.object(9, "<< /Producer (test) /ModDate (D:20260101000000Z) >>");
+    size_t end1 = pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    // nota aggiunta alla pagina
+    pdf.object(7, "<< /Type /Annot /Subtype /Text /Rect [ 10 10 20 20 ] /Contents (note) >>");
+    pdf.object(3, "<< /Type /Page /Parent 2 0 R /MediaBox [ 0 0 612 792 ] /Contents 4 0 R /Annots [ 5 0 R 7 0 R ] >>");
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    // dati di validazione; il catalogo e' riscritto con spazi diversi
+    pdf.object(8, "<< /Certs [ ] /CRLs [ ] >>");
+    pdf.object(1, "<</Type/Catalog/Pages 2 0 R/AcroForm<</Fields[5 0 R]/SigFlags 3>>/DSS 8 0 R>>");
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    // contenuto della pagina cambiato
+    pdf.stream(4, "", "BT /F1 12 Tf (Goodbye) Tj ET");
+    size_t end4 = pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    CPdfRevisionMap map;
+    expect(map.scan(pdf.bytes(), pdf.data().size()) == 0, "scan");
+    expect(map.count() == 5, "one revision per update");
+    if (map.count() != 5)
+        return;
+
+    expect(map.revision(0).nEnd == end0 && map.revision(1).nEnd == end1 && map.revision(4).nEnd == end4,
+           "revision boundaries");
+    expect(map.revision(1).nEof + 1 == end1 && !map.revision(1).bXrefStream, "%%EOF position");
+    expect(map.revision(0).nChanges == 0, "first revision");
+    expect(map.revision(1).nChanges == PDF_UPDATE_SIGNATURE, "signature update");
+    expect(map.revision(2).nChanges == PDF_UPDATE_ANNOTATION, "annotation update");
+    expect(map.revision(3).nChanges == 0, "validation data and rewritten catalog");
+    expect(map.revision(4).nChanges == PDF_UPDATE_CONTENT, "content change");
+    expect(map.changesAfter(1) == (PDF_UPDATE_ANNOTATION | PDF_UPDATE_CONTENT), "changes after the signature");
+    expect(map.changesAfter(4) == 0 && map.changesAfter(-1) == (PDF_UPDATE_SIGNATURE | PDF_UPDATE_ANNOTATION | PDF_UPDATE_CONTENT),
+           "changes after the last and before the first revision");
+
+    // solo xref e trailer: stesse revisioni, aggiornamenti non classificati
+    CPdfRevisionMap xrefOnly;
+    expect(xrefOnly.scan(pdf.bytes(), pdf.data().size(), false) == 0 && xrefOnly.count() == 5, "xref only scan");
+    expect(xrefOnly.count() == 5 && xrefOnly.revision(4).nEnd == end4 &&
+           xrefOnly.revision(4).entries.size() == map.revision(4).entries.size() && xrefOnly.trailer(4) == map.trailer(4),
+           "same xref sections and trailers");
+    expect(xrefOnly.count() == 5 && xrefOnly.revision(1).nChanges == -1 && xrefOnly.changesAfter(1) == -1,
+           "updates not classified");
+
+    int64_t byteRange[4] = { 0, 100, 200, static_cast<int64_t>(end1) - 200 };
+    expect(map.revisionOf(byteRange) == 1, "signature covers revision 1");
+    byteRange[3]--;
+    expect(map.revisionOf(byteRange) == 1, "signature ending before the end of line");
+    byteRange[3]--;
+    expect(map.revisionOf(byteRange) == -1, "signature ending inside a revision");
+    int64_t whole[4] = { 0, 100, 200, static_cast<int64_t>(end4) - 200 };
+    expect(map.revisionOf(whole) == 4, "signature covers the whole file");
+    whole[0] = 1;
+    expect(map.revisionOf(whole) == -1, "signature not starting at the beginning");
+
+    std::string dictionary, stream;
+    expect(map.object(4, 0, dictionary, &stream) && stream == "BT /F1 12 Tf (Hello) Tj ET", "object in revision 0");
+    expect(map.object(4, 4, dictionary, &stream) && stream == "BT /F1 12 Tf (Goodbye) Tj ET", "object in revision 4");
+    expect(map.object(6, 3, dictionary) && dictionary.find("/Type /Sig") != std::string::npos, "object from an earlier revision");
+    expect(!map.object(6, 0, dictionary), "object not yet defined");
+    expect(map.trailer(4).find("/Root 1 0 R") != std::string::npos, "trailer");
+}
+
+// contenuto della pagina riscritto nella revisione 1 con un altro dizionario; PDF_UPDATE_*
+int rewriteContents(const std::string& dictionary)
+{
+    PdfWriter pdf;
+    writeBase(pdf);
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+    pdf.stream(4, dictionary, "BT /F1 12 Tf (Goodbye) Tj ET");
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+
+    CPdfRevisionMap map;
+    if (map.scan(pdf.bytes(), pdf.data().size()) != 0 || map.count() != 2)
+        return -1;
+    return map.revision(1).nChanges;
+}
+
+void testShadowedContent()
+{
+    expect(rewriteContents("") == PDF_UPDATE_CONTENT, "content rewritten");
+    expect(rewriteContents("/Type /Metadata /Subtype /XML") == PDF_UPDATE_CONTENT, "content rewritten as metadata");
+    expect(rewriteContents("/Type /Sig /ByteRange [ 0 10 20 30 ] /Contents <00>") == PDF_UPDATE_CONTENT,
+           "content rewritten as a signature");
+    expect(rewriteContents("/FT /Sig") == PDF_UPDATE_CONTENT, "content rewritten as a signature field");
+
+    // metadati aggiunti e poi aggiornati: nessuna modifica
+    PdfWriter pdf;
+    writeBase(pdf);
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+    pdf.stream(10, "/Type /Metadata /Subtype /XML", "<x:xmpmeta/>");
+    pdf.xrefTable("/Size 11 /Root 1 0 R /Info 9 0 R");
+    pdf.stream(10, "/Type /Metadata /Subtype /XML", "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"/>");
+    pdf.xrefTable("/Size 11 /Root 1 0 R /Info 9 0 R");
+
+    CPdfRevisionMap map;
+    expect(map.scan(pdf.bytes(), pdf.data().size()) == 0 && map.count() == 3, "scan metadata updates");
+    if (map.count() == 3)
+        expect(map.revision(1).nChanges == 0 && map.revision(2).nChanges == 0, "metadata updates");
+}
+
+// campo e firma in uno stream di oggetti, indicizzati da uno stream xref con predittore PNG;
+// restituisce la fine della revisione
+size_t writeXrefStream(PdfWriter& pdf)
+{
+    std::string objects = std::string(kSigned) + "\n" + kSignature;
+    std::string header = "5 0 6 " + std::to_string(std::strlen(kSigned) + 1) + " ";
+    pdf.stream(10, "/Type /ObjStm /N 2 /First " + std::to_string(header.size()) + " /Filter /FlateDecode",
+               deflate(header + objects));
+
+    size_t xref = pdf.data().size();
+    std::vector<std::vector<uint8_t>> rows = {
+        { 2, 0, 0, 0, 10, 0, 0 },
+        { 2, 0, 0, 0, 10, 0, 1 },
+        { 1, static_cast<uint8_t>(pdf.offset(10) >> 24), static_cast<uint8_t>(pdf.offset(10) >> 16),
+          static_cast<uint8_t>(pdf.offset(10) >> 8), static_cast<uint8_t>(pdf.offset(10)), 0, 0 },
+        { 1, static_cast<uint8_t>(xref >> 24), static_cast<uint8_t>(xref >> 16),
+          static_cast<uint8_t>(xref >> 8), static_cast<uint8_t>(xref), 0, 0 },
+    };
+    std::string predicted;
+    std::vector<uint8_t> previous(7, 0);
+    for (const auto& row : rows) {
+        predicted.push_back(2);
+        for (size_t i = 0; i < row.size(); i++)
+            predicted.push_back(static_cast<char>(row[i] - previous[i]));
+        previous = row;
+    }
+    pdf.stream(11, "/Type /XRef /Size 12 /Root 1 0 R /Info 9 0 R /Prev " + std::to_string(pdf.prev()) +
+               " /Index [ 5 2 10 2 ] /W [ 1 4 2 ] /Filter /FlateDecode /DecodeParms << /Predictor 12 /Columns 7 >>",
+               deflate(predicted));
+    expect(pdf.offset(11) == xref, "xref stream offset");
+    return pdf.xrefStream(11);
+}
+
+void testXrefStream()
+{
+    PdfWriter pdf;
+    writeBase(pdf);
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+    size_t end1 = writeXrefStream(pdf);
+
+    CPdfRevisionMap map;
+    expect(map.scan(pdf.bytes(), pdf.data().size()) == 0, "scan xref stream");
+    expect(map.count() == 2, "two revisions");
+    if (map.count() != 2)
+        return;
+    expect(map.revision(1).bXrefStream && map.revision(1).nEnd == end1, "xref stream revision");
+    expect(map.revision(1).entries.size() == 4 && map.revision(1).entries.at(6).nType == 2 &&
+           map.revision(1).entries.at(6).nIndex == 1, "xref stream entries");
+    expect(map.revision(1).nChanges == PDF_UPDATE_SIGNATURE, "signature in an object stream");
+
+    std::string dictionary;
+    expect(map.object(6, 1, dictionary) && dictionary == kSignature, "object read from the object stream");
+    expect(map.object(5, 0, dictionary) && dictionary.find("/V") == std::string::npos, "previous version of the field");
+    expect(map.object(5, 1, dictionary) && dictionary == kSigned, "field in the object stream");
+}
+
+// seconda firma come la scrive PoDoFo: tabella xref classica e oggetti non compressi
+void writeSignatureUpdate(PdfWriter& pdf)
+{
+    pdf.object(12, "<< /Type /Sig /Filter /Adobe.PPKLite /SubFilter /ETSI.CAdES.detached "
+                   "/ByteRange [ 0 1234567890 1234567890 1234567890 ] /Contents <" + std::string(2048, '0') +
+                   "> /M (D:20260101000000Z) >>");
+    pdf.object(13, "<< /FT /Sig /T (Signature2) /Type /Annot /Subtype /Widget /F 132 /Rect [ 10 10 110 60 ] "
+                   "/P 3 0 R /V 12 0 R /AP << /N 14 0 R >> >>");
+    pdf.stream(14, "/Type /XObject /Subtype /Form /BBox [ 0 0 100 50 ] /Filter /FlateDecode",
+               deflate("q 0 0 1 rg 0 0 100 50 re f Q"));
+    pdf.object(3, "<< /Type /Page /Parent 2 0 R /MediaBox [ 0 0 612 792 ] /Contents 4 0 R /Annots [ 5 0 R 13 0 R ] >>");
+    pdf.object(1, "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [ 5 0 R 13 0 R ] /SigFlags 3 >> >>");
+    pdf.object(9, "<< /Producer (test) /ModDate (D:20260101000000Z) >>");
+    pdf.xrefTable("/Size 15 /Root 1 0 R /Info 9 0 R /ID [ <0102> <0304> ]");
+}
+
+void testCompactUpdate()
+{
+    PdfWriter pdf;
+    writeBase(pdf);
+    pdf.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+    size_t base = writeXrefStream(pdf);
+    size_t prev = pdf.prev();
+    writeSignatureUpdate(pdf);
+
+    CPdfUpdateCompactor compactor;
+    expect(compactor.compact(pdf.bytes(), pdf.data().size(), base), "compact the update");
+    std::string compacted = pdf.data().substr(0, base) + compactor.update();
+    expect(compacted.size() < pdf.data().size(), "smaller update");
+
+    CPdfRevisionMap original, map;
+    expect(original.scan(pdf.bytes(), pdf.data().size()) == 0 && original.count() == 3, "scan the update");
+    expect(map.scan(reinterpret_cast<const BYTE*>(compacted.data()), compacted.size()) == 0, "scan the compacted update");
+    expect(map.count() == 3, "three revisions");
+    if (map.count() != 3 || original.count() != 3)
+        return;
+    const CPdfRevisionMap::Revision& revision = map.revision(2);
+    expect(revision.bXrefStream && revision.nEnd == compacted.size(), "xref stream revision");
+    expect(revision.nChanges == original.revision(2).nChanges, "same changes");
+    expect(revision.entries.at(1).nType == 2 && revision.entries.at(3).nType == 2 && revision.entries.at(9).nType == 2 &&
+           revision.entries.at(13).nType == 2, "objects in the object stream");
+    expect(revision.entries.at(12).nType == 1 && revision.entries.at(14).nType == 1, "signature and stream in the file");
+    expect(revision.trailer.find("/Prev " + std::to_string(prev)) != std::string::npos &&
+           revision.trailer.find("/ID [ <0102> <0304> ]") != std::string::npos &&
+           revision.trailer.find("/Root 1 0 R") != std::string::npos, "trailer");
+
+    const uint32_t numbers[] = { 1, 3, 9, 13, 14 };
+    for (uint32_t number : numbers) {
+        std::string before, after, beforeStream, afterStream;
+        expect(original.object(number, 2, before, &beforeStream) && map.object(number, 2, after, &afterStream) &&
+               beforeStream == afterStream, "object rewritten");
+        std::map<std::string, std::string> beforeDict, afterDict;
+        CPdfRevisionMap::dictionary(before, beforeDict);
+        CPdfRevisionMap::dictionary(after, afterDict);
+        beforeDict.erase("Length");
+        afterDict.erase("Length");
+        expect(beforeDict == afterDict, "same dictionary");
+    }
+    expect(map.hasStream(14, 2) && !map.hasStream(13, 2) && !map.hasStream(12, 2), "streams");
+
+    // /ByteRange sulla nuova posizione di /Contents
+    const int64_t* byteRange = compactor.byteRange();
+    expect(byteRange[0] == 0 && compacted[byteRange[1]] == '<' && compacted[byteRange[2] - 1] == '>' &&
+           byteRange[2] - byteRange[1] == 2050 &&
+           static_cast<size_t>(byteRange[2] + byteRange[3]) == compacted.size(), "byte range");
+    expect(map.revisionOf(byteRange) == 2, "signature covers the whole file");
+    std::string signature;
+    std::map<std::string, std::string> dict;
+    std::vector<std::string> items;
+    expect(map.object(12, 2, signature) && CPdfRevisionMap::dictionary(signature, dict) &&
+           CPdfRevisionMap::array(dict["ByteRange"], items) && items.size() == 4, "byte range in the signature");
+    for (size_t i = 0; i < items.size(); i++)
+        expect(std::stoll(items[i]) == byteRange[i], "byte range value");
+
+    // documento con tabella xref classica: l'aggiornamento resta com'e'
+    PdfWriter classic;
+    writeBase(classic);
+    base = classic.xrefTable("/Size 10 /Root 1 0 R /Info 9 0 R");
+    writeSignatureUpdate(classic);
+    expect(!compactor.compact(classic.bytes(), classic.data().size(), base), "classic xref table");
+    expect(!compactor.compact(pdf.bytes(), pdf.data().size(), pdf.data().size()), "no update");
+}
+
+void testInvalid()
+{
+    CPdfRevisionMap map;
+    const char garbage[] = "%PDF-1.7\nnot really a pdf\nstartxref\n12345\n%%EOF\n";
+    expect(map.scan(reinterpret_cast<const BYTE*>(garbage), sizeof(garbage) - 1) == DISIGON_ERROR_INVALID_FILE,
+           "no readable xref section");
+    expect(map.scan(NULL, 0) == DISIGON_ERROR_INVALID_FILE && map.count() == 0, "empty buffer");
+
+    // startxref che punta fuori da una sezione xref: la revisione e' ignorata
+    PdfWriter pdf;
+    writeBase(pdf);
+    pdf.xrefTable("/Size 10 /Root 1 0 R");
+    std::string data = pdf.data() + "startxref\n9\n%%EOF\n";
+    expect(map.scan(reinterpret_cast<const BYTE*>(data.data()), data.size()) == 0 && map.count() == 1,
+           "unreadable boundary skipped");
+}
+
+} // namespace
+
+int main()
+{
+    testIncrementalUpdates();
+    testShadowedContent();
+    testXrefStream();
+    testCompactUpdate();
+    testInvalid();
+
+    return testResult("pdf_revision_test");
+}
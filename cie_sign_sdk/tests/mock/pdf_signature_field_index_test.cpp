@@ -0,0 +1,99 @@
+#include "PdfSignatureFieldIndex.h"
+#include "test_support.h"
+
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+using namespace PoDoFo;
+
+namespace {
+
+static_assert(!std::is_copy_constructible<PdfSignatureFieldIndex>::value, "index refers to its own fields");
+static_assert(!std::is_copy_assignable<PdfSignatureFieldIndex>::value, "index refers to its own fields");
+
+// PDF scritto a mano: oggetti 1..N in ordine, una sola tabella xref
+std::string buildPdf(const std::vector<std::string>& objects)
+{
+    std::string data = "%PDF-1.7\n%\xE2\xE3\xCF\xD3\n";
+    std::vector<size_t> offsets;
+    for (size_t i = 0; i < objects.size(); i++) {
+        offsets.push_back(data.size());
+        data += std::to_string(i + 1) + " 0 obj\n" + objects[i] + "\nendobj\n";
+    }
+
+    size_t xref = data.size();
+    data += "xref\n0 " + std::to_string(objects.size() + 1) + "\n0000000000 65535 f \n";
+    char line[32];
+    for (size_t offset : offsets) {
+        std::snprintf(line, sizeof(line), "%010zu 00000 n \n", offset);
+        data += line;
+    }
+    data += "trailer\n<< /Size " + std::to_string(objects.size() + 1) + " /Root 1 0 R >>\n";
+    data += "startxref\n" + std::to_string(xref) + "\n%%EOF\n";
+    return data;
+}
+
+} // namespace
+
+int main()
+{
+    // firme            /FT /Sig ereditato dai figli
+    //   firme.autore   campo e widget uniti, /V nel campo
+    //   firme.revisore campo con un widget figlio che porta /V
+    // legacy           widget non elencato nelle /Annots, pagina da /P
+    // nome             campo di testo, escluso
+    const std::string pdf = buildPdf({
+        "<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [4 0 R 8 0 R 9 0 R] /SigFlags 3 >> >>",
+        "<< /Type /Pages /Kids [3 0 R] /Count 1 >>",
+        "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 595 842] /Annots [5 0 R 7 0 R 9 0 R] >>",
+        "<< /T (firme) /FT /Sig /Kids [5 0 R 6 0 R] >>",
+        "<< /T (autore) /Parent 4 0 R /Type /Annot /Subtype /Widget /Rect [10 10 110 60] /P 3 0 R /V 10 0 R >>",
+        "<< /T (revisore) /Parent 4 0 R /Kids [7 0 R] >>",
+        "<< /Type /Annot /Subtype /Widget /Parent 6 0 R /Rect [200 10 300 60] /P 3 0 R /V 11 0 R >>",
+        "<< /T (legacy) /FT /Sig /Type /Annot /Subtype /Widget /Rect [0 0 0 0] /P 3 0 R >>",
+        "<< /T (nome) /FT /Tx /Type /Annot /Subtype /Widget /Rect [10 100 110 120] /P 3 0 R >>",
+        "<< /Type /Sig /SubFilter /adbe.pkcs7.detached /ByteRange [0 100 200 50] /Contents <3000> >>",
+        "<< /Type /Sig /SubFilter /ETSI.CAdES.detached /ByteRange [0 300 400 80] >>",
+    });
+
+    PdfMemDocument document;
+    document.LoadFromBuffer(bufferview(pdf.data(), pdf.size()));
+    PdfSignatureFieldIndex index(document);
+
+    const std::vector<PdfSignatureFieldInfo>& fields = index.GetFields();
+    expect(fields.size() == 3, "three signature fields, text field skipped");
+    expect(fields.size() == 3 && fields[0].name == "firme.autore" && fields[1].name == "firme.revisore" &&
+           fields[2].name == "legacy", "depth first /Fields order");
+
+    // nomi completi parent.child
+    const PdfSignatureFieldInfo* author = index.Find("firme.autore");
+    expect(author && author->partialName == "autore", "qualified name found");
+    expect(!index.Find("autore") && !index.Find("firme") && !index.Find("nome"), "partial, parent and text names not indexed");
+
+    expect(author && author->widget == author->field, "merged field and widget");
+    expect(author && author->widgetRef == PdfReference(5, 0), "widget reference");
+    expect(author && author->pageIndex == 0 && author->inPageAnnotations, "page from /Annots");
+    expect(author && author->hasRect && author->rect.Width == 100 && author->rect.Height == 50, "widget rect");
+    expect(author && author->value && author->isSigned, "/V in the field");
+    expect(author && author->hasByteRange && author->byteRange[1] == 100 && author->byteRange[2] == 200 &&
+           author->byteRange[3] == 50, "byte range");
+
+    // /V scritto solo nel widget figlio
+    const PdfSignatureFieldInfo* reviewer = index.Find("firme.revisore");
+    expect(reviewer && reviewer->widget != reviewer->field && reviewer->widgetRef == PdfReference(7, 0), "separate widget");
+    expect(reviewer && reviewer->value && reviewer->value->GetDictionary().FindKey("ByteRange"), "/V from the widget");
+    expect(reviewer && !reviewer->isSigned && reviewer->hasByteRange && reviewer->byteRange[3] == 80,
+           "value without /Contents not signed");
+    expect(reviewer && reviewer->hasRect && reviewer->rect.GetLeft() == 200, "rect of the widget");
+
+    const PdfSignatureFieldInfo* legacy = index.Find("legacy");
+    expect(legacy && !legacy->inPageAnnotations && legacy->pageIndex == 0, "page from /P");
+    expect(legacy && !legacy->value && !legacy->isSigned && !legacy->hasByteRange, "empty signature field");
+
+    const std::vector<const PdfSignatureFieldInfo*>& signatures = index.GetSignatures();
+    expect(signatures.size() == 2 && signatures[0] == author && signatures[1] == reviewer, "signatures in field order");
+
+    return testResult("pdf_signature_field_index_test");
+}
@@ -0,0 +1,212 @@
+#include "mock_http_server.h"
+#include "ASN1/RevocationResolver.h"
+#include "ASN1/CrlCache.h"
+#include "ASN1/OCSPCache.h"
+#include "HttpClient.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/ocsp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// CA that signs the certificates, the CRL and the OCSP responses.
+struct Issuer : TestIssuer {
+    Issuer() : TestIssuer("Test revocation CA") {}
+
+    // certificato con OCSP (authorityInfoAccess) e CRL (cRLDistributionPoints)
+    std::unique_ptr<CCertificate> issue(long serial, const std::string& ocspUrl, const std::string& crlUrl) const
+    {
+        X509* leaf = X509_new();
+        X509_set_version(leaf, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(leaf), serial);
+        X509_gmtime_adj(X509_getm_notBefore(leaf), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(leaf), 86400);
+        X509_NAME* name = X509_get_subject_name(leaf);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>("Test signer"), -1, -1, 0);
+        X509_set_issuer_name(leaf, X509_get_subject_name(cert));
+        X509_set_pubkey(leaf, key);
+        addExtension(leaf, cert, NID_authority_key_identifier, "keyid:always");
+        addExtension(leaf, cert, NID_info_access, "OCSP;URI:" + ocspUrl);
+        addExtension(leaf, cert, NID_crl_distribution_points, "URI:" + crlUrl);
+        X509_sign(leaf, key, EVP_sha256());
+
+        unsigned char* der = nullptr;
+        int len = i2d_X509(leaf, &der);
+        std::unique_ptr<CCertificate> out(new CCertificate(der, len));
+        OPENSSL_free(der);
+        X509_free(leaf);
+        return out;
+    }
+
+    std::vector<uint8_t> crl(long revokedSerial) const
+    {
+        X509_CRL* crl = X509_CRL_new();
+        X509_CRL_set_version(crl, 1);
+        X509_CRL_set_issuer_name(crl, X509_get_subject_name(cert));
+
+        time_t now = std::time(nullptr);
+        ASN1_TIME* lastUpdate = ASN1_TIME_adj(nullptr, now, 0, -60);
+        ASN1_TIME* nextUpdate = ASN1_TIME_adj(nullptr, now, 0, 3600);
+        X509_CRL_set1_lastUpdate(crl, lastUpdate);
+        X509_CRL_set1_nextUpdate(crl, nextUpdate);
+
+        X509_REVOKED* item = X509_REVOKED_new();
+        ASN1_INTEGER* serial = ASN1_INTEGER_new();
+        ASN1_INTEGER_set(serial, revokedSerial);
+        X509_REVOKED_set_serialNumber(item, serial);
+        X509_REVOKED_set_revocationDate(item, lastUpdate);
+        X509_CRL_add0_revoked(crl, item);
+        ASN1_INTEGER_free(serial);
+        ASN1_TIME_free(lastUpdate);
+        ASN1_TIME_free(nextUpdate);
+
+        X509_CRL_sign(crl, key, EVP_sha256());
+
+        unsigned char* der = nullptr;
+        int len = i2d_X509_CRL(crl, &der);
+        std::vector<uint8_t> out(der, der + (len > 0 ? len : 0));
+        OPENSSL_free(der);
+        X509_CRL_free(crl);
+        return out;
+    }
+
+    // risposta good per la CertID della richiesta
+    std::vector<uint8_t> ocspGood(const std::vector<uint8_t>& body, int* status) const
+    {
+        const unsigned char* p = body.data();
+        OCSP_REQUEST* request = d2i_OCSP_REQUEST(nullptr, &p, static_cast<long>(body.size()));
+        if (!request || OCSP_request_onereq_count(request) != 1) {
+            OCSP_REQUEST_free(request);
+            *status = 400;
+            return {};
+        }
+
+        OCSP_CERTID* id = OCSP_onereq_get0_id(OCSP_request_onereq_get0(request, 0));
+        time_t now = std::time(nullptr);
+        ASN1_TIME* thisUpdate = ASN1_TIME_adj(nullptr, now, 0, 0);
+        ASN1_TIME* nextUpdate = ASN1_TIME_adj(nullptr, now, 0, 3600);
+
+        OCSP_BASICRESP* basic = OCSP_BASICRESP_new();
+        OCSP_basic_add1_status(basic, id, V_OCSP_CERTSTATUS_GOOD, 0, nullptr, thisUpdate, nextUpdate);
+        OCSP_basic_sign(basic, cert, key, EVP_sha256(), nullptr, 0);
+        OCSP_RESPONSE* response = OCSP_response_create(OCSP_RESPONSE_STATUS_SUCCESSFUL, basic);
+
+        unsigned char* der = nullptr;
+        int len = i2d_OCSP_RESPONSE(response, &der);
+        std::vector<uint8_t> out(der, der + (len > 0 ? len : 0));
+
+        OPENSSL_free(der);
+        OCSP_RESPONSE_free(response);
+        OCSP_BASICRESP_free(basic);
+        ASN1_TIME_free(nextUpdate);
+        ASN1_TIME_free(thisUpdate);
+        OCSP_REQUEST_free(request);
+        return out;
+    }
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main()
+{
+    Issuer issuer;
+
+    MockHttpServer server;
+    // tre responder lenti: un secondo ciascuno
+    for (int i = 1; i <= 3; i++)
+        server.setHandler("/ocsp-" + std::to_string(i), [&issuer](const std::vector<uint8_t>& body, int* status) {
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            return issuer.ocspGood(body, status);
+        });
+    server.setHandler("/ocsp-down", [](const std::vector<uint8_t>&, int* status) {
+        *status = 500;
+        return std::vector<uint8_t>();
+    });
+    server.setHandler("/ocsp-hung", [&issuer](const std::vector<uint8_t>& body, int* status) {
+        std::this_thread::sleep_for(std::chrono::seconds(3));
+        return issuer.ocspGood(body, status);
+    });
+    server.setResource("/crl", issuer.crl(0x304));
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the HTTP stand-in\n");
+        return 1;
+    }
+    const std::string crlUrl = server.url("/crl");
+
+    // catena di tre certificati con responder diversi: il tempo e' quello del piu' lento
+    std::vector<std::unique_ptr<CCertificate> > chain;
+    for (int i = 1; i <= 3; i++)
+        chain.push_back(issuer.issue(0x300 + i, server.url("/ocsp-" + std::to_string(i)), crlUrl));
+
+    REVOCATION_INFO info[3];
+    CRevocationResolver resolver(nullptr);
+    for (int i = 0; i < 3; i++)
+        expect(resolver.add(*chain[i], &info[i]) == i, "certificate index");
+
+    auto start = std::chrono::steady_clock::now();
+    resolver.resolve();
+    double elapsed = secondsSince(start);
+
+    bool allGood = resolver.size() == 3;
+    for (int i = 0; i < 3; i++)
+        allGood = resolver.getStatus(i) == REVOCATION_STATUS_GOOD && info[i].nType == TYPE_OCSP &&
+                  info[i].nRevocationStatus == REVOCATION_STATUS_GOOD && allGood;
+    expect(allGood, "good status from every responder");
+    expect(elapsed < 2.5, "responders queried in parallel");
+    for (int i = 1; i <= 3; i++)
+        expect(server.requestCount("/ocsp-" + std::to_string(i)) == 1, "one request per responder");
+
+    // responder in errore: si ripiega sulla CRL
+    std::unique_ptr<CCertificate> revoked = issuer.issue(0x304, server.url("/ocsp-down"), crlUrl);
+    REVOCATION_INFO revokedInfo;
+    CRevocationResolver fallback(nullptr);
+    fallback.add(*revoked, &revokedInfo);
+    fallback.resolve();
+    expect(fallback.getStatus(0) == REVOCATION_STATUS_REVOKED, "revoked status from the CRL");
+    expect(revokedInfo.nType == TYPE_CRL, "CRL reported as the source");
+
+    // responder che non risponde: la richiesta scade e si usa la CRL
+    CRevocationResolver::SetTimeout(1);
+    std::unique_ptr<CCertificate> hung = issuer.issue(0x305, server.url("/ocsp-hung"), crlUrl);
+    std::unique_ptr<CCertificate> fast = issuer.issue(0x306, server.url("/ocsp-1"), crlUrl);
+    CRevocationResolver timeout(nullptr);
+    timeout.add(*hung, nullptr);
+    timeout.add(*fast, nullptr);
+    start = std::chrono::steady_clock::now();
+    timeout.resolve();
+    elapsed = secondsSince(start);
+    expect(timeout.getStatus(0) == REVOCATION_STATUS_GOOD, "good status from the CRL after the timeout");
+    expect(timeout.getStatus(1) == REVOCATION_STATUS_GOOD, "good status next to a hung responder");
+    expect(elapsed < 2.5, "timeout honoured");
+    CRevocationResolver::SetTimeout(REVOCATION_DEFAULT_TIMEOUT);
+
+    // nessun certificato
+    CRevocationResolver empty(nullptr);
+    empty.resolve();
+    expect(empty.size() == 0, "empty resolver");
+
+    COCSPCache::CleanUp();
+    CCrlCache::CleanUp();
+    CHttpClient::CleanUp();
+    server.stop();
+
+    return testResult("revocation_resolver_test");
+}
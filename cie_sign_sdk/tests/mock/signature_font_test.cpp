@@ -0,0 +1,248 @@
+#include "SignatureFont.h"
+#include "test_support.h"
+
+#include "cryptopp/filters.h"
+#include "cryptopp/zlib.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+void put16(std::vector<uint8_t>& out, uint16_t value)
+{
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+void put32(std::vector<uint8_t>& out, uint32_t value)
+{
+    put16(out, static_cast<uint16_t>(value >> 16));
+    put16(out, static_cast<uint16_t>(value));
+}
+
+uint16_t get16(const std::vector<uint8_t>& data, size_t offset)
+{
+    return static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+}
+
+uint32_t get32(const std::vector<uint8_t>& data, size_t offset)
+{
+    return (static_cast<uint32_t>(get16(data, offset)) << 16) | get16(data, offset + 2);
+}
+
+// simple glyph: one contour, the rest is filler tagged with the glyph id
+std::vector<uint8_t> simpleGlyph(uint8_t id)
+{
+    std::vector<uint8_t> glyph;
+    put16(glyph, 1);
+    for (int i = 0; i < 10; i++)
+        glyph.push_back(id);
+    return glyph;
+}
+
+// Minimal TrueType font: .notdef, A, B, Aacute (A + acute), acute, Z.
+// 2048 units per em, short loca, cmap format 4.
+std::vector<uint8_t> buildFont()
+{
+    std::vector<std::vector<uint8_t>> glyphs = {
+        simpleGlyph(0), simpleGlyph(1), simpleGlyph(2), {}, simpleGlyph(4), simpleGlyph(5)
+    };
+    std::vector<uint8_t>& composite = glyphs[3];
+    put16(composite, 0xFFFF);
+    for (int i = 0; i < 8; i++)
+        composite.push_back(0);
+    put16(composite, 0x0001 | 0x0020); // ARG_1_AND_2_ARE_WORDS | MORE_COMPONENTS
+    put16(composite, 1);
+    put32(composite, 0);
+    put16(composite, 0x0000);
+    put16(composite, 4);
+    put16(composite, 0);
+
+    std::vector<uint8_t> glyf, loca;
+    for (auto& glyph : glyphs) {
+        put16(loca, static_cast<uint16_t>(glyf.size() / 2));
+        glyf.insert(glyf.end(), glyph.begin(), glyph.end());
+        if (glyf.size() % 2)
+            glyf.push_back(0);
+    }
+    put16(loca, static_cast<uint16_t>(glyf.size() / 2));
+
+    std::vector<uint8_t> head(54, 0);
+    head[18] = 0x08; // unitsPerEm 2048
+    head[50] = 0;    // short loca
+    std::vector<uint8_t> hhea(36, 0);
+    hhea[4] = 0x06; // ascender 1536
+    hhea[6] = 0xFE; // descender -512
+    hhea[35] = 6;
+    std::vector<uint8_t> maxp;
+    put32(maxp, 0x00005000);
+    put16(maxp, 6);
+    std::vector<uint8_t> hmtx;
+    for (uint16_t advance : { 1024, 2048, 1229, 2048, 500, 1000 }) {
+        put16(hmtx, advance);
+        put16(hmtx, 0);
+    }
+
+    // segments: A-B -> 1-2, Z -> 5, U+00C1 -> 3, 0xFFFF
+    std::vector<uint8_t> cmap;
+    put16(cmap, 0);
+    put16(cmap, 1);
+    put16(cmap, 3);
+    put16(cmap, 1);
+    put32(cmap, 12);
+    put16(cmap, 4);
+    put16(cmap, 16 + 4 * 8);
+    put16(cmap, 0);
+    put16(cmap, 8);
+    put16(cmap, 8);
+    put16(cmap, 2);
+    put16(cmap, 0);
+    for (uint16_t end : { 0x42, 0x5A, 0xC1, 0xFFFF })
+        put16(cmap, end);
+    put16(cmap, 0);
+    for (uint16_t start : { 0x41, 0x5A, 0xC1, 0xFFFF })
+        put16(cmap, start);
+    for (uint16_t delta : { static_cast<uint16_t>(1 - 0x41), static_cast<uint16_t>(5 - 0x5A),
+                            static_cast<uint16_t>(3 - 0xC1), static_cast<uint16_t>(1) })
+        put16(cmap, delta);
+    for (int i = 0; i < 4; i++)
+        put16(cmap, 0);
+
+    std::vector<std::pair<const char*, std::vector<uint8_t>*>> tables = {
+        { "cmap", &cmap }, { "glyf", &glyf }, { "head", &head }, { "hhea", &hhea },
+        { "hmtx", &hmtx }, { "loca", &loca }, { "maxp", &maxp }
+    };
+    std::vector<uint8_t> font;
+    put32(font, 0x00010000);
+    put16(font, static_cast<uint16_t>(tables.size()));
+    put16(font, 64);
+    put16(font, 2);
+    put16(font, static_cast<uint16_t>(tables.size() * 16 - 64));
+    uint32_t offset = static_cast<uint32_t>(12 + tables.size() * 16);
+    for (auto& table : tables) {
+        font.insert(font.end(), table.first, table.first + 4);
+        put32(font, 0);
+        put32(font, offset);
+        put32(font, static_cast<uint32_t>(table.second->size()));
+        offset += static_cast<uint32_t>((table.second->size() + 3) & ~size_t(3));
+    }
+    for (auto& table : tables) {
+        font.insert(font.end(), table.second->begin(), table.second->end());
+        font.resize((font.size() + 3) & ~size_t(3), 0);
+    }
+    return font;
+}
+
+bool writeFile(const char* path, const std::vector<uint8_t>& data)
+{
+    FILE* f = std::fopen(path, "wb");
+    if (!f)
+        return false;
+    bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size();
+    std::fclose(f);
+    return ok;
+}
+
+std::vector<uint8_t> inflate(const std::vector<uint8_t>& data)
+{
+    std::vector<uint8_t> out;
+    try {
+        CryptoPP::ZlibDecompressor decompressor(new CryptoPP::VectorSink(out));
+        decompressor.Put(data.data(), data.size());
+        decompressor.MessageEnd();
+    } catch (const CryptoPP::Exception&) {
+        return {};
+    }
+    return out;
+}
+
+// offset of a table in the subset, 0 if missing
+size_t findTable(const std::vector<uint8_t>& font, const char* tag, size_t* length)
+{
+    uint16_t tables = get16(font, 4);
+    for (uint16_t i = 0; i < tables; i++) {
+        size_t record = 12 + i * 16;
+        if (std::memcmp(&font[record], tag, 4) == 0) {
+            *length = get32(font, record + 12);
+            return get32(font, record + 8);
+        }
+    }
+    return 0;
+}
+
+} // namespace
+
+int main()
+{
+    const char* path = "signature_font_test.ttf";
+    const char* garbagePath = "signature_font_test.bin";
+    expect(writeFile(path, buildFont()), "write test font");
+    expect(writeFile(garbagePath, std::vector<uint8_t>(64, 'x')), "write garbage");
+
+    expect(!CSignatureFont::load("missing-font.ttf"), "missing file");
+    expect(!CSignatureFont::load(garbagePath), "not a TrueType font");
+
+    std::shared_ptr<const CSignatureFont> font = CSignatureFont::load(path);
+    expect(font != nullptr, "load");
+    if (!font)
+        return 1;
+    // il file non viene piu' letto: stessa istanza anche se nel frattempo e' cambiato
+    expect(writeFile(path, std::vector<uint8_t>(64, 'x')), "overwrite test font");
+    expect(CSignatureFont::load(path) == font, "parsed once per process");
+
+    expect(font->glyph('A') == 1 && font->glyph('B') == 2 && font->glyph(0xC1) == 3 && font->glyph('Z') == 5,
+           "cmap format 4");
+    expect(font->glyph('q') == 0 && font->glyph(0x1F600) == 0, "missing characters map to .notdef");
+    expect(font->advance(1) == 1000 && font->advance(2) == 600, "advances in thousandths of an em");
+    expect(font->ascent() == 750 && font->descent() == -250, "vertical metrics");
+
+    std::vector<uint32_t> text = CSignatureFont::codePoints("A\xC3\x81\xF0\x9F\x98\x80\xFF");
+    expect(text.size() == 4 && text[0] == 'A' && text[1] == 0xC1 && text[2] == 0x1F600 && text[3] == 0xFFFD,
+           "UTF-8 decoding");
+    expect(font->textWidth(CSignatureFont::codePoints("AB")) == 1600, "text width");
+
+    std::shared_ptr<const CSignatureFont::Subset> subset = font->subset(CSignatureFont::codePoints("\xC3\x81" "B"));
+    expect(subset != nullptr, "subset");
+    if (!subset)
+        return 1;
+    expect(subset->key == "0,1,2,3,4", "composite components included");
+    expect(subset->tag.size() == 6, "subset tag");
+    expect(font->subset(CSignatureFont::codePoints("B\xC3\x81")) == subset, "cached by glyph set");
+    expect(font->subset(CSignatureFont::codePoints("A")) != subset, "other glyph set");
+
+    std::vector<uint8_t> data = inflate(subset->fontFile);
+    expect(data.size() == subset->nLength1 && data.size() > 12, "FontFile2 stream");
+    if (data.size() > 12) {
+        uint32_t sum = 0;
+        for (size_t i = 0; i + 4 <= data.size(); i += 4)
+            sum += get32(data, i);
+        expect(sum == 0xB1B0AFBA, "checksum adjustment");
+
+        size_t headLength = 0, locaLength = 0, cmapLength = 0;
+        size_t head = findTable(data, "head", &headLength);
+        size_t loca = findTable(data, "loca", &locaLength);
+        expect(head && get16(data, head + 50) == 1, "long loca");
+        expect(loca && locaLength == 7 * 4, "glyph ids kept");
+        expect(findTable(data, "cmap", &cmapLength) == 0, "cmap dropped");
+        if (loca && locaLength == 7 * 4) {
+            bool used = true;
+            for (int glyph = 0; glyph <= 4; glyph++)
+                used = used && get32(data, loca + (glyph + 1) * 4) > get32(data, loca + glyph * 4);
+            expect(used, "used glyphs copied");
+            expect(get32(data, loca + 6 * 4) == get32(data, loca + 5 * 4), "unused glyph emptied");
+        }
+    }
+
+    expect(subset->toUnicode.find("<0003> <00C1>") != std::string::npos &&
+           subset->toUnicode.find("<0002> <0042>") != std::string::npos, "ToUnicode");
+    expect(subset->widths.size() == 5 && subset->widths[3].first == 3 && subset->widths[3].second == 1000,
+           "widths");
+
+    std::remove(path);
+    std::remove(garbagePath);
+
+    return testResult("signature_font_test");
+}
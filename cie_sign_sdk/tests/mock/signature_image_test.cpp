@@ -0,0 +1,117 @@
+#include "SignatureImage.h"
+#include "test_support.h"
+
+#include "cryptopp/filters.h"
+#include "cryptopp/zlib.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> inflate(const std::vector<uint8_t>& data, size_t expected)
+{
+    std::vector<uint8_t> out;
+    try {
+        CryptoPP::ZlibDecompressor decompressor(new CryptoPP::VectorSink(out));
+        decompressor.Put(data.data(), data.size());
+        decompressor.MessageEnd();
+    } catch (const CryptoPP::Exception&) {
+        return {};
+    }
+    return out.size() == expected ? out : std::vector<uint8_t>();
+}
+
+// Signature pad capture: dark strokes on a transparent background.
+std::vector<uint8_t> padCapture(uint32_t width, uint32_t height, bool antialiased)
+{
+    std::vector<uint8_t> rgba(static_cast<size_t>(width) * height * 4, 0);
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t* p = &rgba[(static_cast<size_t>(y) * width + x) * 4];
+            // transparent pixels carry garbage colour
+            p[0] = static_cast<uint8_t>(x);
+            p[1] = static_cast<uint8_t>(y);
+            p[2] = 77;
+            long wave = static_cast<long>(height / 2 + (height / 4) * ((x / 40) % 2 ? 1 : -1) * (x % 40) / 40);
+            long distance = std::labs(static_cast<long>(y) - wave);
+            if (distance < 6) {
+                p[0] = p[1] = p[2] = 0x10;
+                p[3] = antialiased && distance == 5 ? 0x80 : 0xFF;
+            }
+        }
+    }
+    return rgba;
+}
+
+} // namespace
+
+int main()
+{
+    uint32_t width = 0, height = 0;
+    CSignatureImage::targetSize(144, 72, 200, &width, &height);
+    expect(width == 400 && height == 200, "widget pixels at 200 dpi");
+    CSignatureImage::targetSize(144, 72, 0, &width, &height);
+    expect(width == 400 && height == 200, "default resolution");
+    CSignatureImage::targetSize(0.1, 0.1, 72, &width, &height);
+    expect(width == 1 && height == 1, "at least one pixel");
+    CSignatureImage::targetSize(1e12, -5, 72, &width, &height);
+    expect(width == UINT32_MAX && height == 1, "size clamped to the uint32_t range");
+
+    // 2000x800 RGBA (6.4 MB) in un riquadro di 5 x 2 cm
+    std::vector<uint8_t> capture = padCapture(2000, 800, true);
+    CSignatureImage image(capture.data(), 2000, 800);
+    CSignatureImage::targetSize(141.7, 56.7, 200, &width, &height);
+    image.downsample(width, height);
+    expect(image.width() == width && image.height() == height, "downsampled to the widget");
+    expect(image.encode() == 0, "encode");
+    expect(image.components() == 1, "monochrome capture becomes grey");
+    // alpha-weighted averaging keeps the stroke colour: shading is left to the soft mask
+    expect(image.bitsPerComponent() == 1, "single-colour strokes become 1 bit");
+    expect(!image.softMask().empty(), "alpha split into a soft mask");
+    expect(image.data().size() + image.softMask().size() < capture.size() / 100, "far smaller than the capture");
+
+    size_t row = (width + 7) / 8;
+    std::vector<uint8_t> bits = inflate(image.data(), row * height);
+    std::vector<uint8_t> alpha = inflate(image.softMask(), static_cast<size_t>(width) * height);
+    expect(bits.size() == row * height, "1 bit rows padded to bytes");
+    expect(alpha.size() == static_cast<size_t>(width) * height, "alpha samples");
+    bool fringes = false, background = true, shaded = false;
+    for (uint32_t y = 0; y < height && bits.size() == row * height && alpha.size() == static_cast<size_t>(width) * height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            bool white = (bits[y * row + x / 8] & (0x80 >> (x % 8))) != 0;
+            uint8_t a = alpha[static_cast<size_t>(y) * width + x];
+            if (a > 0 && white)
+                fringes = true;
+            if (a == 0 && !white)
+                background = false;
+            if (a > 0 && a < 0xFF)
+                shaded = true;
+        }
+    }
+    expect(!fringes, "stroke colour not mixed with the transparent background");
+    expect(shaded, "averaged edges kept in the soft mask");
+    expect(background, "transparent pixels stored as white");
+
+    // grigi intermedi opachi: 8 bit
+    std::vector<uint8_t> shades(64 * 32 * 4, 0xFF);
+    for (size_t i = 0; i < shades.size(); i += 4)
+        shades[i] = shades[i + 1] = shades[i + 2] = static_cast<uint8_t>(i / 4);
+    CSignatureImage grey(shades.data(), 64, 32);
+    grey.downsample(1000, 1000);
+    expect(grey.width() == 64 && grey.height() == 32, "never enlarged");
+    expect(grey.encode() == 0 && grey.components() == 1 && grey.bitsPerComponent() == 8, "grey shades keep 8 bits");
+    expect(inflate(grey.data(), 64 * 32).size() == 64 * 32, "grey samples");
+
+    // colore e immagine opaca
+    std::vector<uint8_t> color(16 * 16 * 4, 0xFF);
+    for (size_t i = 0; i < color.size(); i += 4)
+        color[i] = static_cast<uint8_t>(i);
+    CSignatureImage rgb(color.data(), 16, 16);
+    expect(rgb.encode() == 0 && rgb.components() == 3 && rgb.bitsPerComponent() == 8, "colour kept as RGB");
+    expect(rgb.softMask().empty(), "opaque image has no soft mask");
+    expect(inflate(rgb.data(), 16 * 16 * 3).size() == 16 * 16 * 3, "RGB samples");
+
+    return testResult("signature_image_test");
+}
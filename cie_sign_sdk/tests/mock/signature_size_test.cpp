@@ -0,0 +1,161 @@
+#include "SignatureGenerator.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/pkcs7.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Signer holding a software key and a self-signed certificate.
+class KeySigner : public CBaseSigner
+{
+public:
+    int certificateReads = 0;
+
+    KeySigner(int bits, const std::string& issuer)
+    {
+        key_ = makeRsaKey(bits);
+
+        X509* x509 = X509_new();
+        X509_set_version(x509, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(x509), 0x7f123456);
+        X509_gmtime_adj(X509_getm_notBefore(x509), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(x509), 86400);
+        X509_NAME* name = X509_get_subject_name(x509);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_UTF8,
+                                   reinterpret_cast<const unsigned char*>(issuer.c_str()), -1, -1, 0);
+        X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>("Signature Size Test"), -1, -1, 0);
+        X509_set_issuer_name(x509, name);
+        X509_set_pubkey(x509, key_);
+        X509_sign(x509, key_, EVP_sha256());
+
+        unsigned char* der = nullptr;
+        int len = i2d_X509(x509, &der);
+        certificate_.append(der, len);
+        OPENSSL_free(der);
+        X509_free(x509);
+    }
+
+    ~KeySigner() { EVP_PKEY_free(key_); }
+
+    const UUCByteArray& certificate() const { return certificate_; }
+
+    long GetCertificate(const char*, CCertificate** ppCertificate, UUCByteArray& id) override
+    {
+        certificateReads++;
+        id.append((BYTE)'1');
+        *ppCertificate = new CCertificate(certificate_.getContent(), certificate_.getLength());
+        return CKR_OK;
+    }
+
+    long Sign(UUCByteArray& data, UUCByteArray&, int, UUCByteArray& signature) override
+    {
+        EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(key_, nullptr);
+        EVP_PKEY_sign_init(ctx);
+        EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING);
+        std::vector<unsigned char> buffer(EVP_PKEY_size(key_));
+        size_t len = buffer.size();
+        int ok = EVP_PKEY_sign(ctx, buffer.data(), &len, data.getContent(), data.getLength());
+        EVP_PKEY_CTX_free(ctx);
+        if (ok <= 0)
+            return CKR_FUNCTION_FAILED;
+        signature.append(buffer.data(), static_cast<unsigned int>(len));
+        return CKR_OK;
+    }
+
+    long Close() override { return 0; }
+
+private:
+    EVP_PKEY* key_ = nullptr;
+    UUCByteArray certificate_;
+};
+
+// numero di signerInfo della CMS, -1 se non e' una SignedData valida
+int signerCount(const UUCByteArray& cms)
+{
+    const unsigned char* p = cms.getContent();
+    PKCS7* pkcs7 = d2i_PKCS7(nullptr, &p, cms.getLength());
+    if (!pkcs7)
+        return -1;
+    int count = PKCS7_type_is_signed(pkcs7) ? sk_PKCS7_SIGNER_INFO_num(PKCS7_get_signer_info(pkcs7)) : -1;
+    PKCS7_free(pkcs7);
+    return count;
+}
+
+void checkPrediction(int bits, const std::string& issuer, int hashAlgo, const char* what)
+{
+    KeySigner signer(bits, issuer);
+    CSignatureGenerator generator(&signer);
+    generator.SetHashAlgo(hashAlgo);
+
+    size_t predicted = 0;
+    expect(generator.GetSignatureSize(&predicted) == 0 && predicted > 0, what);
+
+    UUCByteArray data;
+    data.append(reinterpret_cast<const BYTE*>("%PDF-1.7 byte range"), 19);
+    generator.SetData(data);
+    UUCByteArray cms;
+    expect(generator.Generate(cms, TRUE, FALSE) == 0, what);
+    expect(signerCount(cms) == 1, what);
+
+    size_t actual = cms.getLength();
+    if (actual > predicted || predicted - actual > 64) {
+        std::fprintf(stderr, "%s: predicted %zu actual %zu\n", what, predicted, actual);
+        expect(false, what);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    checkPrediction(2048, "Signer", CKM_SHA256_RSA_PKCS, "RSA 2048 SHA-256");
+    checkPrediction(2048, "Signer", CKM_SHA1_RSA_PKCS, "RSA 2048 SHA-1");
+    checkPrediction(4096, "Signer", CKM_SHA256_RSA_PKCS, "RSA 4096");
+    checkPrediction(1024, std::string(200, 'x'), CKM_SHA256_RSA_PKCS, "long issuer name");
+
+    KeySigner signer(2048, "Signer");
+    const UUCByteArray& certificate = signer.certificate();
+    size_t bare = CSignatureGenerator::PredictSignatureSize(certificate, {}, CKM_SHA256_RSA_PKCS, 0);
+    size_t stamped = CSignatureGenerator::PredictSignatureSize(certificate, {}, CKM_SHA256_RSA_PKCS, 5000);
+    expect(stamped >= bare + 5000 && stamped <= bare + 5000 + 32, "timestamp token accounted");
+    std::vector<UUCByteArray> chain(2, certificate);
+    size_t withChain = CSignatureGenerator::PredictSignatureSize(certificate, chain, CKM_SHA256_RSA_PKCS, 0);
+    expect(withChain >= bare + 2 * certificate.getLength(), "chain accounted");
+    UUCByteArray garbage;
+    garbage.append(reinterpret_cast<const BYTE*>("not a certificate"), 17);
+    expect(CSignatureGenerator::PredictSignatureSize(garbage, {}, CKM_SHA256_RSA_PKCS, 0) == 0, "invalid certificate");
+
+    // stesso generatore per piu' firme: certificato letto una volta, Reset tra una firma e l'altra
+    CSignatureGenerator generator(&signer);
+    generator.SetHashAlgo(CKM_SHA256_RSA_PKCS);
+    size_t predicted = 0;
+    generator.GetSignatureSize(&predicted);
+
+    UUCByteArray data;
+    data.append(reinterpret_cast<const BYTE*>("first"), 5);
+    generator.SetData(data);
+    UUCByteArray first;
+    expect(generator.Generate(first, TRUE, FALSE) == 0, "first signature");
+
+    generator.Reset();
+    generator.SetData(data);
+    UUCByteArray second;
+    expect(generator.Generate(second, TRUE, FALSE) == 0, "second signature");
+    expect(signerCount(second) == 1, "reset drops the previous signerInfo");
+    expect(second.getLength() <= predicted, "second signature within the prediction");
+    expect(signer.certificateReads == 1, "certificate read once");
+
+    generator.SetAlias(const_cast<char*>("other"));
+    generator.GetSignatureSize(&predicted);
+    expect(signer.certificateReads == 2, "alias change reads the certificate again");
+
+    return testResult("signature_size_test");
+}
@@ -0,0 +1,401 @@
+#include "SignedDataPatcher.h"
+#include "ASN1/ASN1Exception.h"
+#include "definitions.h"
+#include "test_support.h"
+
+#include <openssl/bio.h>
+#include <openssl/cms.h>
+#include <openssl/objects.h>
+#include <openssl/x509.h>
+
+#include <cstdio>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+const char* const kTimestampTokenOid = "1.2.840.113549.1.9.16.2.14";
+
+Bytes cat(std::initializer_list<Bytes> parts)
+{
+    Bytes out;
+    for (const Bytes& part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
+
+// DER: lunghezza nella forma piu' breve
+Bytes tlv(uint8_t tag, const Bytes& content)
+{
+    Bytes out(1, tag);
+    size_t len = content.size();
+    if (len < 0x80) {
+        out.push_back(static_cast<uint8_t>(len));
+    } else {
+        Bytes digits;
+        for (; len; len >>= 8)
+            digits.insert(digits.begin(), static_cast<uint8_t>(len));
+        out.push_back(static_cast<uint8_t>(0x80 | digits.size()));
+        out.insert(out.end(), digits.begin(), digits.end());
+    }
+    out.insert(out.end(), content.begin(), content.end());
+    return out;
+}
+
+// BER: lunghezza indefinita chiusa da EOC
+Bytes indefinite(uint8_t tag, const Bytes& content)
+{
+    return cat({ { tag, 0x80 }, content, { 0x00, 0x00 } });
+}
+
+Bytes oid(const char* text)
+{
+    ASN1_OBJECT* object = OBJ_txt2obj(text, 1);
+    unsigned char* der = nullptr;
+    int len = i2d_ASN1_OBJECT(object, &der);
+    Bytes out(der, der + (len > 0 ? len : 0));
+    OPENSSL_free(der);
+    ASN1_OBJECT_free(object);
+    return out;
+}
+
+Bytes algorithm(const char* text)
+{
+    return tlv(0x30, cat({ oid(text), { 0x05, 0x00 } }));
+}
+
+// Attribute ::= SEQUENCE { OID, SET { value } }
+Bytes attribute(const char* type, const Bytes& value)
+{
+    return tlv(0x30, cat({ oid(type), tlv(0x31, value) }));
+}
+
+Bytes timestampAttribute(uint8_t marker)
+{
+    return attribute(kTimestampTokenOid, tlv(0x30, { 0x02, 0x01, marker }));
+}
+
+// SignerInfo con firma fittizia di signatureLen byte; unsignedAttrs e' il contenuto di [1]
+Bytes signerInfo(size_t signatureLen, const Bytes& unsignedAttrs = Bytes(), uint8_t serial = 1)
+{
+    Bytes name = tlv(0x30, tlv(0x31, tlv(0x30, cat({ oid("2.5.4.3"), tlv(0x0C, { 'C', 'A' }) }))));
+    Bytes content = cat({
+        { 0x02, 0x01, 0x01 },
+        tlv(0x30, cat({ name, { 0x02, 0x01, serial } })),
+        algorithm("2.16.840.1.101.3.4.2.1"),
+        algorithm("1.2.840.113549.1.1.1"),
+        tlv(0x04, Bytes(signatureLen, 0xAB)),
+    });
+    if (!unsignedAttrs.empty())
+        content = cat({ content, tlv(0xA1, unsignedAttrs) });
+    return tlv(0x30, content);
+}
+
+size_t contentLength(const Bytes& der)
+{
+    if (der[1] < 0x80)
+        return der[1];
+    size_t len = 0;
+    for (size_t i = 0; i < static_cast<size_t>(der[1] & 0x7F); i++)
+        len = (len << 8) | der[2 + i];
+    return len;
+}
+
+// firma fittizia per un SignerInfo il cui contenuto sta in (limit - margin, limit]
+size_t signatureLengthBelow(size_t limit, size_t margin)
+{
+    for (size_t n = 0; n < 1024; n++) {
+        size_t len = contentLength(signerInfo(n));
+        if (len > limit - margin && len <= limit)
+            return n;
+    }
+    return 0;
+}
+
+// ContentInfo { signedData, [0] SignedData } senza contenuto incapsulato
+Bytes signedData(const Bytes& signerInfos, const Bytes& certificates, bool indefiniteLength)
+{
+    Bytes body = cat({
+        { 0x02, 0x01, 0x01 },
+        tlv(0x31, algorithm("2.16.840.1.101.3.4.2.1")),
+        tlv(0x30, oid("1.2.840.113549.1.7.1")),
+        certificates.empty() ? Bytes() : tlv(0xA0, certificates),
+        tlv(0x31, signerInfos),
+    });
+    if (indefiniteLength)
+        return indefinite(0x30, cat({ oid("1.2.840.113549.1.7.2"), indefinite(0xA0, indefinite(0x30, body)) }));
+    return tlv(0x30, cat({ oid("1.2.840.113549.1.7.2"), tlv(0xA0, tlv(0x30, body)) }));
+}
+
+CASN1Object object(const Bytes& der)
+{
+    return CASN1Object(UUCByteArray(der.data(), der.size()));
+}
+
+Bytes patched(CSignedDataPatcher& patcher)
+{
+    UUCByteArray out;
+    patcher.toByteArray(out);
+    return Bytes(out.getContent(), out.getContent() + out.getLength());
+}
+
+Bytes der(X509* cert)
+{
+    unsigned char* p = nullptr;
+    int len = i2d_X509(cert, &p);
+    Bytes out(p, p + (len > 0 ? len : 0));
+    OPENSSL_free(p);
+    return out;
+}
+
+// il risultato deve essere una ContentInfo che OpenSSL legge
+CMS_ContentInfo* parse(const Bytes& data)
+{
+    const unsigned char* p = data.data();
+    CMS_ContentInfo* cms = d2i_CMS_ContentInfo(nullptr, &p, static_cast<long>(data.size()));
+    if (cms && p != data.data() + data.size()) {
+        CMS_ContentInfo_free(cms);
+        return nullptr;
+    }
+    return cms;
+}
+
+int unsignedAttributes(CMS_ContentInfo* cms, int index)
+{
+    STACK_OF(CMS_SignerInfo)* signers = CMS_get0_SignerInfos(cms);
+    if (!signers || index >= sk_CMS_SignerInfo_num(signers))
+        return -1;
+    // -1 se unsignedAttrs manca
+    int count = CMS_unsigned_get_attr_count(sk_CMS_SignerInfo_value(signers, index));
+    return count < 0 ? 0 : count;
+}
+
+bool parsesWith(const Bytes& data, int signers, int attributes)
+{
+    CMS_ContentInfo* cms = parse(data);
+    bool ok = cms && sk_CMS_SignerInfo_num(CMS_get0_SignerInfos(cms)) == signers &&
+              unsignedAttributes(cms, 0) == attributes;
+    CMS_ContentInfo_free(cms);
+    return ok;
+}
+
+// firma CAdES di OpenSSL sul contenuto, opzionalmente in BER a lunghezza indefinita
+Bytes opensslSignedData(const TestIssuer& signer, unsigned int flags, bool streamed)
+{
+    const std::string content = "contenuto firmato";
+    BIO* in = BIO_new_mem_buf(content.data(), static_cast<int>(content.size()));
+    CMS_ContentInfo* cms = CMS_sign(signer.cert, signer.key, nullptr, in, flags | CMS_BINARY | (streamed ? CMS_STREAM : 0));
+    BIO* out = BIO_new(BIO_s_mem());
+    if (streamed) {
+        BIO_free(in);
+        in = BIO_new_mem_buf(content.data(), static_cast<int>(content.size()));
+        i2d_CMS_bio_stream(out, cms, in, flags | CMS_BINARY | CMS_STREAM);
+    } else {
+        i2d_CMS_bio(out, cms);
+    }
+    char* p = nullptr;
+    long len = BIO_get_mem_data(out, &p);
+    Bytes data(p, p + len);
+    BIO_free(out);
+    BIO_free(in);
+    CMS_ContentInfo_free(cms);
+    return data;
+}
+
+bool verifies(const Bytes& data)
+{
+    CMS_ContentInfo* cms = parse(data);
+    X509_STORE* store = X509_STORE_new();
+    bool ok = cms && CMS_verify(cms, nullptr, store, nullptr, nullptr, CMS_NO_SIGNER_CERT_VERIFY) == 1;
+    X509_STORE_free(store);
+    CMS_ContentInfo_free(cms);
+    return ok;
+}
+
+void testLengthBoundaries()
+{
+    // contenuto del SignerInfo appena sotto 0x80 e 0x100: l'attributo sposta
+    // l'header da 2 a 3 byte e da 3 a 4; tutti gli antenati vanno riscritti
+    const size_t limits[] = { 0x7F, 0xFF };
+    for (size_t limit : limits) {
+        Bytes attr = timestampAttribute(1);
+        size_t n = signatureLengthBelow(limit, attr.size());
+        expect(n != 0, "signer info near the boundary");
+
+        for (int indefiniteLength = 0; indefiniteLength < 2; indefiniteLength++) {
+            Bytes input = signedData(signerInfo(n), Bytes(), indefiniteLength != 0);
+            CSignedDataPatcher patcher(input.data(), input.size());
+            expect(patcher.getSignerInfoCount() == 1, "one signer");
+            patcher.addUnsignedAttribute(0, object(attr));
+            Bytes output = patched(patcher);
+
+            expect(output == signedData(signerInfo(n, attr), Bytes(), indefiniteLength != 0),
+                   indefiniteLength ? "indefinite lengths kept, signer info header grown" : "definite lengths rewritten");
+            expect(parsesWith(output, 1, 1), "patched SignedData parsed by OpenSSL");
+        }
+    }
+
+    // secondo attributo nell'unsignedAttrs ora presente, sul SignerInfo gia' patchato
+    Bytes first = timestampAttribute(1);
+    Bytes second = timestampAttribute(2);
+    Bytes input = signedData(signerInfo(0x90, first), Bytes(), false);
+    CSignedDataPatcher patcher(input.data(), input.size());
+    patcher.addUnsignedAttribute(0, object(second));
+    expect(patched(patcher) == signedData(signerInfo(0x90, cat({ first, second })), Bytes(), false),
+           "attribute appended to existing unsignedAttrs");
+}
+
+void testCountersignature()
+{
+    Bytes counter = signerInfo(0x40, Bytes(), 2);
+    Bytes countersignature = attribute(szCounterSignatureOID, counter);
+    Bytes input = signedData(cat({ signerInfo(0x40), signerInfo(0x40, Bytes(), 3) }), Bytes(), false);
+
+    CSignedDataPatcher patcher(input.data(), input.size());
+    expect(patcher.getSignerInfoCount() == 2, "two signers");
+    UUCByteArray second;
+    patcher.getSignerInfo(1, second);
+    expect(Bytes(second.getContent(), second.getContent() + second.getLength()) == signerInfo(0x40, Bytes(), 3),
+           "original signer info");
+    expect(patcher.addUnsignedAttribute(object(signerInfo(0x40)), object(countersignature)), "countersignature added");
+    Bytes output = patched(patcher);
+    expect(output == signedData(cat({ signerInfo(0x40, countersignature), signerInfo(0x40, Bytes(), 3) }), Bytes(), false),
+           "countersignature in the first signer");
+    expect(parsesWith(output, 2, 1), "countersigned SignedData parsed by OpenSSL");
+
+    // marca sulla controfirma, trovata risalendo gli unsignedAttrs del firmatario
+    Bytes timestamp = timestampAttribute(7);
+    CSignedDataPatcher nested(output.data(), output.size());
+    expect(nested.addUnsignedAttribute(object(counter), object(timestamp)), "countersigner found");
+    expect(!nested.addUnsignedAttribute(object(signerInfo(0x41)), object(timestamp)), "unknown signer info");
+    Bytes stamped = patched(nested);
+    Bytes stampedCounter = attribute(szCounterSignatureOID, signerInfo(0x40, timestamp, 2));
+    expect(stamped == signedData(cat({ signerInfo(0x40, stampedCounter), signerInfo(0x40, Bytes(), 3) }), Bytes(), false),
+           "timestamp in the countersignature");
+    expect(parsesWith(stamped, 2, 1), "timestamped countersignature parsed by OpenSSL");
+
+    // nuovo firmatario e algoritmo di digest, ignorato se gia' presente
+    CSignedDataPatcher added(input.data(), input.size());
+    added.addSignerInfo(object(counter));
+    added.addDigestAlgorithm(object(algorithm("2.16.840.1.101.3.4.2.1")));
+    Bytes withSigner = patched(added);
+    expect(withSigner == signedData(cat({ signerInfo(0x40), signerInfo(0x40, Bytes(), 3), counter }), Bytes(), false),
+           "signer info added");
+    expect(parsesWith(withSigner, 3, 0), "three signers parsed by OpenSSL");
+}
+
+void testCertificates()
+{
+    TestIssuer signer("Test patcher signer");
+    TestIssuer other("Test patcher CA");
+    Bytes cert = der(signer.cert);
+
+    // certificates [0] assente: creato dopo encapContentInfo
+    Bytes input = signedData(signerInfo(0x40), Bytes(), false);
+    CSignedDataPatcher patcher(input.data(), input.size());
+    patcher.addCertificate(object(cert));
+    patcher.addCertificate(object(cert));
+    expect(patched(patcher) == signedData(signerInfo(0x40), cert, false), "certificates created");
+
+    CSignedDataPatcher existing(input.data(), input.size());
+    existing.addCertificate(object(cert));
+    Bytes withCert = patched(existing);
+    CSignedDataPatcher again(withCert.data(), withCert.size());
+    again.addCertificate(object(cert));
+    again.addCertificate(object(der(other.cert)));
+    expect(patched(again) == signedData(signerInfo(0x40), cat({ cert, der(other.cert) }), false),
+           "existing certificate skipped, new one appended");
+
+    // firma OpenSSL senza certificati: verificabile solo dopo l'aggiunta
+    Bytes noCerts = opensslSignedData(signer, CMS_NOCERTS, false);
+    expect(!verifies(noCerts), "signature without the signer certificate");
+    CSignedDataPatcher real(noCerts.data(), noCerts.size());
+    real.addCertificate(object(cert));
+    Bytes output = patched(real);
+    expect(verifies(output), "signer certificate added to an OpenSSL signature");
+    CMS_ContentInfo* cms = parse(output);
+    STACK_OF(X509)* certs = cms ? CMS_get1_certs(cms) : nullptr;
+    expect(certs && sk_X509_num(certs) == 1, "one certificate");
+    sk_X509_pop_free(certs, X509_free);
+    CMS_ContentInfo_free(cms);
+}
+
+void testOpenSslSignatures()
+{
+    TestIssuer signer("Test patcher signer");
+    Bytes attr = timestampAttribute(9);
+
+    // DER e BER a lunghezza indefinita (streaming): l'attributo non firmato non tocca la firma
+    for (int streamed = 0; streamed < 2; streamed++) {
+        Bytes input = opensslSignedData(signer, 0, streamed != 0);
+        expect(verifies(input), "OpenSSL signature");
+        expect(!streamed || input[1] == 0x80, "indefinite length encoding");
+
+        CSignedDataPatcher patcher(input.data(), input.size());
+        patcher.addUnsignedAttribute(0, object(attr));
+        Bytes output = patched(patcher);
+        expect(output.size() > input.size() + attr.size(), "attribute inserted");
+        expect(parsesWith(output, 1, 1), "unsigned attribute parsed by OpenSSL");
+        expect(verifies(output), streamed ? "indefinite length signature still verifies" : "signature still verifies");
+    }
+
+    // sorgente e destinazione su file, come per i .p7m grandi
+    Bytes input = opensslSignedData(signer, 0, false);
+    FILE* source = std::tmpfile();
+    FILE* target = std::tmpfile();
+    std::fwrite(input.data(), 1, input.size(), source);
+    std::rewind(source);
+    CSignedDataPatcher fromFile(source);
+    fromFile.addUnsignedAttribute(0, object(attr));
+    expect(fromFile.writeTo(target) == 0, "written to file");
+
+    CSignedDataPatcher inMemory(input.data(), input.size());
+    inMemory.addUnsignedAttribute(0, object(attr));
+    Bytes expected = patched(inMemory);
+    Bytes written(expected.size() + 1);
+    std::rewind(target);
+    written.resize(std::fread(written.data(), 1, written.size(), target));
+    expect(written == expected, "file output equals buffer output");
+    std::fclose(source);
+    std::fclose(target);
+}
+
+void testMalformed()
+{
+    Bytes input = signedData(signerInfo(0x40), Bytes(), false);
+    Bytes truncated(input.begin(), input.end() - 10);
+    bool thrown = false;
+    try {
+        CSignedDataPatcher patcher(truncated.data(), truncated.size());
+        patcher.getSignerInfoCount();
+    } catch (CASN1ParsingException&) {
+        thrown = true;
+    }
+    expect(thrown, "truncated SignedData rejected");
+
+    Bytes notSignedData = tlv(0x30, { 0x02, 0x01, 0x01 });
+    thrown = false;
+    try {
+        CSignedDataPatcher patcher(notSignedData.data(), notSignedData.size());
+        patcher.getSignerInfoCount();
+    } catch (CASN1ParsingException&) {
+        thrown = true;
+    }
+    expect(thrown, "not a ContentInfo");
+}
+
+} // namespace
+
+int main()
+{
+    testLengthBoundaries();
+    testCountersignature();
+    testCertificates();
+    testOpenSslSignatures();
+    testMalformed();
+
+    return testResult("signed_data_patcher_test");
+}
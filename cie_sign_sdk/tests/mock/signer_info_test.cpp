@@ -0,0 +1,133 @@
+#include "SignedDocument.h"
+#include "ASN1/SignedData.h"
+#include "ASN1/SignerInfo.h"
+#include "ASN1/UUCBufferedReader.h"
+#include "disigonsdk.h"
+#include "test_support.h"
+
+#include <openssl/bio.h>
+#include <openssl/cms.h>
+
+#include <algorithm>
+#include <string>
+
+namespace {
+
+// firma CMS detached (SHA-256, attributi firmati) sul contenuto
+std::string detachedSignature(const TestIssuer& signer, const std::string& content)
+{
+    BIO* in = BIO_new_mem_buf(content.data(), static_cast<int>(content.size()));
+    CMS_ContentInfo* cms = CMS_sign(nullptr, nullptr, nullptr, in, CMS_BINARY | CMS_DETACHED | CMS_PARTIAL);
+    CMS_add1_signer(cms, signer.cert, signer.key, EVP_sha256(), CMS_BINARY);
+    CMS_final(cms, in, nullptr, CMS_BINARY | CMS_DETACHED);
+
+    unsigned char* der = nullptr;
+    int len = i2d_CMS_ContentInfo(cms, &der);
+    std::string data(reinterpret_cast<char*>(der), len > 0 ? len : 0);
+    OPENSSL_free(der);
+    BIO_free(in);
+    CMS_ContentInfo_free(cms);
+    return data;
+}
+
+const BYTE* bytes(const std::string& data, size_t offset = 0)
+{
+    return reinterpret_cast<const BYTE*>(data.data()) + offset;
+}
+
+// octet string costruita con il contenuto a blocchi di 16 byte (contenuto corto: lunghezze in un byte)
+UUCByteArray constructedOctetString(const std::string& content)
+{
+    UUCByteArray chunks;
+    for (size_t offset = 0; offset < content.size(); offset += 16) {
+        size_t len = std::min<size_t>(16, content.size() - offset);
+        const BYTE chunk[] = { 0x04, static_cast<BYTE>(len) };
+        chunks.append(chunk, sizeof(chunk));
+        chunks.append(bytes(content, offset), static_cast<unsigned int>(len));
+    }
+    const BYTE header[] = { 0x24, static_cast<BYTE>(chunks.getLength()) };
+    UUCByteArray encoded(header, sizeof(header));
+    encoded.append(chunks);
+    return encoded;
+}
+
+} // namespace
+
+int main()
+{
+    TestIssuer signer("Test segmented signer");
+
+    // come un PDF: la firma copre tre intervalli del file, i "buchi" non sono firmati
+    const std::string file = "%PDF-1.7 prima parte|<buco 1>|seconda parte del documento|<buco 2>|coda %%EOF";
+    const size_t hole1 = file.find("|<buco 1>|");
+    const size_t second = hole1 + 10;
+    const size_t hole2 = file.find("|<buco 2>|");
+    const size_t third = hole2 + 10;
+
+    CONTENT_SEGMENTS segments;
+    segments.push_back(std::make_pair(bytes(file), hole1));
+    segments.push_back(std::make_pair(bytes(file, second), hole2 - second));
+    segments.push_back(std::make_pair(bytes(file, third), file.size() - third));
+
+    const std::string contiguous = file.substr(0, hole1) + file.substr(second, hole2 - second) + file.substr(third);
+    const std::string signature = detachedSignature(signer, contiguous);
+
+    CSignedDocument signedDocument(bytes(signature), static_cast<int>(signature.size()));
+    CSignedData signedData(signedDocument.getSignedData());
+    CASN1SetOf signerInfos = signedData.getSignerInfos();
+    CSignerInfo signerInfo(signerInfos.elementAt(0));
+    CASN1SetOf certificates = signedData.getCertificates();
+
+    // digest incrementale sui segmenti == digest sul contenuto contiguo
+    int segmented = CSignerInfo::verifySignature(segments, signerInfo, certificates, nullptr, nullptr);
+    CASN1OctetString octetString(UUCByteArray(bytes(contiguous), static_cast<unsigned int>(contiguous.size())));
+    int whole = CSignerInfo::verifySignature(octetString, signerInfo, certificates, nullptr, nullptr);
+    expect(segmented >= 0 && (segmented & VERIFIED_SIGNATURE), "segmented content verified");
+    expect(whole >= 0 && (whole & VERIFIED_SIGNATURE), "contiguous content verified");
+    expect(segmented == whole, "same result for segmented and contiguous content");
+
+    UUCByteArray constructedBytes = constructedOctetString(contiguous);
+    UUCBufferedReader constructedReader(constructedBytes);
+    CASN1OctetString chunked(constructedReader);
+    expect(CSignerInfo::verifySignature(chunked, signerInfo, certificates, nullptr, nullptr) == segmented,
+           "same result for a constructed octet string");
+
+    // il contenuto dei buchi non e' firmato
+    std::string patchedHoles = file;
+    patchedHoles[hole1 + 2] = 'X';
+    patchedHoles[hole2 + 2] = 'X';
+    CONTENT_SEGMENTS holes(segments);
+    holes[0].first = bytes(patchedHoles);
+    holes[1].first = bytes(patchedHoles, second);
+    holes[2].first = bytes(patchedHoles, third);
+    expect(CSignerInfo::verifySignature(holes, signerInfo, certificates, nullptr, nullptr) == segmented, "holes not covered");
+
+    // un byte modificato in un segmento, o i segmenti in un altro ordine, invalidano la firma
+    std::string tampered = file;
+    tampered[second + 3] ^= 0x20;
+    CONTENT_SEGMENTS changed(segments);
+    changed[1].first = bytes(tampered, second);
+    expect(!(CSignerInfo::verifySignature(changed, signerInfo, certificates, nullptr, nullptr) & VERIFIED_SIGNATURE),
+           "tampered segment rejected");
+
+    CONTENT_SEGMENTS swapped(segments);
+    std::swap(swapped[0], swapped[1]);
+    expect(!(CSignerInfo::verifySignature(swapped, signerInfo, certificates, nullptr, nullptr) & VERIFIED_SIGNATURE),
+           "reordered segments rejected");
+
+    // segmenti vuoti (ByteRange con lunghezza zero) non cambiano il digest
+    CONTENT_SEGMENTS withEmpty(segments);
+    withEmpty.insert(withEmpty.begin() + 1, std::make_pair(bytes(file), static_cast<size_t>(0)));
+    expect(CSignerInfo::verifySignature(withEmpty, signerInfo, certificates, nullptr, nullptr) == segmented,
+           "empty segment ignored");
+
+    // octet string costruita con un elemento troncato: errore, non la verifica di un contenuto vuoto
+    const BYTE malformed[] = { 0x24, 0x03, 0x04, 0x05, 0x01 };
+    UUCByteArray malformedBytes(malformed, sizeof(malformed));
+    UUCBufferedReader reader(malformedBytes);
+    CASN1OctetString constructed(reader);
+    expect(CSignerInfo::verifySignature(constructed, signerInfo, certificates, nullptr, nullptr) < 0,
+           "unreadable content is a verification error");
+
+    return testResult("signer_info_test");
+}
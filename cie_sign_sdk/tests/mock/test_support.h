@@ -0,0 +1,89 @@
+#pragma once
+
+// Helpers shared by the ctest executables in tests/mock: failure counting
+// and a throwaway CA built with OpenSSL.
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <cstdio>
+#include <string>
+
+inline int g_failures = 0;
+
+inline void expect(bool condition, const char* what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+        g_failures++;
+    }
+}
+
+// exit code of the test executable
+inline int testResult(const char* name)
+{
+    if (g_failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    std::printf("%s: OK\n", name);
+    return 0;
+}
+
+inline EVP_PKEY* makeRsaKey(int bits = 2048)
+{
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    EVP_PKEY_keygen_init(ctx);
+    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, bits);
+    EVP_PKEY_keygen(ctx, &key);
+    EVP_PKEY_CTX_free(ctx);
+    return key;
+}
+
+inline void addExtension(X509* cert, X509* issuer, int nid, const std::string& value)
+{
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, issuer, cert, nullptr, nullptr, 0);
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &ctx, nid, value.c_str());
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+}
+
+// Self-signed CA (RSA 2048, subjectKeyIdentifier) valid from an hour ago
+// for a day; it signs certificates, CRLs and OCSP responses in the tests.
+struct TestIssuer {
+    EVP_PKEY* key = nullptr;
+    X509* cert = nullptr;
+
+    explicit TestIssuer(const char* commonName)
+    {
+        key = makeRsaKey();
+        cert = X509_new();
+        X509_set_version(cert, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+        X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+        X509_NAME* subject = X509_get_subject_name(cert);
+        X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>(commonName), -1, -1, 0);
+        X509_set_issuer_name(cert, subject);
+        X509_set_pubkey(cert, key);
+        addExtension(cert, cert, NID_subject_key_identifier, "hash");
+        X509_sign(cert, key, EVP_sha256());
+    }
+
+    ~TestIssuer()
+    {
+        X509_free(cert);
+        EVP_PKEY_free(key);
+    }
+
+    X509_NAME* name() const { return X509_get_subject_name(cert); }
+
+    TestIssuer(const TestIssuer&) = delete;
+    TestIssuer& operator=(const TestIssuer&) = delete;
+};
@@ -0,0 +1,219 @@
+#include "TimestampUpgrader.h"
+#include "disigonsdk.h"
+#include "local_tsa.h"
+#include "test_support.h"
+
+#include <openssl/bio.h>
+#include <openssl/cms.h>
+#include <openssl/pkcs7.h>
+#include <openssl/sha.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const kSignatureTimeStampOid = "1.2.840.113549.1.9.16.2.14";
+
+std::string readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::string& data)
+{
+    std::ofstream(path, std::ios::binary) << data;
+}
+
+bool exists(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+// CAdES-BES attached, DER, con uno o piu' firmatari
+std::string signedFile(const std::vector<const TestIssuer*>& signers)
+{
+    const std::string content = "documento da marcare";
+    BIO* in = BIO_new_mem_buf(content.data(), static_cast<int>(content.size()));
+    CMS_ContentInfo* cms = CMS_sign(nullptr, nullptr, nullptr, in, CMS_BINARY | CMS_PARTIAL);
+    for (const TestIssuer* signer : signers)
+        CMS_add1_signer(cms, signer->cert, signer->key, EVP_sha256(), CMS_BINARY);
+    CMS_final(cms, in, nullptr, CMS_BINARY);
+
+    unsigned char* der = nullptr;
+    int len = i2d_CMS_ContentInfo(cms, &der);
+    std::string data(reinterpret_cast<char*>(der), len > 0 ? len : 0);
+    OPENSSL_free(der);
+    BIO_free(in);
+    CMS_ContentInfo_free(cms);
+    return data;
+}
+
+CMS_ContentInfo* parse(const std::string& data)
+{
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data());
+    return d2i_CMS_ContentInfo(nullptr, &p, static_cast<long>(data.size()));
+}
+
+// marca di ogni firmatario: token della TSA, impronta SHA-256 del valore della firma
+int timestampedSigners(const std::string& data, X509* tsaCert)
+{
+    CMS_ContentInfo* cms = parse(data);
+    if (!cms)
+        return -1;
+
+    X509_STORE* store = X509_STORE_new();
+    bool intact = CMS_verify(cms, nullptr, store, nullptr, nullptr, CMS_NO_SIGNER_CERT_VERIFY) == 1;
+    X509_STORE_free(store);
+
+    ASN1_OBJECT* oid = OBJ_txt2obj(kSignatureTimeStampOid, 1);
+    STACK_OF(CMS_SignerInfo)* signers = CMS_get0_SignerInfos(cms);
+    int stamped = 0;
+    for (int i = 0; intact && i < sk_CMS_SignerInfo_num(signers); i++) {
+        CMS_SignerInfo* si = sk_CMS_SignerInfo_value(signers, i);
+        int index = CMS_unsigned_get_attr_by_OBJ(si, oid, -1);
+        if (index < 0)
+            continue;
+
+        ASN1_TYPE* value = X509_ATTRIBUTE_get0_type(CMS_unsigned_get_attr(si, index), 0);
+        if (!value || value->type != V_ASN1_SEQUENCE)
+            continue;
+        const unsigned char* p = value->value.sequence->data;
+        PKCS7* token = d2i_PKCS7(nullptr, &p, value->value.sequence->length);
+        TS_TST_INFO* info = token ? PKCS7_to_TS_TST_INFO(token) : nullptr;
+
+        ASN1_OCTET_STRING* signature = CMS_SignerInfo_get0_signature(si);
+        unsigned char digest[SHA256_DIGEST_LENGTH];
+        SHA256(signature->data, signature->length, digest);
+
+        bool ok = false;
+        if (info) {
+            ASN1_OCTET_STRING* imprint = TS_MSG_IMPRINT_get_msg(TS_TST_INFO_get_msg_imprint(info));
+            ok = imprint->length == SHA256_DIGEST_LENGTH && std::memcmp(imprint->data, digest, SHA256_DIGEST_LENGTH) == 0;
+
+            // token firmato con la chiave della TSA locale
+            STACK_OF(X509)* certs = sk_X509_new_null();
+            sk_X509_push(certs, tsaCert);
+            ok = ok && PKCS7_verify(token, certs, nullptr, nullptr, nullptr, PKCS7_NOINTERN | PKCS7_NOVERIFY) == 1;
+            sk_X509_free(certs);
+        }
+        if (ok)
+            stamped++;
+        TS_TST_INFO_free(info);
+        PKCS7_free(token);
+    }
+
+    ASN1_OBJECT_free(oid);
+    CMS_ContentInfo_free(cms);
+    return intact ? stamped : -1;
+}
+
+const TIMESTAMP_UPGRADE_RESULT* resultFor(const std::vector<TIMESTAMP_UPGRADE_RESULT>& results, const std::string& path)
+{
+    for (const TIMESTAMP_UPGRADE_RESULT& result : results)
+        if (result.szInputPath == path)
+            return &result;
+    return nullptr;
+}
+
+} // namespace
+
+int main()
+{
+    TestIssuer first("Test upgrader signer");
+    TestIssuer second("Test upgrader cosigner");
+    LocalTSAClient tsa(0);
+
+    char dirTemplate[] = "/tmp/timestamp_upgrader_test_XXXXXX";
+    std::string root = mkdtemp(dirTemplate);
+    for (const char* dir : { "/a", "/b", "/c", "/out" })
+        mkdir((root + dir).c_str(), 0700);
+
+    const std::string single = signedFile({ &first });
+    const std::string cosigned = signedFile({ &first, &second });
+    writeFile(root + "/a/x.p7m", single);
+    writeFile(root + "/b/x.p7m", single);
+    writeFile(root + "/c/y.p7m", cosigned);
+    writeFile(root + "/c/z.p7m", single);
+    writeFile(root + "/c/bad.p7m", "not a p7m");
+    expect(timestampedSigners(cosigned, tsa.certificate()) == 0, "CAdES-BES without timestamps");
+
+    // output dir: a/x e b/x finirebbero entrambi su out/x.p7m
+    {
+        CTimestampUpgrader upgrader(tsa);
+        upgrader.setThreads(2, 3);
+        upgrader.setOutputDir((root + "/out").c_str());
+        upgrader.addFile((root + "/a/x.p7m").c_str());
+        upgrader.addFile((root + "/b/x.p7m").c_str());
+        expect(upgrader.addDirectory((root + "/c").c_str()) == 3, "directory scanned");
+
+        std::vector<TIMESTAMP_UPGRADE_RESULT> results;
+        expect(upgrader.run(results) == 3, "collisions and invalid file failed");
+        expect(results.size() == 5, "one result per file");
+
+        const TIMESTAMP_UPGRADE_RESULT* a = resultFor(results, root + "/a/x.p7m");
+        const TIMESTAMP_UPGRADE_RESULT* b = resultFor(results, root + "/b/x.p7m");
+        expect(a && a->nError == (long)DISIGON_ERROR_OUTPUT_CONFLICT && a->nTimestamped == 0, "first colliding file refused");
+        expect(b && b->nError == (long)DISIGON_ERROR_OUTPUT_CONFLICT && b->nTimestamped == 0, "second colliding file refused");
+        expect(!exists(root + "/out/x.p7m") && !exists(root + "/out/x.p7m.tmp"), "colliding output not written");
+
+        const TIMESTAMP_UPGRADE_RESULT* y = resultFor(results, root + "/c/y.p7m");
+        expect(y && y->nError == 0 && y->nTimestamped == 2 && y->nSkipped == 0, "both signers timestamped");
+        expect(y && y->szOutputPath == root + "/out/y.p7m", "output in the output dir");
+        expect(timestampedSigners(readFile(root + "/out/y.p7m"), tsa.certificate()) == 2, "CAdES-T tokens over the signature values");
+        expect(readFile(root + "/c/y.p7m") == cosigned, "input left untouched");
+
+        const TIMESTAMP_UPGRADE_RESULT* z = resultFor(results, root + "/c/z.p7m");
+        expect(z && z->nError == 0 && z->nTimestamped == 1, "single signer timestamped");
+        expect(timestampedSigners(readFile(root + "/out/z.p7m"), tsa.certificate()) == 1, "single signer CAdES-T");
+
+        const TIMESTAMP_UPGRADE_RESULT* bad = resultFor(results, root + "/c/bad.p7m");
+        expect(bad && bad->nError == (long)DISIGON_ERROR_INVALID_FILE, "invalid p7m reported");
+        expect(!exists(root + "/out/bad.p7m"), "no output for the invalid p7m");
+    }
+
+    // sul posto: i firmatari gia' marcati si saltano e il file resta invariato
+    {
+        std::string upgraded = readFile(root + "/out/y.p7m");
+        CTimestampUpgrader upgrader(tsa);
+        upgrader.addFile((root + "/out/y.p7m").c_str());
+        upgrader.addFile((root + "/a/x.p7m").c_str());
+
+        std::vector<TIMESTAMP_UPGRADE_RESULT> results;
+        expect(upgrader.run(results) == 0, "in place upgrade");
+        expect(results[0].nError == 0 && results[0].nTimestamped == 0 && results[0].nSkipped == 2, "timestamped signers skipped");
+        expect(readFile(root + "/out/y.p7m") == upgraded, "already upgraded file unchanged");
+        expect(results[1].nError == 0 && results[1].nTimestamped == 1 && results[1].szOutputPath == root + "/a/x.p7m",
+               "file upgraded in place");
+        expect(timestampedSigners(readFile(root + "/a/x.p7m"), tsa.certificate()) == 1, "in place CAdES-T");
+        expect(!exists(root + "/a/x.p7m.tmp"), "temporary file renamed");
+    }
+
+    // TSA che non risponde: nessun file scritto
+    {
+        CTSAClient unreachable;
+        unreachable.SetTSAUrl("http://127.0.0.1:1/tsa");
+        CTimestampUpgrader upgrader(unreachable);
+        upgrader.setOutputDir((root + "/out").c_str());
+        upgrader.addFile((root + "/b/x.p7m").c_str());
+
+        std::vector<TIMESTAMP_UPGRADE_RESULT> results;
+        expect(upgrader.run(results) == 1 && results[0].nError == (long)DISIGON_ERROR_TSA, "TSA failure reported");
+        expect(!exists(root + "/out/x.p7m"), "no output without a timestamp");
+    }
+
+    std::string cleanup = "rm -rf '" + root + "'";
+    std::system(cleanup.c_str());
+
+    return testResult("timestamp_upgrader_test");
+}
@@ -0,0 +1,378 @@
+#include "mock_http_server.h"
+#include "TrustedList.h"
+#include "CertStore.h"
+#include "HttpClient.h"
+#include "disigonsdk.h"
+#include "test_support.h"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#ifndef CIE_SIGN_SDK_SOURCE_DIR
+#define CIE_SIGN_SDK_SOURCE_DIR "."
+#endif
+
+namespace {
+
+std::vector<uint8_t> loadFixture(const char* path)
+{
+    std::string fullPath = std::string(CIE_SIGN_SDK_SOURCE_DIR) + "/" + path;
+    std::ifstream in(fullPath, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void writeFile(const std::string& path, const std::vector<uint8_t>& data)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+}
+
+std::vector<uint8_t> bytes(const std::string& text)
+{
+    return std::vector<uint8_t>(text.begin(), text.end());
+}
+
+void replaceAll(std::string& text, const std::string& from, const std::string& to)
+{
+    for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+        text.replace(pos, from.size(), to);
+}
+
+X509* toX509(const UUCByteArray& der)
+{
+    const unsigned char* p = der.getContent();
+    return d2i_X509(nullptr, &p, der.getLength());
+}
+
+X509* toX509(const TSL_SERVICE& service)
+{
+    return toX509(service.certificate);
+}
+
+std::string commonName(const TSL_SERVICE& service)
+{
+    X509* x509 = toX509(service);
+    char name[256] = { 0 };
+    X509_NAME_get_text_by_NID(X509_get_subject_name(x509), NID_commonName, name, sizeof(name));
+    X509_free(x509);
+    return name;
+}
+
+// SubjectKeyIdentifier letto da OpenSSL, vuoto se assente
+std::string subjectKeyId(const UUCByteArray& der)
+{
+    X509* x509 = toX509(der);
+    const ASN1_OCTET_STRING* ski = X509_get0_subject_key_id(x509);
+    std::string out = ski ? std::string(reinterpret_cast<const char*>(ASN1_STRING_get0_data(ski)), ASN1_STRING_length(ski)) : "";
+    X509_free(x509);
+    return out;
+}
+
+std::string subjectKeyId(const TSL_SERVICE& service)
+{
+    return subjectKeyId(service.certificate);
+}
+
+const TSL_SERVICE* byName(const std::vector<TSL_SERVICE>& services, const std::string& name)
+{
+    for (const TSL_SERVICE& service : services)
+        if (commonName(service) == name)
+            return &service;
+    return nullptr;
+}
+
+bool sameService(const TSL_SERVICE& a, const TSL_SERVICE& b)
+{
+    return a.nType == b.nType && a.nStatus == b.nStatus && a.nStatusStartingTime == b.nStatusStartingTime &&
+           a.szKeyId == b.szKeyId && a.certificate.getLength() == b.certificate.getLength() &&
+           std::equal(a.certificate.getContent(), a.certificate.getContent() + a.certificate.getLength(),
+                      b.certificate.getContent());
+}
+
+// subject DN (DER) del certificato del servizio
+std::string subjectName(const TSL_SERVICE& service)
+{
+    X509* x509 = toX509(service);
+    unsigned char* der = nullptr;
+    int len = i2d_X509_NAME(X509_get_subject_name(x509), &der);
+    std::string out(reinterpret_cast<char*>(der), len > 0 ? len : 0);
+    OPENSSL_free(der);
+    X509_free(x509);
+    return out;
+}
+
+// certificato emesso (AKI e issuer DN, o solo il DN) da una CA della lista, firmato con una chiave qualunque
+CCertificate issuedBy(const TSL_SERVICE& service, bool withAki = true)
+{
+    X509* issuer = toX509(service);
+    EVP_PKEY* key = makeRsaKey();
+
+    X509* leaf = X509_new();
+    X509_set_version(leaf, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(leaf), 0x500);
+    X509_gmtime_adj(X509_getm_notBefore(leaf), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(leaf), 86400);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(leaf), "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char*>("Test signer"), -1, -1, 0);
+    X509_set_issuer_name(leaf, X509_get_subject_name(issuer));
+    X509_set_pubkey(leaf, key);
+    if (withAki && X509_get0_subject_key_id(issuer))
+        addExtension(leaf, issuer, NID_authority_key_identifier, "keyid:always");
+    X509_sign(leaf, key, EVP_sha256());
+
+    unsigned char* der = nullptr;
+    int len = i2d_X509(leaf, &der);
+    CCertificate out(der, len);
+    OPENSSL_free(der);
+    X509_free(leaf);
+    X509_free(issuer);
+    EVP_PKEY_free(key);
+    return out;
+}
+
+// issuer trovato nello store per un certificato emesso dalla CA
+CCertificate* storeIssuer(const TSL_SERVICE& issuer, bool withAki = true)
+{
+    CCertificate leaf = issuedBy(issuer, withAki);
+    return CCertStore::GetCertificate(leaf);
+}
+
+bool inStore(const TSL_SERVICE& issuer, bool withAki = true)
+{
+    CCertificate* found = storeIssuer(issuer, withAki);
+    if (!found)
+        return false;
+    UUCByteArray der;
+    found->toByteArray(der);
+    return subjectKeyId(der) == subjectKeyId(issuer);
+}
+
+std::vector<uint8_t> readFile(const std::string& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+std::string lotl(const std::string& tslUrl, const std::string& selfUrl)
+{
+    return "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+           "<TrustServiceStatusList xmlns=\"http://uri.etsi.org/02231/v2#\"\n"
+           "    xmlns:ns3=\"http://uri.etsi.org/02231/v2/additionaltypes#\">\n"
+           "  <SchemeInformation>\n"
+           "    <TSLType>http://uri.etsi.org/TrstSvc/TrustedList/TSLType/EUlistofthelists</TSLType>\n"
+           "    <PointersToOtherTSL>\n"
+           "      <OtherTSLPointer>\n"
+           "        <TSLLocation>" + tslUrl + "</TSLLocation>\n"
+           "        <AdditionalInformation>\n"
+           "          <OtherInformation><TSLType>http://uri.etsi.org/TrstSvc/TrustedList/TSLType/EUgeneric</TSLType></OtherInformation>\n"
+           "          <OtherInformation><SchemeTerritory>IT</SchemeTerritory></OtherInformation>\n"
+           "          <OtherInformation><ns3:MimeType>application/vnd.etsi.tsl+xml</ns3:MimeType></OtherInformation>\n"
+           "        </AdditionalInformation>\n"
+           "      </OtherTSLPointer>\n"
+           "      <OtherTSLPointer>\n"
+           "        <TSLLocation>" + tslUrl + ".pdf</TSLLocation>\n"
+           "        <AdditionalInformation>\n"
+           "          <OtherInformation><TSLType>http://uri.etsi.org/TrstSvc/TrustedList/TSLType/EUgeneric</TSLType></OtherInformation>\n"
+           "          <OtherInformation><ns3:MimeType>application/pdf</ns3:MimeType></OtherInformation>\n"
+           "        </AdditionalInformation>\n"
+           "      </OtherTSLPointer>\n"
+           "      <OtherTSLPointer>\n"
+           "        <TSLLocation>" + selfUrl + "</TSLLocation>\n"
+           "        <AdditionalInformation>\n"
+           "          <OtherInformation><TSLType>http://uri.etsi.org/TrstSvc/TrustedList/TSLType/EUlistofthelists</TSLType></OtherInformation>\n"
+           "          <OtherInformation><ns3:MimeType>application/vnd.etsi.tsl+xml</ns3:MimeType></OtherInformation>\n"
+           "        </AdditionalInformation>\n"
+           "      </OtherTSLPointer>\n"
+           "    </PointersToOtherTSL>\n"
+           "    <ListIssueDateTime>2026-02-01T00:00:00Z</ListIssueDateTime>\n"
+           "    <NextUpdate><dateTime>2026-08-01T00:00:00Z</dateTime></NextUpdate>\n"
+           "  </SchemeInformation>\n"
+           "</TrustServiceStatusList>\n";
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<uint8_t> xml = loadFixture("data/fixtures/sample_tsl.xml");
+    expect(!xml.empty(), "fixture found");
+
+    // servizi qualificati, uno per certificato; CA/PKC ignorato
+    CTrustedList tsl;
+    expect(tsl.parse(xml.data(), xml.size()) == 0, "fixture parsed");
+    const std::vector<TSL_SERVICE>& services = tsl.getServices();
+    expect(services.size() == 4, "four qualified certificates");
+    expect(byName(services, "Fixture Non Qualified CA") == nullptr, "non-qualified service skipped");
+    expect(tsl.getPointers().empty(), "national list has no pointers");
+    expect(tsl.getNextUpdate() == 1788256800, "NextUpdate");
+
+    const TSL_SERVICE* ca = byName(services, "Fixture Qualified CA");
+    const TSL_SERVICE* tsa = byName(services, "Fixture Qualified TSA");
+    const TSL_SERVICE* withdrawn = byName(services, "Fixture Withdrawn CA");
+    expect(ca && ca->nType == TSL_SERVICE_CA_QC && ca->nStatus == TSL_STATUS_GRANTED, "qualified CA granted");
+    expect(ca && ca->nStatusStartingTime == 1467324000, "StatusStartingTime");
+    expect(ca && ca->szKeyId == subjectKeyId(*ca) && ca->szKeyId.size() == 20, "key identifier from the SKI");
+    expect(tsa && tsa->nType == TSL_SERVICE_TSA_QTST && tsa->nStatus == TSL_STATUS_GRANTED, "qualified TSA granted");
+    expect(withdrawn && withdrawn->nStatus == TSL_STATUS_WITHDRAWN, "withdrawn status (history ignored)");
+    expect(withdrawn && subjectKeyId(*withdrawn).empty() && withdrawn->szKeyId.size() == 20,
+           "key identifier from the public key without SKI");
+
+    // stati pre-eIDAS: solo con il prefisso senza TrustedList
+    std::string legacyText(xml.begin(), xml.end());
+    replaceAll(legacyText, "TrustedList/Svcstatus/granted", "Svcstatus/accredited");
+    replaceAll(legacyText, "TrustedList/Svcstatus/withdrawn", "Svcstatus/supervisionceased");
+    CTrustedList legacy;
+    std::vector<uint8_t> legacyXml = bytes(legacyText);
+    expect(legacy.parse(legacyXml.data(), legacyXml.size()) == 0, "legacy statuses parsed");
+    const TSL_SERVICE* legacyCa = byName(legacy.getServices(), "Fixture Qualified CA");
+    const TSL_SERVICE* legacyWithdrawn = byName(legacy.getServices(), "Fixture Withdrawn CA");
+    expect(legacyCa && legacyCa->nStatus == TSL_STATUS_GRANTED, "accredited is granted");
+    expect(legacyWithdrawn && legacyWithdrawn->nStatus == TSL_STATUS_WITHDRAWN, "supervisionceased is withdrawn");
+
+    std::string wrongPrefix(xml.begin(), xml.end());
+    replaceAll(wrongPrefix, "TrustedList/Svcstatus/granted", "TrustedList/Svcstatus/accredited");
+    CTrustedList wrong;
+    std::vector<uint8_t> wrongXml = bytes(wrongPrefix);
+    expect(wrong.parse(wrongXml.data(), wrongXml.size()) == 0, "eIDAS prefix parsed");
+    const TSL_SERVICE* wrongCa = byName(wrong.getServices(), "Fixture Qualified CA");
+    expect(wrongCa && wrongCa->nStatus == TSL_STATUS_UNKNOWN, "legacy status with the eIDAS prefix unknown");
+
+    // snapshot: stesso contenuto, ricerca per key identifier
+    char dir[] = "/tmp/trusted_list_testXXXXXX";
+    expect(mkdtemp(dir) != nullptr, "temp dir");
+    const std::string path = std::string(dir) + "/" + TSL_SNAPSHOT_FILE;
+    expect(tsl.writeSnapshot(path.c_str()) == 0, "snapshot written");
+
+    CTrustedListSnapshot snapshot;
+    expect(snapshot.open(path.c_str()) == 0, "snapshot mapped");
+    expect(snapshot.size() == 4 && snapshot.getNextUpdate() == tsl.getNextUpdate(), "snapshot header");
+
+    int matched = 0;
+    for (int i = 0; i < snapshot.size(); i++) {
+        TSL_SERVICE service;
+        snapshot.getService(i, service);
+        for (const TSL_SERVICE& parsed : services)
+            if (sameService(service, parsed)) {
+                matched++;
+                break;
+            }
+    }
+    expect(matched == 4, "snapshot entries equal the parsed services");
+
+    std::vector<TSL_SERVICE> found;
+    expect(ca && snapshot.find(ca->szKeyId, found) == 2, "two certificates with the CA key");
+    expect(found.size() == 2 && found[0].szKeyId == ca->szKeyId && found[1].szKeyId == ca->szKeyId, "found by key identifier");
+    found.clear();
+    expect(tsa && snapshot.find(tsa->szKeyId, found) == 1 && sameService(found[0], *tsa), "TSA found");
+    found.clear();
+    expect(snapshot.find(std::string(20, '\x01'), found) == 0 && found.empty(), "unknown key identifier");
+    found.clear();
+    expect(tsa && snapshot.findSubject(subjectName(*tsa), found) == 1 && sameService(found[0], *tsa), "TSA found by subject");
+    found.clear();
+    expect(withdrawn && snapshot.findSubject(subjectName(*withdrawn), found) == 1 && sameService(found[0], *withdrawn),
+           "CA without SKI found by subject");
+    found.clear();
+    expect(snapshot.findSubject("unknown", found) == 0 && found.empty(), "unknown subject");
+    snapshot.close();
+
+    // lo store cerca gli issuer nella snapshot, per SKI o DN; solo i servizi granted
+    CTrustedListSnapshot* stored = new CTrustedListSnapshot();
+    expect(stored->open(path.c_str()) == 0, "snapshot mapped for the store");
+    CCertStore::SetTrustedList(stored);
+    expect(ca && inStore(*ca), "qualified CA found by key identifier");
+    expect(ca && inStore(*ca, false), "qualified CA found by subject");
+    expect(ca && storeIssuer(*ca) == storeIssuer(*ca, false), "certificate decoded once");
+    expect(tsa && inStore(*tsa), "qualified TSA found");
+    expect(withdrawn && !inStore(*withdrawn) && !inStore(*withdrawn, false), "withdrawn CA not in the store");
+    CCertStore::CleanUp();
+    expect(ca && !inStore(*ca), "snapshot released by CleanUp");
+
+    // snapshot danneggiate
+    const std::vector<uint8_t> good = readFile(path);
+    const std::string broken = std::string(dir) + "/broken.snapshot";
+    std::vector<uint8_t> truncated(good.begin(), good.end() - 100);
+    writeFile(broken, truncated);
+    expect(snapshot.open(broken.c_str()) == DISIGON_ERROR_TSL_INVALID, "truncated snapshot rejected");
+    std::vector<uint8_t> badMagic = good;
+    badMagic[0] ^= 0xFF;
+    writeFile(broken, badMagic);
+    expect(snapshot.open(broken.c_str()) == DISIGON_ERROR_TSL_INVALID, "bad magic rejected");
+    // nCertOffset della prima Entry oltre la fine del file
+    std::vector<uint8_t> badOffset = good;
+    uint64_t indexOffset = 0;
+    std::memcpy(&indexOffset, &good[40], sizeof(indexOffset));
+    badOffset[indexOffset + 48 + 3] = 0x7F;
+    writeFile(broken, badOffset);
+    expect(snapshot.open(broken.c_str()) == DISIGON_ERROR_TSL_INVALID, "entry out of bounds rejected");
+    expect(snapshot.open((std::string(dir) + "/missing").c_str()) == DISIGON_ERROR_FILE_NOT_FOUND, "missing snapshot");
+    expect(snapshot.size() == 0, "closed after a failed open");
+
+    // XML non valido o che non e' una trusted list
+    CTrustedList invalid;
+    std::vector<uint8_t> garbage = bytes("<TrustServiceStatusList><Scheme");
+    expect(invalid.parse(garbage.data(), garbage.size()) == DISIGON_ERROR_TSL_PARSE, "malformed XML");
+    std::vector<uint8_t> other = bytes("<?xml version=\"1.0\"?><Signature/>");
+    expect(invalid.parse(other.data(), other.size()) == DISIGON_ERROR_TSL_INVALID, "not a trusted list");
+
+    // LOTL: si seguono i puntatori XML, non il PDF ne' la LOTL stessa
+    MockHttpServer server;
+    expect(server.start(), "HTTP stand-in started");
+    server.setResource("/tsl-it.xml", xml);
+    server.setResource("/lotl.xml", bytes(lotl(server.url("/tsl-it.xml"), server.url("/lotl.xml"))));
+
+    CTrustedList fromLotl;
+    expect(fromLotl.load(server.url("/lotl.xml").c_str()) == 0, "LOTL loaded");
+    expect(fromLotl.getServices().size() == 4, "services of the pointed list");
+    expect(fromLotl.getNextUpdate() == 1785542400, "earliest NextUpdate");
+    expect(fromLotl.getSource() == server.url("/lotl.xml"), "source");
+    expect(server.requestCount("/lotl.xml") == 1 && server.requestCount("/tsl-it.xml") == 1 &&
+           server.requestCount("/tsl-it.xml.pdf") == 0, "only XML trusted lists fetched");
+
+    CTrustedList missing;
+    expect(missing.load(server.url("/none.xml").c_str()) == DISIGON_ERROR_TSL_LOAD, "missing list");
+
+    // la seconda volta dalla snapshot, finche' non scade la NextUpdate
+    std::string text(xml.begin(), xml.end());
+    std::string fresh = text;
+    fresh.replace(fresh.find("2026-09-01T10:00:00Z"), 20, "2099-01-01T00:00:00Z");
+    server.setResource("/tsl-fresh.xml", bytes(fresh));
+    const std::string freshUrl = server.url("/tsl-fresh.xml");
+    unlink(path.c_str());
+    expect(CTrustedList::LoadCertStore(freshUrl.c_str(), path.c_str()) == 0, "list loaded");
+    expect(ca && inStore(*ca), "store filled from the list");
+    CCertStore::CleanUp();
+    expect(CTrustedList::LoadCertStore(freshUrl.c_str(), path.c_str()) == 0, "list loaded again");
+    expect(server.requestCount("/tsl-fresh.xml") == 1, "second load from the snapshot");
+    expect(ca && inStore(*ca), "store filled from the snapshot");
+    CCertStore::CleanUp();
+
+    // snapshot di un'altra lista o scaduta (NextUpdate del fixture passata): si rilegge
+    const std::string itUrl = server.url("/tsl-it.xml");
+    int before = server.requestCount("/tsl-it.xml");
+    expect(CTrustedList::LoadCertStore(itUrl.c_str(), path.c_str()) == 0, "other list loaded");
+    expect(CTrustedList::LoadCertStore(itUrl.c_str(), path.c_str()) == 0, "expired snapshot reloaded");
+    expect(server.requestCount("/tsl-it.xml") == before + 2, "expired snapshot not used");
+
+    CCertStore::CleanUp();
+    CHttpClient::CleanUp();
+    server.stop();
+    unlink(path.c_str());
+    unlink(broken.c_str());
+    rmdir(dir);
+
+    return testResult("trusted_list_test");
+}
@@ -0,0 +1,235 @@
+#include "VerifyDaemon.h"
+#include "VerifyReport.h"
+#include "disigonsdk.h"
+#include "test_support.h"
+
+#include <grp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Daemon whose verification only waits and echoes the request.
+class SlowDaemon : public CVerifyDaemon
+{
+public:
+    std::atomic<int> delayMs{0};
+    std::atomic<int> started{0};
+    std::atomic<int> running{0};
+    std::atomic<int> maxRunning{0};
+
+protected:
+    long verify(int worker, const char* path, bool revocation, std::string& result) override
+    {
+        started++;
+        int now = ++running;
+        for (int seen = maxRunning; now > seen && !maxRunning.compare_exchange_weak(seen, now);)
+            ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(delayMs.load()));
+        running--;
+        result = std::string("{\"path\":\"") + path + "\",\"revocation\":" + (revocation ? "true" : "false") +
+                 ",\"worker\":" + std::to_string(worker) + "}";
+        return 0;
+    }
+};
+
+std::string rawRequest(const std::string& socketPath, const std::string& line)
+{
+    int s = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    std::string response;
+    if (connect(s, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0) {
+        std::string data = line + "\n";
+        send(s, data.data(), data.size(), 0);
+        char buffer[256];
+        ssize_t n;
+        while ((n = recv(s, buffer, sizeof(buffer), 0)) > 0)
+            response.append(buffer, n);
+    }
+    close(s);
+    return response;
+}
+
+bool exists(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+int socketMode(const std::string& path)
+{
+    struct stat info;
+    return stat(path.c_str(), &info) == 0 ? (info.st_mode & 0777) : -1;
+}
+
+// formato condiviso tra il demone e pdf_signature_check
+void testReport()
+{
+    expect(CVerifyReport::jsonString("a\"b\\c\nd\x01") == "\"a\\\"b\\\\c\\nd\\u0001\"", "JSON string escaped");
+
+    SIGNER_INFO signer;
+    std::memset(&signer, 0, sizeof(signer));
+    std::strcpy(signer.szCN, "Mario \"Rossi\"");
+    signer.bitmask = VERIFIED_SIGNATURE | VERIFIED_CERT_VALIDITY | VERIFIED_CACERT_FOUND | VERIFIED_CERT_CHAIN | VERIFIED_CERT_GOOD;
+    expect(CVerifyReport::signerValid(signer.bitmask), "complete signer valid");
+    std::string json = CVerifyReport::signerJson(signer);
+    expect(json.compare(0, 24, "{\"cn\":\"Mario \\\"Rossi\\\"\",") == 0 &&
+           json.find("\"valid\":true,\"revocation\":\"good\"}") != std::string::npos, "signer JSON");
+
+    signer.bitmask |= VERIFIED_CERT_REVOKED;
+    expect(!CVerifyReport::signerValid(signer.bitmask), "revoked signer invalid");
+    expect(std::strcmp(CVerifyReport::revocationStatus(signer.bitmask), "revoked") == 0, "revoked status");
+    expect(!CVerifyReport::signerValid(VERIFIED_SIGNATURE | VERIFIED_CERT_VALIDITY), "signer without chain invalid");
+    expect(!CVerifyReport::signerValid(-1) && std::strcmp(CVerifyReport::revocationStatus(-1), "unknown") == 0,
+           "verification error never valid");
+}
+
+} // namespace
+
+int main()
+{
+    testReport();
+
+    std::string socketPath = "/tmp/verify_daemon_test_" + std::to_string(getpid()) + ".sock";
+
+    // socket rimasto da un processo terminato
+    {
+        int s = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        bind(s, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+        close(s);
+    }
+    expect(exists(socketPath), "stale socket created");
+
+    SlowDaemon daemon;
+    daemon.setThreads(4);
+    daemon.setQueueSize(8);
+    expect(daemon.start(socketPath.c_str()) == 0, "daemon replaces a stale socket");
+    expect(socketMode(socketPath) == 0600, "socket reserved to the owner");
+
+    SlowDaemon second;
+    expect(second.start(socketPath.c_str()) == (long)DISIGON_ERROR_DAEMON_SOCKET, "second daemon on a live socket refused");
+
+    CVerifyClient client(socketPath.c_str());
+    expect(client.ping() == 0, "ping");
+
+    std::string result;
+    expect(client.verify("/archive/doc 1.pdf", true, result) == 0, "verify");
+    expect(result.find("\"path\":\"/archive/doc 1.pdf\"") != std::string::npos, "path with spaces forwarded");
+    expect(result.find("\"revocation\":true") != std::string::npos, "revocation flag forwarded");
+
+    // percorso relativo risolto dal client
+    char cwd[PATH_MAX];
+    expect(getcwd(cwd, sizeof(cwd)) != nullptr, "getcwd");
+    expect(client.verify(".", false, result) == 0 && result.find(std::string("\"path\":\"") + cwd + "\"") != std::string::npos,
+           "relative path made absolute");
+
+    expect(rawRequest(socketPath, "HELLO").compare(0, 4, "ERR ") == 0, "malformed request rejected");
+    expect(rawRequest(socketPath, "VERIFY 2 /x.pdf").compare(0, 4, "ERR ") == 0, "invalid flag rejected");
+
+    // richieste concorrenti sui worker
+    daemon.delayMs = 50;
+    std::atomic<int> ok(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&, t] {
+            std::string out;
+            if (client.verify(("/archive/" + std::to_string(t) + ".pdf").c_str(), false, out) == 0)
+                ok++;
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+    expect(ok == 8, "concurrent requests served");
+    expect(daemon.maxRunning > 1 && daemon.maxRunning <= 4, "requests spread over the workers");
+
+    expect(client.getStats(result) == 0, "stats");
+    expect(result.find("\"served\":10") != std::string::npos, "served requests counted");
+    expect(result.find("\"cert_store\":{\"hits\":") != std::string::npos, "cache counters reported");
+
+    daemon.stop();
+    expect(!exists(socketPath), "socket removed on stop");
+    expect(client.ping() == (long)DISIGON_ERROR_DAEMON_SOCKET, "no daemon after stop");
+
+    // coda piena: BUSY al client, che riprova
+    SlowDaemon narrow;
+    narrow.setThreads(1);
+    narrow.setQueueSize(1);
+    narrow.delayMs = 150;
+    narrow.setSocketGroup("no-such-group-verify-daemon-test");
+    expect(narrow.start(socketPath.c_str()) == (long)DISIGON_ERROR_DAEMON_SOCKET && !exists(socketPath), "unknown group refused");
+    struct group* ownGroup = getgrgid(getegid());
+    narrow.setSocketGroup(ownGroup ? ownGroup->gr_name : nullptr);
+    expect(narrow.start(socketPath.c_str()) == 0, "restart on the same path");
+    expect(socketMode(socketPath) == (ownGroup ? 0660 : 0600), "socket shared with the configured group");
+
+    CVerifyClient impatient(socketPath.c_str());
+    impatient.setRetries(0, 1);
+    std::atomic<int> busy(0), served(0);
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            std::string out;
+            long ret = impatient.verify("/archive/busy.pdf", false, out);
+            if (ret == (long)DISIGON_ERROR_DAEMON_BUSY)
+                busy++;
+            else if (ret == 0)
+                served++;
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+    expect(busy > 0, "full queue answers BUSY");
+    expect(served >= 1 && busy + served == 4, "accepted requests served");
+
+    CVerifyClient patient(socketPath.c_str());
+    patient.setRetries(10, 20);
+    ok = 0;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            std::string out;
+            if (patient.verify("/archive/retry.pdf", false, out) == 0)
+                ok++;
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+    expect(ok == 4, "retries with backoff get through");
+
+    // arresto: la richiesta in corso e quella in coda vengono servite
+    narrow.started = 0;
+    ok = 0;
+    for (int t = 0; t < 2; t++)
+        threads.emplace_back([&] {
+            std::string out;
+            if (patient.verify("/archive/drain.pdf", false, out) == 0)
+                ok++;
+        });
+    while (narrow.started == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    narrow.stop();
+    for (std::thread& thread : threads)
+        thread.join();
+    expect(ok == 2, "queued requests served before stopping");
+    expect(!narrow.isRunning() && !exists(socketPath), "stopped");
+
+    return testResult("verify_daemon_test");
+}
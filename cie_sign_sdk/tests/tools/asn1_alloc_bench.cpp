@@ -0,0 +1,193 @@
+#include "ASN1/Certificate.h"
+#include "ASN1/ASN1Exception.h"
+#include "ASN1/Name.h"
+#include "ASN1/UUCArena.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef CIE_SIGN_SDK_SOURCE_DIR
+#define CIE_SIGN_SDK_SOURCE_DIR "."
+#endif
+
+// Counts operator new calls made by the ASN.1 classes; malloc based buffers
+// are counted by UUCArena::stats().
+static std::atomic<unsigned long> g_newCount(0);
+
+void *operator new(std::size_t size)
+{
+    g_newCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
+struct Fixture
+{
+    std::string name;
+    std::vector<uint8_t> der;
+};
+
+struct Sample
+{
+    unsigned long heapAllocs = 0;
+    unsigned long arenaAllocs = 0;
+    double micros = 0;
+};
+
+std::vector<Fixture> loadDerFixtures(const std::string &dir)
+{
+    std::vector<Fixture> fixtures;
+    DIR *handle = opendir(dir.c_str());
+    if (!handle)
+        return fixtures;
+
+    while (dirent *entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name.size() < 4 || name.compare(name.size() - 4, 4, ".der") != 0)
+            continue;
+        std::ifstream file(dir + "/" + name, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+                                  std::istreambuf_iterator<char>());
+        if (!data.empty())
+            fixtures.push_back({name, std::move(data)});
+    }
+    closedir(handle);
+    return fixtures;
+}
+
+// Parse tree: decode the fields used during verification.
+void decode(CCertificate &cert)
+{
+    UUCByteArray subject;
+    cert.getSubject().getNameAsString(subject);
+    UUCByteArray issuer;
+    cert.getIssuer().getNameAsString(issuer);
+    CASN1Integer serial = cert.getSerialNumber();
+    CASN1Sequence extensions = cert.getExtensions();
+    cert.isNonRepudiation();
+    cert.isSHA256();
+}
+
+// motivo per cui il .der non si misura, nullptr se e' un certificato leggibile:
+// DER non valido (CASN1Exception), SEQUENCE diversa da tbsCertificate, algoritmo
+// e firma (es. un PEM con estensione .der), certificato X.509 v1 (CCertificateInfo
+// legge i campi dopo la [0] version) o elemento mancante (posizione non valida)
+const char *notMeasurable(const Fixture &fixture)
+{
+    try {
+        CCertificate cert(fixture.der.data(), static_cast<long>(fixture.der.size()));
+        if (cert.getTag() != 0x30 || cert.size() != 3)
+            return "not a DER certificate";
+        CASN1Sequence tbsCertificate(cert.elementAt(0));
+        if (tbsCertificate.size() == 0 || tbsCertificate.elementAt(0).getTag() != 0xA0)
+            return "X.509 v1 certificate";
+        decode(cert);
+        return nullptr;
+    } catch (const CASN1Exception &) {
+        return "not a DER certificate";
+    } catch (int) {
+        return "not a DER certificate";
+    }
+}
+
+// Encode tree: rebuild the certificate from its top level elements.
+void parseAndEncode(const Fixture &fixture)
+{
+    CCertificate cert(fixture.der.data(), static_cast<long>(fixture.der.size()));
+    decode(cert);
+
+    CASN1Sequence rebuilt;
+    for (unsigned int i = 0; i < cert.size(); i++)
+        rebuilt.addElement(cert.elementAt(i));
+
+    UUCByteArray encoded;
+    rebuilt.toByteArray(encoded);
+    if (encoded.getLength() != fixture.der.size())
+        throw std::runtime_error("re-encoded certificate differs: " + fixture.name);
+}
+
+Sample run(const Fixture &fixture, int iterations, bool useArena)
+{
+    UUCAllocStats &stats = UUCArena::stats();
+    unsigned long heapBefore = stats.nHeapAllocs + g_newCount.load();
+    unsigned long arenaBefore = stats.nArenaAllocs;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        if (useArena) {
+            UUCArena arena;
+            UUCArenaScope scope(arena);
+            parseAndEncode(fixture);
+        } else {
+            parseAndEncode(fixture);
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    Sample sample;
+    sample.heapAllocs = (stats.nHeapAllocs + g_newCount.load() - heapBefore) / iterations;
+    sample.arenaAllocs = (stats.nArenaAllocs - arenaBefore) / iterations;
+    sample.micros = std::chrono::duration<double, std::micro>(elapsed).count() / iterations;
+    return sample;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string dir = argc > 1 ? argv[1] : std::string(CIE_SIGN_SDK_SOURCE_DIR) + "/data/fixtures";
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 2000;
+    if (iterations <= 0)
+        iterations = 1;
+
+    std::vector<Fixture> fixtures = loadDerFixtures(dir);
+    if (fixtures.empty()) {
+        std::fprintf(stderr, "No .der fixtures found in %s\n", dir.c_str());
+        return 1;
+    }
+
+    std::printf("%-28s %12s %12s %12s %12s %12s\n",
+                "fixture", "heap/op", "us/op", "arena:heap", "arena:bump", "arena:us");
+    int measured = 0;
+    for (const Fixture &fixture : fixtures) {
+        if (const char *reason = notMeasurable(fixture)) {
+            std::printf("%-28s skipped: %s\n", fixture.name.c_str(), reason);
+            continue;
+        }
+
+        // un certificato ricodificato diverso dall'originale fa fallire la misura
+        try {
+            Sample heap = run(fixture, iterations, false);
+            Sample arena = run(fixture, iterations, true);
+            std::printf("%-28s %12lu %12.2f %12lu %12lu %12.2f\n",
+                        fixture.name.c_str(), heap.heapAllocs, heap.micros,
+                        arena.heapAllocs, arena.arenaAllocs, arena.micros);
+            measured++;
+        } catch (const std::exception &ex) {
+            std::fprintf(stderr, "%s\n", ex.what());
+            return 1;
+        }
+    }
+    return measured > 0 ? 0 : 2;
+}
@@ -0,0 +1,75 @@
+#include "ASN1/UUCByteArray.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+template <typename Fn>
+double measure(const char *label, int iterations, Fn &&fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double nanos = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    std::printf("%-32s %14.1f ns/op\n", label, nanos);
+    return nanos;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int scale = argc > 1 ? std::atoi(argv[1]) : 1;
+    if (scale <= 0)
+        scale = 1;
+
+    std::vector<BYTE> chunk(4096, 0x5A);
+    const BYTE oid[] = {0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x07, 0x02};
+    volatile unsigned long sink = 0;
+
+    measure("append(byte) x 64k", 50 * scale, [&] {
+        UUCByteArray buffer;
+        for (int i = 0; i < 65536; i++)
+            buffer.append(static_cast<BYTE>(i));
+        sink += buffer.getLength();
+    });
+
+    measure("append(4k chunk) -> 8 MB", 10 * scale, [&] {
+        UUCByteArray buffer;
+        for (int i = 0; i < 2048; i++)
+            buffer.append(chunk.data(), static_cast<unsigned int>(chunk.size()));
+        sink += buffer.getLength();
+    });
+
+    measure("construct+copy OID", 1000000 * scale, [&] {
+        UUCByteArray value(oid, sizeof(oid));
+        UUCByteArray copy(value);
+        sink += copy.getLength();
+    });
+
+    measure("vector<UUCByteArray> push 1k", 1000 * scale, [&] {
+        std::vector<UUCByteArray> values;
+        for (int i = 0; i < 1000; i++)
+            values.push_back(UUCByteArray(chunk.data(), 256));
+        sink += values.size();
+    });
+
+    measure("toHexString(1 KB)", 20000 * scale, [&] {
+        UUCByteArray value(chunk.data(), 1024);
+        sink += std::strlen(value.toHexString());
+    });
+
+    measure("remove(0) on 4 KB", 2000 * scale, [&] {
+        UUCByteArray value(chunk.data(), static_cast<unsigned long>(chunk.size()));
+        for (int i = 0; i < 64; i++)
+            value.remove(0);
+        sink += value.getLength();
+    });
+
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+#include "TimestampUpgrader.h"
+#include "TSAClient.h"
+#include "../mock/local_tsa.h"
+
+#include <sys/stat.h>
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void usage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "Usage: %s [options] <file.p7m|dir|@list.txt>...\n"
+                 "  --tsa URL              RFC 3161 time stamping authority\n"
+                 "  --user NAME --password PWD\n"
+                 "  --local-tsa [MS]       in-process stand-in TSA, optional latency per request\n"
+                 "  --policy OID           TSA policy\n"
+                 "  --out DIR              write upgraded files to DIR (default: in place)\n"
+                 "  --threads N            preparation threads (default 2)\n"
+                 "  --in-flight N          concurrent TSA requests (default 8)\n",
+                 argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string tsaUrl, user, password, policy, outDir;
+    bool localTsa = false;
+    int latencyMs = 0, threads = 2, inFlight = 8;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--tsa")
+            tsaUrl = next();
+        else if (arg == "--user")
+            user = next();
+        else if (arg == "--password")
+            password = next();
+        else if (arg == "--local-tsa") {
+            localTsa = true;
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+                latencyMs = std::atoi(argv[++i]);
+        } else if (arg == "--policy")
+            policy = next();
+        else if (arg == "--out")
+            outDir = next();
+        else if (arg == "--threads")
+            threads = std::atoi(next().c_str());
+        else if (arg == "--in-flight")
+            inFlight = std::atoi(next().c_str());
+        else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else
+            inputs.push_back(arg);
+    }
+
+    if (inputs.empty() || (!localTsa && tsaUrl.empty())) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    CTSAClient remote;
+    LocalTSAClient *local = localTsa ? new LocalTSAClient(latencyMs) : nullptr;
+    CTSAClient &tsa = local ? static_cast<CTSAClient &>(*local) : remote;
+    if (!local) {
+        remote.SetTSAUrl(tsaUrl.c_str());
+        if (!user.empty())
+            remote.SetCredential(user.c_str(), password.c_str());
+    }
+
+    CTimestampUpgrader upgrader(tsa);
+    upgrader.setThreads(threads, inFlight);
+    if (!policy.empty())
+        upgrader.setPolicyID(policy.c_str());
+    if (!outDir.empty())
+        upgrader.setOutputDir(outDir.c_str());
+
+    for (const std::string &input : inputs) {
+        if (input[0] == '@') {
+            std::ifstream list(input.substr(1));
+            std::string line;
+            while (std::getline(list, line))
+                if (!line.empty())
+                    upgrader.addFile(line.c_str());
+        } else {
+            struct stat info;
+            if (stat(input.c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+                upgrader.addDirectory(input.c_str());
+            else
+                upgrader.addFile(input.c_str());
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<TIMESTAMP_UPGRADE_RESULT> results;
+    int failed = upgrader.run(results);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int timestamped = 0, skipped = 0;
+    for (const TIMESTAMP_UPGRADE_RESULT &result : results) {
+        timestamped += result.nTimestamped;
+        skipped += result.nSkipped;
+        if (result.nError != 0)
+            std::printf("FAIL %s (0x%lx)\n", result.szInputPath.c_str(), static_cast<unsigned long>(result.nError));
+    }
+
+    std::printf("files: %zu  failed: %d  timestamps: %d  already timestamped: %d  %.2f s (%.1f files/s)\n",
+                results.size(), failed, timestamped, skipped, seconds,
+                seconds > 0 ? results.size() / seconds : 0.0);
+
+    delete local;
+    return failed == 0 ? 0 : 1;
+}
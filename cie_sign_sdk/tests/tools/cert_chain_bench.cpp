@@ -0,0 +1,125 @@
+#include "CertStore.h"
+
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+EVP_PKEY* makeKey()
+{
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr);
+    EVP_PKEY_keygen_init(ctx);
+    EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048);
+    EVP_PKEY_keygen(ctx, &key);
+    EVP_PKEY_CTX_free(ctx);
+    return key;
+}
+
+void addExtension(X509* cert, X509* issuer, int nid, const char* value)
+{
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, issuer, cert, nullptr, nullptr, 0);
+    X509_EXTENSION* ext = X509V3_EXT_conf_nid(nullptr, &ctx, nid, value);
+    X509_add_ext(cert, ext, -1);
+    X509_EXTENSION_free(ext);
+}
+
+// issuer == nullptr: autofirmato
+X509* makeCert(const char* commonName, long serial, EVP_PKEY* key, X509* issuer, EVP_PKEY* issuerKey)
+{
+    X509* cert = X509_new();
+    X509_set_version(cert, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), serial);
+    X509_gmtime_adj(X509_getm_notBefore(cert), -3600);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+    X509_NAME* name = X509_get_subject_name(cert);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(commonName), -1, -1, 0);
+    X509_set_issuer_name(cert, issuer ? X509_get_subject_name(issuer) : name);
+    X509_set_pubkey(cert, key);
+    addExtension(cert, cert, NID_subject_key_identifier, "hash");
+    addExtension(cert, issuer ? issuer : cert, NID_authority_key_identifier, "keyid:always");
+    X509_sign(cert, issuer ? issuerKey : key, EVP_sha256());
+    return cert;
+}
+
+Bytes der(X509* cert)
+{
+    unsigned char* p = nullptr;
+    int len = i2d_X509(cert, &p);
+    Bytes out(p, p + (len > 0 ? len : 0));
+    OPENSSL_free(p);
+    return out;
+}
+
+void run(const char* label, const std::vector<Bytes>& signers, int documents)
+{
+    int complete = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < documents; i++) {
+        // ogni documento porta la propria copia del certificato del firmatario
+        const Bytes& signer = signers[i % signers.size()];
+        CCertificate cert(signer.data(), static_cast<long>(signer.size()));
+        std::vector<CCertificate*> chain;
+        if (CCertStore::BuildChain(cert, chain) && chain.size() == 2)
+            complete++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-34s %6d documents: %8.0f chains/s (%d complete)\n", label, documents, documents / seconds, complete);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int documents = argc > 1 ? std::atoi(argv[1]) : 5000;
+    int signerCount = argc > 2 ? std::atoi(argv[2]) : 100;
+    if (documents <= 0 || signerCount <= 0) {
+        std::fprintf(stderr, "Usage: %s [documents=5000] [signers=100]\n", argv[0]);
+        return 2;
+    }
+
+    // root -> CA intermedia -> firmatari
+    EVP_PKEY* rootKey = makeKey();
+    EVP_PKEY* caKey = makeKey();
+    EVP_PKEY* signerKey = makeKey();
+    X509* root = makeCert("Bench Root CA", 1, rootKey, nullptr, nullptr);
+    X509* ca = makeCert("Bench Issuing CA", 2, caKey, root, rootKey);
+
+    std::vector<Bytes> signers;
+    for (int i = 0; i < signerCount; i++) {
+        X509* signer = makeCert("Bench signer", 0x1000 + i, signerKey, ca, caKey);
+        signers.push_back(der(signer));
+        X509_free(signer);
+    }
+
+    for (X509* x509 : {root, ca}) {
+        Bytes bytes = der(x509);
+        CCertificate cert(bytes.data(), static_cast<long>(bytes.size()));
+        CCertStore::AddCertificate(cert);
+    }
+
+    CCertStore::SetCacheTTL(0);
+    run("no cache (every link verified)", signers, documents);
+    CCertStore::SetCacheTTL(CERTSTORE_DEFAULT_TTL);
+    run("cached", signers, documents);
+
+    CCertStore::CleanUp();
+    X509_free(ca);
+    X509_free(root);
+    EVP_PKEY_free(signerKey);
+    EVP_PKEY_free(caKey);
+    EVP_PKEY_free(rootKey);
+    return 0;
+}
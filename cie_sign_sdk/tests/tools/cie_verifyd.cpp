@@ -0,0 +1,114 @@
+#include "VerifyDaemon.h"
+#include "disigonsdk.h"
+
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+namespace {
+
+void usage(const char *argv0)
+{
+    std::fprintf(stderr,
+                 "Usage: %s --socket PATH [options]\n"
+                 "Serves signature verification requests on a Unix domain socket until SIGTERM/SIGINT.\n"
+                 "  --threads N            verification threads (default: hardware threads)\n"
+                 "  --queue N              accepted requests waiting for a thread (default %d)\n"
+                 "  --group NAME           socket mode 0660 for this group (default: 0600, owner only)\n"
+                 "  --cacert-dir DIR       CA directory (trusted list snapshot)\n"
+                 "  --tsl URL|FILE         trusted list loaded into the CA store (needs --cacert-dir)\n"
+                 "  --crl-cache DIR        on-disk CRL cache\n"
+                 "  --ocsp-cache DIR       on-disk OCSP response cache\n",
+                 argv0, VERIFYD_DEFAULT_QUEUE_SIZE);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    std::string socketPath, group, caCertDir, tsl, crlCache, ocspCache;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    int queue = VERIFYD_DEFAULT_QUEUE_SIZE;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--socket")
+            socketPath = next();
+        else if (arg == "--threads")
+            threads = std::atoi(next().c_str());
+        else if (arg == "--queue")
+            queue = std::atoi(next().c_str());
+        else if (arg == "--group")
+            group = next();
+        else if (arg == "--cacert-dir")
+            caCertDir = next();
+        else if (arg == "--tsl")
+            tsl = next();
+        else if (arg == "--crl-cache")
+            crlCache = next();
+        else if (arg == "--ocsp-cache")
+            ocspCache = next();
+        else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (socketPath.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!caCertDir.empty())
+        disigon_set(DISIGON_OPT_CACERT_DIR, const_cast<char *>(caCertDir.c_str()));
+    if (!crlCache.empty())
+        disigon_set(DISIGON_OPT_CRL_CACHE_DIR, const_cast<char *>(crlCache.c_str()));
+    if (!ocspCache.empty())
+        disigon_set(DISIGON_OPT_OCSP_CACHE_DIR, const_cast<char *>(ocspCache.c_str()));
+    if (!tsl.empty()) {
+        long ret = disigon_set(DISIGON_OPT_TSL_URL, const_cast<char *>(tsl.c_str()));
+        if (ret != 0) {
+            std::fprintf(stderr, "Unable to load the trusted list %s (0x%lx)\n", tsl.c_str(), static_cast<unsigned long>(ret));
+            return 1;
+        }
+    }
+
+    // i segnali si ricevono con sigwait, prima che i thread del demone li ereditino
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    CVerifyDaemon daemon;
+    daemon.setThreads(threads);
+    daemon.setQueueSize(queue);
+    if (!group.empty())
+        daemon.setSocketGroup(group.c_str());
+    long ret = daemon.start(socketPath.c_str());
+    if (ret != 0) {
+        std::fprintf(stderr, "Unable to listen on %s (0x%lx)\n", socketPath.c_str(), static_cast<unsigned long>(ret));
+        return 1;
+    }
+    std::fprintf(stderr, "listening on %s\n", socketPath.c_str());
+
+    int sig = 0;
+    sigwait(&signals, &sig);
+    std::fprintf(stderr, "signal %d: serving queued requests and stopping\n", sig);
+    daemon.stop();
+    return 0;
+}
@@ -0,0 +1,211 @@
+#include "ASN1/Crl.h"
+#include "ASN1/ASN1Integer.h"
+#include "ASN1/UUCBufferedReader.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<uint8_t> Bytes;
+
+Bytes tlv(uint8_t tag, const Bytes &content)
+{
+    Bytes out;
+    out.push_back(tag);
+    size_t len = content.size();
+    if (len < 0x80) {
+        out.push_back(static_cast<uint8_t>(len));
+    } else {
+        uint8_t digits[sizeof(size_t)];
+        int count = 0;
+        for (size_t value = len; value; value >>= 8)
+            digits[count++] = static_cast<uint8_t>(value & 0xFF);
+        out.push_back(static_cast<uint8_t>(0x80 | count));
+        while (count--)
+            out.push_back(digits[count]);
+    }
+    out.insert(out.end(), content.begin(), content.end());
+    return out;
+}
+
+Bytes concat(std::initializer_list<Bytes> parts)
+{
+    Bytes out;
+    for (const Bytes &part : parts)
+        out.insert(out.end(), part.begin(), part.end());
+    return out;
+}
+
+Bytes ascii(const char *text)
+{
+    return Bytes(text, text + std::strlen(text));
+}
+
+struct Synthetic
+{
+    Bytes der;
+    std::vector<Bytes> serials;       // INTEGER contents, in CRL order
+    std::vector<int> expected;        // REVOCATION_STATUS_* per serial
+};
+
+// Unsigned CRL (dummy signature): isRevoked does not verify it.
+Synthetic makeCrl(size_t entries, std::mt19937_64 &rng)
+{
+    Synthetic crl;
+    crl.serials.reserve(entries);
+    crl.expected.reserve(entries);
+
+    const Bytes sha256WithRsa = tlv(0x30, concat({tlv(0x06, {0x2A, 0x86, 0x48, 0x86, 0xF7, 0x0D, 0x01, 0x01, 0x0B}),
+                                                  tlv(0x05, {})}));
+    const Bytes issuer = tlv(0x30, tlv(0x31, tlv(0x30, concat({tlv(0x06, {0x55, 0x04, 0x03}),
+                                                               tlv(0x0C, ascii("Synthetic CRL issuer"))}))));
+    const Bytes revocationDate = tlv(0x17, ascii("250101000000Z"));
+
+    Bytes revoked;
+    revoked.reserve(entries * 48);
+    for (size_t i = 0; i < entries; i++) {
+        // seriali da 16 byte positivi come quelli emessi per la CIE
+        Bytes serial(16);
+        for (uint8_t &b : serial)
+            b = static_cast<uint8_t>(rng());
+        serial[0] = static_cast<uint8_t>((serial[0] & 0x7F) | 0x01);
+
+        Bytes entry = concat({tlv(0x02, serial), revocationDate});
+        int status = REVOCATION_STATUS_REVOKED;
+        if (i % 4 == 0) {
+            // una voce su quattro con CRLReason: certificateHold o keyCompromise
+            uint8_t reason = (i % 8 == 0) ? 6 : 1;
+            Bytes extension = tlv(0x30, concat({tlv(0x06, {0x55, 0x1D, 0x15}), tlv(0x04, tlv(0x0A, {reason}))}));
+            entry = concat({entry, tlv(0x30, extension)});
+            if (reason == 6)
+                status = REVOCATION_STATUS_SUSPENDED;
+        }
+
+        Bytes encoded = tlv(0x30, entry);
+        revoked.insert(revoked.end(), encoded.begin(), encoded.end());
+        crl.serials.push_back(serial);
+        crl.expected.push_back(status);
+    }
+
+    Bytes tbs = tlv(0x30, concat({tlv(0x02, {0x01}), sha256WithRsa, issuer,
+                                  tlv(0x17, ascii("250101000000Z")), tlv(0x17, ascii("491231000000Z")),
+                                  tlv(0x30, revoked)}));
+    crl.der = tlv(0x30, concat({tbs, sha256WithRsa, tlv(0x03, Bytes(257, 0))}));
+    return crl;
+}
+
+double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Previous implementation: linear walk with elementAt, which copies the
+// remaining buffer for every element.
+bool legacyIsRevoked(CCrl &crl, const CASN1Integer &serialNumber)
+{
+    CASN1Sequence tbsCertList(crl.elementAt(0));
+    CASN1Sequence revokedCertificates(tbsCertList.elementAt(5));
+    int count = revokedCertificates.size();
+    for (int i = 0; i < count; i++) {
+        CASN1Sequence revokedCertificate = revokedCertificates.elementAt(i);
+        CASN1Integer sn(revokedCertificate.elementAt(0));
+        if (serialNumber == sn)
+            return true;
+    }
+    return false;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t entries = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500000;
+    int lookups = argc > 2 ? std::atoi(argv[2]) : 1000000;
+    size_t legacyEntries = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 2000;
+    if (entries == 0 || lookups <= 0) {
+        std::fprintf(stderr, "Usage: %s [entries=500000] [lookups=1000000] [legacy entries=2000, 0 = skip]\n", argv[0]);
+        return 2;
+    }
+
+    std::mt19937_64 rng(20240531);
+
+    auto start = std::chrono::steady_clock::now();
+    Synthetic synthetic = makeCrl(entries, rng);
+    std::printf("synthetic CRL: %zu entries, %.1f MB, generated in %.0f ms\n",
+                entries, synthetic.der.size() / 1048576.0, elapsedMs(start));
+
+    start = std::chrono::steady_clock::now();
+    UUCBufferedReader reader(synthetic.der.data(), static_cast<int>(synthetic.der.size()));
+    CCrl crl(reader);
+    std::printf("parse + index: %.0f ms (%d revoked serials)\n", elapsedMs(start), crl.getRevokedCount());
+
+    if (static_cast<size_t>(crl.getRevokedCount()) != entries) {
+        std::fprintf(stderr, "index size mismatch\n");
+        return 1;
+    }
+
+    // verifica: ogni seriale revocato con il motivo atteso, un seriale assente non revocato
+    for (size_t i = 0; i < entries; i++) {
+        CASN1Integer serial(synthetic.serials[i].data(), static_cast<unsigned int>(synthetic.serials[i].size()));
+        int reason = 0;
+        if (!crl.isRevoked(serial, nullptr, &reason, nullptr) || reason != synthetic.expected[i]) {
+            std::fprintf(stderr, "wrong status for entry %zu\n", i);
+            return 1;
+        }
+    }
+
+    std::vector<CASN1Integer> hits, misses;
+    for (int i = 0; i < 1024; i++) {
+        const Bytes &serial = synthetic.serials[rng() % entries];
+        hits.emplace_back(serial.data(), static_cast<unsigned int>(serial.size()));
+
+        Bytes absent(16);
+        for (uint8_t &b : absent)
+            b = static_cast<uint8_t>(rng());
+        absent[0] = static_cast<uint8_t>((absent[0] & 0x7F) | 0x01);
+        misses.emplace_back(absent.data(), static_cast<unsigned int>(absent.size()));
+    }
+
+    const std::vector<CASN1Integer> *sets[] = {&hits, &misses};
+    const char *labels[] = {"revoked", "not revoked"};
+    for (int s = 0; s < 2; s++) {
+        int found = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < lookups; i++) {
+            int reason = 0;
+            if (crl.isRevoked((*sets[s])[i & 1023], nullptr, &reason, nullptr))
+                found++;
+        }
+        double ms = elapsedMs(start);
+        std::printf("lookup %-12s %10d in %8.1f ms  %8.3f us/lookup  (%d revoked)\n",
+                    labels[s], lookups, ms, ms * 1000.0 / lookups, found);
+    }
+
+    if (legacyEntries > 0) {
+        Synthetic small = makeCrl(legacyEntries, rng);
+        UUCBufferedReader smallReader(small.der.data(), static_cast<int>(small.der.size()));
+        CCrl smallCrl(smallReader);
+        CASN1Integer last(small.serials.back().data(), static_cast<unsigned int>(small.serials.back().size()));
+
+        start = std::chrono::steady_clock::now();
+        bool revoked = legacyIsRevoked(smallCrl, last);
+        double legacyMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        int reason = 0;
+        for (int i = 0; i < 1000; i++)
+            smallCrl.isRevoked(last, nullptr, &reason, nullptr);
+        double indexedMs = elapsedMs(start) / 1000;
+
+        std::printf("%zu entries, last serial: linear scan %.1f ms (%s), index %.3f us\n",
+                    legacyEntries, legacyMs, revoked ? "found" : "not found", indexedMs * 1000.0);
+    }
+
+    return 0;
+}
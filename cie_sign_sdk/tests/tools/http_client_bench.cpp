@@ -0,0 +1,107 @@
+#include "../mock/mock_http_server.h"
+#include "HttpClient.h"
+#include "curl/curl.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+size_t discard(void*, size_t size, size_t nmemb, void*)
+{
+    return size * nmemb;
+}
+
+// Previous implementation: a new easy handle, hence a new connection, per request.
+bool legacyPost(const std::string& url, const std::vector<uint8_t>& body)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    CURL* ctx = curl_easy_init();
+    curl_easy_setopt(ctx, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(ctx, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(ctx, CURLOPT_POST, 1L);
+    curl_easy_setopt(ctx, CURLOPT_POSTFIELDS, body.data());
+    curl_easy_setopt(ctx, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(ctx, CURLOPT_WRITEFUNCTION, discard);
+
+    struct curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/ocsp-request");
+    curl_easy_setopt(ctx, CURLOPT_HTTPHEADER, headers);
+
+    CURLcode ret = curl_easy_perform(ctx);
+    long code = 0;
+    curl_easy_getinfo(ctx, CURLINFO_RESPONSE_CODE, &code);
+
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(ctx);
+    return ret == CURLE_OK && code == 200;
+}
+
+bool pooledPost(const std::string& url, const std::vector<uint8_t>& body)
+{
+    UUCByteArray data(body.data(), body.size());
+    CHttpClient::Request request(url.c_str());
+    request.pData = &data;
+    request.szContentType = "application/ocsp-request";
+
+    CHttpClient::Response response;
+    return CHttpClient::Perform(request, response) == 0 && response.nHttpCode == 200;
+}
+
+template <typename Post>
+void run(const char* label, MockHttpServer& server, const std::string& url, int requests, int threads,
+         const std::vector<uint8_t>& body, Post post)
+{
+    server.resetCounts();
+    std::atomic<int> next(0), failed(0);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
+        workers.emplace_back([&] {
+            while (next++ < requests)
+                if (!post(url, body))
+                    failed++;
+        });
+    for (std::thread& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-22s %6d requests, %2d threads: %8.0f req/s, %5d connections, %d failed\n",
+                label, requests, threads, requests / seconds, server.connectionCount(), failed.load());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int requests = argc > 1 ? std::atoi(argv[1]) : 5000;
+    int threads = argc > 2 ? std::atoi(argv[2]) : 4;
+    if (requests <= 0 || threads <= 0) {
+        std::fprintf(stderr, "Usage: %s [requests=5000] [threads=4]\n", argv[0]);
+        return 2;
+    }
+
+    // richiesta e risposta delle dimensioni tipiche di un OCSP
+    const std::vector<uint8_t> request(83, 0x30);
+    const std::vector<uint8_t> response(1500, 0x30);
+
+    MockHttpServer server;
+    server.setHandler("/ocsp", [&response](const std::vector<uint8_t>&, int*) { return response; });
+    if (!server.start()) {
+        std::fprintf(stderr, "cannot start the HTTP stand-in\n");
+        return 1;
+    }
+    const std::string url = server.url("/ocsp");
+
+    run("handle per request", server, url, requests, threads, request, legacyPost);
+    run("CHttpClient (pooled)", server, url, requests, threads, request, pooledPost);
+
+    CHttpClient::CleanUp();
+    server.stop();
+    return 0;
+}
@@ -1,113 +1,281 @@
-#include "PdfVerifier.h"
-#include "SignedDocument.h"
-#include "ASN1/Name.h"
+#include "disigonsdk.h"
+#include "VerifyReport.h"
+#include "CertStore.h"
+#include "ASN1/CrlCache.h"
+#include "ASN1/OCSPCache.h"
 
+#include <libxml/parser.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
-#include <iostream>
-#include <iterator>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
-#ifndef CIE_SIGN_SDK_SOURCE_DIR
-#define CIE_SIGN_SDK_SOURCE_DIR "."
-#endif
-
 namespace {
 
+namespace fs = std::filesystem;
+
 void usage(const char *prog)
 {
     std::fprintf(stderr,
-                 "Usage: %s <signed.pdf> [expected-common-name]\n"
-                 "Extracts every embedded CMS signature from the PDF and prints the subject CN.\n"
-                 "If expected-common-name is provided the tool fails when no signature matches it.\n",
-                 prog);
+                 "Usage: %s [options] <file|dir|@list.txt>...\n"
+                 "       %s <signed.pdf> [expected-common-name]\n"
+                 "Verifies every signature of PDF, p7m, m7m, tsd and XML documents (directories are\n"
+                 "scanned recursively) and writes one JSON line per document, then a summary on stderr.\n"
+                 "  --threads N            verification threads (default: hardware threads)\n"
+                 "  --revocation           check the signer certificates with OCSP/CRL\n"
+                 "  --cacert-dir DIR       CA directory (trusted list snapshot)\n"
+                 "  --tsl URL|FILE         trusted list loaded into the CA store (needs --cacert-dir)\n"
+                 "  --crl-cache DIR        on-disk CRL cache\n"
+                 "  --ocsp-cache DIR       on-disk OCSP response cache\n"
+                 "  --expect-cn CN         a document fails unless one of its signers has this CN\n"
+                 "  --out FILE             JSON lines to FILE (default: stdout)\n",
+                 prog, prog);
+}
+
+bool supported(const fs::path &path)
+{
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".pdf" || ext == ".p7m" || ext == ".m7m" || ext == ".tsd" || ext == ".xml";
 }
 
-std::vector<uint8_t> read_file(const std::string &path)
+void addInput(const std::string &input, std::vector<std::string> &files)
 {
-    std::ifstream file(path, std::ios::binary);
-    if (!file)
-        throw std::runtime_error("Unable to open PDF: " + path);
-    std::vector<uint8_t> buffer((std::istreambuf_iterator<char>(file)),
-                                std::istreambuf_iterator<char>());
-    if (buffer.empty())
-        throw std::runtime_error("PDF is empty: " + path);
-    return buffer;
+    std::error_code ec;
+    if (fs::is_directory(input, ec)) {
+        for (fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, ec), end;
+             it != end; it.increment(ec)) {
+            if (ec)
+                break;
+            if (it->is_regular_file(ec) && supported(it->path()))
+                files.push_back(it->path().string());
+        }
+    } else {
+        files.push_back(input);
+    }
+}
+
+struct Options {
+    bool revocation = false;
+    std::string expectedCn;
+};
+
+// esito di un documento: una riga JSON; true se il documento e' valido
+bool verifyDocument(DISIGON_CTX ctx, const Options &options, const std::string &path, std::string &line, double &ms)
+{
+    disigon_verify_set(ctx, DISIGON_OPT_INPUTFILE, const_cast<char *>(path.c_str()));
+    disigon_verify_set(ctx, DISIGON_OPT_VERIFY_REVOCATION, reinterpret_cast<void *>(options.revocation ? 1L : 0L));
+
+    VERIFY_RESULT result;
+    std::memset(&result, 0, sizeof(result));
+    auto start = std::chrono::steady_clock::now();
+    long error = disigon_verify_verify(ctx, &result);
+    ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    bool valid = error == 0;
+    bool cnFound = options.expectedCn.empty();
+    int count = 0;
+
+    char buffer[64];
+    std::snprintf(buffer, sizeof(buffer), ",\"type\":%d,\"error\":\"0x%lx\",\"ms\":%.3f",
+                  result.nResultType, static_cast<unsigned long>(error), ms);
+    line = "{\"path\":" + CVerifyReport::jsonString(path.c_str()) + buffer + ",\"signatures\":[";
+
+    SIGNER_INFOS *signers = result.verifyInfo.pSignerInfos;
+    if (error == 0 && signers) {
+        count = signers->nCount;
+        for (int i = 0; i < signers->nCount; i++) {
+            const SIGNER_INFO &signer = signers->pSignerInfo[i];
+            valid = valid && CVerifyReport::signerValid(signer.bitmask);
+            if (!cnFound && options.expectedCn == signer.szCN)
+                cnFound = true;
+            line += std::string(i ? "," : "") + CVerifyReport::signerJson(signer);
+        }
+    }
+    valid = valid && count > 0 && cnFound;
+
+    line += std::string("],\"valid\":") + (valid ? "true" : "false");
+    if (!options.expectedCn.empty())
+        line += std::string(",\"cn_match\":") + (cnFound ? "true" : "false");
+    line += "}\n";
+
+    disigon_verify_cleanup_result(&result);
+    return valid;
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+    if (sorted.empty())
+        return 0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.5);
+    return sorted[std::min(sorted.size() - 1, rank > 0 ? rank - 1 : 0)];
+}
+
+void printHitRate(const char *label, long hits, long misses)
+{
+    long total = hits + misses;
+    std::fprintf(stderr, "  %-22s %8ld hits %8ld misses  %5.1f%%\n", label, hits, misses,
+                 total > 0 ? 100.0 * hits / total : 0.0);
 }
 
 } // namespace
 
 int main(int argc, char **argv)
 {
-    if (argc < 2)
-    {
-        usage(argv[0]);
-        return EXIT_FAILURE;
-    }
+    Options options;
+    int threads = static_cast<int>(std::thread::hardware_concurrency());
+    std::string caCertDir, tsl, crlCache, ocspCache, outPath;
+    std::vector<std::string> inputs;
 
-    const char *pdfPath = argv[1];
-    const char *expectedCn = argc >= 3 ? argv[2] : nullptr;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                usage(argv[0]);
+                std::exit(2);
+            }
+            return argv[++i];
+        };
+        if (arg == "--threads")
+            threads = std::atoi(next().c_str());
+        else if (arg == "--revocation")
+            options.revocation = true;
+        else if (arg == "--cacert-dir")
+            caCertDir = next();
+        else if (arg == "--tsl")
+            tsl = next();
+        else if (arg == "--crl-cache")
+            crlCache = next();
+        else if (arg == "--ocsp-cache")
+            ocspCache = next();
+        else if (arg == "--expect-cn")
+            options.expectedCn = next();
+        else if (arg == "--out")
+            outPath = next();
+        else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else
+            inputs.push_back(arg);
+    }
 
-    std::vector<uint8_t> pdfBytes;
-    try
-    {
-        pdfBytes = read_file(pdfPath);
+    // forma originale: <signed.pdf> <CN atteso>
+    std::error_code ec;
+    if (argc == 3 && inputs.size() == 2 && !fs::exists(inputs[1], ec)) {
+        options.expectedCn = inputs[1];
+        inputs.pop_back();
     }
-    catch (const std::exception &ex)
-    {
-        std::fprintf(stderr, "Error: %s\n", ex.what());
-        return EXIT_FAILURE;
+
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 2;
     }
+    if (threads <= 0)
+        threads = 1;
 
-    PDFVerifier verifier;
-    int loadResult = verifier.Load(reinterpret_cast<const char *>(pdfBytes.data()),
-                                   static_cast<int>(pdfBytes.size()));
-    if (loadResult != 0)
-    {
-        std::fprintf(stderr, "PdfVerifier failed to load %s (code %d)\n", pdfPath, loadResult);
-        return EXIT_FAILURE;
+    if (!caCertDir.empty())
+        disigon_set(DISIGON_OPT_CACERT_DIR, const_cast<char *>(caCertDir.c_str()));
+    if (!crlCache.empty())
+        disigon_set(DISIGON_OPT_CRL_CACHE_DIR, const_cast<char *>(crlCache.c_str()));
+    if (!ocspCache.empty())
+        disigon_set(DISIGON_OPT_OCSP_CACHE_DIR, const_cast<char *>(ocspCache.c_str()));
+    if (!tsl.empty()) {
+        long ret = disigon_set(DISIGON_OPT_TSL_URL, const_cast<char *>(tsl.c_str()));
+        if (ret != 0) {
+            std::fprintf(stderr, "Unable to load the trusted list %s (0x%lx)\n", tsl.c_str(), static_cast<unsigned long>(ret));
+            return 1;
+        }
     }
 
-    bool any = false;
-    bool matched = false;
-    int signatureIndex = 0;
-
-    while (true)
-    {
-        UUCByteArray cmsArray;
-        SignatureAppearanceInfo info{};
-        int rc = verifier.GetSignature(signatureIndex, cmsArray, info);
-        if (rc < 0)
-            break;
-        any = true;
-        CSignedDocument signedDoc(cmsArray.getContent(), cmsArray.getLength());
-        CCertificate signerCert = signedDoc.getSignerCertificate(0);
-        CName subject = signerCert.getSubject();
-        std::string cn = subject.getField(OID_COMMON_NAME);
-        std::printf("Signature #%d subject CN: %s\n", signatureIndex, cn.c_str());
-        if (expectedCn && cn == expectedCn)
-        {
-            matched = true;
+    std::vector<std::string> files;
+    for (const std::string &input : inputs) {
+        if (input[0] == '@') {
+            std::ifstream list(input.substr(1));
+            if (!list) {
+                std::fprintf(stderr, "Unable to open list: %s\n", input.c_str() + 1);
+                return 2;
+            }
+            std::string line;
+            while (std::getline(list, line)) {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (!line.empty())
+                    addInput(line, files);
+            }
+        } else {
+            addInput(input, files);
         }
-        ++signatureIndex;
     }
 
-    if (!any)
-    {
-        std::fprintf(stderr, "No signatures found inside %s\n", pdfPath);
-        return EXIT_FAILURE;
+    FILE *out = stdout;
+    if (!outPath.empty() && !(out = std::fopen(outPath.c_str(), "w"))) {
+        std::fprintf(stderr, "Unable to write %s\n", outPath.c_str());
+        return 2;
     }
 
-    if (expectedCn && !matched)
-    {
-        std::fprintf(stderr,
-                     "Expected common name '%s' not found in %s\n",
-                     expectedCn,
-                     pdfPath);
-        return EXIT_FAILURE;
+    // libxml2 va inizializzata prima dei thread; i contesti si creano in serie
+    // perche' disigon_verify_init azzera lo stato globale del proxy
+    xmlInitParser();
+    threads = static_cast<int>(std::min<size_t>(threads, std::max<size_t>(files.size(), 1)));
+    std::vector<DISIGON_CTX> contexts;
+    for (int t = 0; t < threads; t++)
+        contexts.push_back(disigon_verify_init());
+
+    std::vector<double> latencies(files.size());
+    std::atomic<size_t> nextFile(0);
+    std::atomic<int> failed(0);
+    std::mutex outMutex;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            std::string line;
+            for (size_t i = nextFile++; i < files.size(); i = nextFile++) {
+                if (!verifyDocument(contexts[t], options, files[i], line, latencies[i]))
+                    failed++;
+                std::lock_guard<std::mutex> lock(outMutex);
+                std::fputs(line.c_str(), out);
+            }
+        });
     }
+    for (std::thread &worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (DISIGON_CTX ctx : contexts)
+        disigon_verify_cleanup(ctx);
+    if (out != stdout)
+        std::fclose(out);
+    else
+        std::fflush(out);
+
+    std::sort(latencies.begin(), latencies.end());
+    std::fprintf(stderr, "documents: %zu  failed: %d  threads: %d  %.2f s (%.1f documents/s)\n",
+                 files.size(), failed.load(), threads, seconds, seconds > 0 ? files.size() / seconds : 0.0);
+    std::fprintf(stderr, "latency ms: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f\n",
+                 percentile(latencies, 50), percentile(latencies, 90), percentile(latencies, 99),
+                 latencies.empty() ? 0.0 : latencies.back());
+
+    long hits, misses;
+    std::fprintf(stderr, "caches:\n");
+    CCertStore::GetStats(&hits, &misses);
+    printHitRate("certificate signatures", hits, misses);
+    COCSPCache::GetStats(&hits, &misses);
+    printHitRate("OCSP responses", hits, misses);
+    CCrlCache::GetStats(&hits, &misses);
+    printHitRate("CRLs", hits, misses);
 
-    return EXIT_SUCCESS;
+    return failed == 0 && !files.empty() ? EXIT_SUCCESS : EXIT_FAILURE;
 }